@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+
+#include "fixture.hpp"
+#include "generator/constant_folding.hpp"
+
+namespace {
+using kuso::test::parse;
+using kuso::test::main_body;
+
+auto exit_value(kuso::AST& ast) -> std::optional<int64_t> {
+  const auto& exit = std::get<std::unique_ptr<kuso::AST::Exit>>(main_body(ast).back().statement);
+  return kuso::ConstantFolding::constant_value(*exit->value);
+}
+}  // namespace
+
+TEST(ConstantFolding, FoldsExpressions) {
+  auto ast = parse("main { a : int = 2 * 3 + 4; b : int = a - 1 - 1; exit (a + b) / 4 == 5; };");
+
+  kuso::ConstantFolding folding;
+  folding.run(ast);
+  ASSERT_EQ(exit_value(ast), 1);
+  ASSERT_EQ(folding.propagated(), 3);
+}
+
+TEST(ConstantFolding, FoldsModuloAndPowers) {
+  auto ast = parse("main { a : int = -7 % 3; b : int = 2 ^ 10; exit a + b + -(3 ^ -1) + (5 % 0 - 5 % 0); };");
+
+  kuso::ConstantFolding folding;
+  folding.run(ast);
+  ASSERT_EQ(exit_value(ast), std::nullopt);
+
+  ast = parse("main { exit -7 % 3 + 2 ^ 10 + 3 ^ -1; };");
+  folding.run(ast);
+  ASSERT_EQ(exit_value(ast), 1023);
+}
+
+TEST(ConstantFolding, Branches) {
+  auto ast = parse(
+      "main { a : int = 1; c : i8 = 1;"
+      "if (a < 2) { a = 5; } else { a = 6; };"
+      "if (c) { a = 7; };"
+      "exit a; };");
+
+  kuso::ConstantFolding folding;
+  folding.run(ast);
+  const auto& first = std::get<std::unique_ptr<kuso::AST::If>>(main_body(ast).at(2).statement);
+  ASSERT_TRUE(first->elseBody.empty());
+  ASSERT_EQ(folding.branches(), 1);
+  ASSERT_EQ(exit_value(ast), std::nullopt);
+}
+
+TEST(ConstantFolding, Loops) {
+  auto ast = parse(
+      "main { a : int = 0; b : int = 3;"
+      "while (a < 10) { a = a + b; };"
+      "while (a == 0) { b = 1; };"
+      "exit b; };");
+
+  kuso::ConstantFolding folding;
+  folding.run(ast);
+  const auto& loop = std::get<std::unique_ptr<kuso::AST::While>>(main_body(ast).at(2).statement);
+  ASSERT_EQ(kuso::ConstantFolding::constant_value(*loop->condition), std::nullopt);
+  ASSERT_EQ(exit_value(ast), std::nullopt);
+}
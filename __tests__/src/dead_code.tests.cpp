@@ -0,0 +1,37 @@
+#include <gtest/gtest.h>
+
+#include "fixture.hpp"
+#include "generator/dead_code.hpp"
+
+using kuso::test::parse;
+using kuso::test::body;
+
+TEST(DeadCode, RemovesDeadStores) {
+  auto ast = parse(
+      "func f(n : int) -> int {"
+      "  a : int = n * 2; b : int = f(n); a = n + 1;"
+      "  i : int = 0; t : int = 0;"
+      "  while (i < n) { t = i; a = a + t; i = i + 1; t = 4; };"
+      "  return a; a = 3; };"
+      "main { exit f(1); };");
+
+  kuso::DeadCode deadCode;
+  deadCode.run(ast);
+  ASSERT_EQ(deadCode.unreachable(), 1);
+  ASSERT_EQ(deadCode.stores(), 3);
+
+  const auto& func = body(ast, "f");
+  ASSERT_EQ(func.size(), 7);
+  ASSERT_FALSE(std::get<std::unique_ptr<kuso::AST::Declaration>>(func.at(0).statement)->value);
+  ASSERT_TRUE(std::get<std::unique_ptr<kuso::AST::Declaration>>(func.at(1).statement)->value);
+  ASSERT_FALSE(std::get<std::unique_ptr<kuso::AST::Declaration>>(func.at(4).statement)->value);
+  ASSERT_EQ(std::get<std::unique_ptr<kuso::AST::While>>(func.at(5).statement)->body.size(), 3);
+}
+
+TEST(DeadCode, AssemblyReadsLocals) {
+  auto ast = parse("func f() -> int { a : int = 1; asm { nop }; return 0; }; main { exit f(); };");
+
+  kuso::DeadCode deadCode;
+  deadCode.run(ast);
+  ASSERT_EQ(deadCode.stores(), 0);
+}
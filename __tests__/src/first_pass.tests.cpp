@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include <set>
+
+#include "fixture.hpp"
+#include "generator/first_pass.hpp"
+
+using kuso::test::parse;
+
+TEST(FirstPass, CallerSaves) {
+  auto ast = parse(
+      "func m(x : int, y : int) -> int { return x + y; };"
+      "func k() -> int { return m(1, 2); };"
+      "func g(a : int) -> int { t : int = k(); return a + t; };"
+      "main { exit g(4); };");
+
+  kuso::FirstPass pass;
+  ASSERT_TRUE(pass.types_pass(ast));
+  ASSERT_TRUE(pass.function_pass(ast));
+
+  const auto& func = pass.get_function("g").value().get();
+  ASSERT_TRUE(func.spills.empty());
+  ASSERT_TRUE(func.saves.empty());
+  ASSERT_EQ(func.callSaves.size(), 1);
+  ASSERT_EQ(func.callSaves.begin()->second, std::vector<kuso::x64::Register>{kuso::x64::Register::RDI});
+
+  const auto& leaf = pass.get_function("m").value().get();
+  ASSERT_FALSE(leaf.clobbers.at(static_cast<size_t>(kuso::x64::Register::RSI)));
+  ASSERT_TRUE(pass.get_function("k").value().get().clobbers.at(static_cast<size_t>(kuso::x64::Register::RSI)));
+}
+
+TEST(FirstPass, ArgumentOrder) {
+  auto ast = parse(
+      "func h(x : int, y : int) -> int { return x - y; };"
+      "func f(a : int, b : int) -> int { t : int = h(b, a); return t; };"
+      "func g(a : int, b : int) -> int { t : int = h(a, b); return t; };"
+      "main { exit f(1, 2) + g(1, 2); };");
+
+  kuso::FirstPass pass;
+  ASSERT_TRUE(pass.types_pass(ast));
+  ASSERT_TRUE(pass.function_pass(ast));
+
+  // b is moved into rdi before a is read from it
+  ASSERT_EQ(pass.get_function("f").value().get().spills.size(), 1);
+  ASSERT_TRUE(pass.get_function("f").value().get().spills.contains("a"));
+  ASSERT_TRUE(pass.get_function("g").value().get().spills.empty());
+}
+
+TEST(FirstPass, CalleeSaved) {
+  auto ast = parse(
+      "func f(a : int, b : int) -> int { asm { mov rbx, 1 }; return f(b, a) + 1; };"
+      "main { exit f(1, 2); };");
+
+  kuso::FirstPass pass;
+  ASSERT_TRUE(pass.types_pass(ast));
+  ASSERT_TRUE(pass.function_pass(ast));
+
+  const auto& func = pass.get_function("f").value().get();
+  ASSERT_EQ(func.saves.size(), 1);
+  ASSERT_EQ(func.saves.begin()->first, kuso::x64::Register::RBX);
+  ASSERT_EQ(func.spills.size(), 1);
+  ASSERT_EQ(func.spills.begin()->first, "a");
+  ASSERT_TRUE(func.tailCalls.empty());
+}
+
+TEST(FirstPass, SharesSlots) {
+  auto ast = parse(
+      "func f(n : int) -> int {"
+      "  s : int = 0;"
+      "  if (n) { a : int = n * 3; s = a; } else { b : int = n * 5; s = b; };"
+      "  c : int = 1;"
+      "  while (n) { s = s + c; d : int = n; n = d - 1; };"
+      "  return s;"
+      "};"
+      "main { exit f(4); };");
+
+  kuso::FirstPass pass;
+  ASSERT_TRUE(pass.types_pass(ast));
+  ASSERT_TRUE(pass.function_pass(ast));
+
+  // a, b and c share a slot, c is read again by the next iteration after d is declared
+  const auto& func = pass.get_function("f").value().get();
+  std::set<int64_t> slots;
+  for (const auto& [decl, local] : func.locals) slots.insert(local.location.disp);
+  ASSERT_EQ(func.locals.size(), 5);
+  ASSERT_EQ(slots.size(), 3);
+}
+
+TEST(FirstPass, Layout) {
+  auto ast = parse(
+      "type Rec { a : i8; b : int; c : i16; };"
+      "type Packed @packed { a : i8; b : int; };"
+      "type Wide @align(64) @ordered { a : i8; b : i32; };"
+      "main { exit 0; };");
+
+  kuso::FirstPass pass;
+  ASSERT_TRUE(pass.types_pass(ast));
+
+  const auto& rec = pass.get_type("Rec").value().get();
+  ASSERT_EQ(rec.size, 16);
+  ASSERT_EQ(rec.padding, 5);
+  ASSERT_EQ(rec.get_offset("b"), 0);
+  ASSERT_EQ(rec.get_offset("c"), 8);
+  ASSERT_EQ(rec.get_offset("a"), 10);
+
+  const auto& packed = pass.get_type("Packed").value().get();
+  ASSERT_EQ(packed.size, 9);
+  ASSERT_EQ(packed.get_offset("b"), 1);
+
+  const auto& wide = pass.get_type("Wide").value().get();
+  ASSERT_EQ(wide.size, 64);
+  ASSERT_EQ(wide.align, 64);
+  ASSERT_EQ(wide.get_offset("b"), 4);
+}
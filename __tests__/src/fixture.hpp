@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "lexer/lexer.hpp"
+#include "parser/parser.hpp"
+
+namespace kuso::test {
+inline auto parse(const std::string& source) -> kuso::AST {
+  kuso::Lexer  lexer;
+  kuso::Parser parser;
+  auto         ast = parser.parse(lexer.tokenize(source));
+  if (!ast) throw std::runtime_error("Parse failed");
+  return std::move(ast.value());
+}
+
+inline auto body(kuso::AST& ast, const std::string& name) -> std::vector<kuso::AST::Statement>& {
+  for (auto& statement : ast) {
+    auto* func = std::get_if<std::unique_ptr<kuso::AST::Func>>(&statement.statement);
+    if (func && (*func)->name == name) return (*func)->body;
+  }
+  throw std::runtime_error("No function " + name);
+}
+
+inline auto main_body(kuso::AST& ast) -> std::vector<kuso::AST::Statement>& {
+  for (auto& statement : ast) {
+    auto* main = std::get_if<std::unique_ptr<kuso::AST::Main>>(&statement.statement);
+    if (main) return (*main)->body;
+  }
+  throw std::runtime_error("No main");
+}
+}  // namespace kuso::test
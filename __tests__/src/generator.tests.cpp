@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include "fixture.hpp"
+#include "generator/generator.hpp"
+
+namespace {
+auto generate(const std::string& source) -> std::string {
+  auto ast = kuso::test::parse(source);
+  auto path = std::filesystem::temp_directory_path() /
+              (std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()) + ".asm");
+  {
+    kuso::Generator generator(path, false);
+    generator.generate(ast);
+  }
+
+  std::ifstream     file(path);
+  std::stringstream assembly;
+  assembly << file.rdbuf();
+  std::filesystem::remove(path);
+  return assembly.str();
+}
+}  // namespace
+
+TEST(Generator, BranchesOnCompares) {
+  auto assembly = generate(
+      "func f(a : int, b : int) -> int { s : int = 0; while (a < b) { a = a + 1; s = s + 1; };"
+      "if (s > 2) { return s; }; return 0; };"
+      "main { exit f(1, 4); };");
+
+  ASSERT_EQ(assembly.find("set"), std::string::npos);
+  ASSERT_EQ(assembly.find("movzx"), std::string::npos);
+  ASSERT_EQ(assembly.find("test"), std::string::npos);
+  // the rotated loop jumps back to its body while the condition holds
+  ASSERT_NE(assembly.find("cmp rax, r10\njl label_0\n"), std::string::npos);
+  // the if skips its body when the condition doesn't hold
+  ASSERT_NE(assembly.find("cmp rax, r10\njle label_3\n"), std::string::npos);
+}
+
+TEST(Generator, FramesFunctions) {
+  auto assembly = generate(
+      "type Big { a : int; b : int; c : int; d : int; e : int; f : int; g : int; h : int;"
+      "i : int; j : int; k : int; l : int; m : int; n : int; o : int; p : int; };"
+      "func leaf(x : int) -> int { big : Big; big.a = x; asm { mov rbx, 1 }; return big.a; };"
+      "func outer(x : int) -> int { asm { mov r12, 2 }; return leaf(x) + 1; };"
+      "main { exit outer(3); };");
+
+  auto leafStart = assembly.find(".func_0:\n");
+  auto outerStart = assembly.find(".func_1:\n");
+  auto mainStart = assembly.find("_start:\n");
+  ASSERT_NE(leafStart, std::string::npos);
+  ASSERT_NE(outerStart, std::string::npos);
+  ASSERT_NE(mainStart, std::string::npos);
+  auto leaf = assembly.substr(leafStart, outerStart - leafStart);
+  auto outer = assembly.substr(outerStart, mainStart - outerStart);
+
+  // the frame is too big for the red zone, so even the leaf sets up rbp
+  ASSERT_EQ(leaf.find(".func_0:\npush qword rbp\nmov rbp, rsp\nsub rsp, 144\nmov -136[rbp], rbx\n"), 0);
+  ASSERT_NE(leaf.find("mov rbx, -136[rbp]\nleave\nret\n"), std::string::npos);
+  ASSERT_EQ(outer.find(".func_1:\npush qword rbp\nmov rbp, rsp\nsub rsp, 16\nmov -8[rbp], r12\n"), 0);
+  ASSERT_NE(outer.find("call .func_0\n"), std::string::npos);
+  ASSERT_NE(outer.find("mov r12, -8[rbp]\nleave\nret\n"), std::string::npos);
+
+  // the whole frame is reserved once and released by leave
+  for (const auto& func : {leaf, outer}) {
+    ASSERT_EQ(func.find("sub rsp"), func.rfind("sub rsp"));
+    ASSERT_EQ(func.find("add rsp"), std::string::npos);
+    ASSERT_EQ(func.find("pop qword rbp"), std::string::npos);
+  }
+}
@@ -0,0 +1,379 @@
+#include <gtest/gtest.h>
+
+#include "fixture.hpp"
+#include "generator/argument_splitting.hpp"
+#include "generator/constant_folding.hpp"
+#include "ir/cfg.hpp"
+#include "ir/dead_code.hpp"
+#include "ir/inliner.hpp"
+#include "ir/lowering.hpp"
+#include "ir/regalloc.hpp"
+#include "ir/scalar_replacement.hpp"
+#include "ir/slot_promotion.hpp"
+#include "ir/value_numbering.hpp"
+#include "ir/verifier.hpp"
+#include "ir/x64_lowering.hpp"
+
+namespace {
+using kuso::test::parse;
+
+auto value(kuso::ir::Function& func, kuso::ir::BlockId block, kuso::ir::Op operation,
+           std::vector<kuso::ir::VReg> operands, int64_t imm = 0) -> kuso::ir::VReg {
+  kuso::ir::Instruction inst(operation, kuso::ir::Type::I64);
+  inst.dest = func.new_vreg(kuso::ir::Type::I64);
+  inst.operands = std::move(operands);
+  inst.imm = imm;
+  func.blocks[block].instructions.push_back(inst);
+  return inst.dest;
+}
+
+void terminate(kuso::ir::Function& func, kuso::ir::BlockId block, kuso::ir::Op operation,
+               std::vector<kuso::ir::VReg> operands, std::vector<kuso::ir::BlockId> targets) {
+  kuso::ir::Instruction inst(operation);
+  inst.operands = std::move(operands);
+  inst.blocks = std::move(targets);
+  func.blocks[block].instructions.push_back(inst);
+}
+}  // namespace
+
+TEST(IR, LowersValidSSA) {
+  auto ast = parse(
+      "type Vec { x : int; y : i8; };"
+      "func f(a : int, b : int) -> int { if (a < b) { return b; }; return a; };"
+      "main { v : Vec; v.y = 3; n : int = 0; while (n < 4) { n = n + f(n, v.y); }; exit n; };");
+
+  kuso::ir::Lowering lowering;
+  auto               module = lowering.lower(ast);
+  ASSERT_TRUE(module.has_value());
+  ASSERT_TRUE(kuso::ir::verify(module.value()).empty());
+
+  auto& func = module->find("f").value().get();
+  ASSERT_EQ(func.params.size(), 2);
+  ASSERT_EQ(func.blocks.size(), 3);
+  ASSERT_FALSE(func.has_asm());
+}
+
+TEST(IR, VerifiesPhis) {
+  // bb0 -> bb1 | bb2 -> bb3, %3 = phi [bb1: %1], [bb2: %2]
+  kuso::ir::Function func;
+  func.name = "phi";
+  for (int i = 0; i < 4; ++i) func.new_block();
+
+  auto cond = value(func, 0, kuso::ir::Op::CONST, {}, 1);
+  terminate(func, 0, kuso::ir::Op::BR, {cond}, {1, 2});
+  auto one = value(func, 1, kuso::ir::Op::CONST, {}, 1);
+  terminate(func, 1, kuso::ir::Op::JMP, {}, {3});
+  auto two = value(func, 2, kuso::ir::Op::CONST, {}, 2);
+  terminate(func, 2, kuso::ir::Op::JMP, {}, {3});
+
+  kuso::ir::Instruction phi(kuso::ir::Op::PHI, kuso::ir::Type::I64);
+  phi.dest = func.new_vreg(kuso::ir::Type::I64);
+  phi.operands = {one, two};
+  phi.blocks = {1, 2};
+  func.blocks[3].instructions.push_back(phi);
+  terminate(func, 3, kuso::ir::Op::RET, {phi.dest}, {});
+
+  ASSERT_TRUE(kuso::ir::verify(func).empty());
+
+  kuso::ir::DominatorTree dom(func);
+  ASSERT_EQ(dom.idom(3), 0);
+  ASSERT_TRUE(dom.dominates(0, 3));
+  ASSERT_FALSE(dom.dominates(1, 3));
+
+  // a value from the other branch does not dominate the use
+  func.blocks[3].instructions.back().operands = {one};
+  ASSERT_FALSE(kuso::ir::verify(func).empty());
+
+  func.blocks[3].instructions.back().operands = {phi.dest};
+  func.blocks[3].instructions.front().blocks = {1, 1};
+  ASSERT_FALSE(kuso::ir::verify(func).empty());
+}
+
+TEST(IR, AllocatesRegisters) {
+  // sixteen call results are live at once, more than there are callee saved registers
+  kuso::ir::Function func;
+  func.name = "pressure";
+  func.new_block();
+
+  std::vector<kuso::ir::VReg> values;
+  for (int i = 0; i < 16; ++i) {
+    kuso::ir::Instruction call(kuso::ir::Op::CALL, kuso::ir::Type::I64);
+    call.dest = func.new_vreg(kuso::ir::Type::I64);
+    call.name = "g";
+    func.blocks[0].instructions.push_back(call);
+    values.push_back(call.dest);
+  }
+  auto sum = values.front();
+  for (size_t i = 1; i < values.size(); ++i) sum = value(func, 0, kuso::ir::Op::ADD, {sum, values[i]});
+  terminate(func, 0, kuso::ir::Op::RET, {sum}, {});
+  ASSERT_TRUE(kuso::ir::verify(func).empty());
+
+  kuso::ir::LinearScan scan(func, true);
+  auto                 first = 2 * static_cast<int64_t>(values.size());
+  size_t               spilled = 0;
+  for (size_t i = 1; i < values.size(); ++i) {
+    auto location = scan.location(values[i], first);
+    if (location.kind == kuso::ir::Location::Kind::STACK) {
+      ++spilled;
+      continue;
+    }
+    ASSERT_EQ(location.kind, kuso::ir::Location::Kind::REGISTER);
+    for (size_t j = 1; j < i; ++j) ASSERT_NE(scan.location(values[j], first), location);
+  }
+  ASSERT_GT(spilled, 0);
+
+  // values live across a call end up in callee saved registers or on the stack
+  auto across = scan.location(values.front(), 3);
+  ASSERT_TRUE(across.kind == kuso::ir::Location::Kind::STACK || kuso::x64::is_callee_saved(across.reg));
+}
+
+TEST(IR, RemovesDeadCode) {
+  kuso::ir::Function func;
+  func.name = "f";
+  auto entry = func.new_block();
+  auto taken = func.new_block();
+  auto dropped = func.new_block();
+
+  auto slot = value(func, entry, kuso::ir::Op::LOCAL, {}, 8);
+  auto one = value(func, entry, kuso::ir::Op::CONST, {}, 1);
+  auto unused = value(func, entry, kuso::ir::Op::ADD, {one, one});
+  kuso::ir::Instruction store(kuso::ir::Op::STORE);
+  store.operands = {slot, unused};
+  store.size = 8;
+  func.blocks[entry].instructions.push_back(store);
+  terminate(func, entry, kuso::ir::Op::BR, {one}, {taken, dropped});
+  terminate(func, taken, kuso::ir::Op::RET, {one}, {});
+  terminate(func, dropped, kuso::ir::Op::RET, {one}, {});
+
+  kuso::ir::DeadCode deadCode;
+  deadCode.run(func);
+  ASSERT_TRUE(kuso::ir::verify(func).empty());
+  ASSERT_EQ(func.blocks.size(), 2);
+  ASSERT_EQ(func.blocks[entry].instructions.size(), 2);
+  ASSERT_EQ(func.blocks[entry].instructions.back().op, kuso::ir::Op::JMP);
+}
+
+TEST(IR, KeepsFaultingDivisions) {
+  kuso::ir::Function func;
+  func.name = "f";
+  auto entry = func.new_block();
+
+  auto zero = value(func, entry, kuso::ir::Op::CONST, {}, 0);
+  auto one = value(func, entry, kuso::ir::Op::CONST, {}, 1);
+  auto sum = value(func, entry, kuso::ir::Op::ADD, {zero, one});
+  value(func, entry, kuso::ir::Op::MOD, {sum, zero});
+  value(func, entry, kuso::ir::Op::DIV, {sum, one});
+  terminate(func, entry, kuso::ir::Op::RET, {one}, {});
+
+  kuso::ir::DeadCode deadCode;
+  deadCode.run(func);
+  ASSERT_TRUE(kuso::ir::verify(func).empty());
+  ASSERT_EQ(func.blocks[entry].instructions.size(), 5);
+  ASSERT_EQ(func.blocks[entry].instructions[3].op, kuso::ir::Op::MOD);
+}
+
+TEST(IR, InlinesSmallFunctions) {
+  auto ast = parse(
+      "func pick(a : int, b : int) -> int { if (a < b) { return b; }; return a; };"
+      "func fact(n : int) -> int { if (n < 2) { return 1; }; return n * fact(n - 1); };"
+      "func keep(a : int) -> int @noinline { return a + 1; };"
+      "main { n : int = 0; while (n < 4) { n = n + pick(n, 2) + keep(n); }; exit fact(n); };");
+
+  kuso::ir::Lowering lowering;
+  auto               module = lowering.lower(ast);
+  ASSERT_TRUE(module.has_value());
+
+  kuso::ir::Inliner inliner;
+  inliner.run(module.value());
+  ASSERT_TRUE(kuso::ir::verify(module.value()).empty());
+  ASSERT_EQ(inliner.inlined(), 1);
+  ASSERT_EQ(inliner.removed(), 1);
+  ASSERT_FALSE(module->find("pick").has_value());
+  ASSERT_EQ(module->find("keep")->get().inlining, kuso::ir::Inlining::NEVER);
+
+  std::vector<std::string> calls;
+  for (const auto& block : module->find("main")->get().blocks) {
+    for (const auto& inst : block.instructions) {
+      if (inst.op == kuso::ir::Op::CALL) calls.push_back(inst.name);
+    }
+  }
+  ASSERT_EQ(calls, (std::vector<std::string>{"keep", "fact"}));
+}
+
+TEST(IR, ReturnsTwoValues) {
+  auto ast = parse(
+      "type Pair { a : int; b : i8; };"
+      "func divmod(a : int, b : int) -> (int, int) { return a / b, a % b; };"
+      "func pair(a : int) -> Pair { p : Pair; p.a = a; p.b = 1; return p; };"
+      "main { (q : int, r : i8) = divmod(7, 2); p : Pair = pair(q); exit p.b + r; };");
+
+  kuso::ir::Lowering lowering;
+  auto               module = lowering.lower(ast);
+  ASSERT_TRUE(module.has_value());
+  ASSERT_TRUE(module->find("divmod")->get().pair);
+  ASSERT_TRUE(module->find("pair")->get().pair);
+
+  kuso::ir::Inliner inliner;
+  inliner.run(module.value());
+  ASSERT_TRUE(kuso::ir::verify(module.value()).empty());
+  ASSERT_EQ(inliner.inlined(), 0);
+
+  // both calls read their second value right after returning
+  const auto& insts = module->find("main")->get().blocks.front().instructions;
+  auto        results = 0;
+  for (size_t inst = 1; inst < insts.size(); ++inst) {
+    if (insts[inst].op != kuso::ir::Op::RESULT) continue;
+    ASSERT_EQ(insts[inst - 1].op, kuso::ir::Op::CALL);
+    ++results;
+  }
+  ASSERT_EQ(results, 2);
+}
+
+TEST(IR, KeepsCallValuesApartFromSplitMoves) {
+  // reduced from a fuzzed program, p4 was split out of the register the value of the inlined f2 call took
+  auto ast = parse(
+      "func f0() -> int { v10 : int = (-18); return (v10 + (v10 * 1)); };"
+      "func f1(p0 : int) -> int {"
+      "  v26 : int = 11;"
+      "  return (((((p0 < (-1)) - (p0 - v26)) * (-v26)) + (p0 * 1)) + (v26 * 2));"
+      "};"
+      "func f2(p0 : int, p1 : int, p2 : int, p3 : int) -> int {"
+      "  if (((8 >= p3) < (p0 - p1))) {"
+      "    v30 : int = p3; i21 : int = 3;"
+      "    while (i21 != 3) { };"
+      "    if (((v30 * p1) > p3)) { };"
+      "  };"
+      "  p1 = (f0() > ((p0 * p1) <= (p1 + 20)));"
+      "  return (((((30 / ((21 * 21) + 1)) + (p0 * 1)) + (p1 * 2)) + (p2 * 3)) + (p3 * 4));"
+      "};"
+      "func f3(p0 : int, p1 : int, p2 : int, p3 : int, p4 : int, p5 : int, p6 : int) -> int {"
+      "  v9 : int = ((p1 >= (p5 == (-15))) + (p6 / 1));"
+      "  i02 : int = 2;"
+      "  while (i02 < 7) {"
+      "    p1 = f2(f0(), (f1((-8)) / 8), p2, p6);"
+      "    v29 : int = (f0() ^ 5);"
+      "    if ((f0() >= (p5 % ((v9 * v9) + 1)))) { p4 = p1; v21 : int = f1(((p6 == 12) < v29)); };"
+      "    i02 = i02 + 2;"
+      "  };"
+      "  return ((((((((((((p6 % ((p2 * p2) + 1)) >= (p0 ^ 4)) >= f0()) + (p0 * 1)) + (p1 * 2)) + (p2 * 3))"
+      "    + (p3 * 4)) + (p4 * 5)) + (p5 * 6)) + (p6 * 7)) + (v9 * 8)) + (i02 * 9));"
+      "};"
+      "main { exit f3(35, -7, 22, 2, 26, 36, 19); };");
+
+  kuso::ConstantFolding folding;
+  folding.run(ast);
+  kuso::ir::Lowering lowering;
+  auto               module = lowering.lower(ast);
+  ASSERT_TRUE(module.has_value());
+
+  kuso::ir::Inliner inliner;
+  inliner.run(module.value());
+  kuso::ir::SlotPromotion slotPromotion;
+  slotPromotion.run(module.value());
+  ASSERT_TRUE(kuso::ir::verify(module.value()).empty());
+
+  // a call copies its value out of rax before the moves ahead of the next instruction run
+  size_t calls = 0;
+  for (const auto& func : module->functions) {
+    kuso::ir::LinearScan scan(func, true);
+    size_t               index = 0;
+    for (const auto& block : func.blocks) {
+      for (const auto& inst : block.instructions) {
+        ++index;
+        if (inst.op != kuso::ir::Op::CALL || inst.dest == kuso::ir::NO_VREG) continue;
+        auto written = scan.location(inst.dest, 2 * static_cast<int64_t>(index));
+        for (const auto& move : scan.moves_before(index)) ASSERT_NE(move.second, written);
+        ++calls;
+      }
+    }
+  }
+  ASSERT_GT(calls, 0);
+}
+
+TEST(IR, NumbersRedundantValues) {
+  auto ast = parse(
+      "func f(a : int, b : int) -> int { c : int = (a + b) * (b + a); a = 1; return c + a; };"
+      "main { exit f(1, 2); };");
+
+  kuso::ir::Lowering lowering;
+  auto               module = lowering.lower(ast);
+  ASSERT_TRUE(module.has_value());
+
+  kuso::ir::ValueNumbering valueNumbering;
+  valueNumbering.run(module->find("f")->get());
+  ASSERT_TRUE(kuso::ir::verify(module.value()).empty());
+  ASSERT_EQ(valueNumbering.values(), 1);
+  ASSERT_EQ(valueNumbering.loads(), 6);
+}
+
+TEST(IR, PromotesSlots) {
+  auto ast = parse(
+      "func f(n : int) -> int { s : int = 0; while (n) { s = s + n; n = n - 1; }; return s; };"
+      "main { exit f(4); };");
+
+  kuso::ir::Lowering lowering;
+  auto               module = lowering.lower(ast);
+  ASSERT_TRUE(module.has_value());
+
+  auto&                   func = module->find("f")->get();
+  kuso::ir::SlotPromotion slotPromotion;
+  slotPromotion.run(func);
+  ASSERT_TRUE(kuso::ir::verify(module.value()).empty());
+  ASSERT_EQ(slotPromotion.promoted(), 2);
+  for (const auto& block : func.blocks) {
+    for (const auto& inst : block.instructions) {
+      ASSERT_NE(inst.op, kuso::ir::Op::LOAD);
+      ASSERT_NE(inst.op, kuso::ir::Op::STORE);
+    }
+  }
+}
+
+TEST(IR, BranchesOnCompares) {
+  auto ast = parse(
+      "func f(n : int) -> int { i : int = 0; s : int = 0; while (i < n) { s = s + i; i = i + 1; }; return s; };"
+      "main { exit f(4); };");
+
+  kuso::ir::Lowering lowering;
+  auto               module = lowering.lower(ast);
+  ASSERT_TRUE(module.has_value());
+
+  kuso::ir::SlotPromotion slotPromotion;
+  slotPromotion.run(module.value());
+
+  kuso::ir::X64Lowering x64Lowering(true);
+  auto                  assembly = x64Lowering.generate(module.value());
+  ASSERT_EQ(assembly.find("setl"), std::string::npos);
+  ASSERT_EQ(assembly.find("test"), std::string::npos);
+  // the latch jumps straight back to the header
+  ASSERT_NE(assembly.find("jl label_1\n"), std::string::npos);
+  ASSERT_EQ(assembly.find("jmp label_1\n"), std::string::npos);
+}
+
+TEST(IR, ReplacesAggregates) {
+  auto ast = parse(
+      "type Point { x : int; y : int; };"
+      "func f(p : Point, k : int) -> int { p.x = p.x * k; return p.x + p.y; };"
+      "main { p : Point; p.x = 3; p.y = 4; exit f(p, 2); };");
+  kuso::ArgumentSplitting splitting;
+  splitting.run(ast);
+
+  kuso::ir::Lowering lowering;
+  auto               module = lowering.lower(ast);
+  ASSERT_TRUE(module.has_value());
+  ASSERT_EQ(module->find("f")->get().params.size(), 3);
+
+  kuso::ir::ScalarReplacement scalarReplacement;
+  kuso::ir::SlotPromotion     slotPromotion;
+  scalarReplacement.run(module.value());
+  slotPromotion.run(module.value());
+  ASSERT_TRUE(kuso::ir::verify(module.value()).empty());
+  ASSERT_EQ(scalarReplacement.split(), 2);
+  for (const auto& func : module->functions) {
+    for (const auto& block : func.blocks) {
+      for (const auto& inst : block.instructions) {
+        ASSERT_NE(inst.op, kuso::ir::Op::LOAD);
+        ASSERT_NE(inst.op, kuso::ir::Op::STORE);
+      }
+    }
+  }
+}
@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+
+#include "fixture.hpp"
+#include "generator/loop_invariants.hpp"
+
+using kuso::test::parse;
+using kuso::test::body;
+
+TEST(LoopInvariants, HoistsBeforeTheLoop) {
+  auto ast = parse(
+      "func g(a : int) -> int { return a; };"
+      "func f(a : int, b : int, n : int) -> int {"
+      "  i : int = 0; s : int = 0;"
+      "  while (i < n * 2) { s = s + a * b + i / (b + 1) + g(a - 1); i = i + 1; };"
+      "  return s; };"
+      "main { exit f(1, 2, 3); };");
+
+  kuso::LoopInvariants loopInvariants;
+  loopInvariants.run(ast);
+  ASSERT_EQ(loopInvariants.hoisted(), 4);
+
+  const auto& func = body(ast, "f");
+  ASSERT_EQ(func.size(), 8);
+  for (size_t statement = 2; statement < 6; ++statement) {
+    const auto& hoisted = func.at(statement).statement;
+    ASSERT_TRUE(std::holds_alternative<std::unique_ptr<kuso::AST::Declaration>>(hoisted));
+  }
+  ASSERT_TRUE(std::holds_alternative<std::unique_ptr<kuso::AST::While>>(func.at(6).statement));
+}
+
+TEST(LoopInvariants, KeepsFaultsAndAssembly) {
+  auto ast = parse(
+      "func f(a : int, b : int) -> int {"
+      "  i : int = 0; s : int = 0;"
+      "  while (i < 4) { s = s + a / b; i = i + 1; };"
+      "  while (i < a + b) { asm { nop }; i = i + 1; };"
+      "  return s; };"
+      "main { exit f(1, 2); };");
+
+  kuso::LoopInvariants loopInvariants;
+  loopInvariants.run(ast);
+  ASSERT_EQ(loopInvariants.hoisted(), 0);
+}
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include "fixture.hpp"
+#include "generator/loop_unrolling.hpp"
+
+namespace {
+using kuso::test::parse;
+using kuso::test::body;
+
+template <typename T>
+auto count(const std::vector<kuso::AST::Statement>& body) -> int64_t {
+  return std::ranges::count_if(body, [](const kuso::AST::Statement& statement) {
+    return std::holds_alternative<std::unique_ptr<T>>(statement.statement);
+  });
+}
+}  // namespace
+
+TEST(LoopUnrolling, FullyUnrollsKnownTripCounts) {
+  auto ast = parse(
+      "func f(a : int) -> int {"
+      "  i : int = 0;"
+      "  while (i < 3) { t : int = a * i; a = a + t; i = i + 1; };"
+      "  return a; };"
+      "main { exit f(1); };");
+
+  kuso::LoopUnrolling loopUnrolling;
+  loopUnrolling.run(ast);
+  ASSERT_EQ(loopUnrolling.full(), 1);
+
+  const auto& func = body(ast, "f");
+  ASSERT_EQ(func.size(), 5);
+  ASSERT_EQ(count<kuso::AST::While>(func), 0);
+  ASSERT_EQ(count<kuso::AST::If>(func), 3);
+}
+
+TEST(LoopUnrolling, PartiallyUnrollsWithRemainder) {
+  auto ast = parse(
+      "func f(n : int, m : int) -> int {"
+      "  s : int = 0;"
+      "  while (n) { s = s + n; n = n - 1; };"
+      "  while (m < n + 8) { s = s + m; m = m + 2; };"
+      "  while (m < 100) @nounroll { m = m + 1; };"
+      "  while (s < m) { s = s + 1; m = m - 1; };"
+      "  return s; };"
+      "main { exit f(5, 1); };");
+
+  kuso::LoopUnrolling loopUnrolling(2);
+  loopUnrolling.run(ast);
+  ASSERT_EQ(loopUnrolling.full(), 0);
+  ASSERT_EQ(loopUnrolling.partial(), 2);
+
+  const auto& func = body(ast, "f");
+  ASSERT_EQ(count<kuso::AST::While>(func), 6);
+  ASSERT_EQ(count<kuso::AST::Declaration>(func), 3);
+
+  const auto& unrolled = std::get<std::unique_ptr<kuso::AST::While>>(func.at(1).statement);
+  ASSERT_EQ(unrolled->body.size(), 4);
+}
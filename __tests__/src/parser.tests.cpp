@@ -2,6 +2,7 @@
 #include <gtest/gtest.h>
 #include <filesystem>
 #include <random>
+#include <string>
 
 #include "parser/parser.hpp"
 
@@ -45,4 +46,12 @@ TEST(Parser, FuzzTest) {
 
     ASSERT_NO_THROW(auto ast = parser.parse(tokens));
   }
-}
\ No newline at end of file
+}
+TEST(Parser, ConflictingInlineAnnotations) {
+  kuso::Lexer       lexer;
+  kuso::Parser      parser;
+  const std::string conflicting = "func f(a : int) -> int @inline @noinline { return a; };";
+  const std::string repeated = "func f(a : int) -> int @inline @inline { return a; };";
+  ASSERT_FALSE(parser.parse(lexer.tokenize(conflicting)));
+  ASSERT_TRUE(parser.parse(lexer.tokenize(repeated)));
+}
@@ -0,0 +1,27 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+
+#include "setup/pipeline.hpp"
+
+using Pass = kuso::Pipeline::Pass;
+
+TEST(Pipeline, SelectsLevels) {
+  ASSERT_TRUE(kuso::Pipeline::level("0").passes().empty());
+  ASSERT_FALSE(kuso::Pipeline::level("1").has(Pass::INLINE));
+  ASSERT_TRUE(kuso::Pipeline::level("2").has(Pass::UNROLL));
+  ASSERT_FALSE(kuso::Pipeline::level("s").has(Pass::UNROLL));
+  ASSERT_TRUE(kuso::Pipeline::level("s").optimize_size());
+  ASSERT_THROW(kuso::Pipeline::level("3"), std::runtime_error);
+}
+
+TEST(Pipeline, ParsesPasses) {
+  auto pipeline = kuso::Pipeline::parse("fold,unroll,fold,mem2reg,peephole,gvn");
+  std::vector<Pass> passes{Pass::FOLD, Pass::UNROLL, Pass::FOLD, Pass::MEM2REG, Pass::PEEPHOLE, Pass::GVN};
+  ASSERT_EQ(pipeline.passes(), passes);
+  ASSERT_THROW(kuso::Pipeline::parse("fold,cse"), std::runtime_error);
+  ASSERT_THROW(kuso::Pipeline::parse("gvn,fold"), std::runtime_error);
+  ASSERT_THROW(kuso::Pipeline::parse(""), std::runtime_error);
+  ASSERT_THROW(kuso::Pipeline::parse("fold,,dce"), std::runtime_error);
+  ASSERT_THROW(kuso::Pipeline::parse("fold,"), std::runtime_error);
+}
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+
+#include "fixture.hpp"
+#include "generator/stack_analysis.hpp"
+
+namespace {
+auto analyze(const std::string& source) -> kuso::StackAnalysis {
+  auto ast = kuso::test::parse(source);
+
+  kuso::FirstPass pass;
+  if (!pass.types_pass(ast) || !pass.function_pass(ast)) throw std::runtime_error("Pass failed");
+
+  kuso::StackAnalysis analysis;
+  analysis.analyze(ast, pass);
+  return analysis;
+}
+}  // namespace
+
+TEST(StackAnalysis, Bounded) {
+  auto analysis = analyze(
+      "func add(a : int, b : int) -> int { return a + b; };"
+      "main { x : int = add(1, 2); exit x; };");
+
+  const auto& add = analysis.get_functions().at("add");
+  ASSERT_EQ(add.frame, 8);
+  ASSERT_EQ(add.temporaries, 0);
+  ASSERT_EQ(add.total, 8);
+
+  const auto& main = analysis.get_functions().at("main");
+  ASSERT_EQ(main.frame, 24);
+  ASSERT_EQ(analysis.program_bound(), 32);
+}
+
+TEST(StackAnalysis, Recursion) {
+  auto analysis = analyze(
+      "func f(n : int) -> int { if (n) { return f(n - 1) + 1; }; return 0; };"
+      "main { exit f(3); };");
+
+  ASSERT_TRUE(analysis.get_functions().at("f").recursive);
+  ASSERT_FALSE(analysis.get_functions().at("main").recursive);
+  ASSERT_FALSE(analysis.program_bound().has_value());
+}
+
+TEST(StackAnalysis, TailCalls) {
+  auto analysis = analyze(
+      "func g(a : int) -> int { return a; };"
+      "func f(n : int, acc : int) -> int { if (n) { return f(n - 1, acc + n); }; return g(acc); };"
+      "main { exit f(3, 0); };");
+
+  const auto& f = analysis.get_functions().at("f");
+  ASSERT_FALSE(f.recursive);
+  ASSERT_EQ(f.temporaries, 8);
+  ASSERT_EQ(f.total, 16);
+  ASSERT_TRUE(analysis.program_bound().has_value());
+}
+
+TEST(StackAnalysis, RedZone) {
+  auto ast = kuso::test::parse(
+      "func sq(a : int) -> int { t : int = a * a; return t; };"
+      "func f(a : int) -> int { t : int = sq(a); return t + 1; };"
+      "main { exit f(3); };");
+
+  kuso::FirstPass pass;
+  ASSERT_TRUE(pass.types_pass(ast));
+  ASSERT_TRUE(pass.function_pass(ast));
+  kuso::StackAnalysis analysis;
+  analysis.analyze(ast, pass);
+
+  const auto& leaf = pass.get_function("sq").value().get();
+  ASSERT_FALSE(leaf.needs_frame());
+  ASSERT_EQ(leaf.locals.begin()->second.location.reg, kuso::x64::Register::RSP);
+  ASSERT_EQ(leaf.locals.begin()->second.location.disp, -16);
+  ASSERT_TRUE(pass.get_function("f").value().get().needs_frame());
+}
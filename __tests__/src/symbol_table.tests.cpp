@@ -0,0 +1,36 @@
+#include <gtest/gtest.h>
+
+#include "generator/symbol_table.hpp"
+
+TEST(SymbolTable, Shadowing) {
+  kuso::SymbolTable table;
+  table.enter_scope();
+  ASSERT_TRUE(table.declare("a", kuso::Variable{kuso::TypeID{1}, {}}));
+  ASSERT_FALSE(table.declare("a", kuso::Variable{kuso::TypeID{1}, {}}));
+
+  table.enter_scope();
+  ASSERT_TRUE(table.declare("a", kuso::Variable{kuso::TypeID{2}, {}}));
+  ASSERT_EQ(table.find("a")->get().type, 2);
+  ASSERT_FALSE(table.find_in_scope("b"));
+
+  table.leave_scope();
+  ASSERT_EQ(table.find("a")->get().type, 1);
+  ASSERT_EQ(table.size(), 1);
+}
+
+TEST(SymbolTable, LeaveScope) {
+  kuso::SymbolTable table;
+  table.enter_scope();
+  table.enter_scope();
+  table.declare("x", kuso::Variable{});
+  table.declare("y", kuso::Variable{});
+  ASSERT_EQ(table.depth(), 2);
+
+  table.leave_scope();
+  ASSERT_FALSE(table.find("x"));
+  ASSERT_FALSE(table.find("y"));
+  ASSERT_EQ(table.depth(), 1);
+
+  table.leave_scope();
+  ASSERT_THROW(table.leave_scope(), std::runtime_error);
+}
@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+
+#include "x64/arithmetic.hpp"
+#include "x64/instruction.hpp"
+#include "x64/peephole.hpp"
+
+namespace x64 = kuso::x64;
+
+TEST(X64, RendersInstructions) {
+  x64::InstructionBuffer code;
+
+  auto loop = code.label("label_0");
+  code.text("global _start");
+  code.define(loop);
+  code.emit(x64::Op::PUSH, x64::Operand::from(x64::Register::RBP).with_size(x64::Size::QWORD));
+  auto local = x64::Address{x64::Address::Mode::INDIRECT_DISPLACEMENT, x64::Register::RBP, -8};
+  code.emit(x64::Op::MOVSX, x64::Operand::from(x64::Register::RAX),
+            x64::Operand::from(local).with_size(x64::Size::BYTE));
+  code.emit(x64::Op::ADD, x64::Operand::from(x64::Register::RSP), x64::Operand::from(x64::Literal{16}));
+  code.emit(x64::Op::JMP, x64::Operand::label(loop));
+  code.emit(x64::Op::RET);
+
+  ASSERT_EQ(code.label("label_0"), loop);
+  ASSERT_EQ(code.render(),
+            "global _start\n"
+            "label_0:\n"
+            "push qword rbp\n"
+            "movsx rax, byte -8[rbp]\n"
+            "add rsp, 16\n"
+            "jmp label_0\n"
+            "ret\n");
+}
+
+TEST(X64, PeepholeRewrites) {
+  x64::InstructionBuffer code;
+  auto                   rax = x64::Operand::from(x64::Register::RAX);
+  auto                   rdi = x64::Operand::from(x64::Register::RDI);
+  auto                   end = code.label("end");
+
+  code.emit(x64::Op::MOV, rax, x64::Operand::from(x64::Literal{5}));
+  code.emit(x64::Op::PUSH, rax.with_size(x64::Size::QWORD));
+  code.emit(x64::Op::POP, rdi.with_size(x64::Size::QWORD));
+  code.emit(x64::Op::MOV, rax, x64::Operand::from(x64::Literal{60}));
+  code.emit(x64::Op::JMP, x64::Operand::label(end));
+  code.define(end);
+  code.emit(x64::Op::SYSCALL);
+
+  x64::Peephole peephole;
+  peephole.run(code);
+
+  ASSERT_EQ(code.render(),
+            "mov rdi, 5\n"
+            "mov rax, 60\n"
+            "end:\n"
+            "syscall\n");
+
+  int64_t removed = 0;
+  for (const auto& rule : peephole.get_stats()) removed += rule.removed;
+  ASSERT_EQ(removed, 3);
+}
+
+TEST(X64, PeepholeKeepsLiveValues) {
+  x64::InstructionBuffer code;
+  auto                   rax = x64::Operand::from(x64::Register::RAX);
+  auto                   rdi = x64::Operand::from(x64::Register::RDI);
+
+  code.emit(x64::Op::MOV, rax, x64::Operand::from(x64::Literal{5}));
+  code.emit(x64::Op::MOV, rdi, rax);
+  code.emit(x64::Op::SYSCALL);
+
+  x64::Peephole peephole;
+  peephole.run(code);
+
+  ASSERT_EQ(code.render(),
+            "mov rax, 5\n"
+            "mov rdi, rax\n"
+            "syscall\n");
+}
+
+TEST(X64, MagicDivision) {
+  constexpr std::array<int64_t, 12> DIVIDENDS{
+      0, 1, -1, 7, -7, 1000000007, -1000000007, INT64_MAX, INT64_MIN, INT64_MIN + 1, 123456789012345, -99,
+  };
+
+  for (int64_t divisor = -2000; divisor <= 2000; ++divisor) {
+    if (divisor >= -1 && divisor <= 1) continue;
+    auto [multiplier, shift] = x64::magic(divisor);
+    for (auto dividend : DIVIDENDS) {
+      if (dividend == INT64_MIN && divisor == -1) continue;
+      auto high = static_cast<int64_t>((static_cast<__int128>(dividend) * multiplier) >> 64);
+      if (divisor > 0 && multiplier < 0) high += dividend;
+      if (divisor < 0 && multiplier > 0) high -= dividend;
+      high >>= shift;
+      auto quotient = high + static_cast<int64_t>(static_cast<uint64_t>(high) >> 63U);
+      ASSERT_EQ(quotient, dividend / divisor) << dividend << " / " << divisor;
+    }
+  }
+}
+
+TEST(X64, StrengthReduces) {
+  x64::InstructionBuffer code;
+  x64::multiply(code, x64::Register::RCX, -10);
+  x64::divide(code, 8, true, x64::Register::RDX);
+  x64::power(code, 5, x64::Register::RDX);
+
+  ASSERT_EQ(code.render(),
+            "lea rcx, [rcx+rcx*4]\n"
+            "shl rcx, 1\n"
+            "neg rcx\n"
+            "mov rdx, rax\n"
+            "sar rdx, 63\n"
+            "shr rdx, 61\n"
+            "add rdx, rax\n"
+            "and rdx, -8\n"
+            "sub rax, rdx\n"
+            "mov rdx, rax\n"
+            "imul rax, rax\n"
+            "imul rax, rax\n"
+            "imul rax, rdx\n");
+  ASSERT_EQ(x64::power(3, 5), 243);
+  ASSERT_EQ(x64::power(-2, 63), INT64_MIN);
+  ASSERT_EQ(x64::power(7, -1), 0);
+}
@@ -0,0 +1,59 @@
+/**
+ * @file argument_splitting.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-19
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <belt/class_macros.hpp>
+
+#include "parser/ast.hpp"
+
+namespace kuso {
+/**
+ * @brief Passes small user defined types to functions one attribute per argument
+ *
+ * A type is small when it has at most MAX_FIELDS attributes and all of them are builtin integers. A
+ * parameter of such a type becomes one parameter per attribute, in declaration order, and the function
+ * starts by declaring a local of the type and copying them into it. Every argument for it has to be a
+ * local of the type, which is passed as its attributes.
+ *
+ * The split parameters are named `<parameter>.<attribute>`, which can't be written in source, so they
+ * never clash with a local of the program.
+ */
+class ArgumentSplitting {
+  DEFAULT_CONSTRUCTIBLE(ArgumentSplitting)
+  DEFAULT_COPYABLE(ArgumentSplitting)
+  DEFAULT_MOVABLE(ArgumentSplitting)
+  DEFAULT_DESTRUCTIBLE(ArgumentSplitting)
+
+ public:
+  static constexpr size_t MAX_FIELDS = 6;
+
+  void run(AST&);
+
+ private:
+  std::map<std::string, std::vector<AST::Attribute>> _fields;
+  std::map<std::string, std::vector<std::string>>    _signatures;
+  std::vector<std::map<std::string, std::string>>    _scopes;
+
+  void split(AST::Func&);
+  void run(std::vector<AST::Statement>&);
+  void run(AST::Expression&);
+  void run(AST::Call&);
+
+  [[nodiscard]] auto type_of(const std::string&) const -> std::optional<std::string>;
+};
+}  // namespace kuso
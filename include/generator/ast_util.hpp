@@ -0,0 +1,85 @@
+/**
+ * @file ast_util.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-19
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "parser/ast.hpp"
+
+/**
+ * @brief Building, copying and searching AST nodes for the passes that rewrite the AST
+ *
+ */
+namespace kuso::ast {
+/**
+ * @brief Names a block of statements writes, searched through ifs and loops
+ *
+ */
+struct Writes {
+  std::multiset<std::string> assigned;  // once per assignment
+  std::multiset<std::string> declared;  // once per declaration, including the targets of destructures
+  bool                       assembly{false};
+  bool                       loops{false};
+
+  [[nodiscard]] auto names() const -> std::multiset<std::string>;
+};
+
+void collect_writes(const AST::Statement&, Writes&);
+void collect_writes(const std::vector<AST::Statement>&, Writes&);
+
+[[nodiscard]] auto variable(std::string name, std::optional<std::string> attribute = std::nullopt)
+    -> std::unique_ptr<AST::Primary>;
+[[nodiscard]] auto number(int64_t value) -> std::unique_ptr<AST::Primary>;
+
+[[nodiscard]] auto parent_of(std::unique_ptr<AST::Primary>) -> std::unique_ptr<AST::Unary>;
+[[nodiscard]] auto parent_of(std::unique_ptr<AST::Unary>) -> std::unique_ptr<AST::Factor>;
+[[nodiscard]] auto parent_of(std::unique_ptr<AST::Factor>) -> std::unique_ptr<AST::Term>;
+[[nodiscard]] auto parent_of(std::unique_ptr<AST::Term>) -> std::unique_ptr<AST::Comparison>;
+[[nodiscard]] auto parent_of(std::unique_ptr<AST::Comparison>) -> std::unique_ptr<AST::Equality>;
+[[nodiscard]] auto parent_of(std::unique_ptr<AST::Equality>) -> std::unique_ptr<AST::Expression>;
+
+/**
+ * @brief Wraps a node in the nodes above it, without operators, until it is a Node
+ *
+ * `wrap<AST::Term>(number(1))` builds the term 1.
+ *
+ * @param node Node to wrap
+ * @return std::unique_ptr<Node> the wrapped node
+ */
+template <typename Node, typename Child>
+[[nodiscard]] auto wrap(std::unique_ptr<Child> node) -> std::unique_ptr<Node> {
+  if constexpr (std::is_same_v<Node, Child>) {
+    return node;
+  } else {
+    return wrap<Node>(parent_of(std::move(node)));
+  }
+}
+
+[[nodiscard]] auto clone(const AST::Variable&) -> std::unique_ptr<AST::Variable>;
+[[nodiscard]] auto clone(const AST::String&) -> std::unique_ptr<AST::String>;
+[[nodiscard]] auto clone(const AST::Call&) -> std::unique_ptr<AST::Call>;
+[[nodiscard]] auto clone(const AST::Primary&) -> std::unique_ptr<AST::Primary>;
+[[nodiscard]] auto clone(const AST::Unary&) -> std::unique_ptr<AST::Unary>;
+[[nodiscard]] auto clone(const AST::Factor&) -> std::unique_ptr<AST::Factor>;
+[[nodiscard]] auto clone(const AST::Term&) -> std::unique_ptr<AST::Term>;
+[[nodiscard]] auto clone(const AST::Comparison&) -> std::unique_ptr<AST::Comparison>;
+[[nodiscard]] auto clone(const AST::Equality&) -> std::unique_ptr<AST::Equality>;
+[[nodiscard]] auto clone(const AST::Expression&) -> std::unique_ptr<AST::Expression>;
+[[nodiscard]] auto clone(const AST::Statement&) -> AST::Statement;
+[[nodiscard]] auto clone(const std::vector<AST::Statement>&) -> std::vector<AST::Statement>;
+}  // namespace kuso::ast
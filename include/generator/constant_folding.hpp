@@ -0,0 +1,93 @@
+/**
+ * @file constant_folding.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <belt/class_macros.hpp>
+
+#include "parser/ast.hpp"
+
+namespace kuso {
+/**
+ * @brief Folds constant expressions and propagates constants through the int locals of a function
+ *
+ * Statements are walked in order with the value every local is known to hold. Branches whose condition
+ * folds to a constant only walk the side that runs and drop the other one, the states at the end of
+ * both sides of other branches are merged. Locals assigned anywhere in a loop are unknown inside and
+ * after it, code behind a return, an exit or a loop that never ends is unreachable.
+ *
+ * Only int locals are propagated, narrower ones would have to be truncated and attributes live in
+ * memory. Inline assembly may write any local, nothing is known after it.
+ */
+class ConstantFolding {
+  DEFAULT_CONSTRUCTIBLE(ConstantFolding)
+  DEFAULT_COPYABLE(ConstantFolding)
+  DEFAULT_MOVABLE(ConstantFolding)
+  DEFAULT_DESTRUCTIBLE(ConstantFolding)
+
+ public:
+  void run(AST&);
+
+  [[nodiscard]] static auto constant_value(const AST::Expression&) -> std::optional<int64_t>;
+  [[nodiscard]] static auto constant_value(const AST::Factor&) -> std::optional<int64_t>;
+  [[nodiscard]] static auto constant_value(const AST::Unary&) -> std::optional<int64_t>;
+
+  [[nodiscard]] auto folded() const -> int64_t { return _folded; }
+  [[nodiscard]] auto propagated() const -> int64_t { return _propagated; }
+  [[nodiscard]] auto branches() const -> int64_t { return _branches; }
+  [[nodiscard]] auto to_string() const -> std::string;
+
+ private:
+  /**
+   * @brief Known values of the locals at some point, nullopt for locals that are not constant
+   *
+   */
+  struct State {
+    std::vector<std::optional<int64_t>> values;
+    bool                                reachable{true};
+  };
+
+  std::vector<std::map<std::string, size_t>> _scopes;
+  std::vector<bool>                          _tracked;
+  State                                      _state;
+  int64_t                                    _folded{0};
+  int64_t                                    _propagated{0};
+  int64_t                                    _branches{0};
+
+  void fold_function(const std::vector<std::unique_ptr<AST::Declaration>>&, std::vector<AST::Statement>&);
+  void fold_block(std::vector<AST::Statement>&);
+  void fold(AST::Statement&);
+  void fold_declaration(AST::Declaration&);
+  void fold_assignment(AST::Assignment&);
+  void fold_if(AST::If&);
+  void fold_while(AST::While&);
+
+  void declare(const std::string&, const std::string&, std::optional<int64_t>);
+  void forget(const std::vector<AST::Statement>&);
+  void merge(const State&);
+  [[nodiscard]] auto find(const AST::Variable&) const -> std::optional<size_t>;
+
+  auto fold(AST::Expression&) -> std::optional<int64_t>;
+  auto fold(AST::Equality&) -> std::optional<int64_t>;
+  auto fold(AST::Comparison&) -> std::optional<int64_t>;
+  auto fold(AST::Term&) -> std::optional<int64_t>;
+  auto fold(AST::Factor&) -> std::optional<int64_t>;
+  auto fold(AST::Unary&) -> std::optional<int64_t>;
+  auto fold(AST::Primary&) -> std::optional<int64_t>;
+  auto fold(const AST::Variable&) -> std::optional<int64_t>;
+};
+}  // namespace kuso
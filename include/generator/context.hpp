@@ -11,24 +11,26 @@
 
 #pragma once
 
-#include <map>
-#include <stack>
-#include <string>
-
-#include "generator/types.hpp"
-#include "generator/variables.hpp"
+#include <cstdint>
+#include <optional>
 
 #include "x64/addressing.hpp"
+#include "x64/instruction.hpp"
 
 namespace kuso {
 /**
- * @brief Holds information about the current context
+ * @brief Holds information about the current function context
  * 
+ * Variables are tracked separately in the generator's SymbolTable,
+ * size is the number of bytes reserved below rbp for the function's frame,
+ * loop is where calls of the function to itself in tail position jump to
  */
 struct Context {
-  int64_t                         size;
-  x64::Address                    stack;
-  std::map<std::string, Variable> variables;
-  int                             currVariable;
+  int64_t      size;
+  x64::Address stack;
+  int          currVariable;
+  bool         frame;
+
+  std::optional<x64::LabelId> loop;
 };
 }  // namespace kuso
\ No newline at end of file
@@ -11,6 +11,9 @@
 
 #pragma once
 
+#include <map>
+#include <string>
+
 #include "parser/ast.hpp"
 
 #include "context.hpp"
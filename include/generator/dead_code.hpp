@@ -0,0 +1,77 @@
+/**
+ * @file dead_code.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <belt/class_macros.hpp>
+
+#include "parser/ast.hpp"
+
+namespace kuso {
+/**
+ * @brief Removes statements that never run and stores to locals that are never read
+ *
+ * Statements after a return, an exit or a loop that never ends are dropped first. Liveness of the
+ * primitive locals is then computed backwards through every function, loops are iterated until their
+ * live set settles. An assignment to a local that is dead afterwards is removed, as is the value of
+ * such a declaration, as long as evaluating it cannot call anything or fault. Inline assembly reads
+ * every local.
+ *
+ * Declarations without a value don't end a local's life, a local declared in a loop keeps its slot and
+ * may still be read before it is assigned again.
+ */
+class DeadCode {
+  DEFAULT_CONSTRUCTIBLE(DeadCode)
+  DEFAULT_COPYABLE(DeadCode)
+  DEFAULT_MOVABLE(DeadCode)
+  DEFAULT_DESTRUCTIBLE(DeadCode)
+
+ public:
+  using Live = std::vector<bool>;
+
+  void run(AST&);
+
+  [[nodiscard]] auto unreachable() const -> int64_t { return _unreachable; }
+  [[nodiscard]] auto stores() const -> int64_t { return _stores; }
+  [[nodiscard]] auto branches() const -> int64_t { return _branches; }
+  [[nodiscard]] auto to_string() const -> std::string;
+
+ private:
+  std::vector<std::map<std::string, size_t>>           _scopes;
+  std::vector<bool>                                    _tracked;
+  std::unordered_map<const AST::Variable*, size_t>     _variables;
+  std::unordered_map<const AST::Declaration*, size_t>  _declarations;
+  int64_t                                              _unreachable{0};
+  int64_t                                              _stores{0};
+  int64_t                                              _branches{0};
+
+  void run(const std::vector<std::unique_ptr<AST::Declaration>>&, std::vector<AST::Statement>&);
+
+  auto prune(std::vector<AST::Statement>&) -> bool;
+  auto falls_through(AST::Statement&) -> bool;
+
+  void resolve(std::vector<AST::Statement>&);
+  void resolve(const AST::Statement&);
+  void resolve(const AST::Expression&);
+  void declare(const AST::Declaration&);
+
+  auto live(std::vector<AST::Statement>&, Live, bool) -> Live;
+  auto live(AST::Statement&, Live&, bool) -> bool;
+  auto live(AST::While&, const Live&, bool) -> Live;
+  void read(const AST::Expression&, Live&) const;
+};
+}  // namespace kuso
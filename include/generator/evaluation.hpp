@@ -0,0 +1,99 @@
+/**
+ * @file evaluation.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <optional>
+
+#include <belt/class_macros.hpp>
+
+#include "parser/ast.hpp"
+#include "x64/x64.hpp"
+
+namespace kuso {
+/**
+ * @brief Decides the evaluation order of binary expressions and where their first operand is held
+ *
+ * Expressions are labeled with Sethi-Ullman numbers, the registers needed to evaluate them without
+ * touching the stack. The operand that needs more is evaluated first, ties and anything with calls on
+ * both sides keep the right to left order, so of two calls the one on the right runs first. The first
+ * operand is held in a scratch register while the second is evaluated, only once the pool runs out it
+ * is pushed.
+ *
+ * Factors with a constant multiplier, divisor or exponent are strength reduced, only the other operand
+ * is evaluated.
+ *
+ * A return that gives back the result of a call is a tail call, the callee reuses the caller's frame.
+ *
+ * Call arguments that are a number or a variable are moved straight into their parameter register once
+ * every other argument is evaluated, they call nothing and clobber nothing on the way.
+ *
+ * The first pass and the stack analysis make the same decisions as the generator through this class.
+ */
+class Evaluation {
+  DEFAULT_CONSTRUCTIBLE(Evaluation)
+  DEFAULT_COPYABLE(Evaluation)
+  DEFAULT_MOVABLE(Evaluation)
+  DEFAULT_DESTRUCTIBLE(Evaluation)
+
+ public:
+  /**
+   * @brief Scratch registers, values held across a call only use the callee saved ones
+   *
+   */
+  static constexpr std::array<x64::Register, 7> SCRATCH{
+      x64::Register::R10, x64::Register::R11, x64::Register::RBX, x64::Register::R12,
+      x64::Register::R13, x64::Register::R14, x64::Register::R15,
+  };
+
+  struct Label {
+    int64_t need{1};
+    bool    calls{false};
+  };
+
+  /**
+   * @brief Constant operand of a factor that is folded into the instructions instead of being held
+   *
+   */
+  struct Reduction {
+    int64_t constant{0};
+    bool    constantLeft{false};
+  };
+
+  [[nodiscard]] auto label(const AST::Expression&) -> Label;
+  [[nodiscard]] auto label(const AST::Equality&) -> Label;
+  [[nodiscard]] auto label(const AST::Comparison&) -> Label;
+  [[nodiscard]] auto label(const AST::Term&) -> Label;
+  [[nodiscard]] auto label(const AST::Factor&) -> Label;
+  [[nodiscard]] auto label(const AST::Unary&) -> Label;
+  [[nodiscard]] auto label(const AST::Primary&) -> Label;
+
+  [[nodiscard]] static auto left_first(const Label&, const Label&, bool) -> bool;
+  [[nodiscard]] static auto strength_reduced(const AST::Factor&) -> std::optional<Reduction>;
+  [[nodiscard]] static auto tail_call(const AST::Return&) -> const AST::Call*;
+  [[nodiscard]] static auto call(const AST::Expression&) -> const AST::Call*;
+  [[nodiscard]] static auto variable(const AST::Expression&) -> const AST::Variable*;
+  [[nodiscard]] static auto direct(const AST::Expression&, size_t) -> bool;
+
+  [[nodiscard]] auto acquire(bool) -> x64::Register;
+  void               release(x64::Register);
+
+ private:
+  std::map<const void*, Label>     _labels;
+  std::array<bool, SCRATCH.size()> _busy{};
+
+  [[nodiscard]] static auto combine(const Label&, const Label&) -> Label;
+  [[nodiscard]] static auto single(const AST::Expression&) -> const AST::Primary*;
+};
+}  // namespace kuso
@@ -11,9 +11,17 @@
 
 #pragma once
 
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string_view>
+#include <vector>
+
 #include <belt/class_macros.hpp>
-#include "generator/context.hpp"
+#include "generator/evaluation.hpp"
+#include "generator/symbol_table.hpp"
 #include "generator/types.hpp"
+#include "generator/variables.hpp"
 #include "parser/ast.hpp"
 #include "x64/x64.hpp"
 
@@ -29,12 +37,54 @@ class FirstPass {
   DEFAULT_DESTRUCTIBLE(FirstPass)
 
  public:
+  using RegisterSet = std::array<bool, x64::REGISTER_COUNT>;
+
+  /**
+   * @brief Frame layout and register usage of a function
+   * 
+   * dirtyRegs are the registers written by the function's own code, clobbers are the caller saved
+   * registers a call to the function may change, including everything its callees change.
+   * saves are the callee saved registers the function has to restore, callSaves are the registers
+   * that have to be preserved around each call made by the function. tailCalls are the calls that
+   * replace the function when they return straight through it. A function with its frame in the red zone
+   * addresses it through rsp and never sets up rbp. A pair function returns a second value in rdx.
+   */
   struct FuncInfo {
-    int64_t                               size;
-    x64::Address                          stack;
-    std::map<std::string, Variable>       locals;
-    std::map<std::string, Variable>       params;
-    std::array<bool, x64::REGISTER_COUNT> dirtyRegs{false};
+    int64_t                                                size;
+    x64::Address                                           stack;
+    std::map<const AST::Declaration*, Variable>            locals;
+    std::map<std::string, Variable>                        params;
+    std::map<std::string, x64::Address>                    spills;
+    std::map<x64::Register, x64::Address>                  saves;
+    std::map<const AST::Call*, std::vector<x64::Register>> callSaves;
+    std::set<const AST::Call*>                             tailCalls;
+    bool                                                   tailRecursive{false};
+    bool                                                   redZone{false};
+    bool                                                   pair{false};
+    RegisterSet                                            dirtyRegs{false};
+    RegisterSet                                            clobbers{false};
+
+    /**
+     * @brief Checks if the function needs an rbp frame
+     * 
+     */
+    [[nodiscard]] auto needs_frame() const -> bool {
+      if (redZone) return false;
+      if (size > 0 || !saves.empty()) return true;
+      return std::any_of(params.begin(), params.end(),
+                         [](const auto& param) { return param.second.location.reg == x64::Register::RBP; });
+    }
+
+    /**
+     * @brief Size reserved below rbp, kept 16 byte aligned
+     * 
+     */
+    [[nodiscard]] auto frame_size() const -> int64_t {
+      constexpr int64_t STACK_ALIGNMENT = 16;
+      return (size + STACK_ALIGNMENT - 1) / STACK_ALIGNMENT * STACK_ALIGNMENT;
+    }
+
+    auto use_red_zone() -> bool;
   };
 
   [[nodiscard]] auto types_pass(const AST&) -> bool;
@@ -69,16 +119,67 @@ class FirstPass {
   };
 
  private:
-  TypeContainer                   _types;
-  std::map<std::string, FuncInfo> _functions;
-  std::string                     _currFunc;
+  // slots are aligned relative to rbp, stricter alignments only shape type layouts
+  static constexpr int MAX_SLOT_ALIGN = 16;
+
+  /**
+   * @brief Register usage of a function in evaluation order, every event gets a sequence number
+   * 
+   * lifetimes are the first and last event of each local, its declaration and its last read or write.
+   */
+  struct Usage {
+    struct CallSite {
+      const AST::Call* call;
+      std::string      callee;
+      size_t           seq;
+    };
+
+    size_t                                                       seq{0};
+    std::map<std::string, std::vector<size_t>>                   uses;
+    std::vector<std::pair<x64::Register, size_t>>                writes;
+    std::vector<CallSite>                                        calls;
+    std::vector<std::pair<size_t, size_t>>                       loops;
+    std::map<const AST::Declaration*, std::pair<size_t, size_t>> lifetimes;
+    bool                                                         callsUnknown{false};
+  };
+
+  TypeContainer                             _types;
+  std::map<std::string, FuncInfo>           _functions;
+  std::map<std::string, Usage>              _usage;
+  SymbolTable                               _scope;
+  BasicSymbolTable<const AST::Declaration*> _declarations;
+  Evaluation                                _evaluation;
+  std::string                               _currFunc;
 
   void generate_type(const AST::Type&);
 
   void pass_func(const AST::Func&);
+  void pass_body(const std::vector<AST::Statement>&);
   void pass_decl(const AST::Declaration&);
   void pass_call(const AST::Call&);
+  void pass_tail_call(const AST::Call&);
   void pass_main(const AST::Main&);
+  void pass_asm(const AST::ASM&);
   void pass_expression(const AST::Expression&);
+  void pass_expression(const AST::Equality&);
+  void pass_expression(const AST::Comparison&);
+  void pass_expression(const AST::Term&);
+  void pass_expression(const AST::Factor&);
+  void pass_expression(const AST::Unary&);
+  void pass_expression(const AST::Primary&);
+  void pass_expression(const AST::Terminal&);
+  void pass_expression(const AST::Variable&);
+
+  template <typename Left, typename Right>
+  void pass_operands(const Left&, const Right&, bool, x64::Register);
+
+  void write_reg(x64::Register);
+  void use_local(std::string_view);
+  void resolve_registers();
+  void assign_slots(const std::string&, FuncInfo&);
+  void assign_saves(const std::string&, FuncInfo&);
+
+  [[nodiscard]] static auto live_after(const Usage&, const std::string&, size_t) -> bool;
+  static auto               allocate_slot(FuncInfo&, int64_t, int64_t = x64::Size::QWORD) -> x64::Address;
 };
 }  // namespace kuso
\ No newline at end of file
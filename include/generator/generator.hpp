@@ -18,14 +18,19 @@
 #include <belt/file.hpp>
 
 #include "generator/context_pass.hpp"
+#include "generator/evaluation.hpp"
 #include "generator/first_pass.hpp"
+#include "generator/stack_analysis.hpp"
 #include "parser/ast.hpp"
 
 #include "context.hpp"
 #include "function.hpp"
+#include "symbol_table.hpp"
 #include "variables.hpp"
 
 #include "x64/addressing.hpp"
+#include "x64/instruction.hpp"
+#include "x64/peephole.hpp"
 #include "x64/x64.hpp"
 
 namespace kuso {
@@ -40,16 +45,23 @@ class Generator {
   NON_COPYABLE(Generator)
 
  public:
-  explicit Generator(const std::filesystem::path& outputpath);
+  Generator(const std::filesystem::path& outputpath, bool peephole);
 
   void generate(const AST&);
 
+  [[nodiscard]] auto stack_analysis() const -> const StackAnalysis& { return _stackAnalysis; }
+  [[nodiscard]] auto peephole() const -> const x64::Peephole& { return _peephole; }
+  [[nodiscard]] auto types() -> const TypeContainer& { return _firstpass.get_types(); }
+
  private:
   belt::File _outputFile;
 
-  FirstPass _firstpass;
+  FirstPass     _firstpass;
+  StackAnalysis _stackAnalysis;
+  Evaluation    _evaluation;
 
   std::stack<Context> _contexts;
+  SymbolTable         _symbols;
 
   std::stack<std::string>         _currentFunction;
   std::map<std::string, Function> _functions;
@@ -57,7 +69,9 @@ class Generator {
   std::map<std::string, std::string> _string_names;
   std::map<std::string, std::string> _string_values;
 
-  std::string _output_code;
+  x64::InstructionBuffer _code;
+  x64::Peephole          _peephole;
+  bool                   _optimize{true};
 
   size_t _label_count{0};
 
@@ -65,11 +79,12 @@ class Generator {
 
   void init_context();
 
-  void enter_context(int64_t);
   void enter_context(const std::string&);
   void leave_context();
+  void emit_epilogue();
+  void generate_block(const std::vector<AST::Statement>&);
 
-  [[nodiscard]] auto new_label() -> std::string;
+  [[nodiscard]] auto new_label() -> x64::LabelId;
 
   void push(x64::Register);
   void push(x64::Address);
@@ -77,7 +92,8 @@ class Generator {
   void pop(x64::Register);
   void emit(x64::Op);
   void emit(const std::string&);
-  void emit(x64::Op, const std::string&);
+  void emit(x64::LabelId);
+  void emit(x64::Op, x64::LabelId);
   void emit(x64::Op, x64::Register);
   void emit(x64::Op, x64::Address);
   void emit(x64::Op, x64::Size, x64::Register);
@@ -85,31 +101,54 @@ class Generator {
   void emit(x64::Op, x64::Size, x64::Literal);
   void emit(x64::Op, x64::Address, x64::Address);
   void emit(x64::Op, x64::Register, x64::Address);
+  void emit(x64::Op, x64::Register, x64::Size, x64::Address);
   void emit(x64::Op, x64::Register, x64::Register);
   void emit(x64::Op, x64::Address, x64::Register);
-  void emit(x64::Op, x64::Register, const std::string&);
   void emit(x64::Op, x64::Literal);
   void emit(x64::Op, x64::Literal, x64::Literal);
   void emit(x64::Op, x64::Address, x64::Literal);
   void emit(x64::Op, x64::Register, x64::Literal);
 
+  /**
+   * @brief Operands of a binary expression, the second one evaluated is in rax
+   * 
+   */
+  struct Operands {
+    x64::Register held;
+    bool          leftFirst;
+  };
+
+  template <typename Left, typename Right>
+  auto generate_operands(const Left&, const Right&, bool, x64::Register) -> Operands;
+
   void pull_comparison_result(AST::BinaryOp);
 
+  [[nodiscard]] static auto jump(AST::BinaryOp) -> x64::Op;
+  [[nodiscard]] static auto inverted_jump(AST::BinaryOp) -> x64::Op;
+
+  void load(x64::Register, x64::Address, x64::Size);
+  void store(x64::Register, x64::Address, x64::Size);
+  void store_returned(x64::Address, int64_t);
+
   void generate(const AST::Statement&);
   void generate_assignment(const AST::Assignment&);
   void generate_declaration(const AST::Declaration&);
+  void generate_destructure(const AST::Destructure&);
   void generate_exit(const AST::Exit&);
 
   void generate_if(const AST::If&);
 
   void generate_while(const AST::While&);
 
+  void generate_condition(const AST::Expression&, x64::LabelId, bool);
+
   void generate_expression(const AST::Expression&);
   void generate_expression(const AST::Terminal&);
   void generate_expression(const AST::Equality&);
   void generate_expression(const AST::Comparison&);
   void generate_expression(const AST::Term&);
   void generate_expression(const AST::Factor&);
+  void generate_reduced(const AST::Factor&, const Evaluation::Reduction&);
   void generate_expression(const AST::Unary&);
   void generate_expression(const AST::Primary&);
   void generate_expression(const AST::Variable&);
@@ -120,12 +159,15 @@ class Generator {
 
   void generate_main(const AST::Main&);
   void generate_call(const AST::Call&);
-  void generate_parameters(const AST::Call&);
+  void generate_tail_call(const AST::Call&);
+  [[nodiscard]] auto generate_parameters(const AST::Call&) -> int64_t;
   void generate_return(const AST::Return&);
+  void generate_returned(const AST::Expression&, const AST::Func&, const Type&);
 
   void generate_string(const AST::String&);
 
   [[nodiscard]] auto get_location(const AST::Variable&) -> x64::Address;
+  [[nodiscard]] auto get_access_size(const AST::Variable&) -> x64::Size;
 
   [[nodiscard]] static auto get_identifier(const AST::Terminal&) -> const std::string&;
   [[nodiscard]] static auto get_identifier(const AST::Declaration&) -> const std::string&;
@@ -133,6 +175,8 @@ class Generator {
   [[nodiscard]] static auto get_decl_type(const AST::Declaration&) -> const std::string&;
 
   [[nodiscard]] auto get_check_func_info(const std::string&) -> const FirstPass::FuncInfo&;
+  [[nodiscard]] auto get_func(const std::string&) const -> const AST::Func*;
+  [[nodiscard]] auto aggregate(const AST::Func*) -> bool;
   [[nodiscard]] auto get_check_type(const std::string&) -> Type&;
   [[nodiscard]] auto get_check_type(TypeID) -> Type&;
 
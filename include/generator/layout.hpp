@@ -0,0 +1,45 @@
+/**
+ * @file layout.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "generator/types.hpp"
+
+namespace kuso {
+/**
+ * @brief Lays out the attributes of user defined types
+ *
+ * Attributes are placed at their natural alignment. By default they are sorted by decreasing alignment
+ * first, which leaves no padding between attributes whose sizes are multiples of their alignment.
+ */
+class Layout {
+ public:
+  struct Field {
+    std::string name;
+    TypeID      type;
+    int         size;
+    int         align;
+  };
+
+  struct Options {
+    bool packed{false};
+    bool reorder{true};
+    int  align{0};
+  };
+
+  [[nodiscard]] static auto compute(std::vector<Field>, const Options&) -> Type;
+  [[nodiscard]] static auto report(const TypeContainer&) -> std::string;
+  [[nodiscard]] static auto align_to(int64_t, int64_t) -> int64_t;
+};
+}  // namespace kuso
@@ -0,0 +1,86 @@
+/**
+ * @file loop_invariants.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-19
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <belt/class_macros.hpp>
+
+#include "parser/ast.hpp"
+
+namespace kuso {
+/**
+ * @brief Hoists expressions that compute the same value on every iteration of a while loop out of it
+ *
+ * A local is variant in a loop when it is assigned or declared anywhere in it, including nested loops.
+ * The largest subexpressions of the condition and the body that only read invariant locals and numbers
+ * are computed once into a new int local declared right before the loop and read from there. Loops are
+ * visited outermost first, so an expression leaves every loop it is invariant in at once.
+ *
+ * Hoisted code runs even when the loop or the branch it was in doesn't, so calls and divisions that may
+ * fault stay where they are. Inline assembly may write any local, loops containing it are left alone.
+ */
+class LoopInvariants {
+  DEFAULT_CONSTRUCTIBLE(LoopInvariants)
+  DEFAULT_COPYABLE(LoopInvariants)
+  DEFAULT_MOVABLE(LoopInvariants)
+  DEFAULT_DESTRUCTIBLE(LoopInvariants)
+
+ public:
+  void run(AST&);
+
+  [[nodiscard]] auto hoisted() const -> int64_t { return _hoisted; }
+  [[nodiscard]] auto to_string() const -> std::string;
+
+ private:
+  /**
+   * @brief Whether a subexpression can be hoisted and whether it computes anything
+   *
+   */
+  struct Invariance {
+    bool invariant{true};
+    bool operation{false};
+  };
+
+  std::multiset<std::string> _variant;
+  std::vector<AST::Statement> _preheader;
+  int64_t                     _hoisted{0};
+
+  void run(std::vector<AST::Statement>&);
+  void hoist_loop(AST::While&);
+  void hoist_block(std::vector<AST::Statement>&);
+  void root(AST::Expression&);
+
+  auto visit(AST::Expression&) -> Invariance;
+  auto visit(AST::Equality&) -> Invariance;
+  auto visit(AST::Comparison&) -> Invariance;
+  auto visit(AST::Term&) -> Invariance;
+  auto visit(AST::Factor&) -> Invariance;
+  auto visit(AST::Unary&) -> Invariance;
+  auto visit(AST::Primary&) -> Invariance;
+  auto visit(const AST::Variable&) const -> Invariance;
+
+  template <typename Left, typename Right>
+  auto operands(Left&, Right&, bool) -> Invariance;
+
+  void hoist(AST::Expression&);
+  void hoist(AST::Equality&);
+  void hoist(AST::Comparison&);
+  void hoist(AST::Term&);
+  void hoist(AST::Factor&);
+  void hoist(AST::Unary&);
+  auto declare(std::unique_ptr<AST::Expression>) -> std::string;
+};
+}  // namespace kuso
@@ -0,0 +1,87 @@
+/**
+ * @file loop_unrolling.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-19
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <belt/class_macros.hpp>
+
+#include "parser/ast.hpp"
+
+namespace kuso {
+/**
+ * @brief Unrolls counted while loops, copying their body so fewer iterations test the condition
+ *
+ * A loop is counted when its condition compares an int local against a bound the loop never changes and
+ * its body steps that local by a constant once, at its top level. Only innermost loops without inline
+ * assembly are unrolled. A loop whose local starts from a constant before it and whose bound is a constant
+ * runs a known number of times, when that is small the loop is replaced by as many copies of its body.
+ * Other loops are preceded by a loop running factor copies of the body per iteration for as long as the
+ * local is at least factor steps away from the bound, the original loop then runs what is left.
+ *
+ * The factor comes from -unroll and is capped so the copies stay within MAX_STATEMENTS. @unroll(N) sets
+ * the factor of a single loop without the cap, @nounroll and a factor of 1 leave the loop alone. Copies
+ * of a body that declares locals are wrapped in a block of their own.
+ */
+class LoopUnrolling {
+  DEFAULT_CONSTRUCTIBLE(LoopUnrolling)
+  DEFAULT_COPYABLE(LoopUnrolling)
+  DEFAULT_MOVABLE(LoopUnrolling)
+  DEFAULT_DESTRUCTIBLE(LoopUnrolling)
+
+ public:
+  static constexpr int64_t DEFAULT_FACTOR = 4;
+  static constexpr int64_t MAX_STATEMENTS = 32;
+
+  explicit LoopUnrolling(int64_t factor) : _factor(factor) {}
+
+  void run(AST&);
+
+  [[nodiscard]] auto full() const -> int64_t { return _full; }
+  [[nodiscard]] auto partial() const -> int64_t { return _partial; }
+  [[nodiscard]] auto to_string() const -> std::string;
+
+ private:
+  /**
+   * @brief Local counting the iterations of a loop, the loop runs while `variable op bound` holds
+   *
+   */
+  struct Induction {
+    std::string                      variable;
+    AST::BinaryOp                    op;
+    std::unique_ptr<AST::Expression> bound;
+    int64_t                          step;
+  };
+
+  std::vector<std::map<std::string, std::string>> _scopes;
+  int64_t                                         _factor{DEFAULT_FACTOR};
+  int64_t                                         _full{0};
+  int64_t                                         _partial{0};
+  int64_t                                         _locals{0};
+
+  void run(std::vector<AST::Statement>&);
+  auto unroll(std::vector<AST::Statement>&, size_t) -> std::optional<size_t>;
+  auto unroll_full(std::vector<AST::Statement>&, size_t, int64_t) -> size_t;
+  auto unroll_partial(std::vector<AST::Statement>&, size_t, const Induction&, int64_t)
+      -> std::optional<size_t>;
+
+  [[nodiscard]] auto induction(const AST::While&) const -> std::optional<Induction>;
+  [[nodiscard]] auto type_of(const std::string&) const -> std::optional<std::string>;
+  auto declare(std::vector<AST::Statement>&, std::unique_ptr<AST::Expression>) -> std::string;
+};
+}  // namespace kuso
@@ -0,0 +1,90 @@
+/**
+ * @file stack_analysis.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <belt/class_macros.hpp>
+
+#include "generator/evaluation.hpp"
+#include "generator/first_pass.hpp"
+#include "parser/ast.hpp"
+
+namespace kuso {
+/**
+ * @brief Computes how much stack every function and the whole program needs
+ *
+ * Walks the AST the same way the generator emits it, counting the bytes pushed for expression
+ * temporaries that did not fit the scratch registers, saved registers and stack arguments on top of
+ * each function's frame. A tail call replaces the caller's frame with the callee's, one to the function
+ * itself is a loop.
+ */
+class StackAnalysis {
+  DEFAULT_CONSTRUCTIBLE(StackAnalysis)
+  DEFAULT_COPYABLE(StackAnalysis)
+  DEFAULT_MOVABLE(StackAnalysis)
+  DEFAULT_DESTRUCTIBLE(StackAnalysis)
+
+ public:
+  struct FuncStack {
+    int64_t                  frame{0};
+    int64_t                  temporaries{0};
+    std::optional<int64_t>   total;
+    bool                     recursive{false};
+    bool                     hasAsm{false};
+    std::vector<std::string> callees;
+  };
+
+  void analyze(const AST&, FirstPass&);
+
+  [[nodiscard]] auto get_functions() const -> const std::map<std::string, FuncStack>& { return _functions; }
+  [[nodiscard]] auto program_bound() const -> std::optional<int64_t>;
+  [[nodiscard]] auto to_string() const -> std::string;
+
+ private:
+  struct CallSite {
+    std::string callee;
+    int64_t     depth;
+    bool        tail{false};
+  };
+
+  std::map<std::string, FuncStack>             _functions;
+  std::map<std::string, std::vector<CallSite>> _calls;
+
+  const FirstPass::FuncInfo* _currInfo{nullptr};
+  std::string                _currFunc;
+  int64_t                    _depth{0};
+  Evaluation                 _evaluation;
+
+  void analyze_func(const std::string&, const std::vector<AST::Statement>&, FirstPass&, bool);
+  void analyze_body(const std::vector<AST::Statement>&);
+  void analyze_call(const AST::Call&);
+  void analyze_tail_call(const AST::Call&);
+  void analyze_expression(const AST::Expression&);
+  void analyze_expression(const AST::Equality&);
+  void analyze_expression(const AST::Comparison&);
+  void analyze_expression(const AST::Term&);
+  void analyze_expression(const AST::Factor&);
+  void analyze_expression(const AST::Unary&);
+  void analyze_expression(const AST::Primary&);
+
+  template <typename Left, typename Right>
+  void analyze_operands(const Left&, const Right&, bool);
+
+  void push(int64_t);
+  void find_recursion();
+  auto resolve_total(const std::string&, std::map<std::string, bool>&) -> std::optional<int64_t>;
+};
+}  // namespace kuso
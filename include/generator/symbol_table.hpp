@@ -0,0 +1,114 @@
+/**
+ * @file symbol_table.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "generator/variables.hpp"
+
+namespace kuso {
+/**
+ * @brief Scoped symbol table
+ *
+ * Entries are kept in a single flat array, each scope only records where it starts.
+ * Entering a scope pushes a marker and leaving one truncates the array back to it,
+ * lookups search from the innermost entry outwards so inner declarations shadow outer ones.
+ *
+ * Names are not owned, they must outlive the table (they point into the AST).
+ */
+template <typename T>
+class BasicSymbolTable {
+ public:
+  struct Entry {
+    std::string_view name;
+    T                variable;
+  };
+
+  using iterator = typename std::vector<Entry>::iterator;
+  using const_iterator = typename std::vector<Entry>::const_iterator;
+
+  /**
+   * @brief Opens a new scope
+   *
+   */
+  void enter_scope() { _scopes.push_back(_entries.size()); }
+
+  /**
+   * @brief Closes the innermost scope, dropping every entry declared in it
+   *
+   */
+  void leave_scope() {
+    if (_scopes.empty()) throw std::runtime_error("Cannot leave global scope");
+    _entries.resize(_scopes.back());
+    _scopes.pop_back();
+  }
+
+  /**
+   * @brief Declares a variable in the innermost scope
+   *
+   * @param name name of the variable
+   * @param variable variable information
+   * @return true if the variable was declared
+   * @return false if the name is already declared in the innermost scope
+   */
+  auto declare(std::string_view name, const T& variable) -> bool {
+    if (find_in_scope(name)) return false;
+    _entries.push_back(Entry{name, variable});
+    return true;
+  }
+
+  /**
+   * @brief Finds the innermost visible declaration of a name
+   *
+   * @param name name to look up
+   * @return std::optional<std::reference_wrapper<T>> variable, if found
+   */
+  [[nodiscard]] auto find(std::string_view name) -> std::optional<std::reference_wrapper<T>> {
+    for (auto iter = _entries.rbegin(); iter != _entries.rend(); ++iter) {
+      if (iter->name == name) return iter->variable;
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * @brief Finds a declaration of a name in the innermost scope only
+   *
+   * @param name name to look up
+   * @return std::optional<std::reference_wrapper<T>> variable, if found
+   */
+  [[nodiscard]] auto find_in_scope(std::string_view name) -> std::optional<std::reference_wrapper<T>> {
+    auto start = _scopes.empty() ? 0 : _scopes.back();
+    for (auto idx = _entries.size(); idx > start; --idx) {
+      if (_entries[idx - 1].name == name) return _entries[idx - 1].variable;
+    }
+    return std::nullopt;
+  }
+
+  [[nodiscard]] auto depth() const -> size_t { return _scopes.size(); }
+  [[nodiscard]] auto size() const -> size_t { return _entries.size(); }
+
+  [[nodiscard]] auto begin() -> iterator { return _entries.begin(); }
+  [[nodiscard]] auto end() -> iterator { return _entries.end(); }
+  [[nodiscard]] auto begin() const -> const_iterator { return _entries.begin(); }
+  [[nodiscard]] auto end() const -> const_iterator { return _entries.end(); }
+
+ private:
+  std::vector<Entry>  _entries;
+  std::vector<size_t> _scopes;
+};
+
+using SymbolTable = BasicSymbolTable<Variable>;
+}  // namespace kuso
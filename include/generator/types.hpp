@@ -14,32 +14,52 @@
 #include <functional>
 #include <map>
 #include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "x64/x64.hpp"
 
 namespace kuso {
 
+struct TypeID {
+  size_t id;
+
+  // NOLINTNEXTLINE
+  operator size_t() const { return id; }
+};
+
 /**
  * @brief Holds information about a type
  * 
+ * order lists the attributes in memory order, padding counts every byte that is not part of an attribute
  */
 struct Type {
   int                                       size{x64::Size::QWORD};
   std::optional<std::map<std::string, int>> offsets;
+  int                                       align{x64::Size::QWORD};
+  int                                       padding{0};
+  std::map<std::string, TypeID>             fields;
+  std::vector<std::string>                  order;
+
+  /**
+   * @brief Creates a builtin type, aligned to its own size
+   * 
+   */
+  [[nodiscard]] static auto primitive(int size) -> Type {
+    Type type;
+    type.size = size;
+    type.align = size > 0 ? size : 1;
+    return type;
+  }
 
   [[nodiscard]] auto get_offset(const std::string& attribute) const -> int {
     if (!offsets.has_value()) return 0;
+    if (!offsets->contains(attribute)) throw std::runtime_error("Unknown Attribute " + attribute);
     return offsets->at(attribute);
   }
 };
 
-struct TypeID {
-  size_t id;
-
-  // NOLINTNEXTLINE
-  operator size_t() const { return id; }
-};
-
 class TypeContainer {
  public:
   void add_type(const std::string& name, const Type& type) {
@@ -57,11 +77,18 @@ class TypeContainer {
     return std::nullopt;
   }
 
+  [[nodiscard]] auto get_type(TypeID tid) const -> std::optional<std::reference_wrapper<const Type>> {
+    if (_types.contains(tid)) return _types.at(tid);
+    return std::nullopt;
+  }
+
   [[nodiscard]] auto get_type(const std::string& name) -> std::optional<std::reference_wrapper<Type>> {
     if (_typeIDs.contains(name)) return get_type(_typeIDs.at(name));
     return std::nullopt;
   }
 
+  [[nodiscard]] auto names() const -> const std::map<std::string, TypeID>& { return _typeIDs; }
+
  private:
   std::map<std::string, TypeID> _typeIDs;
   std::map<TypeID, Type>        _types;
@@ -0,0 +1,44 @@
+/**
+ * @file cfg.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "ir/ir.hpp"
+
+namespace kuso::ir {
+[[nodiscard]] auto predecessors(const Function&) -> std::vector<std::vector<BlockId>>;
+[[nodiscard]] auto reverse_postorder(const Function&) -> std::vector<BlockId>;
+
+auto remove_unreachable_blocks(Function&) -> bool;
+
+/**
+ * @brief Dominator tree of a function's reachable blocks
+ *
+ */
+class DominatorTree {
+ public:
+  explicit DominatorTree(const Function&);
+
+  [[nodiscard]] auto reachable(BlockId) const -> bool;
+  [[nodiscard]] auto idom(BlockId) const -> BlockId;
+  [[nodiscard]] auto dominates(BlockId, BlockId) const -> bool;
+  [[nodiscard]] auto children(BlockId) const -> const std::vector<BlockId>&;
+  [[nodiscard]] auto order() const -> const std::vector<BlockId>&;
+
+ private:
+  std::vector<BlockId>              _order;
+  std::vector<size_t>               _position;
+  std::vector<BlockId>              _idom;
+  std::vector<std::vector<BlockId>> _children;
+};
+}  // namespace kuso::ir
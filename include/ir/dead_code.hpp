@@ -0,0 +1,52 @@
+/**
+ * @file dead_code.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <belt/class_macros.hpp>
+
+#include "ir/ir.hpp"
+
+namespace kuso::ir {
+/**
+ * @brief Removes IR that cannot affect the result of a function
+ *
+ * Branches on constants become jumps and the blocks no longer reached are dropped. Stores to stack
+ * slots that are never loaded go away, then every instruction whose value is never used and that has no
+ * side effects is removed, along with whatever only it used. Slots of functions with inline assembly are
+ * left alone.
+ */
+class DeadCode {
+  DEFAULT_CONSTRUCTIBLE(DeadCode)
+  DEFAULT_COPYABLE(DeadCode)
+  DEFAULT_MOVABLE(DeadCode)
+  DEFAULT_DESTRUCTIBLE(DeadCode)
+
+ public:
+  void run(Module&);
+  void run(Function&);
+
+  [[nodiscard]] auto to_string() const -> std::string;
+
+ private:
+  int64_t _branches{0};
+  int64_t _blocks{0};
+  int64_t _stores{0};
+  int64_t _instructions{0};
+
+  void fold_branches(Function&);
+  void remove_dead_stores(Function&);
+  void remove_dead_instructions(Function&);
+};
+}  // namespace kuso::ir
@@ -0,0 +1,99 @@
+/**
+ * @file inliner.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-19
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <belt/class_macros.hpp>
+
+#include "ir/ir.hpp"
+
+namespace kuso::ir {
+/**
+ * @brief Replaces calls to small functions with a copy of their body
+ *
+ * Functions are visited callees first, so a function is measured after its own calls were inlined. Every
+ * instruction of the callee costs one except its parameters, slots and returns. A call is inlined when the
+ * cost stays within the threshold, which grows for every constant argument and is larger for a function
+ * called from a single place, since that copy replaces the function. @inline always inlines and @noinline
+ * never does. Recursive functions, functions with inline assembly and the entry are kept as calls, as are
+ * calls into a caller that already grew past its limit. Optimizing for size lowers the threshold to
+ * SIZE_THRESHOLD, about what the call and its argument moves cost.
+ *
+ * The parameters of the copy are the arguments of the call, its values and blocks are renumbered into the
+ * caller and its slots join the caller's entry block. Returns jump to the code after the call, which picks
+ * the returned value with a phi. Functions whose every call was inlined are removed.
+ */
+class Inliner {
+  DEFAULT_CONSTRUCTIBLE(Inliner)
+  DEFAULT_COPYABLE(Inliner)
+  DEFAULT_MOVABLE(Inliner)
+  DEFAULT_DESTRUCTIBLE(Inliner)
+
+ public:
+  static constexpr int64_t THRESHOLD = 16;
+  static constexpr int64_t SIZE_THRESHOLD = 4;
+  static constexpr int64_t CONSTANT_ARGUMENT_BONUS = 4;
+  static constexpr int64_t SINGLE_CALL_THRESHOLD = 64;
+  static constexpr int64_t MAX_CALLER_COST = 1024;
+
+  /**
+   * @brief What was decided for one call
+   *
+   */
+  struct Decision {
+    std::string caller;
+    std::string callee;
+    int64_t     cost{0};
+    int64_t     threshold{0};
+    bool        inlined{false};
+    std::string reason;
+  };
+
+  explicit Inliner(int64_t threshold) : _threshold(threshold) {}
+
+  void run(Module&);
+
+  [[nodiscard]] static auto cost(const Function&) -> int64_t;
+
+  [[nodiscard]] auto decisions() const -> const std::vector<Decision>& { return _decisions; }
+  [[nodiscard]] auto inlined() const -> int64_t;
+  [[nodiscard]] auto removed() const -> int64_t { return _removed; }
+  [[nodiscard]] auto report() const -> std::string;
+  [[nodiscard]] auto to_string() const -> std::string;
+
+ private:
+  /**
+   * @brief Functions of a module by name, how often each is called and what it costs
+   *
+   */
+  struct CallGraph {
+    std::map<std::string, size_t> index;
+    std::vector<bool>             recursive;
+    std::vector<int64_t>          calls;
+    std::vector<int64_t>          costs;
+  };
+
+  std::vector<Decision> _decisions;
+  int64_t               _removed{0};
+  int64_t               _threshold{THRESHOLD};
+
+  void inline_calls(Module&, size_t, const CallGraph&);
+
+  [[nodiscard]] auto decide(const Function&, int64_t, const Function&, size_t, const CallGraph&,
+                            int64_t) const -> Decision;
+  static void inline_call(Function&, BlockId, size_t, const Function&);
+};
+}  // namespace kuso::ir
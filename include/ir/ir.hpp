@@ -0,0 +1,180 @@
+/**
+ * @file ir.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace kuso::ir {
+/**
+ * @brief Virtual register, every value is defined exactly once
+ *
+ */
+using VReg = uint32_t;
+
+/**
+ * @brief Index of a block in its function
+ *
+ */
+using BlockId = uint32_t;
+
+constexpr VReg NO_VREG = std::numeric_limits<VReg>::max();
+
+/**
+ * @brief Types of IR values, integers narrower than I64 only exist in memory
+ *
+ */
+enum class Type { VOID, I1, I8, I16, I32, I64, PTR };
+
+/**
+ * @brief IR operations
+ *
+ */
+enum class Op {
+  CONST,  // dest = imm
+  PARAM,  // dest = parameter number imm
+  LOCAL,  // dest = address of a stack slot of size bytes, aligned to imm
+  LOAD,   // dest = sign extended size bytes at operand 0 + imm
+  STORE,  // size bytes at operand 0 + imm = operand 1
+  COPY,   // dest = operand 0
+  ADD,
+  SUB,
+  MUL,
+  DIV,
+  MOD,
+  POW,  // dest = operand 0 to the power of operand 1, 0 for negative powers
+  NEG,
+  CMP,     // dest = operand 0 <cond> operand 1
+  ZEXT,    // dest = operand 0 widened to I64
+  PHI,     // dest = operand i when control came from blocks[i]
+  CALL,    // dest = name(operands...)
+  RESULT,  // dest = second value returned by the call right before, which defines operand 0
+  ASM,     // inline assembly in name
+  RET,     // return operand 0, if any, and operand 1 as a second value
+  EXIT,    // exit the program with operand 0
+  JMP,     // jump to blocks[0]
+  BR,      // jump to blocks[0] if operand 0 is not zero, blocks[1] otherwise
+};
+
+/**
+ * @brief Signed comparison conditions
+ *
+ */
+enum class Cond { EQ, NE, LT, LE, GT, GE };
+
+/**
+ * @brief Single IR instruction
+ *
+ */
+struct Instruction {
+  Op                   op;
+  Type                 type{Type::VOID};
+  VReg                 dest{NO_VREG};
+  std::vector<VReg>    operands;
+  std::vector<BlockId> blocks;
+  int64_t              imm{0};
+  int64_t              size{0};
+  Cond                 cond{Cond::EQ};
+  std::string          name;
+
+  explicit Instruction(Op operation, Type valueType = Type::VOID) : op(operation), type(valueType) {}
+
+  [[nodiscard]] auto is_terminator() const -> bool {
+    return op == Op::RET || op == Op::EXIT || op == Op::JMP || op == Op::BR;
+  }
+
+  /**
+   * @brief Checks if the instruction does anything besides defining its value
+   *
+   */
+  [[nodiscard]] auto has_side_effects() const -> bool {
+    return op == Op::STORE || op == Op::CALL || op == Op::ASM || is_terminator();
+  }
+};
+
+/**
+ * @brief Basic block, a list of instructions ending in exactly one terminator
+ *
+ */
+struct Block {
+  std::vector<Instruction> instructions;
+
+  [[nodiscard]] auto terminated() const -> bool {
+    return !instructions.empty() && instructions.back().is_terminator();
+  }
+
+  [[nodiscard]] auto successors() const -> std::vector<BlockId> {
+    if (!terminated()) return {};
+    return instructions.back().blocks;
+  }
+};
+
+/**
+ * @brief Whether calls to a function are inlined, @inline and @noinline override the cost model
+ *
+ */
+enum class Inlining { DEFAULT, ALWAYS, NEVER };
+
+/**
+ * @brief Function in SSA form, block 0 is the entry, a pair function returns a second value in rdx
+ *
+ */
+struct Function {
+  std::string        name;
+  std::vector<Type>  params;
+  Type               returnType{Type::I64};
+  bool               entry{false};
+  bool               pair{false};
+  Inlining           inlining{Inlining::DEFAULT};
+  std::vector<Block> blocks;
+  std::vector<Type>  vregs;
+
+  auto new_vreg(Type type) -> VReg {
+    vregs.push_back(type);
+    return static_cast<VReg>(vregs.size() - 1);
+  }
+
+  auto new_block() -> BlockId {
+    blocks.emplace_back();
+    return static_cast<BlockId>(blocks.size() - 1);
+  }
+
+  [[nodiscard]] auto has_asm() const -> bool;
+};
+
+/**
+ * @brief A whole program, the entry function is the one named main
+ *
+ */
+struct Module {
+  std::vector<Function> functions;
+
+  [[nodiscard]] auto find(const std::string& name) -> std::optional<std::reference_wrapper<Function>> {
+    for (auto& func : functions) {
+      if (func.name == name) return func;
+    }
+    return std::nullopt;
+  }
+};
+
+[[nodiscard]] auto to_string(Type) -> std::string;
+[[nodiscard]] auto to_string(Op) -> std::string;
+[[nodiscard]] auto to_string(Cond) -> std::string;
+[[nodiscard]] auto to_string(const Instruction&) -> std::string;
+[[nodiscard]] auto to_string(const Function&) -> std::string;
+[[nodiscard]] auto to_string(const Module&) -> std::string;
+}  // namespace kuso::ir
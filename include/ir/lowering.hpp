@@ -0,0 +1,111 @@
+/**
+ * @file lowering.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <belt/class_macros.hpp>
+
+#include "generator/first_pass.hpp"
+#include "generator/symbol_table.hpp"
+#include "ir/ir.hpp"
+#include "parser/ast.hpp"
+
+namespace kuso::ir {
+/**
+ * @brief Lowers the AST to the SSA IR
+ *
+ * Variables live in stack slots (LOCAL), every read is a LOAD and every write a STORE, so the
+ * output is in SSA form without any phi nodes. Slots are hoisted into the entry block, parameters
+ * only get one once they are referenced. Expressions are evaluated in the same order as the
+ * AST generator, right operand first.
+ */
+class Lowering {
+  DEFAULT_CONSTRUCTIBLE(Lowering)
+  NON_COPYABLE(Lowering)
+  DEFAULT_MOVABLE(Lowering)
+  DEFAULT_DESTRUCTIBLE(Lowering)
+
+ public:
+  [[nodiscard]] auto lower(const AST&) -> std::optional<Module>;
+
+  [[nodiscard]] auto types() -> const TypeContainer& { return _firstpass.get_types(); }
+
+ private:
+  struct Local {
+    VReg    address{NO_VREG};
+    TypeID  type{0};
+    int64_t param{-1};
+  };
+
+  struct Signature {
+    size_t      argCnt;
+    bool        returns;
+    std::string returnType;
+    bool        tuple;
+  };
+
+  FirstPass                        _firstpass;
+  std::map<std::string, Signature> _signatures;
+  BasicSymbolTable<Local>          _scope;
+
+  Function*                _func{nullptr};
+  BlockId                  _block{0};
+  std::vector<Instruction> _prologue;
+
+  [[nodiscard]] static auto inlining(const AST::Func&) -> Inlining;
+  [[nodiscard]] auto signature(const AST::Func&) -> Signature;
+
+  void lower_func(const std::string&, const std::vector<std::unique_ptr<AST::Declaration>>&,
+                  const std::vector<AST::Statement>&, Type, bool);
+  void lower_body(const std::vector<AST::Statement>&);
+  void lower(const AST::Statement&);
+  void lower_declaration(const AST::Declaration&);
+  void lower_destructure(const AST::Destructure&);
+  void declare_local(const AST::Declaration&, VReg);
+  void lower_assignment(const AST::Assignment&);
+  void lower_if(const AST::If&);
+  void lower_while(const AST::While&);
+  void lower_return(const AST::Return&);
+  auto lower_returned(const AST::Expression&, const Signature&) -> std::vector<VReg>;
+  void lower_exit(const AST::Exit&);
+
+  auto lower_call(const AST::Call&, bool) -> VReg;
+  auto lower_expression(const AST::Expression&) -> VReg;
+  auto lower_expression(const AST::Equality&) -> VReg;
+  auto lower_expression(const AST::Comparison&) -> VReg;
+  auto lower_expression(const AST::Term&) -> VReg;
+  auto lower_expression(const AST::Factor&) -> VReg;
+  auto lower_expression(const AST::Unary&) -> VReg;
+  auto lower_expression(const AST::Primary&) -> VReg;
+  auto lower_expression(const AST::Terminal&) -> VReg;
+  auto lower_expression(const AST::Variable&) -> VReg;
+
+  auto emit(Instruction) -> VReg;
+  auto emit_binary(Op, VReg, VReg) -> VReg;
+  auto emit_compare(Cond, VReg, VReg) -> VReg;
+  auto emit_const(int64_t) -> VReg;
+  auto emit_result(VReg) -> VReg;
+  auto new_local(int64_t, int64_t) -> VReg;
+  void jump(BlockId);
+  void start_block(BlockId);
+
+  [[nodiscard]] auto find_local(const AST::Variable&) -> Local&;
+  [[nodiscard]] auto access(const AST::Variable&) -> std::pair<int64_t, int64_t>;
+  [[nodiscard]] auto get_check_type(TypeID) -> kuso::Type&;
+  [[nodiscard]] auto get_check_type_id(const std::string&) -> TypeID;
+  [[nodiscard]] auto aggregate(const Signature&) -> bool;
+};
+}  // namespace kuso::ir
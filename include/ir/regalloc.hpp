@@ -0,0 +1,122 @@
+/**
+ * @file regalloc.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "ir/ir.hpp"
+#include "x64/x64.hpp"
+
+namespace kuso::ir {
+/**
+ * @brief Where a value lives at some point of a function
+ *
+ */
+struct Location {
+  enum class Kind { NONE, REGISTER, STACK, CONSTANT, LOCAL };
+
+  Kind          kind{Kind::NONE};
+  x64::Register reg{x64::Register::NONE};
+  int64_t       value{0};
+
+  [[nodiscard]] static auto in_register(x64::Register) -> Location;
+  [[nodiscard]] static auto spilled(int64_t) -> Location;
+  [[nodiscard]] static auto constant(int64_t) -> Location;
+  [[nodiscard]] static auto local(VReg) -> Location;
+
+  [[nodiscard]] auto operator==(const Location&) const -> bool = default;
+};
+
+/**
+ * @brief Linear scan register allocator over the values of a function
+ *
+ * Instructions are numbered in block order, instruction i reads its operands at 2i and writes its value
+ * at 2i + 1. Every value gets a live interval with holes from the block liveness, intervals are then
+ * assigned registers in order of their start. When a register is only free for part of an interval the
+ * interval is split and the rest goes back into the queue, when none is free the interval with the
+ * furthest next use is spilled. Constants never take a register or a stack slot, they are rematerialized
+ * as immediates wherever they are used.
+ *
+ * Calls clobber the caller saved registers and division clobbers rdx, values that are live across them
+ * end up in callee saved registers or split around them. rax and r11 are never allocated, they are the
+ * scratch registers of the code generator. LOCAL values are not allocated, they are frame addresses.
+ */
+class LinearScan {
+ public:
+  using Range = std::pair<int64_t, int64_t>;
+  using Move = std::pair<Location, Location>;
+
+  LinearScan(const Function&, bool);
+
+  [[nodiscard]] auto location(VReg, int64_t) const -> Location;
+  [[nodiscard]] auto moves_before(size_t) const -> std::vector<Move>;
+  [[nodiscard]] auto edge_moves(BlockId, BlockId) const -> std::vector<Move>;
+  [[nodiscard]] auto used_registers() const -> const std::set<x64::Register>& { return _used; }
+  [[nodiscard]] auto spill_slots() const -> int64_t { return _slotCount; }
+
+ private:
+  struct Interval {
+    VReg                 vreg{NO_VREG};
+    std::vector<Range>   ranges;
+    std::vector<int64_t> uses;
+    Location             location;
+
+    [[nodiscard]] auto start() const -> int64_t { return ranges.front().first; }
+    [[nodiscard]] auto end() const -> int64_t { return ranges.back().second; }
+    [[nodiscard]] auto covers(int64_t) const -> bool;
+    [[nodiscard]] auto next_use(int64_t) const -> int64_t;
+    [[nodiscard]] auto intersection(const std::vector<Range>&) const -> int64_t;
+    [[nodiscard]] auto split(int64_t) -> Interval;
+  };
+
+  const Function& _func;
+
+  std::vector<const Instruction*>                     _defs;
+  std::vector<int64_t>                                _blockFrom;
+  std::vector<int64_t>                                _blockTo;
+  std::vector<std::pair<int64_t, VReg>>               _calls;
+  std::vector<std::vector<bool>>                      _liveIn;
+  std::vector<std::vector<bool>>                      _liveOut;
+  std::vector<Interval>                               _intervals;
+  std::vector<std::vector<size_t>>                    _children;
+  std::array<std::vector<Range>, x64::REGISTER_COUNT> _fixed;
+  std::vector<x64::Register>                          _hints;
+  std::set<std::pair<int64_t, size_t>>                _unhandled;
+  std::vector<int64_t>                                _slots;
+  std::map<size_t, std::vector<Move>>                 _moves;
+  std::set<x64::Register>                             _used;
+  int64_t                                             _slotCount{0};
+
+  void number();
+  void compute_liveness();
+  void build_intervals();
+  void block_registers();
+  void allocate(bool);
+  void resolve();
+
+  auto try_allocate_free(size_t, const std::vector<size_t>&, const std::vector<size_t>&) -> bool;
+  void allocate_blocked(size_t, std::vector<size_t>&, std::vector<size_t>&);
+  [[nodiscard]] auto call_blocks(size_t) const -> std::array<int64_t, x64::REGISTER_COUNT>;
+  void evict(size_t, int64_t);
+  auto split(size_t, int64_t) -> size_t;
+  void spill(size_t);
+  void assign(size_t, x64::Register);
+
+  [[nodiscard]] auto tracked(VReg) const -> bool;
+  [[nodiscard]] auto phi_inputs(BlockId, BlockId) const -> std::vector<std::pair<VReg, VReg>>;
+};
+}  // namespace kuso::ir
@@ -0,0 +1,62 @@
+/**
+ * @file scalar_replacement.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-19
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+
+#include <belt/class_macros.hpp>
+
+#include "ir/ir.hpp"
+
+namespace kuso::ir {
+/**
+ * @brief Splits the stack slots of user defined types into one slot per attribute, so slot promotion
+ * can keep each attribute in a register
+ *
+ * A slot is split when its address is only ever the address of a load or store and the ranges of bytes
+ * they access never partially overlap. Every distinct range becomes a slot of its own, accessed at offset
+ * 0, and the original slot is removed. Slots only ever accessed whole are left to slot promotion.
+ *
+ * Functions with inline assembly keep their slots, the assembly may read or write any of them.
+ */
+class ScalarReplacement {
+  DEFAULT_CONSTRUCTIBLE(ScalarReplacement)
+  DEFAULT_COPYABLE(ScalarReplacement)
+  DEFAULT_MOVABLE(ScalarReplacement)
+  DEFAULT_DESTRUCTIBLE(ScalarReplacement)
+
+ public:
+  void run(Module&);
+  void run(Function&);
+
+  [[nodiscard]] auto split() const -> int64_t { return _split; }
+  [[nodiscard]] auto fields() const -> int64_t { return _fields; }
+  [[nodiscard]] auto to_string() const -> std::string;
+
+ private:
+  /**
+   * @brief Byte range accessed in a slot, its offset and size
+   *
+   */
+  using Range = std::pair<int64_t, int64_t>;
+
+  std::map<VReg, std::map<Range, VReg>> _slots;
+  int64_t                               _split{0};
+  int64_t                               _fields{0};
+
+  void find_slots(const Function&);
+  void replace(Function&);
+};
+}  // namespace kuso::ir
@@ -0,0 +1,71 @@
+/**
+ * @file slot_promotion.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-19
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <belt/class_macros.hpp>
+
+#include "ir/cfg.hpp"
+#include "ir/ir.hpp"
+
+namespace kuso::ir {
+/**
+ * @brief Turns stack slots into SSA values, so locals stay in registers instead of memory
+ *
+ * A slot is promoted when its address is only ever loaded from and stored to whole, as a single 8 byte
+ * value of one type. Narrower slots are left alone, their loads sign extend what was stored. Phis are
+ * placed on the iterated dominance frontier of the blocks storing to a slot, then the blocks are walked
+ * down the dominator tree replacing every load with the value last stored on the way. A load before any
+ * store is undefined in the language and reads 0 here. Phis that nothing but other placed phis use are
+ * removed again.
+ *
+ * Functions with inline assembly keep their slots, the assembly may read or write any of them, as do
+ * functions whose entry block is jumped back to, since a phi there would have no edge for the call.
+ */
+class SlotPromotion {
+  DEFAULT_CONSTRUCTIBLE(SlotPromotion)
+  DEFAULT_COPYABLE(SlotPromotion)
+  DEFAULT_MOVABLE(SlotPromotion)
+  DEFAULT_DESTRUCTIBLE(SlotPromotion)
+
+ public:
+  void run(Module&);
+  void run(Function&);
+
+  [[nodiscard]] auto promoted() const -> int64_t { return _promoted; }
+  [[nodiscard]] auto loads() const -> int64_t { return _loads; }
+  [[nodiscard]] auto to_string() const -> std::string;
+
+ private:
+  std::map<VReg, size_t>            _slots;
+  std::map<VReg, size_t>            _phis;
+  std::vector<Type>                 _types;
+  std::vector<VReg>                 _undefined;
+  std::vector<std::vector<VReg>>    _values;
+  std::vector<VReg>                 _leaders;
+  std::vector<std::vector<BlockId>> _preds;
+  int64_t                           _promoted{0};
+  int64_t                           _loads{0};
+  int64_t                           _stores{0};
+
+  void find_slots(const Function&);
+  void place_phis(Function&, const DominatorTree&);
+  void rename(Function&, const DominatorTree&, BlockId);
+  void remove_unused_phis(Function&);
+
+  [[nodiscard]] auto leader(VReg) const -> VReg;
+};
+}  // namespace kuso::ir
@@ -0,0 +1,97 @@
+/**
+ * @file value_numbering.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-19
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <compare>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <belt/class_macros.hpp>
+
+#include "ir/cfg.hpp"
+#include "ir/ir.hpp"
+
+namespace kuso::ir {
+/**
+ * @brief Removes instructions that compute a value already computed by an instruction dominating them
+ *
+ * Blocks are visited down the dominator tree with a table of the values computed on the way, an
+ * instruction whose operation and operands are in the table is replaced by the value found there.
+ * Operands of commutative operations are ordered first, so a + b and b + a are the same value.
+ *
+ * Loads also depend on the memory they read. Every store, call and inline assembly starts a new version
+ * of memory, and a load is only the same as an earlier one if memory has the same version. A store to a
+ * stack slot only starts a new version of that slot, since no other address can reach it. Memory is only
+ * followed into a block whose single predecessor is the block above it in the tree, any other block
+ * starts with memory unknown. A load reading back what a store wrote is replaced by the stored value.
+ */
+class ValueNumbering {
+  DEFAULT_CONSTRUCTIBLE(ValueNumbering)
+  DEFAULT_COPYABLE(ValueNumbering)
+  DEFAULT_MOVABLE(ValueNumbering)
+  DEFAULT_DESTRUCTIBLE(ValueNumbering)
+
+ public:
+  void run(Module&);
+  void run(Function&);
+
+  [[nodiscard]] auto values() const -> int64_t { return _values; }
+  [[nodiscard]] auto loads() const -> int64_t { return _loads; }
+  [[nodiscard]] auto to_string() const -> std::string;
+
+ private:
+  /**
+   * @brief Everything the value of an instruction depends on
+   *
+   */
+  struct Key {
+    Op                op;
+    Type              type;
+    Cond              cond;
+    int64_t           imm;
+    int64_t           size;
+    int64_t           memory;
+    std::vector<VReg> operands;
+
+    auto operator<=>(const Key&) const = default;
+  };
+
+  /**
+   * @brief Versions of memory at some point, a slot's version only counts when it is newer than all
+   *
+   */
+  struct Memory {
+    int64_t                 all{0};
+    int64_t                 any{0};
+    std::map<VReg, int64_t> slots;
+  };
+
+  std::map<Key, VReg>               _table;
+  std::vector<Key>                  _keys;
+  std::vector<VReg>                 _leaders;
+  std::vector<bool>                 _slots;
+  std::vector<Memory>               _exits;
+  std::vector<std::vector<BlockId>> _preds;
+  int64_t                           _version{0};
+  int64_t                           _values{0};
+  int64_t                           _loads{0};
+
+  void number(Function&, const DominatorTree&, BlockId);
+  void clobber(Memory&, const Instruction&);
+  void forward(const Function&, const Instruction&, const Memory&);
+
+  [[nodiscard]] auto key(const Instruction&, const Memory&) const -> Key;
+  [[nodiscard]] auto leader(VReg) const -> VReg;
+};
+}  // namespace kuso::ir
@@ -0,0 +1,27 @@
+/**
+ * @file verifier.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "ir/ir.hpp"
+
+namespace kuso::ir {
+/**
+ * @brief Checks the structural and SSA invariants of the IR
+ *
+ * @return std::vector<std::string> One message per violation, empty if the IR is valid
+ */
+[[nodiscard]] auto verify(const Function&) -> std::vector<std::string>;
+[[nodiscard]] auto verify(const Module&) -> std::vector<std::string>;
+}  // namespace kuso::ir
@@ -0,0 +1,111 @@
+/**
+ * @file x64_lowering.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <belt/class_macros.hpp>
+
+#include "ir/ir.hpp"
+#include "ir/regalloc.hpp"
+#include "x64/addressing.hpp"
+#include "x64/instruction.hpp"
+#include "x64/peephole.hpp"
+#include "x64/x64.hpp"
+
+namespace kuso::ir {
+/**
+ * @brief Generates x64 assembly from the SSA IR
+ *
+ * Values live where the linear scan allocator puts them, rax and r11 are left as scratch registers.
+ * Phi nodes and values that changed location become parallel moves on the incoming edges, edges out
+ * of a branch that need moves get their own trampoline. A compare that only feeds a branch sets the
+ * flags the branch jumps on. Functions with inline assembly keep every
+ * value on the stack, the assembly may use any register. Labels and calling convention match the AST
+ * generator, including tail calls.
+ */
+class X64Lowering {
+  DEFAULT_CONSTRUCTIBLE(X64Lowering)
+  NON_COPYABLE(X64Lowering)
+  DEFAULT_MOVABLE(X64Lowering)
+  DEFAULT_DESTRUCTIBLE(X64Lowering)
+
+ public:
+  explicit X64Lowering(bool peephole) : _optimize(peephole) {}
+
+  [[nodiscard]] auto generate(const Module&) -> std::string;
+  [[nodiscard]] auto peephole() const -> const x64::Peephole& { return _peephole; }
+
+ private:
+  struct Frame {
+    std::vector<int64_t>                  locals;
+    std::vector<int64_t>                  spills;
+    std::map<x64::Register, x64::Address> saves;
+    int64_t                               size{0};
+    bool                                  frame{false};
+    size_t                                stackParams{0};
+  };
+
+  std::map<std::string, x64::LabelId> _labels;
+  std::vector<x64::LabelId>           _blockLabels;
+  x64::InstructionBuffer              _code;
+  x64::Peephole                       _peephole;
+  bool                                _optimize{true};
+  size_t                              _labelCount{0};
+
+  const Function*           _func{nullptr};
+  std::optional<LinearScan> _allocation;
+  Frame                     _frame;
+  size_t                    _index{0};
+  std::vector<int64_t>      _uses;
+  std::optional<Cond>       _flags;
+
+  void generate(const Function&);
+  void generate(const Instruction&, BlockId, BlockId);
+  void generate_binary(const Instruction&);
+  void generate_call(const Instruction&);
+  void generate_tail_call(const Instruction&);
+  void generate_epilogue();
+
+  [[nodiscard]] auto tail_call(const Function&, const std::vector<Instruction>&, size_t) const -> bool;
+  [[nodiscard]] auto fused_branch(const std::vector<Instruction>&, size_t) const -> bool;
+
+  [[nodiscard]] auto layout_frame(const Function&) -> Frame;
+  [[nodiscard]] auto location(VReg, int64_t) const -> Location;
+  [[nodiscard]] auto local_slot(VReg) const -> x64::Address;
+  [[nodiscard]] auto spill_slot(int64_t) const -> x64::Address;
+  [[nodiscard]] auto address(const Instruction&, int64_t) -> x64::Address;
+  [[nodiscard]] auto new_label() -> x64::LabelId;
+
+  void move(const Location&, const Location&);
+  void move(x64::Register, const Location&);
+  void parallel_move(std::vector<LinearScan::Move>);
+  void load(const Location&, x64::Address, x64::Size);
+
+  void emit(const std::string&);
+  void emit(x64::LabelId);
+  void emit(x64::Op);
+  void emit(x64::Op, x64::LabelId);
+  void emit(x64::Op, x64::Register);
+  void emit(x64::Op, x64::Size, x64::Register);
+  void emit(x64::Op, x64::Size, x64::Address);
+  void emit(x64::Op, x64::Register, x64::Register);
+  void emit(x64::Op, x64::Register, x64::Address);
+  void emit(x64::Op, x64::Register, x64::Size, x64::Address);
+  void emit(x64::Op, x64::Address, x64::Register);
+  void emit(x64::Op, x64::Register, x64::Literal);
+  void emit(x64::Op, x64::Register, const Location&, x64::Register);
+};
+}  // namespace kuso::ir
@@ -11,6 +11,7 @@
 
 #pragma once
 
+#include <array>
 #include <cstddef>
 #include <memory>
 #include <optional>
@@ -52,6 +53,7 @@ class AST {
   };
 
   struct Declaration;
+  struct Destructure;
   struct Return;
   struct Assignment;
 
@@ -72,6 +74,7 @@ class AST {
 
   struct Type;
   struct Attribute;
+  struct Annotation;
 
   struct Statement;
   struct Exit;
@@ -129,11 +132,23 @@ struct AST::Declaration {
 };
 
 /**
- * @brief AST node for return statements
+ * @brief AST node for declarations of the two values a function returns, (q : int, r : int) = f();
+ * 
+ */
+struct AST::Destructure {
+  std::array<std::unique_ptr<Declaration>, 2> targets;
+  std::unique_ptr<Call>                       call;
+
+  [[nodiscard]] auto to_string(int) const -> std::string;
+};
+
+/**
+ * @brief AST node for return statements, second is the other value of a function returning two
  * 
  */
 struct AST::Return {
   std::unique_ptr<Expression> value;
+  std::unique_ptr<Expression> second;
 
   [[nodiscard]] auto to_string(int) const -> std::string;
 };
@@ -262,13 +277,15 @@ struct AST::Main {
 };
 
 /**
- * @brief AST node for function definitions
+ * @brief AST node for function definitions, tuple holds both types of a function returning two values
  * 
  */
 struct AST::Func {
   std::string                               name;
   std::vector<std::unique_ptr<Declaration>> args;
   std::string                               returnType;
+  std::vector<std::string>                  tuple;
+  std::vector<Annotation>                   annotations;
   std::vector<Statement>                    body;
 
   [[nodiscard]] auto to_string(int) const -> std::string;
@@ -315,12 +332,22 @@ struct AST::Attribute {
   std::string type;
 };
 
+/**
+ * @brief AST node for annotations, `@name` or `@name(value)`
+ * 
+ */
+struct AST::Annotation {
+  std::string            name;
+  std::optional<int64_t> value;
+};
+
 /**
  * @brief AST node for while statements
  * 
  */
 struct AST::While {
   std::unique_ptr<Expression> condition;
+  std::vector<Annotation>     annotations;
   std::vector<Statement>      body;
 
   [[nodiscard]] auto to_string(int) const -> std::string;
@@ -331,8 +358,9 @@ struct AST::While {
  * 
  */
 struct AST::Type {
-  std::string            name;
-  std::vector<Attribute> attributes;
+  std::string             name;
+  std::vector<Annotation> annotations;
+  std::vector<Attribute>  attributes;
 
   [[nodiscard]] auto to_string(int) const -> std::string;
 };
@@ -345,7 +373,7 @@ struct AST::Statement {
   std::variant<std::unique_ptr<Type>, std::unique_ptr<If>, std::unique_ptr<Exit>, std::unique_ptr<Assignment>,
                std::unique_ptr<Declaration>, std::unique_ptr<Func>, std::unique_ptr<Main>,
                std::unique_ptr<ASM>, std::unique_ptr<Call>, std::unique_ptr<Return>, std::unique_ptr<While>,
-               std::nullptr_t>
+               std::unique_ptr<Destructure>, std::nullptr_t>
       statement;
 
   [[nodiscard]] auto to_string(int) const -> std::string;
@@ -355,6 +383,7 @@ struct AST::Statement {
   explicit Statement(std::unique_ptr<Return> return_) : statement(std::move(return_)) {}
   explicit Statement(std::unique_ptr<Assignment> assignment) : statement(std::move(assignment)) {}
   explicit Statement(std::unique_ptr<Declaration> declaration) : statement(std::move(declaration)) {}
+  explicit Statement(std::unique_ptr<Destructure> destructure) : statement(std::move(destructure)) {}
   explicit Statement(std::unique_ptr<Type> type) : statement(std::move(type)) {}
   explicit Statement(std::unique_ptr<If> if_) : statement(std::move(if_)) {}
   explicit Statement(std::unique_ptr<While> while_) : statement(std::move(while_)) {}
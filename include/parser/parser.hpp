@@ -67,10 +67,12 @@ class Parser {
 
   [[nodiscard]] auto parse_type(Token&, Tokens&) -> std::unique_ptr<AST::Type>;
   [[nodiscard]] auto parse_attribute(Token&, Tokens&) -> AST::Attribute;
+  [[nodiscard]] auto parse_annotations(Token&, Tokens&) -> std::vector<AST::Annotation>;
 
   [[nodiscard]] auto parse_assignment(Token&, Tokens&) -> std::unique_ptr<AST::Assignment>;
   [[nodiscard]] auto parse_return(Token&, Tokens&) -> std::unique_ptr<AST::Return>;
   [[nodiscard]] auto parse_declaration(Token&, Tokens&) -> std::unique_ptr<AST::Declaration>;
+  [[nodiscard]] auto parse_destructure(Token&, Tokens&) -> std::unique_ptr<AST::Destructure>;
 
   [[nodiscard]] auto parse_if(Token&, Tokens&) -> std::unique_ptr<AST::If>;
   [[nodiscard]] auto parse_while(Token&, Tokens&) -> std::unique_ptr<AST::While>;
@@ -0,0 +1,132 @@
+/**
+ * @file pipeline.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-19
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <belt/class_macros.hpp>
+
+namespace kuso {
+/**
+ * @brief Optimization passes to run, in order
+ *
+ * -O0 runs none of them, not even the peephole rules, -O1 the ones that are cheap and never grow the code,
+ * -O2 all of them and -Os all but loop unrolling, with the inliner only taking calls that shrink the code.
+ * -passes= names the passes instead. Passes on the AST run before it is lowered to the SSA IR, so they
+ * have to be named before the passes on the IR. The peephole rules run on the generated assembly
+ * wherever they are named.
+ */
+class Pipeline {
+  DEFAULT_CONSTRUCTIBLE(Pipeline)
+  DEFAULT_COPYABLE(Pipeline)
+  DEFAULT_MOVABLE(Pipeline)
+  DEFAULT_DESTRUCTIBLE(Pipeline)
+
+ public:
+  enum class Pass { FOLD, DEAD_CODE, LICM, UNROLL, INLINE, SROA, MEM2REG, GVN, IR_DEAD_CODE, PEEPHOLE };
+
+  static constexpr std::array<std::pair<std::string_view, Pass>, 10> NAMES{{
+      {"fold", Pass::FOLD},
+      {"dce", Pass::DEAD_CODE},
+      {"licm", Pass::LICM},
+      {"unroll", Pass::UNROLL},
+      {"inline", Pass::INLINE},
+      {"sroa", Pass::SROA},
+      {"mem2reg", Pass::MEM2REG},
+      {"gvn", Pass::GVN},
+      {"ir-dce", Pass::IR_DEAD_CODE},
+      {"peephole", Pass::PEEPHOLE},
+  }};
+
+  /**
+   * @brief Builds the pipeline of an optimization level
+   *
+   * @param level 0, 1, 2 or s
+   * @return Pipeline the pipeline
+   */
+  static auto level(std::string_view level) -> Pipeline {
+    Pipeline pipeline;
+    if (level == "0") return pipeline;
+    if (level == "1") {
+      pipeline._passes = {Pass::FOLD, Pass::DEAD_CODE,    Pass::SROA,    Pass::MEM2REG,
+                          Pass::GVN,  Pass::IR_DEAD_CODE, Pass::PEEPHOLE};
+      return pipeline;
+    }
+    if (level == "2") {
+      // the copies of a fully unrolled loop see their induction local as a constant again
+      pipeline._passes = {Pass::FOLD, Pass::DEAD_CODE,    Pass::LICM,     Pass::UNROLL,
+                          Pass::FOLD, Pass::INLINE,       Pass::SROA,     Pass::MEM2REG,
+                          Pass::GVN,  Pass::IR_DEAD_CODE, Pass::PEEPHOLE};
+      return pipeline;
+    }
+    if (level == "s") {
+      pipeline._passes = {Pass::FOLD,     Pass::DEAD_CODE, Pass::LICM, Pass::INLINE,
+                          Pass::SROA,     Pass::MEM2REG,   Pass::GVN,  Pass::IR_DEAD_CODE,
+                          Pass::PEEPHOLE};
+      pipeline._size = true;
+      return pipeline;
+    }
+    throw std::runtime_error("Unknown optimization level " + std::string(level) + ", expected 0, 1, 2 or s");
+  }
+
+  /**
+   * @brief Builds a pipeline from a comma separated list of pass names, an empty list or name is an error
+   *
+   * @param names Pass names
+   * @return Pipeline the pipeline
+   */
+  static auto parse(std::string_view names) -> Pipeline {
+    static constexpr std::string_view EXPECTED =
+        ", expected fold, dce, licm, unroll, inline, sroa, mem2reg, gvn, ir-dce or peephole";
+
+    Pipeline pipeline;
+    bool     lowered = false;
+    for (bool last = false; !last;) {
+      auto comma = names.find(',');
+      auto name = names.substr(0, comma);
+      last = comma == std::string_view::npos;
+      if (!last) names = names.substr(comma + 1);
+
+      if (name.empty()) throw std::runtime_error("Missing pass name in -passes" + std::string(EXPECTED));
+      auto found = std::ranges::find(NAMES, name, &std::pair<std::string_view, Pass>::first);
+      if (found == NAMES.end()) {
+        throw std::runtime_error("Unknown pass " + std::string(name) + std::string(EXPECTED));
+      }
+      if (lowered && on_ast(found->second)) {
+        throw std::runtime_error("Pass " + std::string(name) +
+                                 " runs on the AST and has to come before the passes on the IR");
+      }
+      if (!on_ast(found->second) && found->second != Pass::PEEPHOLE) lowered = true;
+      pipeline._passes.push_back(found->second);
+    }
+    return pipeline;
+  }
+
+  [[nodiscard]] static auto on_ast(Pass pass) -> bool {
+    return pass == Pass::FOLD || pass == Pass::DEAD_CODE || pass == Pass::LICM || pass == Pass::UNROLL;
+  }
+
+  [[nodiscard]] auto passes() const -> const std::vector<Pass>& { return _passes; }
+  [[nodiscard]] auto has(Pass pass) const -> bool { return std::ranges::count(_passes, pass) > 0; }
+  [[nodiscard]] auto optimize_size() const -> bool { return _size; }
+
+ private:
+  std::vector<Pass> _passes;
+  bool              _size{false};
+};
+}  // namespace kuso
@@ -29,6 +29,19 @@ inline void register_args() {
                              pirate::ArgType::OPTIONAL | pirate::ArgType::VALUE_REQUIRED);
   pirate::Args::register_arg("log", "info", pirate::ArgType::OPTIONAL | pirate::ArgType::VALUE_REQUIRED);
   pirate::Args::register_arg("s", pirate::ArgType::OPTIONAL);
+  pirate::Args::register_arg("stack-report", pirate::ArgType::OPTIONAL);
+  pirate::Args::register_arg("layout-report", pirate::ArgType::OPTIONAL);
+  pirate::Args::register_arg("inline-report", pirate::ArgType::OPTIONAL);
+  pirate::Args::register_arg("stats", pirate::ArgType::OPTIONAL);
+  pirate::Args::register_arg("emit", "asm", pirate::ArgType::OPTIONAL | pirate::ArgType::VALUE_REQUIRED);
+  pirate::Args::register_arg("backend", pirate::ArgType::OPTIONAL | pirate::ArgType::VALUE_REQUIRED);
+  pirate::Args::register_arg("unroll", "4", pirate::ArgType::OPTIONAL | pirate::ArgType::VALUE_REQUIRED);
+  pirate::Args::register_arg("O0", pirate::ArgType::OPTIONAL);
+  pirate::Args::register_arg("O1", pirate::ArgType::OPTIONAL);
+  pirate::Args::register_arg("O2", pirate::ArgType::OPTIONAL);
+  pirate::Args::register_arg("Os", pirate::ArgType::OPTIONAL);
+  // an empty -passes is reported by the pipeline instead of aborting in the argument parser
+  pirate::Args::register_arg("passes", pirate::ArgType::OPTIONAL);
   pirate::Args::register_arg("h", pirate::ArgType::OPTIONAL);
   pirate::Args::register_arg("help", pirate::ArgType::OPTIONAL);
 }
@@ -41,7 +54,10 @@ inline auto initialize(int argc, const char** argv) -> bool {
 
   if (pirate::Args::has("h") || pirate::Args::has("help")) {
     kuso::Logging::info(fmt::format(
-        "Usage: {} -in=<input path> [-out=<output path>] [-s] [-log=<debug|info|warn|error>]", args[0]));
+        "Usage: {} -in=<input path> [-out=<output path>] [-s] [-log=<debug|info|warn|error>] [-stack-report] "
+        "[-layout-report] [-inline-report] [-stats] [-emit=<asm|ir>] [-backend=<ast|ssa>] [-unroll=<factor>] "
+        "[-O0|-O1|-O2|-Os] [-passes=<pass,...>]",
+        args[0]));
     return false;
   }
 
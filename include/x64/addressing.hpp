@@ -18,11 +18,13 @@
 namespace kuso::x64 {
 
 struct Address {
-  enum class Mode { DIRECT, INDIRECT, INDIRECT_DISPLACEMENT };
+  enum class Mode { DIRECT, INDIRECT, INDIRECT_DISPLACEMENT, SCALED };
 
   Mode     mode{Mode::DIRECT};
   Register reg{Register::NONE};
   int64_t  disp{0};
+  Register index{Register::NONE};
+  int64_t  scale{1};
 
   [[nodiscard]] auto to_string() const -> std::string {
     switch (mode) {
@@ -32,6 +34,9 @@ struct Address {
         return "[" + x64::to_string(reg) + "]";
       case Mode::INDIRECT_DISPLACEMENT:
         return std::to_string(disp) + "[" + x64::to_string(reg) + "]";
+      case Mode::SCALED:
+        if (disp == 0) return fmt::format("[{}+{}*{}]", x64::to_string(reg), x64::to_string(index), scale);
+        return fmt::format("[{}+{}*{}{:+}]", x64::to_string(reg), x64::to_string(index), scale, disp);
     }
 
     throw std::runtime_error("Invalid Address");
@@ -0,0 +1,44 @@
+/**
+ * @file arithmetic.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include "x64/instruction.hpp"
+#include "x64/x64.hpp"
+
+namespace kuso::x64 {
+/**
+ * @brief Multiplier and shift that replace a signed division by a constant
+ *
+ * The quotient is the high half of the product of the dividend and the multiplier, corrected by the
+ * dividend when the multiplier overflowed, shifted right by shift and rounded towards zero.
+ */
+struct Magic {
+  int64_t multiplier{0};
+  int64_t shift{0};
+};
+
+[[nodiscard]] auto magic(int64_t divisor) -> Magic;
+[[nodiscard]] auto power_of_two(int64_t value) -> std::optional<int64_t>;
+[[nodiscard]] auto fits_immediate(int64_t value) -> bool;
+
+[[nodiscard]] auto reduces_multiply(int64_t factor) -> bool;
+[[nodiscard]] auto reduces_divide(int64_t divisor) -> bool;
+[[nodiscard]] auto power(int64_t base, int64_t exponent) -> int64_t;
+
+void multiply(InstructionBuffer&, Register, int64_t factor);
+void divide(InstructionBuffer&, int64_t divisor, bool remainder, Register scratch);
+void power(InstructionBuffer&, int64_t exponent, Register scratch);
+void power(InstructionBuffer&, Register exponent, Register scratch, LabelId loop, LabelId skip, LabelId done);
+}  // namespace kuso::x64
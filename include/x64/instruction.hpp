@@ -0,0 +1,108 @@
+/**
+ * @file instruction.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <belt/class_macros.hpp>
+
+#include "x64/addressing.hpp"
+#include "x64/x64.hpp"
+
+namespace kuso::x64 {
+using LabelId = int64_t;
+
+/**
+ * @brief Operand of an emitted instruction
+ *
+ * Registers, memory, immediates and labels share one layout, value is the displacement, the immediate or
+ * the label id. Scaled memory operands also read an index register. Sized operands are printed with their
+ * size, as in push qword rax.
+ */
+struct Operand {
+  enum class Kind : uint8_t { NONE, REGISTER, ADDRESS, IMMEDIATE, LABEL };
+
+  int64_t       value{0};
+  Register      reg{Register::NONE};
+  Register      index{Register::NONE};
+  Address::Mode mode{Address::Mode::DIRECT};
+  Kind          kind{Kind::NONE};
+  Size          size{Size::QWORD};
+  uint8_t       scale{1};
+  bool          sized{false};
+
+  [[nodiscard]] static auto from(Register) -> Operand;
+  [[nodiscard]] static auto from(Address) -> Operand;
+  [[nodiscard]] static auto from(Literal) -> Operand;
+  [[nodiscard]] static auto label(LabelId) -> Operand;
+
+  [[nodiscard]] auto with_size(Size) const -> Operand;
+  [[nodiscard]] auto address() const -> Address;
+
+  [[nodiscard]] auto operator==(const Operand&) const -> bool = default;
+};
+
+/**
+ * @brief Emitted instruction, a label definition or verbatim text such as inline assembly
+ *
+ */
+struct Instruction {
+  enum class Kind : uint8_t { OP, LABEL, TEXT };
+
+  std::array<Operand, 2> operands{};
+  Op                     op{Op::NOP};
+  Kind                   kind{Kind::OP};
+  uint8_t                count{0};
+
+  [[nodiscard]] auto operator==(const Instruction&) const -> bool = default;
+};
+
+/**
+ * @brief Instructions of a whole program, only turned into text once code generation is done
+ *
+ * Labels are interned, instructions refer to them by id so passes over the buffer can compare them
+ * without touching strings.
+ */
+class InstructionBuffer {
+  DEFAULT_CONSTRUCTIBLE(InstructionBuffer)
+  DEFAULT_COPYABLE(InstructionBuffer)
+  DEFAULT_MOVABLE(InstructionBuffer)
+  DEFAULT_DESTRUCTIBLE(InstructionBuffer)
+
+ public:
+  void emit(Op);
+  void emit(Op, const Operand&);
+  void emit(Op, const Operand&, const Operand&);
+  void define(LabelId);
+  void text(std::string);
+
+  [[nodiscard]] auto label(const std::string&) -> LabelId;
+  [[nodiscard]] auto label_name(LabelId) const -> const std::string&;
+
+  [[nodiscard]] auto instructions() -> std::vector<Instruction>& { return _instructions; }
+  [[nodiscard]] auto instructions() const -> const std::vector<Instruction>& { return _instructions; }
+
+  [[nodiscard]] auto render() const -> std::string;
+
+ private:
+  std::vector<Instruction>                 _instructions;
+  std::vector<std::string>                 _texts;
+  std::vector<std::string>                 _labels;
+  std::unordered_map<std::string, LabelId> _labelIds;
+
+  void render(std::string&, const Operand&) const;
+};
+}  // namespace kuso::x64
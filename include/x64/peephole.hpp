@@ -0,0 +1,77 @@
+/**
+ * @file peephole.hpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <belt/class_macros.hpp>
+
+#include "x64/instruction.hpp"
+#include "x64/x64.hpp"
+
+namespace kuso::x64 {
+/**
+ * @brief Rewrites short instruction sequences of an instruction buffer
+ *
+ * Instructions are moved from the buffer one at a time, after each one the rules of the current sweep
+ * are matched against the end of the rewritten code. A rule that matches replaces its window, the
+ * replacement is matched again so rewrites chain. Rules that drop a value or the flags first check that
+ * nothing after the window reads them, labels, jumps and inline assembly count as reading everything.
+ */
+class Peephole {
+  DEFAULT_CONSTRUCTIBLE(Peephole)
+  DEFAULT_COPYABLE(Peephole)
+  DEFAULT_MOVABLE(Peephole)
+  DEFAULT_DESTRUCTIBLE(Peephole)
+
+ public:
+  using Replacement = std::optional<std::vector<Instruction>>;
+
+  /**
+   * @brief Rewrite rule, the window is the last length instructions of the rewritten code
+   *
+   */
+  struct Rule {
+    std::string_view name;
+    size_t           length;
+    size_t           sweep;
+    Replacement (*rewrite)(const Peephole&, std::span<const Instruction>);
+  };
+
+  struct RuleStats {
+    std::string_view name;
+    int64_t          applied{0};
+    int64_t          removed{0};
+  };
+
+  void run(InstructionBuffer&);
+
+  [[nodiscard]] auto live_after(Register) const -> bool;
+  [[nodiscard]] auto flags_live_after() const -> bool;
+
+  [[nodiscard]] auto get_stats() const -> const std::vector<RuleStats>& { return _stats; }
+  [[nodiscard]] auto to_string() const -> std::string;
+
+ private:
+  std::vector<Instruction> _input;
+  std::vector<Instruction> _output;
+  size_t                   _next{0};
+  std::vector<RuleStats>   _stats;
+
+  void reduce(size_t);
+};
+}  // namespace kuso::x64
@@ -11,8 +11,12 @@
 
 #pragma once
 
+#include <array>
+#include <cctype>
+#include <cstdint>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 
 namespace kuso::x64 {
 /**
@@ -120,6 +124,7 @@ enum class Op {
   NEG,
   SHL,
   SHR,
+  SAR,
   CMP,
   JMP,
   JE,
@@ -135,6 +140,8 @@ enum class Op {
   LEA,
   NOP,
   MOVZX,
+  MOVSX,
+  MOVSXD,
   INT,
   SETGE,
   SETE,
@@ -145,6 +152,8 @@ enum class Op {
   SYSCALL,
   ENTER,
   LEAVE,
+  CQO,
+  TEST,
 };
 
 struct Literal {
@@ -203,6 +212,221 @@ struct Literal {
   throw std::runtime_error("Invalid Parameter");
 }
 
+/**
+ * @brief Checks if a register must be preserved across calls, System V ABI
+ * 
+ * @param reg Register to check
+ * @return true If the callee has to restore the register before returning
+ */
+[[nodiscard]] inline auto is_callee_saved(Register reg) -> bool {
+  switch (reg) {
+    case Register::RBX:
+    case Register::RBP:
+    case Register::RSP:
+    case Register::R12:
+    case Register::R13:
+    case Register::R14:
+    case Register::R15:
+      return true;
+    default:
+      break;
+  }
+  return false;
+}
+
+/**
+ * @brief Finds the 64 bit register a register name refers to, sub registers resolve to their full register
+ * 
+ * @param name Name of the register, lowercase
+ * @return Register Full register, NONE if the name is not a register
+ */
+[[nodiscard]] inline auto full_register(std::string_view name) -> Register {
+  struct Aliases {
+    Register                        reg;
+    std::array<std::string_view, 5> names;
+  };
+
+  constexpr std::array<Aliases, 16> ALIASES{{
+      {Register::RAX, {"rax", "eax", "ax", "al", "ah"}},
+      {Register::RBX, {"rbx", "ebx", "bx", "bl", "bh"}},
+      {Register::RCX, {"rcx", "ecx", "cx", "cl", "ch"}},
+      {Register::RDX, {"rdx", "edx", "dx", "dl", "dh"}},
+      {Register::RSI, {"rsi", "esi", "si", "sil", "rsi"}},
+      {Register::RDI, {"rdi", "edi", "di", "dil", "rdi"}},
+      {Register::RBP, {"rbp", "ebp", "bp", "bpl", "rbp"}},
+      {Register::RSP, {"rsp", "esp", "sp", "spl", "rsp"}},
+      {Register::R8, {"r8", "r8d", "r8w", "r8b", "r8"}},
+      {Register::R9, {"r9", "r9d", "r9w", "r9b", "r9"}},
+      {Register::R10, {"r10", "r10d", "r10w", "r10b", "r10"}},
+      {Register::R11, {"r11", "r11d", "r11w", "r11b", "r11"}},
+      {Register::R12, {"r12", "r12d", "r12w", "r12b", "r12"}},
+      {Register::R13, {"r13", "r13d", "r13w", "r13b", "r13"}},
+      {Register::R14, {"r14", "r14d", "r14w", "r14b", "r14"}},
+      {Register::R15, {"r15", "r15d", "r15w", "r15b", "r15"}},
+  }};
+
+  for (const auto& alias : ALIASES) {
+    for (const auto& aliasName : alias.names) {
+      if (aliasName == name) return alias.reg;
+    }
+  }
+  return Register::NONE;
+}
+
+/**
+ * @brief Registers used by a piece of inline assembly
+ * 
+ */
+struct AsmUsage {
+  std::array<bool, REGISTER_COUNT> regs{false};
+  bool                             calls{false};
+};
+
+/**
+ * @brief Scans inline assembly for the registers it names, every named register counts as written
+ * 
+ * syscall also clobbers rcx and r11, a call may clobber every caller saved register
+ * 
+ * @param code Assembly text
+ * @return AsmUsage Registers named and whether the assembly calls out
+ */
+[[nodiscard]] inline auto scan_asm(std::string_view code) -> AsmUsage {
+  AsmUsage usage;
+  auto     mark = [&](Register reg) {
+    if (static_cast<size_t>(reg) < REGISTER_COUNT) usage.regs.at(static_cast<size_t>(reg)) = true;
+  };
+  auto isWord = [](char chr) { return std::isalnum(static_cast<unsigned char>(chr)) != 0 || chr == '_'; };
+
+  size_t pos = 0;
+  while (pos < code.size()) {
+    if (!isWord(code[pos])) {
+      ++pos;
+      continue;
+    }
+
+    std::string word;
+    while (pos < code.size() && isWord(code[pos])) {
+      word.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(code[pos]))));
+      ++pos;
+    }
+
+    if (word == "syscall") {
+      mark(Register::RAX);
+      mark(Register::RCX);
+      mark(Register::R11);
+    } else if (word == "call") {
+      usage.calls = true;
+    } else {
+      mark(full_register(word));
+    }
+  }
+  return usage;
+}
+
+/**
+ * @brief Sub registers of every 64 bit register
+ * 
+ */
+struct SubRegisters {
+  Register qword;
+  Register dword;
+  Register word;
+  Register byte;
+};
+
+constexpr std::array<SubRegisters, 16> SUB_REGISTERS{{
+    {Register::RAX, Register::EAX, Register::AX, Register::AL},
+    {Register::RBX, Register::EBX, Register::BX, Register::BL},
+    {Register::RCX, Register::ECX, Register::CX, Register::CL},
+    {Register::RDX, Register::EDX, Register::DX, Register::DL},
+    {Register::RSI, Register::ESI, Register::SI, Register::SIL},
+    {Register::RDI, Register::EDI, Register::DI, Register::DIL},
+    {Register::RBP, Register::EBP, Register::BP, Register::BPL},
+    {Register::RSP, Register::ESP, Register::SP, Register::SPL},
+    {Register::R8, Register::R8D, Register::R8W, Register::R8B},
+    {Register::R9, Register::R9D, Register::R9W, Register::R9B},
+    {Register::R10, Register::R10D, Register::R10W, Register::R10B},
+    {Register::R11, Register::R11D, Register::R11W, Register::R11B},
+    {Register::R12, Register::R12D, Register::R12W, Register::R12B},
+    {Register::R13, Register::R13D, Register::R13W, Register::R13B},
+    {Register::R14, Register::R14D, Register::R14W, Register::R14B},
+    {Register::R15, Register::R15D, Register::R15W, Register::R15B},
+}};
+
+/**
+ * @brief Gets the part of a 64 bit register that holds the given size, eg. rax -> eax for DWORD
+ * 
+ * @param reg 64 bit register
+ * @param size Size of the access
+ * @return Register Sub register of the given size
+ */
+[[nodiscard]] inline auto sized_register(Register reg, Size size) -> Register {
+  for (const auto& sizes : SUB_REGISTERS) {
+    if (sizes.qword != reg) continue;
+    switch (size) {
+      case Size::BYTE:
+        return sizes.byte;
+      case Size::WORD:
+        return sizes.word;
+      case Size::DWORD:
+        return sizes.dword;
+      case Size::QWORD:
+        return sizes.qword;
+    }
+  }
+  throw std::runtime_error("Invalid Register");
+}
+
+/**
+ * @brief Gets the 64 bit register a sub register is part of, eg. al -> rax
+ * 
+ * @param reg Register of any size
+ * @return Register 64 bit register, NONE for NONE
+ */
+[[nodiscard]] inline auto full_register(Register reg) -> Register {
+  for (const auto& sizes : SUB_REGISTERS) {
+    if (sizes.qword == reg || sizes.dword == reg || sizes.word == reg || sizes.byte == reg) {
+      return sizes.qword;
+    }
+  }
+  return Register::NONE;
+}
+
+/**
+ * @brief Gets the size of a register
+ * 
+ * @param reg Register of any size
+ * @return Size Size of the register
+ */
+[[nodiscard]] inline auto register_size(Register reg) -> Size {
+  for (const auto& sizes : SUB_REGISTERS) {
+    if (sizes.dword == reg) return Size::DWORD;
+    if (sizes.word == reg) return Size::WORD;
+    if (sizes.byte == reg) return Size::BYTE;
+  }
+  return Size::QWORD;
+}
+
+/**
+ * @brief Gets the access size for a size in bytes, anything that is not a machine word size uses a QWORD
+ * 
+ * @param bytes Size in bytes
+ * @return Size Access size
+ */
+[[nodiscard]] inline auto access_size(int64_t bytes) -> Size {
+  switch (bytes) {
+    case Size::BYTE:
+      return Size::BYTE;
+    case Size::WORD:
+      return Size::WORD;
+    case Size::DWORD:
+      return Size::DWORD;
+    default:
+      break;
+  }
+  return Size::QWORD;
+}
+
 [[nodiscard]] inline auto to_string(Register reg) -> std::string {
   switch (reg) {
     case Register::RAX:
@@ -375,6 +599,8 @@ struct Literal {
       return "shl";
     case Op::SHR:
       return "shr";
+    case Op::SAR:
+      return "sar";
     case Op::CMP:
       return "cmp";
     case Op::JMP:
@@ -419,12 +645,20 @@ struct Literal {
       return "setle";
     case Op::MOVZX:
       return "movzx";
+    case Op::MOVSX:
+      return "movsx";
+    case Op::MOVSXD:
+      return "movsxd";
     case Op::SYSCALL:
       return "syscall";
     case Op::ENTER:
       return "enter";
     case Op::LEAVE:
       return "leave";
+    case Op::CQO:
+      return "cqo";
+    case Op::TEST:
+      return "test";
   }
   throw std::runtime_error("Invalid Op");
 }
@@ -0,0 +1,243 @@
+/**
+ * @file argument_splitting.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-19
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "generator/argument_splitting.hpp"
+
+#include <algorithm>
+#include <belt/overload.hpp>
+#include <cstddef>
+#include <fmt/format.h>
+#include <iterator>
+#include <stdexcept>
+
+#include "generator/ast_util.hpp"
+#include "generator/evaluation.hpp"
+
+namespace kuso {
+namespace {
+auto integer(const AST::Attribute& attribute) -> bool {
+  const auto& type = attribute.type;
+  return type == "int" || type == "i8" || type == "i16" || type == "i32" || type == "i64";
+}
+
+template <typename Visitor>
+void calls(AST::Expression&, const Visitor&);
+
+template <typename Visitor>
+void calls(AST::Primary& primary, const Visitor& visitor) {
+  belt::overloaded_visit(
+      primary.value, [&](std::unique_ptr<AST::Expression>& nested) { calls(*nested, visitor); },
+      [&](std::unique_ptr<AST::Call>& call) { visitor(*call); }, [](auto&) {});
+}
+
+template <typename Visitor>
+void calls(AST::Unary& unary, const Visitor& visitor) {
+  belt::overloaded_visit(
+      unary.value, [&](std::unique_ptr<AST::Unary>& nested) { calls(*nested, visitor); },
+      [&](std::unique_ptr<AST::Primary>& primary) { calls(*primary, visitor); });
+}
+
+template <typename Visitor>
+void calls(AST::Factor& factor, const Visitor& visitor) {
+  calls(*factor.left, visitor);
+  if (factor.right) calls(*factor.right, visitor);
+}
+
+template <typename Visitor>
+void calls(AST::Term& term, const Visitor& visitor) {
+  calls(*term.left, visitor);
+  if (term.right) calls(*term.right, visitor);
+}
+
+template <typename Visitor>
+void calls(AST::Comparison& comparison, const Visitor& visitor) {
+  calls(*comparison.left, visitor);
+  if (comparison.right) calls(*comparison.right, visitor);
+}
+
+template <typename Visitor>
+void calls(AST::Equality& equality, const Visitor& visitor) {
+  calls(*equality.left, visitor);
+  if (equality.right) calls(*equality.right, visitor);
+}
+
+template <typename Visitor>
+void calls(AST::Expression& expression, const Visitor& visitor) {
+  calls(*expression.value, visitor);
+}
+}  // namespace
+
+/**
+ * @brief Splits the parameters of small types of every function and the arguments passed for them
+ *
+ * @param ast AST to rewrite in place
+ */
+void ArgumentSplitting::run(AST& ast) {
+  _fields.clear();
+  _signatures.clear();
+  for (const auto& statement : ast) {
+    belt::overloaded_visit(
+        statement.statement,
+        [&](const std::unique_ptr<AST::Type>& type) {
+          const auto& attributes = type->attributes;
+          if (attributes.empty() || attributes.size() > MAX_FIELDS) return;
+          if (std::ranges::all_of(attributes, integer)) _fields[type->name] = attributes;
+        },
+        [&](const std::unique_ptr<AST::Func>& func) {
+          auto& signature = _signatures[func->name];
+          for (const auto& arg : func->args) signature.push_back(arg->type);
+        },
+        [](const auto&) {});
+  }
+  if (_fields.empty()) return;
+
+  for (auto& statement : ast) {
+    belt::overloaded_visit(
+        statement.statement,
+        [&](const std::unique_ptr<AST::Main>& main) {
+          _scopes.assign(1, {});
+          run(main->body);
+        },
+        [&](const std::unique_ptr<AST::Func>& func) {
+          _scopes.assign(1, {});
+          for (const auto& arg : func->args) _scopes.back()[arg->name] = arg->type;
+          run(func->body);
+          split(*func);
+        },
+        [](const auto&) {});
+  }
+}
+
+/**
+ * @brief Replaces the parameters of small types with their attributes, copied into a local of the same
+ * name at the start of the function
+ *
+ * @param func Function to split the parameters of
+ */
+void ArgumentSplitting::split(AST::Func& func) {
+  auto small = [&](const auto& arg) { return _fields.contains(arg->type); };
+  if (std::ranges::none_of(func.args, small)) return;
+
+  std::vector<std::unique_ptr<AST::Declaration>> args;
+  std::vector<AST::Statement>                    prologue;
+  for (auto& arg : func.args) {
+    auto fields = _fields.find(arg->type);
+    if (fields == _fields.end()) {
+      args.push_back(std::move(arg));
+      continue;
+    }
+
+    for (const auto& field : fields->second) {
+      auto param = std::make_unique<AST::Declaration>();
+      param->name = arg->name + "." + field.name;
+      param->type = field.type;
+
+      auto copy = std::make_unique<AST::Assignment>();
+      copy->dest = std::make_unique<AST::Variable>();
+      copy->dest->name = arg->name;
+      copy->dest->attribute = field.name;
+      copy->value = ast::wrap<AST::Expression>(ast::variable(param->name));
+      prologue.emplace_back(std::move(copy));
+      args.push_back(std::move(param));
+    }
+    prologue.emplace(prologue.end() - static_cast<std::ptrdiff_t>(fields->second.size()), std::move(arg));
+  }
+
+  func.args = std::move(args);
+  std::ranges::move(func.body, std::back_inserter(prologue));
+  func.body = std::move(prologue);
+}
+
+/**
+ * @brief Splits the arguments of the calls of a block, keeping track of the types of the locals in scope
+ *
+ * @param body Block to rewrite
+ */
+void ArgumentSplitting::run(std::vector<AST::Statement>& body) {
+  _scopes.emplace_back();
+  for (auto& statement : body) {
+    belt::overloaded_visit(
+        statement.statement,
+        [&](std::unique_ptr<AST::Declaration>& declaration) {
+          if (declaration->value) run(*declaration->value);
+          _scopes.back()[declaration->name] = declaration->type;
+        },
+        [&](std::unique_ptr<AST::Destructure>& destructure) {
+          run(*destructure->call);
+          for (const auto& target : destructure->targets) _scopes.back()[target->name] = target->type;
+        },
+        [&](std::unique_ptr<AST::Assignment>& assignment) { run(*assignment->value); },
+        [&](std::unique_ptr<AST::Exit>& exit) { run(*exit->value); },
+        [&](std::unique_ptr<AST::Return>& ret) {
+          if (ret->value) run(*ret->value);
+          if (ret->second) run(*ret->second);
+        },
+        [&](std::unique_ptr<AST::Call>& call) { run(*call); },
+        [&](std::unique_ptr<AST::If>& ifStatement) {
+          run(*ifStatement->condition);
+          run(ifStatement->body);
+          run(ifStatement->elseBody);
+        },
+        [&](std::unique_ptr<AST::While>& loop) {
+          run(*loop->condition);
+          run(loop->body);
+        },
+        [](auto&) {});
+  }
+  _scopes.pop_back();
+}
+
+void ArgumentSplitting::run(AST::Expression& expression) {
+  calls(expression, [&](AST::Call& call) { run(call); });
+}
+
+/**
+ * @brief Passes the attributes of the locals given for parameters of small types instead of the locals
+ *
+ * Calls with the wrong number of arguments are left for the backends to report.
+ *
+ * @param call Call to rewrite
+ */
+void ArgumentSplitting::run(AST::Call& call) {
+  for (auto& arg : call.args) run(*arg);
+
+  auto signature = _signatures.find(call.name);
+  if (signature == _signatures.end() || signature->second.size() != call.args.size()) return;
+
+  std::vector<std::unique_ptr<AST::Expression>> args;
+  for (size_t index = 0; index < call.args.size(); ++index) {
+    const auto& type = signature->second[index];
+    auto        fields = _fields.find(type);
+    if (fields == _fields.end()) {
+      args.push_back(std::move(call.args[index]));
+      continue;
+    }
+
+    const auto* variable = Evaluation::variable(*call.args[index]);
+    if (variable == nullptr || variable->attribute || type_of(variable->name) != type) {
+      throw std::runtime_error(
+          fmt::format("Argument {} of {} has to be a local of type {}", index + 1, call.name, type));
+    }
+    for (const auto& field : fields->second) {
+      args.push_back(ast::wrap<AST::Expression>(ast::variable(variable->name, field.name)));
+    }
+  }
+  call.args = std::move(args);
+}
+
+auto ArgumentSplitting::type_of(const std::string& name) const -> std::optional<std::string> {
+  for (auto scope = _scopes.rbegin(); scope != _scopes.rend(); ++scope) {
+    auto type = scope->find(name);
+    if (type != scope->end()) return type->second;
+  }
+  return std::nullopt;
+}
+}  // namespace kuso
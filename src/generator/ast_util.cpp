@@ -0,0 +1,276 @@
+/**
+ * @file ast_util.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-19
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "generator/ast_util.hpp"
+
+#include <belt/overload.hpp>
+#include <stdexcept>
+
+namespace kuso::ast {
+/**
+ * @brief Gets every name written, assigned or declared
+ *
+ */
+auto Writes::names() const -> std::multiset<std::string> {
+  auto names = assigned;
+  names.insert(declared.begin(), declared.end());
+  return names;
+}
+
+/**
+ * @brief Collects the names a statement assigns or declares, and whether it contains inline assembly or
+ * a loop
+ *
+ * @param statement Statement to search
+ * @param writes Writes found so far
+ */
+void collect_writes(const AST::Statement& statement, Writes& writes) {
+  belt::overloaded_visit(
+      statement.statement,
+      [&](const std::unique_ptr<AST::Assignment>& assignment) {
+        writes.assigned.insert(assignment->dest->name);
+      },
+      [&](const std::unique_ptr<AST::Declaration>& declaration) {
+        writes.declared.insert(declaration->name);
+      },
+      [&](const std::unique_ptr<AST::Destructure>& destructure) {
+        for (const auto& target : destructure->targets) writes.declared.insert(target->name);
+      },
+      [&](const std::unique_ptr<AST::If>& ifStatement) {
+        collect_writes(ifStatement->body, writes);
+        collect_writes(ifStatement->elseBody, writes);
+      },
+      [&](const std::unique_ptr<AST::While>& whileStatement) {
+        writes.loops = true;
+        collect_writes(whileStatement->body, writes);
+      },
+      [&](const std::unique_ptr<AST::ASM>&) { writes.assembly = true; }, [](const auto&) {});
+}
+
+void collect_writes(const std::vector<AST::Statement>& body, Writes& writes) {
+  for (const auto& statement : body) collect_writes(statement, writes);
+}
+
+auto variable(std::string name, std::optional<std::string> attribute) -> std::unique_ptr<AST::Primary> {
+  auto access = std::make_unique<AST::Variable>();
+  access->name = std::move(name);
+  access->attribute = std::move(attribute);
+  auto primary = std::make_unique<AST::Primary>();
+  primary->value = std::move(access);
+  return primary;
+}
+
+auto number(int64_t value) -> std::unique_ptr<AST::Primary> {
+  auto terminal = std::make_unique<AST::Terminal>();
+  terminal->value = Token(Token::Type::NUMBER, 0, 0, std::to_string(value));
+  auto primary = std::make_unique<AST::Primary>();
+  primary->value = std::move(terminal);
+  return primary;
+}
+
+auto parent_of(std::unique_ptr<AST::Primary> primary) -> std::unique_ptr<AST::Unary> {
+  auto unary = std::make_unique<AST::Unary>();
+  unary->value = std::move(primary);
+  unary->op = AST::BinaryOp::ADD;
+  return unary;
+}
+
+auto parent_of(std::unique_ptr<AST::Unary> unary) -> std::unique_ptr<AST::Factor> {
+  auto factor = std::make_unique<AST::Factor>();
+  factor->left = std::move(unary);
+  return factor;
+}
+
+auto parent_of(std::unique_ptr<AST::Factor> factor) -> std::unique_ptr<AST::Term> {
+  auto term = std::make_unique<AST::Term>();
+  term->left = std::move(factor);
+  return term;
+}
+
+auto parent_of(std::unique_ptr<AST::Term> term) -> std::unique_ptr<AST::Comparison> {
+  auto comparison = std::make_unique<AST::Comparison>();
+  comparison->left = std::move(term);
+  return comparison;
+}
+
+auto parent_of(std::unique_ptr<AST::Comparison> comparison) -> std::unique_ptr<AST::Equality> {
+  auto equality = std::make_unique<AST::Equality>();
+  equality->left = std::move(comparison);
+  return equality;
+}
+
+auto parent_of(std::unique_ptr<AST::Equality> equality) -> std::unique_ptr<AST::Expression> {
+  auto expression = std::make_unique<AST::Expression>();
+  expression->value = std::move(equality);
+  return expression;
+}
+
+auto clone(const AST::Variable& variable) -> std::unique_ptr<AST::Variable> {
+  auto copy = std::make_unique<AST::Variable>();
+  copy->name = variable.name;
+  copy->attribute = variable.attribute;
+  return copy;
+}
+
+auto clone(const AST::String& string) -> std::unique_ptr<AST::String> {
+  auto copy = std::make_unique<AST::String>();
+  copy->value = string.value;
+  return copy;
+}
+
+auto clone(const AST::Call& call) -> std::unique_ptr<AST::Call> {
+  auto copy = std::make_unique<AST::Call>();
+  copy->name = call.name;
+  for (const auto& arg : call.args) copy->args.push_back(clone(*arg));
+  return copy;
+}
+
+auto clone(const AST::Primary& primary) -> std::unique_ptr<AST::Primary> {
+  auto copy = std::make_unique<AST::Primary>();
+  belt::overloaded_visit(
+      primary.value, [&](const std::unique_ptr<AST::Variable>& variable) { copy->value = clone(*variable); },
+      [&](const std::unique_ptr<AST::Terminal>& terminal) {
+        auto value = std::make_unique<AST::Terminal>();
+        belt::overloaded_visit(
+            terminal->value,
+            [&](const std::unique_ptr<AST::Variable>& variable) { value->value = clone(*variable); },
+            [&](const Token& token) { value->value = token; },
+            [&](const std::unique_ptr<AST::String>& string) { value->value = clone(*string); });
+        copy->value = std::move(value);
+      },
+      [&](const std::unique_ptr<AST::Expression>& expression) { copy->value = clone(*expression); },
+      [&](const std::unique_ptr<AST::String>& string) { copy->value = clone(*string); },
+      [&](const std::unique_ptr<AST::Call>& call) { copy->value = clone(*call); });
+  return copy;
+}
+
+auto clone(const AST::Unary& unary) -> std::unique_ptr<AST::Unary> {
+  auto copy = std::make_unique<AST::Unary>();
+  belt::overloaded_visit(
+      unary.value, [&](const std::unique_ptr<AST::Unary>& operand) { copy->value = clone(*operand); },
+      [&](const std::unique_ptr<AST::Primary>& primary) { copy->value = clone(*primary); });
+  copy->op = unary.op;
+  return copy;
+}
+
+auto clone(const AST::Factor& factor) -> std::unique_ptr<AST::Factor> {
+  auto copy = std::make_unique<AST::Factor>();
+  copy->left = clone(*factor.left);
+  if (factor.right) copy->right = clone(*factor.right);
+  copy->op = factor.op;
+  return copy;
+}
+
+auto clone(const AST::Term& term) -> std::unique_ptr<AST::Term> {
+  auto copy = std::make_unique<AST::Term>();
+  copy->left = clone(*term.left);
+  if (term.right) copy->right = clone(*term.right);
+  copy->op = term.op;
+  return copy;
+}
+
+auto clone(const AST::Comparison& comparison) -> std::unique_ptr<AST::Comparison> {
+  auto copy = std::make_unique<AST::Comparison>();
+  copy->left = clone(*comparison.left);
+  if (comparison.right) copy->right = clone(*comparison.right);
+  copy->op = comparison.op;
+  return copy;
+}
+
+auto clone(const AST::Equality& equality) -> std::unique_ptr<AST::Equality> {
+  auto copy = std::make_unique<AST::Equality>();
+  copy->left = clone(*equality.left);
+  if (equality.right) copy->right = clone(*equality.right);
+  copy->equal = equality.equal;
+  return copy;
+}
+
+auto clone(const AST::Expression& expression) -> std::unique_ptr<AST::Expression> {
+  auto copy = std::make_unique<AST::Expression>();
+  copy->value = clone(*expression.value);
+  return copy;
+}
+
+/**
+ * @brief Copies a statement of a function body, definitions only appear at the top level of a program
+ *
+ * @param statement Statement to copy
+ * @return AST::Statement the copy
+ */
+auto clone(const AST::Statement& statement) -> AST::Statement {
+  AST::Statement copy(nullptr);
+  belt::overloaded_visit(
+      statement.statement,
+      [&](const std::unique_ptr<AST::If>& ifStatement) {
+        auto value = std::make_unique<AST::If>();
+        value->condition = clone(*ifStatement->condition);
+        value->body = clone(ifStatement->body);
+        value->elseBody = clone(ifStatement->elseBody);
+        copy.statement = std::move(value);
+      },
+      [&](const std::unique_ptr<AST::While>& whileStatement) {
+        auto value = std::make_unique<AST::While>();
+        value->condition = clone(*whileStatement->condition);
+        value->annotations = whileStatement->annotations;
+        value->body = clone(whileStatement->body);
+        copy.statement = std::move(value);
+      },
+      [&](const std::unique_ptr<AST::Declaration>& declaration) {
+        auto value = std::make_unique<AST::Declaration>();
+        value->name = declaration->name;
+        value->type = declaration->type;
+        if (declaration->value) value->value = clone(*declaration->value);
+        copy.statement = std::move(value);
+      },
+      [&](const std::unique_ptr<AST::Assignment>& assignment) {
+        auto value = std::make_unique<AST::Assignment>();
+        value->dest = clone(*assignment->dest);
+        value->value = clone(*assignment->value);
+        copy.statement = std::move(value);
+      },
+      [&](const std::unique_ptr<AST::Destructure>& destructure) {
+        auto value = std::make_unique<AST::Destructure>();
+        for (size_t i = 0; i < destructure->targets.size(); ++i) {
+          value->targets.at(i) = std::make_unique<AST::Declaration>();
+          value->targets.at(i)->name = destructure->targets.at(i)->name;
+          value->targets.at(i)->type = destructure->targets.at(i)->type;
+        }
+        value->call = clone(*destructure->call);
+        copy.statement = std::move(value);
+      },
+      [&](const std::unique_ptr<AST::Return>& ret) {
+        auto value = std::make_unique<AST::Return>();
+        if (ret->value) value->value = clone(*ret->value);
+        if (ret->second) value->second = clone(*ret->second);
+        copy.statement = std::move(value);
+      },
+      [&](const std::unique_ptr<AST::Exit>& exit) {
+        auto value = std::make_unique<AST::Exit>();
+        if (exit->value) value->value = clone(*exit->value);
+        copy.statement = std::move(value);
+      },
+      [&](const std::unique_ptr<AST::ASM>& asmStatement) {
+        auto value = std::make_unique<AST::ASM>();
+        value->code = asmStatement->code;
+        copy.statement = std::move(value);
+      },
+      [&](const std::unique_ptr<AST::Call>& call) { copy.statement = clone(*call); }, [](std::nullptr_t) {},
+      [](const auto&) { throw std::runtime_error("Cannot copy a definition"); });
+  return copy;
+}
+
+auto clone(const std::vector<AST::Statement>& body) -> std::vector<AST::Statement> {
+  std::vector<AST::Statement> copy;
+  copy.reserve(body.size());
+  for (const auto& statement : body) copy.push_back(clone(statement));
+  return copy;
+}
+}  // namespace kuso::ast
@@ -0,0 +1,432 @@
+/**
+ * @file constant_folding.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "generator/constant_folding.hpp"
+
+#include <belt/overload.hpp>
+#include <fmt/format.h>
+#include <limits>
+
+#include "generator/ast_util.hpp"
+#include "x64/arithmetic.hpp"
+
+namespace kuso {
+namespace {
+/**
+ * @brief Arithmetic wraps like the generated code, so it is done on unsigned values
+ *
+ */
+auto wrap(uint64_t value) -> int64_t { return static_cast<int64_t>(value); }
+
+auto compare(AST::BinaryOp op, int64_t left, int64_t right) -> std::optional<int64_t> {
+  switch (op) {
+    case AST::BinaryOp::LT:
+      return left < right ? 1 : 0;
+    case AST::BinaryOp::GT:
+      return left > right ? 1 : 0;
+    case AST::BinaryOp::LTE:
+      return left <= right ? 1 : 0;
+    case AST::BinaryOp::GTE:
+      return left >= right ? 1 : 0;
+    default:
+      return std::nullopt;
+  }
+}
+
+auto arithmetic(AST::BinaryOp op, int64_t left, int64_t right) -> std::optional<int64_t> {
+  auto uleft = static_cast<uint64_t>(left);
+  auto uright = static_cast<uint64_t>(right);
+  switch (op) {
+    case AST::BinaryOp::ADD:
+      return wrap(uleft + uright);
+    case AST::BinaryOp::SUB:
+      return wrap(uleft - uright);
+    case AST::BinaryOp::MUL:
+      return wrap(uleft * uright);
+    case AST::BinaryOp::DIV:
+    case AST::BinaryOp::MOD:
+      // both fault at runtime, keep them there
+      if (right == 0 || (left == std::numeric_limits<int64_t>::min() && right == -1)) return std::nullopt;
+      return op == AST::BinaryOp::DIV ? left / right : left % right;
+    case AST::BinaryOp::POW:
+      return x64::power(left, right);
+    default:
+      return std::nullopt;
+  }
+}
+}  // namespace
+
+/**
+ * @brief Folds every function of the program, rewriting the AST in place
+ *
+ * @param ast AST to fold
+ */
+void ConstantFolding::run(AST& ast) {
+  for (auto& statement : ast) {
+    belt::overloaded_visit(
+        statement.statement,
+        [&](const std::unique_ptr<AST::Main>& main) { fold_function({}, main->body); },
+        [&](const std::unique_ptr<AST::Func>& func) { fold_function(func->args, func->body); },
+        [](const auto&) {});
+  }
+}
+
+/**
+ * @brief Gets the value of an expression that is a single number, as left by folding
+ *
+ * @param expression Expression to check
+ * @return std::optional<int64_t> value of the expression, nullopt if it isn't a number
+ */
+auto ConstantFolding::constant_value(const AST::Expression& expression) -> std::optional<int64_t> {
+  const auto& equality = *expression.value;
+  if (equality.right || equality.left->right) return std::nullopt;
+  const auto& term = *equality.left->left;
+  if (term.right) return std::nullopt;
+  return constant_value(*term.left);
+}
+
+/**
+ * @brief Gets the value of a factor that is a single number
+ *
+ * @param factor Factor to check
+ * @return std::optional<int64_t> value of the factor, nullopt if it isn't a number
+ */
+auto ConstantFolding::constant_value(const AST::Factor& factor) -> std::optional<int64_t> {
+  if (factor.right) return std::nullopt;
+  return constant_value(*factor.left);
+}
+
+/**
+ * @brief Gets the value of a unary that is a single number, possibly parenthesized
+ *
+ * @param unary Unary to check
+ * @return std::optional<int64_t> value of the unary, nullopt if it isn't a number
+ */
+auto ConstantFolding::constant_value(const AST::Unary& unary) -> std::optional<int64_t> {
+  if (unary.op != AST::BinaryOp::ADD || !std::holds_alternative<std::unique_ptr<AST::Primary>>(unary.value)) {
+    return std::nullopt;
+  }
+
+  const auto& primary = *std::get<std::unique_ptr<AST::Primary>>(unary.value);
+  if (const auto* nested = std::get_if<std::unique_ptr<AST::Expression>>(&primary.value)) {
+    return constant_value(**nested);
+  }
+  if (const auto* terminal = std::get_if<std::unique_ptr<AST::Terminal>>(&primary.value)) {
+    const auto* token = std::get_if<Token>(&(*terminal)->value);
+    if (token && token->type == Token::Type::NUMBER) return std::stoll(token->value);
+  }
+  return std::nullopt;
+}
+
+auto ConstantFolding::to_string() const -> std::string {
+  std::string report = fmt::format("{:<20}{:>8}\n", "constant folding", "count");
+  report += fmt::format("{:<20}{:>8}\n", "folded", _folded);
+  report += fmt::format("{:<20}{:>8}\n", "propagated", _propagated);
+  report += fmt::format("{:<20}{:>8}\n", "branches removed", _branches);
+  return report;
+}
+
+/**
+ * @brief Folds a function, its parameters are never constant
+ *
+ * @param args Parameters of the function
+ * @param body Body of the function
+ */
+void ConstantFolding::fold_function(const std::vector<std::unique_ptr<AST::Declaration>>& args,
+                                    std::vector<AST::Statement>& body) {
+  _scopes.clear();
+  _tracked.clear();
+  _state = State{};
+
+  _scopes.emplace_back();
+  for (const auto& arg : args) declare(arg->name, arg->type, std::nullopt);
+  for (auto& statement : body) fold(statement);
+  _scopes.pop_back();
+}
+
+void ConstantFolding::fold_block(std::vector<AST::Statement>& body) {
+  _scopes.emplace_back();
+  for (auto& statement : body) fold(statement);
+  _scopes.pop_back();
+}
+
+void ConstantFolding::fold(AST::Statement& statement) {
+  belt::overloaded_visit(
+      statement.statement,
+      [&](const std::unique_ptr<AST::Declaration>& declaration) { fold_declaration(*declaration); },
+      [&](const std::unique_ptr<AST::Assignment>& assignment) { fold_assignment(*assignment); },
+      [&](const std::unique_ptr<AST::If>& ifStatement) { fold_if(*ifStatement); },
+      [&](const std::unique_ptr<AST::While>& whileStatement) { fold_while(*whileStatement); },
+      [&](const std::unique_ptr<AST::Call>& call) {
+        for (auto& arg : call->args) fold(*arg);
+      },
+      [&](const std::unique_ptr<AST::Destructure>& destructure) {
+        for (auto& arg : destructure->call->args) fold(*arg);
+        for (const auto& target : destructure->targets) declare(target->name, target->type, std::nullopt);
+      },
+      [&](const std::unique_ptr<AST::Return>& return_) {
+        if (return_->value) fold(*return_->value);
+        if (return_->second) fold(*return_->second);
+        _state.reachable = false;
+      },
+      [&](const std::unique_ptr<AST::Exit>& exit) {
+        if (exit->value) fold(*exit->value);
+        _state.reachable = false;
+      },
+      [&](const std::unique_ptr<AST::ASM>&) {
+        for (auto& value : _state.values) value.reset();
+      },
+      [](const auto&) {});
+}
+
+void ConstantFolding::fold_declaration(AST::Declaration& declaration) {
+  std::optional<int64_t> value;
+  if (declaration.value) value = fold(*declaration.value);
+  declare(declaration.name, declaration.type, value);
+}
+
+void ConstantFolding::fold_assignment(AST::Assignment& assignment) {
+  auto value = fold(*assignment.value);
+  auto local = find(*assignment.dest);
+  if (local) _state.values.at(local.value()) = value;
+}
+
+/**
+ * @brief Folds an if statement, a constant condition drops the side that never runs
+ *
+ * @param ifNode If to fold
+ */
+void ConstantFolding::fold_if(AST::If& ifNode) {
+  auto condition = fold(*ifNode.condition);
+  if (condition) {
+    auto& dropped = condition.value() != 0 ? ifNode.elseBody : ifNode.body;
+    if (!dropped.empty()) ++_branches;
+    dropped.clear();
+    fold_block(condition.value() != 0 ? ifNode.body : ifNode.elseBody);
+    return;
+  }
+
+  auto before = _state;
+  fold_block(ifNode.body);
+  auto taken = std::move(_state);
+  _state = std::move(before);
+  fold_block(ifNode.elseBody);
+  merge(taken);
+}
+
+/**
+ * @brief Folds a while statement, locals assigned in the body are not constant anywhere in the loop
+ *
+ * There is no break, a loop with a constant true condition only ends through a return or an exit
+ *
+ * @param whileStatement While to fold
+ */
+void ConstantFolding::fold_while(AST::While& whileStatement) {
+  auto before = _state;
+  forget(whileStatement.body);
+
+  auto condition = fold(*whileStatement.condition);
+  if (condition && condition.value() == 0) {
+    if (!whileStatement.body.empty()) ++_branches;
+    whileStatement.body.clear();
+    _state = std::move(before);
+    return;
+  }
+
+  auto entry = _state;
+  fold_block(whileStatement.body);
+  _state = std::move(entry);
+  if (condition) _state.reachable = false;
+}
+
+/**
+ * @brief Declares a local in the innermost scope, only int locals are followed
+ *
+ * @param name Name of the local
+ * @param type Type of the local
+ * @param value Value the local starts with
+ */
+void ConstantFolding::declare(const std::string& name, const std::string& type,
+                              std::optional<int64_t> value) {
+  auto local = _tracked.size();
+  _tracked.push_back(type == "int");
+  _state.values.resize(_tracked.size());
+  _state.values.at(local) = _tracked.back() ? value : std::nullopt;
+  _scopes.back()[name] = local;
+}
+
+/**
+ * @brief Forgets the value of every visible local a block may assign
+ *
+ * @param body Block that is about to run
+ */
+void ConstantFolding::forget(const std::vector<AST::Statement>& body) {
+  ast::Writes writes;
+  ast::collect_writes(body, writes);
+  if (writes.assembly) {
+    for (auto& value : _state.values) value.reset();
+    return;
+  }
+
+  for (const auto& name : writes.assigned) {
+    for (const auto& scope : _scopes) {
+      auto local = scope.find(name);
+      if (local != scope.end()) _state.values.at(local->second).reset();
+    }
+  }
+}
+
+/**
+ * @brief Merges the state at the end of another path into the current one
+ *
+ * @param other State at the end of the other path
+ */
+void ConstantFolding::merge(const State& other) {
+  if (!other.reachable) return;
+  if (!_state.reachable) {
+    _state = other;
+    return;
+  }
+
+  auto size = std::min(_state.values.size(), other.values.size());
+  _state.values.resize(size);
+  for (size_t local = 0; local < size; ++local) {
+    if (_state.values.at(local) != other.values.at(local)) _state.values.at(local).reset();
+  }
+}
+
+auto ConstantFolding::find(const AST::Variable& variable) const -> std::optional<size_t> {
+  if (variable.attribute) return std::nullopt;
+  for (auto scope = _scopes.rbegin(); scope != _scopes.rend(); ++scope) {
+    auto local = scope->find(variable.name);
+    if (local != scope->end()) {
+      if (!_tracked.at(local->second)) return std::nullopt;
+      return local->second;
+    }
+  }
+  return std::nullopt;
+}
+
+auto ConstantFolding::fold(AST::Expression& expression) -> std::optional<int64_t> {
+  return fold(*expression.value);
+}
+
+auto ConstantFolding::fold(AST::Equality& equality) -> std::optional<int64_t> {
+  auto left = fold(*equality.left);
+  if (!equality.right) return left;
+  auto right = fold(*equality.right);
+  if (!left || !right) return std::nullopt;
+
+  int64_t value = (left.value() == right.value()) == equality.equal ? 1 : 0;
+  equality.left = ast::wrap<AST::Comparison>(ast::number(value));
+  equality.right.reset();
+  ++_folded;
+  return value;
+}
+
+auto ConstantFolding::fold(AST::Comparison& comparison) -> std::optional<int64_t> {
+  auto left = fold(*comparison.left);
+  if (!comparison.right) return left;
+  auto right = fold(*comparison.right);
+  if (!left || !right) return std::nullopt;
+
+  auto value = compare(comparison.op, left.value(), right.value());
+  if (!value) return std::nullopt;
+  comparison.left = ast::wrap<AST::Term>(ast::number(value.value()));
+  comparison.right.reset();
+  ++_folded;
+  return value;
+}
+
+auto ConstantFolding::fold(AST::Term& term) -> std::optional<int64_t> {
+  auto left = fold(*term.left);
+  if (!term.right) return left;
+  auto right = fold(*term.right);
+  if (!left || !right) return std::nullopt;
+
+  auto value = arithmetic(term.op, left.value(), right.value());
+  if (!value) return std::nullopt;
+  term.left = ast::wrap<AST::Factor>(ast::number(value.value()));
+  term.right.reset();
+  ++_folded;
+  return value;
+}
+
+auto ConstantFolding::fold(AST::Factor& factor) -> std::optional<int64_t> {
+  auto left = fold(*factor.left);
+  if (!factor.right) return left;
+  auto right = fold(*factor.right);
+  if (!left || !right) return std::nullopt;
+
+  auto value = arithmetic(factor.op, left.value(), right.value());
+  if (!value) return std::nullopt;
+  factor.left = ast::wrap<AST::Unary>(ast::number(value.value()));
+  factor.right.reset();
+  ++_folded;
+  return value;
+}
+
+/**
+ * @brief Folds a unary expression, both - and ! negate their operand in the generated code
+ *
+ * @param unary Unary to fold
+ * @return std::optional<int64_t> value of the expression, nullopt if it isn't constant
+ */
+auto ConstantFolding::fold(AST::Unary& unary) -> std::optional<int64_t> {
+  auto value = belt::overloaded_visit<std::optional<int64_t>>(
+      unary.value, [&](const std::unique_ptr<AST::Unary>& operand) { return fold(*operand); },
+      [&](const std::unique_ptr<AST::Primary>& primary) { return fold(*primary); });
+  if (unary.op != AST::BinaryOp::SUB && unary.op != AST::BinaryOp::NOT) return value;
+  if (!value) return std::nullopt;
+
+  auto negated = wrap(0 - static_cast<uint64_t>(value.value()));
+  unary.value = ast::number(negated);
+  unary.op = AST::BinaryOp::ADD;
+  ++_folded;
+  return negated;
+}
+
+/**
+ * @brief Folds a primary expression, constant locals and parenthesized constants become numbers
+ *
+ * @param primary Primary to fold
+ * @return std::optional<int64_t> value of the expression, nullopt if it isn't constant
+ */
+auto ConstantFolding::fold(AST::Primary& primary) -> std::optional<int64_t> {
+  auto value = belt::overloaded_visit<std::optional<int64_t>>(
+      primary.value, [&](const std::unique_ptr<AST::Variable>& variable) { return fold(*variable); },
+      [&](const std::unique_ptr<AST::Terminal>& terminal) {
+        return belt::overloaded_visit<std::optional<int64_t>>(
+            terminal->value, [&](const std::unique_ptr<AST::Variable>& variable) { return fold(*variable); },
+            [](const Token& token) -> std::optional<int64_t> {
+              if (token.type != Token::Type::NUMBER) return std::nullopt;
+              return std::stoll(token.value);
+            },
+            [](const std::unique_ptr<AST::String>&) -> std::optional<int64_t> { return std::nullopt; });
+      },
+      [&](const std::unique_ptr<AST::Expression>& expression) { return fold(*expression); },
+      [&](const std::unique_ptr<AST::Call>& call) -> std::optional<int64_t> {
+        for (auto& arg : call->args) fold(*arg);
+        return std::nullopt;
+      },
+      [](const std::unique_ptr<AST::String>&) -> std::optional<int64_t> { return std::nullopt; });
+
+  if (value) primary.value = std::move(ast::number(value.value())->value);
+  return value;
+}
+
+auto ConstantFolding::fold(const AST::Variable& variable) -> std::optional<int64_t> {
+  auto local = find(variable);
+  if (!local || !_state.values.at(local.value())) return std::nullopt;
+  ++_propagated;
+  return _state.values.at(local.value());
+}
+}  // namespace kuso
@@ -0,0 +1,388 @@
+/**
+ * @file dead_code.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "generator/dead_code.hpp"
+
+#include <algorithm>
+#include <belt/overload.hpp>
+#include <fmt/format.h>
+
+#include "generator/constant_folding.hpp"
+
+namespace kuso {
+namespace {
+/**
+ * @brief Locals an expression reads, and whether evaluating it can do anything besides computing a value
+ *
+ */
+struct Reads {
+  std::vector<const AST::Variable*> variables;
+  bool                              pure{true};
+};
+
+void collect(const AST::Expression&, Reads&);
+
+/**
+ * @brief Checks if a divisor is a nonzero number, anything else may fault
+ *
+ */
+auto safe_divisor(const AST::Factor& factor) -> bool {
+  auto divisor = ConstantFolding::constant_value(factor);
+  return divisor && divisor.value() != 0;
+}
+
+void collect(const AST::Primary& primary, Reads& reads) {
+  belt::overloaded_visit(
+      primary.value,
+      [&](const std::unique_ptr<AST::Variable>& variable) { reads.variables.push_back(&*variable); },
+      [&](const std::unique_ptr<AST::Terminal>& terminal) {
+        const auto* variable = std::get_if<std::unique_ptr<AST::Variable>>(&terminal->value);
+        if (variable) reads.variables.push_back(&**variable);
+      },
+      [&](const std::unique_ptr<AST::Expression>& expression) { collect(*expression, reads); },
+      [&](const std::unique_ptr<AST::Call>& call) {
+        reads.pure = false;
+        for (const auto& arg : call->args) collect(*arg, reads);
+      },
+      [](const std::unique_ptr<AST::String>&) {});
+}
+
+void collect(const AST::Unary& unary, Reads& reads) {
+  belt::overloaded_visit(
+      unary.value, [&](const std::unique_ptr<AST::Unary>& operand) { collect(*operand, reads); },
+      [&](const std::unique_ptr<AST::Primary>& primary) { collect(*primary, reads); });
+}
+
+void collect(const AST::Factor& factor, Reads& reads) {
+  collect(*factor.left, reads);
+  if (!factor.right) return;
+  if ((factor.op == AST::BinaryOp::DIV || factor.op == AST::BinaryOp::MOD) && !safe_divisor(*factor.right)) {
+    reads.pure = false;
+  }
+  collect(*factor.right, reads);
+}
+
+void collect(const AST::Term& term, Reads& reads) {
+  collect(*term.left, reads);
+  if (term.right) collect(*term.right, reads);
+}
+
+void collect(const AST::Comparison& comparison, Reads& reads) {
+  collect(*comparison.left, reads);
+  if (comparison.right) collect(*comparison.right, reads);
+}
+
+void collect(const AST::Equality& equality, Reads& reads) {
+  collect(*equality.left, reads);
+  if (equality.right) collect(*equality.right, reads);
+}
+
+void collect(const AST::Expression& expression, Reads& reads) { collect(*expression.value, reads); }
+
+auto pure(const AST::Expression& expression) -> bool {
+  Reads reads;
+  collect(expression, reads);
+  return reads.pure;
+}
+
+auto primitive(const std::string& type) -> bool {
+  return type == "int" || type == "i8" || type == "i16" || type == "i32" || type == "i64";
+}
+
+void merge(DeadCode::Live& live, const DeadCode::Live& other) {
+  for (size_t local = 0; local < live.size(); ++local) live[local] = live[local] || other[local];
+}
+}  // namespace
+
+/**
+ * @brief Removes dead code from every function of the program, rewriting the AST in place
+ *
+ * @param ast AST to clean up
+ */
+void DeadCode::run(AST& ast) {
+  for (auto& statement : ast) {
+    belt::overloaded_visit(
+        statement.statement, [&](const std::unique_ptr<AST::Main>& main) { run({}, main->body); },
+        [&](const std::unique_ptr<AST::Func>& func) { run(func->args, func->body); }, [](const auto&) {});
+  }
+}
+
+auto DeadCode::to_string() const -> std::string {
+  std::string report = fmt::format("{:<20}{:>8}\n", "dead code", "count");
+  report += fmt::format("{:<20}{:>8}\n", "unreachable", _unreachable);
+  report += fmt::format("{:<20}{:>8}\n", "dead stores", _stores);
+  report += fmt::format("{:<20}{:>8}\n", "empty branches", _branches);
+  return report;
+}
+
+void DeadCode::run(const std::vector<std::unique_ptr<AST::Declaration>>& args,
+                   std::vector<AST::Statement>& body) {
+  prune(body);
+
+  _scopes.clear();
+  _tracked.clear();
+  _variables.clear();
+  _declarations.clear();
+
+  _scopes.emplace_back();
+  for (const auto& arg : args) declare(*arg);
+  for (const auto& statement : body) resolve(statement);
+  _scopes.pop_back();
+
+  live(body, Live(_tracked.size(), false), true);
+}
+
+/**
+ * @brief Drops the statements of a block that follow one which never falls through
+ *
+ * @param body Block to prune
+ * @return true If control can reach the end of the block
+ */
+auto DeadCode::prune(std::vector<AST::Statement>& body) -> bool {
+  for (auto statement = body.begin(); statement != body.end(); ++statement) {
+    if (falls_through(*statement)) continue;
+
+    _unreachable += std::distance(statement + 1, body.end());
+    body.erase(statement + 1, body.end());
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Checks if control can continue after a statement, a loop with a constant true condition only
+ * ends through a return or an exit since there is no break
+ *
+ * @param statement Statement to check, its blocks are pruned along the way
+ * @return true If the next statement can run
+ */
+auto DeadCode::falls_through(AST::Statement& statement) -> bool {
+  return belt::overloaded_visit<bool>(
+      statement.statement, [](const std::unique_ptr<AST::Return>&) { return false; },
+      [](const std::unique_ptr<AST::Exit>&) { return false; },
+      [&](const std::unique_ptr<AST::If>& ifStatement) {
+        auto condition = ConstantFolding::constant_value(*ifStatement->condition);
+        auto body = prune(ifStatement->body);
+        auto elseBody = prune(ifStatement->elseBody);
+        if (condition) return condition.value() != 0 ? body : elseBody;
+        return body || elseBody;
+      },
+      [&](const std::unique_ptr<AST::While>& whileStatement) {
+        prune(whileStatement->body);
+        auto condition = ConstantFolding::constant_value(*whileStatement->condition);
+        return !condition || condition.value() == 0;
+      },
+      [](const auto&) { return true; });
+}
+
+void DeadCode::resolve(std::vector<AST::Statement>& body) {
+  _scopes.emplace_back();
+  for (const auto& statement : body) resolve(statement);
+  _scopes.pop_back();
+}
+
+/**
+ * @brief Binds every local a statement reads or writes to its declaration, following the scopes of
+ * the generator
+ *
+ * @param statement Statement to resolve
+ */
+void DeadCode::resolve(const AST::Statement& statement) {
+  belt::overloaded_visit(
+      statement.statement,
+      [&](const std::unique_ptr<AST::Declaration>& declaration) {
+        if (declaration->value) resolve(*declaration->value);
+        declare(*declaration);
+      },
+      [&](const std::unique_ptr<AST::Assignment>& assignment) {
+        resolve(*assignment->value);
+        for (auto scope = _scopes.rbegin(); scope != _scopes.rend(); ++scope) {
+          auto local = scope->find(assignment->dest->name);
+          if (local == scope->end()) continue;
+          _variables[&*assignment->dest] = local->second;
+          break;
+        }
+      },
+      [&](const std::unique_ptr<AST::If>& ifStatement) {
+        resolve(*ifStatement->condition);
+        resolve(ifStatement->body);
+        resolve(ifStatement->elseBody);
+      },
+      [&](const std::unique_ptr<AST::While>& whileStatement) {
+        resolve(*whileStatement->condition);
+        resolve(whileStatement->body);
+      },
+      [&](const std::unique_ptr<AST::Call>& call) {
+        for (const auto& arg : call->args) resolve(*arg);
+      },
+      [&](const std::unique_ptr<AST::Destructure>& destructure) {
+        for (const auto& arg : destructure->call->args) resolve(*arg);
+        for (const auto& target : destructure->targets) declare(*target);
+      },
+      [&](const std::unique_ptr<AST::Return>& return_) {
+        if (return_->value) resolve(*return_->value);
+        if (return_->second) resolve(*return_->second);
+      },
+      [&](const std::unique_ptr<AST::Exit>& exit) {
+        if (exit->value) resolve(*exit->value);
+      },
+      [](const auto&) {});
+}
+
+void DeadCode::resolve(const AST::Expression& expression) {
+  Reads reads;
+  collect(expression, reads);
+  for (const auto* variable : reads.variables) {
+    for (auto scope = _scopes.rbegin(); scope != _scopes.rend(); ++scope) {
+      auto local = scope->find(variable->name);
+      if (local == scope->end()) continue;
+      _variables[variable] = local->second;
+      break;
+    }
+  }
+}
+
+void DeadCode::declare(const AST::Declaration& declaration) {
+  auto local = _tracked.size();
+  _tracked.push_back(primitive(declaration.type));
+  _declarations[&declaration] = local;
+  _scopes.back()[declaration.name] = local;
+}
+
+/**
+ * @brief Computes the locals live before a block from the ones live after it
+ *
+ * @param body Block to walk backwards
+ * @param after Locals live after the block
+ * @param remove Whether dead statements are removed on the way
+ * @return Live locals live before the block
+ */
+auto DeadCode::live(std::vector<AST::Statement>& body, Live after, bool remove) -> Live {
+  for (auto statement = body.size(); statement-- > 0;) {
+    if (live(body[statement], after, remove)) body.erase(body.begin() + static_cast<int64_t>(statement));
+  }
+  return after;
+}
+
+/**
+ * @brief Updates the live locals across a statement
+ *
+ * @param statement Statement to walk
+ * @param live Locals live after the statement, updated to the ones live before it
+ * @param remove Whether dead statements are removed on the way
+ * @return true If the statement is dead and has to be removed
+ */
+auto DeadCode::live(AST::Statement& statement, Live& live, bool remove) -> bool {
+  return belt::overloaded_visit<bool>(
+      statement.statement,
+      [&](const std::unique_ptr<AST::Declaration>& declaration) {
+        auto local = _declarations.at(&*declaration);
+        if (!declaration->value) return false;
+        if (_tracked[local] && !live[local] && pure(*declaration->value)) {
+          if (!remove) return false;
+          declaration->value.reset();
+          ++_stores;
+          return false;
+        }
+        live[local] = false;
+        read(*declaration->value, live);
+        return false;
+      },
+      [&](const std::unique_ptr<AST::Assignment>& assignment) {
+        auto local = _variables.find(&*assignment->dest);
+        if (local != _variables.end() && !assignment->dest->attribute && _tracked[local->second]) {
+          if (!live[local->second] && pure(*assignment->value)) {
+            if (remove) ++_stores;
+            return remove;
+          }
+          live[local->second] = false;
+        }
+        read(*assignment->value, live);
+        return false;
+      },
+      [&](const std::unique_ptr<AST::If>& ifStatement) {
+        auto taken = DeadCode::live(ifStatement->body, live, remove);
+        live = DeadCode::live(ifStatement->elseBody, live, remove);
+        merge(live, taken);
+        read(*ifStatement->condition, live);
+        if (!remove || !ifStatement->body.empty() || !ifStatement->elseBody.empty()) return false;
+        if (!pure(*ifStatement->condition)) return false;
+        ++_branches;
+        return true;
+      },
+      [&](const std::unique_ptr<AST::While>& whileStatement) {
+        if (remove && ConstantFolding::constant_value(*whileStatement->condition) == 0) {
+          ++_branches;
+          return true;
+        }
+        live = DeadCode::live(*whileStatement, live, remove);
+        return false;
+      },
+      [&](const std::unique_ptr<AST::Call>& call) {
+        for (const auto& arg : call->args) read(*arg, live);
+        return false;
+      },
+      [&](const std::unique_ptr<AST::Destructure>& destructure) {
+        // the call stays even when neither value is read
+        for (const auto& target : destructure->targets) live[_declarations.at(&*target)] = false;
+        for (const auto& arg : destructure->call->args) read(*arg, live);
+        return false;
+      },
+      [&](const std::unique_ptr<AST::Return>& return_) {
+        std::fill(live.begin(), live.end(), false);
+        if (return_->value) read(*return_->value, live);
+        if (return_->second) read(*return_->second, live);
+        return false;
+      },
+      [&](const std::unique_ptr<AST::Exit>& exit) {
+        std::fill(live.begin(), live.end(), false);
+        if (exit->value) read(*exit->value, live);
+        return false;
+      },
+      [&](const std::unique_ptr<AST::ASM>&) {
+        std::fill(live.begin(), live.end(), true);
+        return false;
+      },
+      [](const auto&) { return false; });
+}
+
+/**
+ * @brief Computes the locals live at the condition of a loop, iterating until the set settles
+ *
+ * @param whileStatement Loop to walk
+ * @param after Locals live after the loop
+ * @param remove Whether dead statements of the body are removed once the set is known
+ * @return Live locals live before the loop
+ */
+auto DeadCode::live(AST::While& whileStatement, const Live& after, bool remove) -> Live {
+  auto header = after;
+  read(*whileStatement.condition, header);
+
+  while (true) {
+    auto next = live(whileStatement.body, header, false);
+    merge(next, header);
+    if (next == header) break;
+    header = std::move(next);
+  }
+
+  if (remove) live(whileStatement.body, header, true);
+  return header;
+}
+
+void DeadCode::read(const AST::Expression& expression, Live& live) const {
+  Reads reads;
+  collect(expression, reads);
+  for (const auto* variable : reads.variables) {
+    auto local = _variables.find(variable);
+    if (local != _variables.end()) live[local->second] = true;
+  }
+}
+}  // namespace kuso
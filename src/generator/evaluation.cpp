@@ -0,0 +1,229 @@
+/**
+ * @file evaluation.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "generator/evaluation.hpp"
+
+#include <algorithm>
+
+#include <belt/overload.hpp>
+
+#include "generator/constant_folding.hpp"
+#include "x64/arithmetic.hpp"
+
+namespace kuso {
+namespace {
+// a call clobbers every caller saved register, nothing can be held in the pool across it for free
+constexpr int64_t CALL_NEED = Evaluation::SCRATCH.size() + 1;
+}  // namespace
+
+auto Evaluation::label(const AST::Expression& expr) -> Label { return label(*expr.value); }
+
+auto Evaluation::label(const AST::Equality& equality) -> Label {
+  if (!equality.right) return label(*equality.left);
+
+  auto cached = _labels.find(&equality);
+  if (cached != _labels.end()) return cached->second;
+  return _labels[&equality] = combine(label(*equality.left), label(*equality.right));
+}
+
+auto Evaluation::label(const AST::Comparison& comparison) -> Label {
+  if (!comparison.right) return label(*comparison.left);
+
+  auto cached = _labels.find(&comparison);
+  if (cached != _labels.end()) return cached->second;
+  return _labels[&comparison] = combine(label(*comparison.left), label(*comparison.right));
+}
+
+auto Evaluation::label(const AST::Term& term) -> Label {
+  if (!term.right) return label(*term.left);
+
+  auto cached = _labels.find(&term);
+  if (cached != _labels.end()) return cached->second;
+  return _labels[&term] = combine(label(*term.left), label(*term.right));
+}
+
+auto Evaluation::label(const AST::Factor& factor) -> Label {
+  if (!factor.right) return label(*factor.left);
+  if (auto reduction = strength_reduced(factor)) {
+    return reduction->constantLeft ? label(*factor.right) : label(*factor.left);
+  }
+
+  auto cached = _labels.find(&factor);
+  if (cached != _labels.end()) return cached->second;
+  return _labels[&factor] = combine(label(*factor.left), label(*factor.right));
+}
+
+auto Evaluation::label(const AST::Unary& unary) -> Label {
+  return belt::overloaded_visit<Label>(
+      unary.value, [&](const std::unique_ptr<AST::Primary>& primary) { return label(*primary); },
+      [&](const std::unique_ptr<AST::Unary>& inner) { return label(*inner); });
+}
+
+auto Evaluation::label(const AST::Primary& primary) -> Label {
+  return belt::overloaded_visit<Label>(
+      primary.value, [&](const std::unique_ptr<AST::Expression>& expression) { return label(*expression); },
+      [&](const std::unique_ptr<AST::Call>&) { return Label{CALL_NEED, true}; },
+      [&](const auto&) { return Label{}; });
+}
+
+/**
+ * @brief Checks if the left operand of a binary expression is evaluated first
+ *
+ * The right operand goes first by default, so with calls on both sides the right one runs before the left
+ *
+ * @param left Label of the left operand
+ * @param right Label of the right operand
+ * @param reorderable Whether the operation can be generated with its operands swapped
+ * @return true If the left operand needs more registers and evaluating it first changes no call order
+ */
+auto Evaluation::left_first(const Label& left, const Label& right, bool reorderable) -> bool {
+  return reorderable && !(left.calls && right.calls) && left.need > right.need;
+}
+
+/**
+ * @brief Checks if a factor has a constant operand that its operation can take as an immediate
+ *
+ * Multiplication takes the constant from either side, division and modulo only a nonzero divisor that
+ * fits 32 bits, a power any constant exponent
+ *
+ * @param factor Factor to check
+ * @return std::optional<Reduction> the constant and its side, nullopt if both operands are evaluated
+ */
+auto Evaluation::strength_reduced(const AST::Factor& factor) -> std::optional<Reduction> {
+  if (!factor.right) return std::nullopt;
+
+  auto right = ConstantFolding::constant_value(*factor.right);
+  switch (factor.op) {
+    case AST::BinaryOp::MUL: {
+      if (right && x64::reduces_multiply(right.value())) return Reduction{right.value(), false};
+      auto left = ConstantFolding::constant_value(*factor.left);
+      if (left && x64::reduces_multiply(left.value())) return Reduction{left.value(), true};
+      return std::nullopt;
+    }
+    case AST::BinaryOp::DIV:
+    case AST::BinaryOp::MOD:
+      if (right && x64::reduces_divide(right.value())) return Reduction{right.value(), false};
+      return std::nullopt;
+    case AST::BinaryOp::POW:
+      if (right) return Reduction{right.value(), false};
+      return std::nullopt;
+    default:
+      return std::nullopt;
+  }
+}
+
+/**
+ * @brief Checks if a return gives back the result of a call directly, possibly parenthesized
+ *
+ * Only calls that pass every argument in a register qualify, stack arguments would have to be written
+ * over the caller's own incoming arguments
+ *
+ * @param ret Return to check
+ * @return const AST::Call* the call in tail position, nullptr if there is none
+ */
+auto Evaluation::tail_call(const AST::Return& ret) -> const AST::Call* {
+  if (!ret.value || ret.second) return nullptr;
+  const auto* found = call(*ret.value);
+  if (found == nullptr) return nullptr;
+  if (!found->args.empty() && x64::parameter_reg(found->args.size() - 1) == x64::Register::NONE) {
+    return nullptr;
+  }
+  return found;
+}
+
+/**
+ * @brief Gets the call an expression only consists of, possibly parenthesized
+ *
+ * @param expression Expression to check
+ * @return const AST::Call* the call, nullptr if the expression computes anything else
+ */
+auto Evaluation::call(const AST::Expression& expression) -> const AST::Call* {
+  const auto* primary = single(expression);
+  if (primary == nullptr) return nullptr;
+  return belt::overloaded_visit<const AST::Call*>(
+      primary->value, [](const std::unique_ptr<AST::Call>& found) -> const AST::Call* { return found.get(); },
+      [](const std::unique_ptr<AST::Expression>& nested) { return call(*nested); },
+      [](const auto&) -> const AST::Call* { return nullptr; });
+}
+
+/**
+ * @brief Gets the variable an expression only reads, possibly parenthesized
+ *
+ * @param expression Expression to check
+ * @return const AST::Variable* the variable, nullptr if the expression computes anything
+ */
+auto Evaluation::variable(const AST::Expression& expression) -> const AST::Variable* {
+  const auto* primary = single(expression);
+  if (primary == nullptr) return nullptr;
+  return belt::overloaded_visit<const AST::Variable*>(
+      primary->value,
+      [](const std::unique_ptr<AST::Variable>& found) -> const AST::Variable* { return found.get(); },
+      [](const std::unique_ptr<AST::Terminal>& terminal) -> const AST::Variable* {
+        const auto* found = std::get_if<std::unique_ptr<AST::Variable>>(&terminal->value);
+        return found == nullptr ? nullptr : found->get();
+      },
+      [](const std::unique_ptr<AST::Expression>& nested) { return variable(*nested); },
+      [](const auto&) -> const AST::Variable* { return nullptr; });
+}
+
+/**
+ * @brief Checks if a call argument is moved straight into its parameter register
+ *
+ * @param arg Argument to check
+ * @param index Position of the argument
+ * @return true If the argument is a number or a variable passed in a register
+ */
+auto Evaluation::direct(const AST::Expression& arg, size_t index) -> bool {
+  if (x64::parameter_reg(index) == x64::Register::NONE) return false;
+  return variable(arg) != nullptr || ConstantFolding::constant_value(arg).has_value();
+}
+
+/**
+ * @brief Gets the primary an expression consists of when it has no operators
+ *
+ * @param expression Expression to check
+ * @return const AST::Primary* the primary, nullptr if there is an operator
+ */
+auto Evaluation::single(const AST::Expression& expression) -> const AST::Primary* {
+  const auto& equality = *expression.value;
+  if (equality.right || equality.left->right || equality.left->left->right) return nullptr;
+  const auto& factor = *equality.left->left->left;
+  if (factor.right || factor.left->op != AST::BinaryOp::ADD) return nullptr;
+
+  const auto* primary = std::get_if<std::unique_ptr<AST::Primary>>(&factor.left->value);
+  return primary == nullptr ? nullptr : primary->get();
+}
+
+/**
+ * @brief Takes a scratch register to hold an operand in
+ *
+ * @param acrossCall Whether the value has to survive a call
+ * @return x64::Register Register to hold the value in, NONE if it has to be pushed
+ */
+auto Evaluation::acquire(bool acrossCall) -> x64::Register {
+  for (size_t reg = 0; reg < SCRATCH.size(); ++reg) {
+    if (_busy.at(reg) || (acrossCall && !x64::is_callee_saved(SCRATCH.at(reg)))) continue;
+    _busy.at(reg) = true;
+    return SCRATCH.at(reg);
+  }
+  return x64::Register::NONE;
+}
+
+void Evaluation::release(x64::Register reg) {
+  auto held = std::find(SCRATCH.begin(), SCRATCH.end(), reg);
+  if (held != SCRATCH.end()) _busy.at(static_cast<size_t>(held - SCRATCH.begin())) = false;
+}
+
+auto Evaluation::combine(const Label& left, const Label& right) -> Label {
+  auto need = left.need == right.need ? left.need + 1 : std::max(left.need, right.need);
+  return Label{need, left.calls || right.calls};
+}
+}  // namespace kuso
@@ -11,16 +11,23 @@
 
 #include "generator/first_pass.hpp"
 
+#include <algorithm>
 #include <belt/overload.hpp>
 #include <optional>
+#include <tuple>
 
+#include "generator/layout.hpp"
 #include "logging/logging.hpp"
 
 namespace kuso {
 
 FirstPass::FirstPass() {
-  _types.add_type("none", Type{0, std::nullopt});
-  _types.add_type("int", Type{x64::Size::QWORD, std::nullopt});
+  _types.add_type("none", Type::primitive(0));
+  _types.add_type("int", Type::primitive(x64::Size::QWORD));
+  _types.add_type("i8", Type::primitive(x64::Size::BYTE));
+  _types.add_type("i16", Type::primitive(x64::Size::WORD));
+  _types.add_type("i32", Type::primitive(x64::Size::DWORD));
+  _types.add_type("i64", Type::primitive(x64::Size::QWORD));
 }
 
 /**
@@ -41,7 +48,8 @@ auto FirstPass::types_pass(const AST& ast) -> bool {
           [&](const std::unique_ptr<AST::Return>&) {}, [&](const std::unique_ptr<AST::Exit>&) {},
           [&](const std::unique_ptr<AST::Assignment>&) {}, [&](const std::unique_ptr<AST::ASM>&) {},
           [&](const std::unique_ptr<AST::Main>&) { hasMain = true; },
-          [&](const std::unique_ptr<AST::Call>&) {}, [](std::nullptr_t) {});
+          [&](const std::unique_ptr<AST::Call>&) {}, [&](const std::unique_ptr<AST::Destructure>&) {},
+          [](std::nullptr_t) {});
     }
 
     if (!hasMain) {
@@ -77,8 +85,11 @@ auto FirstPass::function_pass(const AST& ast) -> bool {
           [&](const std::unique_ptr<AST::Return>&) {}, [&](const std::unique_ptr<AST::Exit>&) {},
           [&](const std::unique_ptr<AST::Assignment>& assignment) { pass_expression(*assignment->value); },
           [&](const std::unique_ptr<AST::Main>& main) { pass_main(*main); },
-          [&](const std::unique_ptr<AST::Call>&) {}, [](std::nullptr_t) {});
+          [&](const std::unique_ptr<AST::Call>&) {}, [&](const std::unique_ptr<AST::Destructure>&) {},
+          [](std::nullptr_t) {});
     }
+
+    resolve_registers();
   } catch (FirstPassException& e) {
     Logging::error(e.what());
     return false;
@@ -98,24 +109,46 @@ void FirstPass::generate_type(const AST::Type& type) {
     throw std::runtime_error("Multiple Declarations of " + type.name);
   }
 
+  Layout::Options options;
+  for (const auto& annotation : type.annotations) {
+    if (annotation.name == "packed" && !annotation.value) {
+      options.packed = true;
+    } else if (annotation.name == "ordered" && !annotation.value) {
+      options.reorder = false;
+    } else if (annotation.name == "align" && annotation.value) {
+      auto align = annotation.value.value();
+      if (align <= 0 || (align & (align - 1)) != 0) {
+        throw FirstPassException(fmt::format("Invalid Alignment {} for {}", align, type.name));
+      }
+      options.align = static_cast<int>(align);
+    } else {
+      throw FirstPassException("Unknown Annotation @" + annotation.name + " on " + type.name);
+    }
+  }
+
   Type newType;
 
   if (!type.attributes.empty()) {
-    newType.offsets = std::map<std::string, int>{};
-    int currOffset = 0;
-
+    std::vector<Layout::Field> fields;
     for (const auto& attribute : type.attributes) {
-      auto refType = _types.get_type(attribute.type);
-      if (!refType.has_value()) {
+      auto refID = _types.get_type_id(attribute.type);
+      if (!refID.has_value()) {
         throw std::runtime_error("Unknown Type " + attribute.type);
       }
+      if (std::any_of(fields.begin(), fields.end(),
+                      [&](const Layout::Field& field) { return field.name == attribute.name; })) {
+        throw FirstPassException("Multiple Declarations of " + type.name + "." + attribute.name);
+      }
 
-      newType.offsets.value()[attribute.name] = currOffset;
-      currOffset += refType.value().get().size;
-      newType.size += refType.value().get().size;
+      const auto& refType = _types.get_type(refID.value()).value().get();
+      fields.push_back(Layout::Field{attribute.name, refID.value(), refType.size, refType.align});
     }
+
+    newType = Layout::compute(std::move(fields), options);
   } else {
-    newType.size = x64::Size::QWORD;
+    newType.align = std::max<int>(x64::Size::QWORD, options.align);
+    newType.size = static_cast<int>(Layout::align_to(x64::Size::QWORD, newType.align));
+    newType.padding = newType.size - x64::Size::QWORD;
   }
 
   _types.add_type(type.name, newType);
@@ -131,11 +164,23 @@ void FirstPass::pass_func(const AST::Func& func) {
     throw FirstPassException("Multiple Declarations of " + func.name);
   }
 
+  // inlining only happens on the ssa backend, the annotations are still checked here
+  for (const auto& annotation : func.annotations) {
+    if ((annotation.name != "inline" && annotation.name != "noinline") || annotation.value) {
+      throw FirstPassException("Unknown Annotation @" + annotation.name + " on " + func.name);
+    }
+  }
+
   _currFunc = func.name;
 
   FuncInfo newFunc;
   newFunc.size = 0;
-  newFunc.stack = x64::Address{x64::Address::Mode::INDIRECT_DISPLACEMENT, x64::Register::RSP, 0};
+  newFunc.stack = x64::Address{x64::Address::Mode::INDIRECT_DISPLACEMENT, x64::Register::RBP, 0};
+
+  int64_t stackParams = 0;
+  for (size_t i = 0; i < func.args.size(); ++i) {
+    if (x64::parameter_reg(i) == x64::Register::NONE) ++stackParams;
+  }
 
   size_t paramIndex = 0;
   for (const auto& arg : func.args) {
@@ -153,28 +198,39 @@ void FirstPass::pass_func(const AST::Func& func) {
     if (reg != x64::Register::NONE) {
       newFunc.params[arg->name] = Variable{typeID.value(), x64::Address{x64::Address::Mode::DIRECT, reg}};
     } else {
-      newFunc.params[arg->name] = Variable{typeID.value(), newFunc.stack};
-      newFunc.stack.disp += typeIter.value().get().size;
-      newFunc.size += typeIter.value().get().size;
+      // the caller pushes stack arguments in order, above the return address and saved rbp
+      --stackParams;
+      newFunc.params[arg->name] =
+          Variable{typeID.value(), x64::Address{x64::Address::Mode::INDIRECT_DISPLACEMENT, x64::Register::RBP,
+                                                (2 + stackParams) * x64::Size::QWORD}};
+    }
+    ++paramIndex;
+  }
+
+  for (const auto& element : func.tuple) {
+    auto type = _types.get_type(element);
+    if (!type.has_value()) throw FirstPassException("Unknown Type " + element);
+    if (type.value().get().offsets) {
+      throw FirstPassException("Types with attributes cannot be returned with another value by " + func.name);
     }
   }
 
+  auto returned = func.tuple.empty() ? _types.get_type(func.returnType) : std::nullopt;
+  if (returned && returned.value().get().size > 2 * x64::Size::QWORD) {
+    throw FirstPassException("Types returned by value are at most 16 bytes, " + func.name + " returns " +
+                             func.returnType);
+  }
+  newFunc.pair = !func.tuple.empty() || (returned && returned.value().get().size > x64::Size::QWORD);
+
   _functions[func.name] = newFunc;
+  _usage[func.name] = Usage{};
 
-  for (const auto& statement : func.body) {
-    belt::overloaded_visit(
-        statement.statement, [&](const std::unique_ptr<AST::Type>&) {},
-        [&](const std::unique_ptr<AST::Declaration>& decl) { pass_decl(*decl); },
-        [&](const std::unique_ptr<AST::If>& ifStatement) { pass_expression(*ifStatement->condition); },
-        [&](const std::unique_ptr<AST::While>& whileStatement) {
-          pass_expression(*whileStatement->condition);
-        },
-        [&](const std::unique_ptr<AST::ASM>&) {}, [&](const std::unique_ptr<AST::Func>&) {},
-        [&](const std::unique_ptr<AST::Return>&) {}, [&](const std::unique_ptr<AST::Exit>&) {},
-        [&](const std::unique_ptr<AST::Assignment>& assignment) { pass_expression(*assignment->value); },
-        [&](const std::unique_ptr<AST::Main>&) {},
-        [&](const std::unique_ptr<AST::Call>& call) { pass_call(*call); }, [](std::nullptr_t) {});
+  _scope.enter_scope();
+  for (const auto& [name, param] : _functions[func.name].params) {
+    _scope.declare(name, param);
   }
+  pass_body(func.body);
+  _scope.leave_scope();
 }
 
 /**
@@ -191,50 +247,347 @@ void FirstPass::pass_main(const AST::Main& main) {
 
   FuncInfo newFunc;
   newFunc.size = 0;
-  newFunc.stack = x64::Address{x64::Address::Mode::INDIRECT_DISPLACEMENT, x64::Register::RSP, 0};
+  newFunc.stack = x64::Address{x64::Address::Mode::INDIRECT_DISPLACEMENT, x64::Register::RBP, 0};
 
   _functions["main"] = newFunc;
+  _usage["main"] = Usage{};
 
-  for (const auto& statement : main.body) {
+  pass_body(main.body);
+}
+
+/**
+ * @brief Handles the first pass of a list of statements, including nested blocks
+ * 
+ * Statements are walked in the order the generator emits them, recording every register write,
+ * every read of a register parameter and every call
+ * 
+ * @param body Statements to pass
+ */
+void FirstPass::pass_body(const std::vector<AST::Statement>& body) {
+  _scope.enter_scope();
+  _declarations.enter_scope();
+  for (const auto& statement : body) {
     belt::overloaded_visit(
         statement.statement, [&](const std::unique_ptr<AST::Type>&) {},
-        [&](const std::unique_ptr<AST::Declaration>& decl) { pass_decl(*decl); },
-        [&](const std::unique_ptr<AST::If>& ifStatement) { pass_expression(*ifStatement->condition); },
+        [&](const std::unique_ptr<AST::Declaration>& decl) {
+          if (decl->value) {
+            pass_expression(*decl->value);
+            // a type with attributes comes back in rax and rdx
+            auto type = _types.get_type(decl->type);
+            if (type && type.value().get().offsets) write_reg(x64::Register::RDX);
+          }
+          pass_decl(*decl);
+        },
+        [&](const std::unique_ptr<AST::If>& ifStatement) {
+          pass_expression(*ifStatement->condition);
+          pass_body(ifStatement->body);
+          pass_body(ifStatement->elseBody);
+        },
         [&](const std::unique_ptr<AST::While>& whileStatement) {
+          // loops are unrolled before either backend runs, the annotations are still checked here
+          for (const auto& annotation : whileStatement->annotations) {
+            auto valid = annotation.name == "unroll" ? annotation.value && annotation.value.value() > 0
+                                                     : annotation.name == "nounroll" && !annotation.value;
+            if (!valid) throw FirstPassException("Unknown Annotation @" + annotation.name + " on while");
+          }
+
+          auto start = _usage[_currFunc].seq;
           pass_expression(*whileStatement->condition);
+          pass_body(whileStatement->body);
+          auto& usage = _usage[_currFunc];
+          usage.loops.emplace_back(start, usage.seq);
+        },
+        [&](const std::unique_ptr<AST::ASM>& asmStatement) { pass_asm(*asmStatement); },
+        [&](const std::unique_ptr<AST::Func>&) {},
+        [&](const std::unique_ptr<AST::Return>& ret) {
+          const auto* call = _currFunc == "main" ? nullptr : Evaluation::tail_call(*ret);
+          if (call) {
+            pass_tail_call(*call);
+          } else if (ret->second) {
+            pass_expression(*ret->value);
+            pass_expression(*ret->second);
+            write_reg(x64::Register::RDX);
+            write_reg(x64::Register::RAX);
+          } else if (ret->value) {
+            pass_expression(*ret->value);
+            if (_functions[_currFunc].pair) write_reg(x64::Register::RDX);
+          }
+        },
+        [&](const std::unique_ptr<AST::Exit>& exit) {
+          if (exit->value) pass_expression(*exit->value);
+          write_reg(x64::Register::RDI);
+          write_reg(x64::Register::RAX);
+          write_reg(x64::Register::RCX);
+          write_reg(x64::Register::R11);
+        },
+        [&](const std::unique_ptr<AST::Assignment>& assignment) {
+          pass_expression(*assignment->value);
+          use_local(assignment->dest->name);
+          // assigning to a register parameter updates its home, it is not a clobber of the parameter
+          auto dest = _scope.find(assignment->dest->name);
+          if (dest && dest.value().get().location.mode == x64::Address::Mode::DIRECT) {
+            _functions[_currFunc].dirtyRegs.at(static_cast<size_t>(dest.value().get().location.reg)) = true;
+          }
+        },
+        [&](const std::unique_ptr<AST::Main>&) {},
+        [&](const std::unique_ptr<AST::Call>& call) { pass_call(*call); },
+        [&](const std::unique_ptr<AST::Destructure>& destructure) {
+          pass_call(*destructure->call);
+          write_reg(x64::Register::RDX);
+          for (const auto& target : destructure->targets) pass_decl(*target);
+          // both are stored right after the call, so their lifetimes start together
+          auto& lifetimes = _usage[_currFunc].lifetimes;
+          lifetimes[destructure->targets[1].get()].first = lifetimes[destructure->targets[0].get()].first;
         },
-        [&](const std::unique_ptr<AST::ASM>&) {}, [&](const std::unique_ptr<AST::Func>&) {},
-        [&](const std::unique_ptr<AST::Return>&) {}, [&](const std::unique_ptr<AST::Exit>&) {},
-        [&](const std::unique_ptr<AST::Assignment>& assignment) { pass_expression(*assignment->value); },
-        [&](const std::unique_ptr<AST::Main>&) {}, [&](const std::unique_ptr<AST::Call>&) {},
         [](std::nullptr_t) {});
   }
+  _declarations.leave_scope();
+  _scope.leave_scope();
 }
 
 /**
- * @brief Handles the first pass of a call
+ * @brief Handles the first pass of a call, in the order the generator moves the arguments into place
+ * 
+ * Arguments that have to be evaluated go first and only the last of them is moved into its register
+ * right away, the others are popped or read back into theirs once all are done. Numbers and variables
+ * are moved last, a parameter they read after its register was set is spilled
  * 
  * @param call Call to pass
  */
 void FirstPass::pass_call(const AST::Call& call) {
-  for (const auto& arg : call.args) {
-    pass_expression(*arg);
+  std::vector<size_t> evaluated;
+  for (size_t i = 0; i < call.args.size(); ++i) {
+    if (!Evaluation::direct(*call.args[i], i)) evaluated.push_back(i);
   }
+
+  for (auto index : evaluated) pass_expression(*call.args[index]);
+  for (auto index : evaluated) {
+    auto reg = x64::parameter_reg(index);
+    if (reg != x64::Register::NONE) write_reg(reg);
+  }
+  for (size_t i = 0; i < call.args.size(); ++i) {
+    if (!Evaluation::direct(*call.args[i], i)) continue;
+    pass_expression(*call.args[i]);
+    write_reg(x64::parameter_reg(i));
+  }
+
+  auto& usage = _usage[_currFunc];
+  usage.calls.push_back(Usage::CallSite{&call, call.name, usage.seq++});
+  write_reg(x64::Register::RAX);
 }
 
 /**
- * @brief Handles the first pass of an expression
+ * @brief Handles the first pass of a tail call, every argument is evaluated before the first one is moved
+ * into its register
+ * 
+ * Control never comes back after the moves, they do not clobber parameters that are read later on
+ * 
+ * @param call Call to pass
+ */
+void FirstPass::pass_tail_call(const AST::Call& call) {
+  for (const auto& arg : call.args) pass_expression(*arg);
+
+  auto& func = _functions[_currFunc];
+  for (size_t paramIndex = 0; paramIndex < call.args.size(); ++paramIndex) {
+    func.dirtyRegs.at(static_cast<size_t>(x64::parameter_reg(paramIndex))) = true;
+  }
+
+  auto& usage = _usage[_currFunc];
+  usage.calls.push_back(Usage::CallSite{&call, call.name, usage.seq++});
+
+  func.tailCalls.insert(&call);
+  if (call.name == _currFunc) func.tailRecursive = true;
+}
+
+/**
+ * @brief Handles the first pass of inline assembly, every register it names counts as written
+ * 
+ * @param asmStatement Assembly to pass
+ */
+void FirstPass::pass_asm(const AST::ASM& asmStatement) {
+  auto usage = x64::scan_asm(asmStatement.code);
+  for (size_t reg = 0; reg < x64::REGISTER_COUNT; ++reg) {
+    if (usage.regs.at(reg)) write_reg(static_cast<x64::Register>(reg));
+  }
+  if (usage.calls) _usage[_currFunc].callsUnknown = true;
+}
+
+/**
+ * @brief Handles the first pass of an expression, the result always ends up in rax
  * 
  * @param expr Expression to pass
  */
-void FirstPass::pass_expression(const AST::Expression& /*unused*/) {
-  auto& context = _functions[_currFunc];
-  // TODO(rolland): temporarily setting all registers to dirty on a call
-  context.dirtyRegs.fill(true);
+void FirstPass::pass_expression(const AST::Expression& expr) {
+  pass_expression(*expr.value);
+  write_reg(x64::Register::RAX);
+}
+
+/**
+ * @brief Handles the first pass of the operands of a binary expression, in the order the generator picks
+ * 
+ * The first operand is held in a scratch register, or popped into the fallback register once the
+ * scratch registers ran out
+ * 
+ * @param left Left operand
+ * @param right Right operand
+ * @param reorderable Whether the operation can take its left operand second
+ * @param fallback Register the first operand is popped into when it had to be pushed
+ */
+template <typename Left, typename Right>
+void FirstPass::pass_operands(const Left& left, const Right& right, bool reorderable,
+                              x64::Register fallback) {
+  auto leftLabel = _evaluation.label(left);
+  auto rightLabel = _evaluation.label(right);
+  auto leftFirst = Evaluation::left_first(leftLabel, rightLabel, reorderable);
+
+  if (leftFirst) {
+    pass_expression(left);
+  } else {
+    pass_expression(right);
+  }
+
+  auto held = _evaluation.acquire(leftFirst ? rightLabel.calls : leftLabel.calls);
+  if (held != x64::Register::NONE) write_reg(held);
+
+  if (leftFirst) {
+    pass_expression(right);
+  } else {
+    pass_expression(left);
+  }
+
+  if (held == x64::Register::NONE) {
+    write_reg(fallback);
+  } else {
+    _evaluation.release(held);
+  }
 }
 
 /**
- * @brief Handles the first pass of a declaration
+ * @brief Handles the first pass of an equality
+ * 
+ * @param equality Equality to pass
+ */
+void FirstPass::pass_expression(const AST::Equality& equality) {
+  if (!equality.right) {
+    pass_expression(*equality.left);
+    return;
+  }
+  pass_operands(*equality.left, *equality.right, true, x64::Register::RDX);
+  write_reg(x64::Register::RAX);
+}
+
+/**
+ * @brief Handles the first pass of a comparison
+ * 
+ * @param comparison Comparison to pass
+ */
+void FirstPass::pass_expression(const AST::Comparison& comparison) {
+  if (!comparison.right) {
+    pass_expression(*comparison.left);
+    return;
+  }
+  pass_operands(*comparison.left, *comparison.right, true, x64::Register::RDX);
+  write_reg(x64::Register::RAX);
+}
+
+/**
+ * @brief Handles the first pass of a term
+ * 
+ * @param term Term to pass
+ */
+void FirstPass::pass_expression(const AST::Term& term) {
+  if (!term.right) {
+    pass_expression(*term.left);
+    return;
+  }
+  pass_operands(*term.left, *term.right, true, x64::Register::RDX);
+  write_reg(x64::Register::RAX);
+}
+
+/**
+ * @brief Handles the first pass of a factor, only multiplication can be reordered, division, modulo and
+ * powers clobber rdx and their strength reduced forms rcx as well
+ * 
+ * @param factor Factor to pass
+ */
+void FirstPass::pass_expression(const AST::Factor& factor) {
+  if (!factor.right) {
+    pass_expression(*factor.left);
+    return;
+  }
+
+  auto multiply = factor.op == AST::BinaryOp::MUL;
+  if (auto reduction = Evaluation::strength_reduced(factor)) {
+    if (reduction->constantLeft) {
+      pass_expression(*factor.right);
+    } else {
+      pass_expression(*factor.left);
+    }
+    if (factor.op == AST::BinaryOp::DIV || factor.op == AST::BinaryOp::MOD) write_reg(x64::Register::RCX);
+  } else {
+    pass_operands(*factor.left, *factor.right, multiply, multiply ? x64::Register::RDX : x64::Register::RCX);
+  }
+  if (!multiply) write_reg(x64::Register::RDX);
+  write_reg(x64::Register::RAX);
+}
+
+/**
+ * @brief Handles the first pass of a unary
+ * 
+ * @param unary Unary to pass
+ */
+void FirstPass::pass_expression(const AST::Unary& unary) {
+  belt::overloaded_visit(
+      unary.value, [&](const std::unique_ptr<AST::Primary>& primary) { pass_expression(*primary); },
+      [&](const std::unique_ptr<AST::Unary>& unary) { pass_expression(*unary); }, [](std::nullptr_t) {});
+  write_reg(x64::Register::RAX);
+}
+
+/**
+ * @brief Handles the first pass of a primary
+ * 
+ * @param primary Primary to pass
+ */
+void FirstPass::pass_expression(const AST::Primary& primary) {
+  belt::overloaded_visit(
+      primary.value, [&](const std::unique_ptr<AST::Terminal>& terminal) { pass_expression(*terminal); },
+      [&](const std::unique_ptr<AST::Call>& call) { pass_call(*call); },
+      [&](const std::unique_ptr<AST::Expression>& expression) { pass_expression(*expression); },
+      [&](const std::unique_ptr<AST::String>&) {},
+      [&](const std::unique_ptr<AST::Variable>& variable) { pass_expression(*variable); });
+}
+
+/**
+ * @brief Handles the first pass of a terminal
+ * 
+ * @param terminal Terminal to pass
+ */
+void FirstPass::pass_expression(const AST::Terminal& terminal) {
+  belt::overloaded_visit(
+      terminal.value, [&](const std::unique_ptr<AST::Variable>& variable) { pass_expression(*variable); },
+      [&](const Token&) { write_reg(x64::Register::RAX); }, [&](const std::unique_ptr<AST::String>&) {},
+      [](std::nullptr_t) {});
+}
+
+/**
+ * @brief Handles the first pass of a variable read, only reads of locals and register parameters are
+ * tracked
+ * 
+ * @param variable Variable to pass
+ */
+void FirstPass::pass_expression(const AST::Variable& variable) {
+  use_local(variable.name);
+  auto var = _scope.find(variable.name);
+  if (var && var.value().get().location.mode == x64::Address::Mode::DIRECT) {
+    auto& usage = _usage[_currFunc];
+    usage.uses[variable.name].push_back(usage.seq++);
+  }
+  write_reg(x64::Register::RAX);
+}
+
+/**
+ * @brief Handles the first pass of a declaration, its slot is only assigned once the lifetimes of all
+ * locals of the function are known
  * 
  * @param decl Declaration to pass
  */
@@ -250,8 +603,240 @@ void FirstPass::pass_decl(const AST::Declaration& decl) {
     throw FirstPassException("Unknown Type " + decl.type);
   }
 
-  context.locals[decl.name] = Variable{typeID.value(), context.stack};
-  context.stack.disp += typeIter.value().get().size;
-  context.size += typeIter.value().get().size;
+  auto local = Variable{typeID.value(), context.stack};
+  context.locals[&decl] = local;
+  _scope.declare(decl.name, local);
+  _declarations.declare(decl.name, &decl);
+
+  auto& usage = _usage[_currFunc];
+  usage.lifetimes[&decl] = {usage.seq, usage.seq};
+  ++usage.seq;
+}
+
+/**
+ * @brief Records a read or write of a local at the current point of the current function
+ * 
+ * @param name Name of the local, parameters are ignored
+ */
+void FirstPass::use_local(std::string_view name) {
+  auto decl = _declarations.find(name);
+  if (!decl) return;
+
+  auto& usage = _usage[_currFunc];
+  usage.lifetimes[decl.value().get()].second = usage.seq++;
+}
+
+/**
+ * @brief Records a register write at the current point of the current function
+ * 
+ * @param reg Register written, registers outside of the tracked set are ignored
+ */
+void FirstPass::write_reg(x64::Register reg) {
+  if (static_cast<size_t>(reg) >= x64::REGISTER_COUNT) return;
+
+  auto& usage = _usage[_currFunc];
+  _functions[_currFunc].dirtyRegs.at(static_cast<size_t>(reg)) = true;
+  usage.writes.emplace_back(reg, usage.seq++);
+}
+
+/**
+ * @brief Propagates clobbered registers through the call graph, then places spills and saves
+ * 
+ * A call clobbers the caller saved registers the callee writes and everything its own callees clobber,
+ * this is iterated until nothing changes so recursion converges. Calls to unknown functions clobber
+ * every caller saved register.
+ */
+void FirstPass::resolve_registers() {
+  for (auto& [name, func] : _functions) {
+    for (size_t reg = 0; reg < x64::REGISTER_COUNT; ++reg) {
+      auto callerSaved = !x64::is_callee_saved(static_cast<x64::Register>(reg));
+      func.clobbers.at(reg) = callerSaved && (func.dirtyRegs.at(reg) || _usage[name].callsUnknown);
+    }
+  }
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto& [name, func] : _functions) {
+      for (const auto& site : _usage[name].calls) {
+        auto callee = _functions.find(site.callee);
+        for (size_t reg = 0; reg < x64::REGISTER_COUNT; ++reg) {
+          auto clobbered = callee == _functions.end() ? !x64::is_callee_saved(static_cast<x64::Register>(reg))
+                                                      : callee->second.clobbers.at(reg);
+          if (clobbered && !func.clobbers.at(reg)) {
+            func.clobbers.at(reg) = true;
+            changed = true;
+          }
+        }
+      }
+    }
+  }
+
+  for (auto& [name, func] : _functions) {
+    assign_slots(name, func);
+    assign_saves(name, func);
+  }
+}
+
+/**
+ * @brief Gives every local of a function a slot, locals whose lifetimes don't overlap share one
+ * 
+ * A local used inside a loop it was declared before lives until the end of the loop, the next iteration
+ * may read it again. Locals are placed in the order they are declared, each into the smallest free slot
+ * it fits with its alignment, a new slot is only reserved when none does.
+ * 
+ * @param name Name of the function
+ * @param func Function to place the locals in
+ */
+void FirstPass::assign_slots(const std::string& name, FuncInfo& func) {
+  struct Slot {
+    x64::Address address;
+    int64_t      size;
+    size_t       end;
+  };
+
+  const auto& usage = _usage[name];
+  std::vector<std::tuple<size_t, size_t, const AST::Declaration*>> lifetimes;
+  for (auto [decl, lifetime] : usage.lifetimes) {
+    auto [start, end] = lifetime;
+    // loops are recorded innermost first, so a local leaves all loops it is used in
+    for (auto [loopStart, loopEnd] : usage.loops) {
+      if (start < loopStart && end >= loopStart) end = std::max(end, loopEnd);
+    }
+    lifetimes.emplace_back(start, end, decl);
+  }
+  std::ranges::sort(lifetimes);
+
+  std::vector<Slot> slots;
+  for (auto [start, end, decl] : lifetimes) {
+    auto& local = func.locals.at(decl);
+    auto& type = _types.get_type(local.type).value().get();
+    auto  align = std::min<int64_t>(type.align, MAX_SLOT_ALIGN);
+
+    auto fits = [&](const Slot& slot) {
+      return slot.end < start && slot.size >= type.size && -slot.address.disp % align == 0;
+    };
+    auto best = slots.end();
+    for (auto slot = slots.begin(); slot != slots.end(); ++slot) {
+      if (fits(*slot) && (best == slots.end() || slot->size < best->size)) best = slot;
+    }
+    if (best != slots.end()) {
+      best->end = end;
+      local.location = best->address;
+      continue;
+    }
+    local.location = allocate_slot(func, type.size, align);
+    slots.push_back(Slot{local.location, type.size, end});
+  }
+}
+
+/**
+ * @brief Decides where a function's register parameters and callee saved registers are preserved
+ * 
+ * A register parameter the function overwrites while it is still needed is spilled to the frame on entry,
+ * one that is only clobbered by calls is saved around just those calls.
+ * 
+ * @param name Name of the function
+ * @param func Function to place the saves in
+ */
+void FirstPass::assign_saves(const std::string& name, FuncInfo& func) {
+  const auto& usage = _usage[name];
+
+  for (const auto& [param, var] : func.params) {
+    if (var.location.mode != x64::Address::Mode::DIRECT) continue;
+    for (const auto& [reg, seq] : usage.writes) {
+      if (reg == var.location.reg && live_after(usage, param, seq)) {
+        func.spills[param] = allocate_slot(func, x64::Size::QWORD);
+        break;
+      }
+    }
+  }
+
+  for (const auto& site : usage.calls) {
+    auto  callee = _functions.find(site.callee);
+    auto& saved = func.callSaves[site.call];
+    for (const auto& [param, var] : func.params) {
+      if (var.location.mode != x64::Address::Mode::DIRECT || func.spills.count(param) != 0) continue;
+
+      auto reg = var.location.reg;
+      auto clobbered = callee == _functions.end() || callee->second.clobbers.at(static_cast<size_t>(reg));
+      if (clobbered && live_after(usage, param, site.seq)) saved.push_back(reg);
+    }
+  }
+
+  // _start never returns, nothing to restore
+  if (name == "main") return;
+
+  for (size_t idx = 0; idx < x64::REGISTER_COUNT; ++idx) {
+    auto reg = static_cast<x64::Register>(idx);
+    // rbp is the frame pointer and restored by leave
+    if (reg == x64::Register::RBP || !x64::is_callee_saved(reg) || !func.dirtyRegs.at(idx)) continue;
+    func.saves[reg] = allocate_slot(func, x64::Size::QWORD);
+  }
+}
+
+/**
+ * @brief Checks if a register parameter is read after a point, reads anywhere in an enclosing loop count
+ * 
+ * @param usage Usage of the function
+ * @param param Name of the parameter
+ * @param seq Point in the function
+ * @return true If the parameter is still needed after the point
+ */
+auto FirstPass::live_after(const Usage& usage, const std::string& param, size_t seq) -> bool {
+  auto uses = usage.uses.find(param);
+  if (uses == usage.uses.end()) return false;
+
+  for (auto use : uses->second) {
+    if (use > seq) return true;
+  }
+
+  for (const auto& [start, end] : usage.loops) {
+    if (seq < start || seq >= end) continue;
+    for (auto use : uses->second) {
+      if (use >= start && use < end) return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Moves the frame into the 128 bytes below rsp that signal handlers leave alone
+ * 
+ * Only for functions that call nothing and push nothing, rsp then stays where it was on entry. Slots are
+ * moved to the same place they had below the pushed rbp, so they keep their alignment
+ * 
+ * @return true If the frame fits the red zone
+ */
+auto FirstPass::FuncInfo::use_red_zone() -> bool {
+  constexpr int64_t RED_ZONE = 128;
+  if (!needs_frame() || size + x64::Size::QWORD > RED_ZONE) return false;
+
+  auto move = [](x64::Address& address) {
+    if (address.mode == x64::Address::Mode::DIRECT || address.reg != x64::Register::RBP) return;
+    address.reg = x64::Register::RSP;
+    address.disp -= x64::Size::QWORD;
+  };
+  move(stack);
+  for (auto& [decl, local] : locals) move(local.location);
+  for (auto& [name, param] : params) move(param.location);
+  for (auto& [name, spill] : spills) move(spill);
+  for (auto& [reg, save] : saves) move(save);
+  redZone = true;
+  return true;
+}
+
+/**
+ * @brief Reserves a slot in a function's frame, frames grow down from rbp
+ * 
+ * @param func Function to reserve the slot in
+ * @param size Size of the slot
+ * @param align Alignment of the slot relative to rbp
+ * @return x64::Address Address of the lowest byte of the slot
+ */
+auto FirstPass::allocate_slot(FuncInfo& func, int64_t size, int64_t align) -> x64::Address {
+  func.stack.disp = -Layout::align_to(size - func.stack.disp, align);
+  func.size = -func.stack.disp;
+  return func.stack;
 }
 }  // namespace kuso
\ No newline at end of file
@@ -20,12 +20,14 @@
 
 #include <belt/overload.hpp>
 
+#include "generator/constant_folding.hpp"
 #include "generator/context.hpp"
 #include "lexer/token.hpp"
 #include "linux/linux.hpp"
 #include "logging/logging.hpp"
 #include "parser/ast.hpp"
 #include "x64/addressing.hpp"
+#include "x64/arithmetic.hpp"
 #include "x64/x64.hpp"
 
 // TODO(rolland): add semantic errors function
@@ -40,13 +42,15 @@ void Generator::generate(const AST& ast) {
   try {
     if (!_firstpass.types_pass(ast)) return;
     if (!_firstpass.function_pass(ast)) return;
+    _stackAnalysis.analyze(ast, _firstpass);
 
     emit("global _start\nsection .text\n");
     for (const auto& statement : ast) {
       generate(statement);
     }
 
-    _outputFile.write(_output_code);
+    if (_optimize) _peephole.run(_code);
+    _outputFile.write(_code.render());
   } catch (std::exception& e) {
     Logging::error(e.what());
   }
@@ -61,6 +65,7 @@ void Generator::generate(const AST::Statement& statement) {
   belt::overloaded_visit(
       statement.statement,
       [&](const std::unique_ptr<AST::Declaration>& declaration) { generate_declaration(*declaration); },
+      [&](const std::unique_ptr<AST::Destructure>& destructure) { generate_destructure(*destructure); },
       [&](const std::unique_ptr<AST::Assignment>& assignment) { generate_assignment(*assignment); },
       [&](const std::unique_ptr<AST::Exit>& exit) { generate_exit(*exit); },
       [&](const std::unique_ptr<AST::If>& ifStatement) { generate_if(*ifStatement); },
@@ -79,8 +84,6 @@ void Generator::generate(const AST::Statement& statement) {
  * @param declaration Declaration to generate from
  */
 void Generator::generate_declaration(const AST::Declaration& declaration) {
-  auto& current = context();
-
   auto typeID = _firstpass.get_type_id(declaration.type);
   if (!typeID.has_value()) {
     throw std::runtime_error("Unknown Type " + declaration.type);
@@ -93,13 +96,24 @@ void Generator::generate_declaration(const AST::Declaration& declaration) {
   const auto& typeRef = type.value().get();
 
   const auto& func = get_check_func_info(_currentFunction.top());
-  if (declaration.value) {
-    if (typeRef.offsets) throw std::runtime_error("Cannot assign value to type with attributes");
+  const auto& local = func.locals.at(&declaration);
+  if (declaration.value && typeRef.offsets) {
+    // only a call returning the whole type can initialize it, the value comes back in rax:rdx
+    const auto* call = Evaluation::call(*declaration.value);
+    const auto* callee = call == nullptr ? nullptr : get_func(call->name);
+    if (callee == nullptr || callee->returnType != declaration.type) {
+      throw std::runtime_error("Cannot assign value to type with attributes");
+    }
+    generate_call(*call);
+    store_returned(local.location, typeRef.size);
+  } else if (declaration.value) {
     generate_expression(*declaration.value);
-    emit(x64::Op::MOV, func.locals.at(declaration.name).location, x64::Register::RAX);
+    store(x64::Register::RAX, local.location, x64::access_size(typeRef.size));
   }
 
-  current.variables[declaration.name] = Variable{typeID.value(), func.locals.at(declaration.name).location};
+  if (!_symbols.declare(declaration.name, Variable{typeID.value(), local.location})) {
+    throw std::runtime_error("Multiple Declarations of " + declaration.name);
+  }
 }
 
 /**
@@ -109,25 +123,48 @@ void Generator::generate_declaration(const AST::Declaration& declaration) {
  */
 void Generator::generate_assignment(const AST::Assignment& assignment) {
   // TODO(rolland): check if assignment is valid
-  const auto& name = get_identifier(assignment);
+  generate_expression(*assignment.value);
+  store(x64::Register::RAX, get_location(*assignment.dest), get_access_size(*assignment.dest));
+}
 
-  auto variableIter = context().variables.find(name);
-  if (variableIter == context().variables.end()) {
-    throw std::runtime_error("Unknown Variable " + name);
+/**
+ * @brief Generates x64 assembly from a destructuring declaration, the call returns its values in rax:rdx
+ * 
+ * @param destructure Destructuring declaration to generate from
+ */
+void Generator::generate_destructure(const AST::Destructure& destructure) {
+  const auto* callee = get_func(destructure.call->name);
+  if (callee != nullptr && callee->tuple.empty()) {
+    throw std::runtime_error(destructure.call->name + " does not return two values");
   }
+  generate_call(*destructure.call);
 
-  generate_expression(*assignment.value);
-  emit(x64::Op::MOV, get_location(*assignment.dest), x64::Register::RAX);
+  const auto& func = get_check_func_info(_currentFunction.top());
+  for (size_t i = 0; i < destructure.targets.size(); ++i) {
+    const auto& target = *destructure.targets.at(i);
+    auto        typeID = _firstpass.get_type_id(target.type);
+    if (!typeID.has_value()) throw std::runtime_error("Unknown Type " + target.type);
+
+    const auto& local = func.locals.at(&target);
+    auto        reg = i == 0 ? x64::Register::RAX : x64::Register::RDX;
+    store(reg, local.location, x64::access_size(get_check_type(typeID.value()).size));
+    if (!_symbols.declare(target.name, Variable{typeID.value(), local.location})) {
+      throw std::runtime_error("Multiple Declarations of " + target.name);
+    }
+  }
 }
 
 void Generator::generate_main(const AST::Main& main) {
   _currentFunction.emplace("main");
 
-  emit("_start:");
+  emit(_code.label("_start"));
   enter_context("main");
   for (const auto& statement : main.body) {
     generate(statement);
   }
+  leave_context();
+
+  _currentFunction.pop();
 }
 
 void Generator::generate_func(const AST::Func& func) {
@@ -141,7 +178,7 @@ void Generator::generate_func(const AST::Func& func) {
                                          .argCnt = func.args.size()});
 
   const auto& label = _functions.at(func.name).label;
-  emit(fmt::format("{}:", label));
+  emit(_code.label(label));
   _currentFunction.push(func.name);
   enter_context(func.name);
 
@@ -149,6 +186,12 @@ void Generator::generate_func(const AST::Func& func) {
     generate(statement);
   }
 
+  if (func.body.empty() || !std::holds_alternative<std::unique_ptr<AST::Return>>(func.body.back().statement)) {
+    emit_epilogue();
+    emit(x64::Op::RET);
+  }
+  leave_context();
+
   _currentFunction.pop();
 }
 
@@ -165,33 +208,188 @@ void Generator::generate_call(const AST::Call& call) {
     throw std::runtime_error("Invalid number of arguments for " + call.name);
   }
 
-  generate_parameters(call);
-  emit(x64::Op::CALL, func.label);
+  // registers still needed after the call that the callee clobbers
+  const auto& caller = get_check_func_info(_currentFunction.top());
+  auto        saved = caller.callSaves.find(&call);
+  if (saved != caller.callSaves.end()) {
+    for (auto reg : saved->second) push(reg);
+  }
+
+  auto pushed = generate_parameters(call);
+  emit(x64::Op::CALL, _code.label(func.label));
+  if (pushed > 0) emit(x64::Op::ADD, x64::Register::RSP, x64::Literal{pushed});
+
+  if (saved != caller.callSaves.end()) {
+    for (auto reg = saved->second.rbegin(); reg != saved->second.rend(); ++reg) pop(*reg);
+  }
 }
 
-void Generator::generate_parameters(const AST::Call& call) {
-  size_t paramIndex = 0;
-  for (const auto& arg : call.args) {
-    generate_expression(*arg);
-    auto reg = x64::parameter_reg(paramIndex);
-    if (reg == x64::Register::NONE) {
-      push(x64::Register::RAX);
-    } else {
+/**
+ * @brief Moves the arguments of a call into place
+ * 
+ * Arguments that have to be evaluated go first, in source order, so no call or division in a later one
+ * can overwrite a parameter register that is already set. Their values are pushed, only the last one
+ * goes straight into its register. Without stack arguments the pushed values are popped into their
+ * registers, otherwise the stack arguments are on top of them and they are read from below. Numbers and
+ * variables are moved into their registers last.
+ * 
+ * @param call Call to move the arguments of
+ * @return int64_t bytes left pushed for the call
+ */
+auto Generator::generate_parameters(const AST::Call& call) -> int64_t {
+  std::vector<size_t> evaluated;
+  bool                stackArgs = false;
+  for (size_t i = 0; i < call.args.size(); ++i) {
+    if (!Evaluation::direct(*call.args[i], i)) evaluated.push_back(i);
+    if (x64::parameter_reg(i) == x64::Register::NONE) stackArgs = true;
+  }
+
+  std::vector<std::pair<x64::Register, int64_t>> held;
+  int64_t                                        pushed = 0;
+  for (auto index : evaluated) {
+    generate_expression(*call.args[index]);
+    auto reg = x64::parameter_reg(index);
+    if (reg != x64::Register::NONE && index == evaluated.back()) {
       emit(x64::Op::MOV, reg, x64::Register::RAX);
+      continue;
+    }
+    push(x64::Register::RAX);
+    if (reg != x64::Register::NONE) held.emplace_back(reg, pushed);
+    pushed += x64::Size::QWORD;
+  }
+
+  for (auto value = held.rbegin(); value != held.rend(); ++value) {
+    if (stackArgs) {
+      emit(x64::Op::MOV, value->first,
+           x64::Address{x64::Address::Mode::INDIRECT_DISPLACEMENT, x64::Register::RSP,
+                        pushed - value->second - x64::Size::QWORD});
+    } else {
+      pop(value->first);
+    }
+  }
+
+  for (size_t i = 0; i < call.args.size(); ++i) {
+    if (!Evaluation::direct(*call.args[i], i)) continue;
+    if (const auto* variable = Evaluation::variable(*call.args[i])) {
+      load(x64::parameter_reg(i), get_location(*variable), get_access_size(*variable));
+    } else {
+      auto constant = ConstantFolding::constant_value(*call.args[i]).value();
+      emit(x64::Op::MOV, x64::parameter_reg(i), x64::Literal{constant});
     }
-    ++paramIndex;
   }
+  return stackArgs ? pushed : 0;
 }
 
+/**
+ * @brief Generates a call in tail position, the callee takes over the caller's frame and returns for it
+ * 
+ * Arguments can still read the caller's parameters, so they are all evaluated before the first parameter
+ * register is written. A call of the function to itself jumps back past its prologue instead.
+ * 
+ * @param call Call to generate
+ */
+void Generator::generate_tail_call(const AST::Call& call) {
+  auto funcIter = _functions.find(call.name);
+  if (funcIter == _functions.end()) {
+    throw std::runtime_error("Unknown Function " + call.name);
+  }
+  const auto& func = funcIter->second;
+
+  if (call.args.size() != func.argCnt) {
+    throw std::runtime_error("Invalid number of arguments for " + call.name);
+  }
+
+  for (size_t i = 0; i < call.args.size(); ++i) {
+    generate_expression(*call.args[i]);
+    if (i + 1 < call.args.size()) push(x64::Register::RAX);
+  }
+  for (auto i = call.args.size(); i-- > 0;) {
+    if (i + 1 < call.args.size()) {
+      pop(x64::parameter_reg(i));
+    } else {
+      emit(x64::Op::MOV, x64::parameter_reg(i), x64::Register::RAX);
+    }
+  }
+
+  if (call.name == _currentFunction.top()) {
+    emit(x64::Op::JMP, context().loop.value());
+    return;
+  }
+  emit_epilogue();
+  emit(x64::Op::JMP, _code.label(func.label));
+}
+
+/**
+ * @brief Generates x64 assembly from a return statement
+ * 
+ * the context stays open, statements after a nested return are still part of the function
+ * 
+ * @param ret Return to generate from
+ */
 void Generator::generate_return(const AST::Return& ret) {
-  if (ret.value) {
+  const auto* func = get_func(_currentFunction.top());
+  auto        returned = func == nullptr ? std::nullopt : _firstpass.get_type(func->returnType);
+  auto        tuple = func != nullptr && !func->tuple.empty();
+  auto        pair = aggregate(func);
+
+  // a call returning the same values leaves them in rax:rdx already
+  const auto* forwarded = ret.value && !ret.second && pair ? Evaluation::call(*ret.value) : nullptr;
+  const auto* callee = forwarded == nullptr ? nullptr : get_func(forwarded->name);
+  if (callee == nullptr || callee->returnType != func->returnType) forwarded = nullptr;
+
+  if (ret.second ? !tuple : tuple && forwarded == nullptr) {
+    throw std::runtime_error("Invalid number of return values in " + _currentFunction.top());
+  }
+
+  const auto* call = Evaluation::tail_call(ret);
+  if (call && forwarded == nullptr && aggregate(get_func(call->name))) {
+    throw std::runtime_error("The values returned by " + call->name + " can only be declared");
+  }
+  if (call && get_check_func_info(_currentFunction.top()).tailCalls.contains(call)) {
+    generate_tail_call(*call);
+    return;
+  }
+
+  if (forwarded) {
+    generate_call(*forwarded);
+  } else if (ret.second) {
+    generate_expression(*ret.value);
+    push(x64::Register::RAX);
+    generate_expression(*ret.second);
+    emit(x64::Op::MOV, x64::Register::RDX, x64::Register::RAX);
+    pop(x64::Register::RAX);
+  } else if (ret.value && pair) {
+    generate_returned(*ret.value, *func, returned.value().get());
+  } else if (ret.value) {
     generate_expression(*ret.value);
   }
 
-  leave_context();
+  emit_epilogue();
   emit(x64::Op::RET);
 }
 
+/**
+ * @brief Loads a local of a type with attributes into rax:rdx to return it
+ * 
+ * @param value Value returned
+ * @param func Function returning it
+ * @param type Type returned
+ */
+void Generator::generate_returned(const AST::Expression& value, const AST::Func& func, const Type& type) {
+  const auto* variable = Evaluation::variable(value);
+  auto        found = _symbols.find(variable == nullptr ? "" : variable->name);
+  auto        typeID = _firstpass.get_type_id(func.returnType);
+  if (!found || variable->attribute || found.value().get().type.id != typeID.value().id ||
+      found.value().get().location.mode == x64::Address::Mode::DIRECT) {
+    throw std::runtime_error(func.name + " has to return a local of type " + func.returnType);
+  }
+
+  // the bytes past a smaller type are never stored by the caller
+  auto location = found.value().get().location;
+  load(x64::Register::RAX, location, x64::Size::QWORD);
+  if (type.size > x64::Size::QWORD) load(x64::Register::RDX, location + x64::Size::QWORD, x64::Size::QWORD);
+}
+
 /**
  * @brief Generates x64 assembly from an expression
  * 
@@ -202,25 +400,70 @@ void Generator::generate_expression(const AST::Expression& expression) {
   if (!_exprInReg) pop(x64::Register::RAX);
 }
 
+/**
+ * @brief Evaluates both operands of a binary expression in Sethi-Ullman order
+ * 
+ * The operand evaluated first is held in a scratch register, or pushed and popped into the fallback
+ * register once the pool is used up
+ * 
+ * @param left Left operand
+ * @param right Right operand
+ * @param reorderable Whether the operation can take its left operand second
+ * @param fallback Register the first operand is popped into when it had to be pushed
+ * @return Operands Register holding the first operand and which one it was
+ */
+template <typename Left, typename Right>
+auto Generator::generate_operands(const Left& left, const Right& right, bool reorderable,
+                                  x64::Register fallback) -> Operands {
+  auto leftLabel = _evaluation.label(left);
+  auto rightLabel = _evaluation.label(right);
+  auto leftFirst = Evaluation::left_first(leftLabel, rightLabel, reorderable);
+
+  if (leftFirst) {
+    generate_expression(left);
+  } else {
+    generate_expression(right);
+  }
+  if (!_exprInReg) pop(x64::Register::RAX);
+
+  auto held = _evaluation.acquire(leftFirst ? rightLabel.calls : leftLabel.calls);
+  if (held == x64::Register::NONE) {
+    push(x64::Register::RAX);
+  } else {
+    emit(x64::Op::MOV, held, x64::Register::RAX);
+  }
+
+  if (leftFirst) {
+    generate_expression(right);
+  } else {
+    generate_expression(left);
+  }
+  if (!_exprInReg) pop(x64::Register::RAX);
+
+  if (held == x64::Register::NONE) {
+    pop(fallback);
+    held = fallback;
+  } else {
+    _evaluation.release(held);
+  }
+  return Operands{held, leftFirst};
+}
+
 /**
  * @brief Generates x64 assembly from an equality expression
  * 
  * @param equality Equality to generate from
  */
 void Generator::generate_expression(const AST::Equality& equality) {
-  if (equality.right) {
-    generate_expression(*equality.right);
-    if (_exprInReg) push(x64::Register::RAX);
+  if (!equality.right) {
+    generate_expression(*equality.left);
+    return;
   }
-  generate_expression(*equality.left);
 
-  if (equality.right) {
-    if (!_exprInReg) pop(x64::Register::RAX);
-    pop(x64::Register::RDX);
-    emit(x64::Op::CMP, x64::Register::RAX, x64::Register::RDX);
-    pull_comparison_result(equality.equal ? AST::BinaryOp::EQ : AST::BinaryOp::NEQ);
-    _exprInReg = true;
-  }
+  auto operands = generate_operands(*equality.left, *equality.right, true, x64::Register::RDX);
+  emit(x64::Op::CMP, x64::Register::RAX, operands.held);
+  pull_comparison_result(equality.equal ? AST::BinaryOp::EQ : AST::BinaryOp::NEQ);
+  _exprInReg = true;
 }
 
 /**
@@ -229,19 +472,19 @@ void Generator::generate_expression(const AST::Equality& equality) {
  * @param comparison Comparison to generate from
  */
 void Generator::generate_expression(const AST::Comparison& comparison) {
-  if (comparison.right) {
-    generate_expression(*comparison.right);
-    if (_exprInReg) push(x64::Register::RAX);
+  if (!comparison.right) {
+    generate_expression(*comparison.left);
+    return;
   }
-  generate_expression(*comparison.left);
 
-  if (comparison.right) {
-    if (!_exprInReg) pop(x64::Register::RAX);
-    pop(x64::Register::RDX);
-    emit(x64::Op::CMP, x64::Register::RAX, x64::Register::RDX);
-    pull_comparison_result(comparison.op);
-    _exprInReg = true;
+  auto operands = generate_operands(*comparison.left, *comparison.right, true, x64::Register::RDX);
+  if (operands.leftFirst) {
+    emit(x64::Op::CMP, operands.held, x64::Register::RAX);
+  } else {
+    emit(x64::Op::CMP, x64::Register::RAX, operands.held);
   }
+  pull_comparison_result(comparison.op);
+  _exprInReg = true;
 }
 
 /**
@@ -250,47 +493,95 @@ void Generator::generate_expression(const AST::Comparison& comparison) {
  * @param term Term to generate from
  */
 void Generator::generate_expression(const AST::Term& term) {
-  if (term.right) {
-    generate_expression(*term.right);
-    if (_exprInReg) push(x64::Register::RAX);
+  if (!term.right) {
+    generate_expression(*term.left);
+    return;
   }
-  generate_expression(*term.left);
 
-  if (term.right) {
-    if (!_exprInReg) pop(x64::Register::RAX);
-    pop(x64::Register::RDX);
-    if (term.op == AST::BinaryOp::ADD)
-      emit(x64::Op::ADD, x64::Register::RAX, x64::Register::RDX);
-    else if (term.op == AST::BinaryOp::SUB)
-      emit(x64::Op::SUB, x64::Register::RAX, x64::Register::RDX);
-    _exprInReg = true;
+  auto operands = generate_operands(*term.left, *term.right, true, x64::Register::RDX);
+  if (term.op == AST::BinaryOp::ADD) {
+    emit(x64::Op::ADD, x64::Register::RAX, operands.held);
+  } else if (term.op == AST::BinaryOp::SUB && operands.leftFirst) {
+    emit(x64::Op::SUB, operands.held, x64::Register::RAX);
+    emit(x64::Op::MOV, x64::Register::RAX, operands.held);
+  } else if (term.op == AST::BinaryOp::SUB) {
+    emit(x64::Op::SUB, x64::Register::RAX, operands.held);
   }
+  _exprInReg = true;
 }
 
 /**
- * @brief Generates x64 assembly from a factor expression
+ * @brief Generates x64 assembly from a factor expression, the dividend and the base have to be in rax so
+ * division, modulo and powers always evaluate their right side first
  * 
  * @param factor Factor to generate from
  */
 void Generator::generate_expression(const AST::Factor& factor) {
-  if (factor.right) {
-    generate_expression(*factor.right);
-    if (_exprInReg) push(x64::Register::RAX);
+  if (!factor.right) {
+    generate_expression(*factor.left);
+    return;
+  }
+  if (auto reduction = Evaluation::strength_reduced(factor)) {
+    generate_reduced(factor, reduction.value());
+    return;
   }
-  generate_expression(*factor.left);
 
-  if (factor.right) {
-    if (!_exprInReg) pop(x64::Register::RAX);
-    if (factor.op == AST::BinaryOp::MUL) {
-      pop(x64::Register::RDX);
-      emit(x64::Op::IMUL, x64::Register::RAX, x64::Register::RDX);
-    } else if (factor.op == AST::BinaryOp::DIV) {
-      emit(x64::Op::XOR, x64::Register::RDX, x64::Register::RDX);
-      pop(x64::Register::RCX);
-      emit(x64::Op::IDIV, x64::Register::RCX);
+  auto multiply = factor.op == AST::BinaryOp::MUL;
+  auto fallback = multiply ? x64::Register::RDX : x64::Register::RCX;
+  auto operands = generate_operands(*factor.left, *factor.right, multiply, fallback);
+  switch (factor.op) {
+    case AST::BinaryOp::MUL:
+      emit(x64::Op::IMUL, x64::Register::RAX, operands.held);
+      break;
+    case AST::BinaryOp::DIV:
+    case AST::BinaryOp::MOD:
+      emit(x64::Op::CQO);
+      emit(x64::Op::IDIV, operands.held);
+      if (factor.op == AST::BinaryOp::MOD) emit(x64::Op::MOV, x64::Register::RAX, x64::Register::RDX);
+      break;
+    case AST::BinaryOp::POW: {
+      auto loop = new_label();
+      auto skip = new_label();
+      auto done = new_label();
+      x64::power(_code, operands.held, x64::Register::RDX, loop, skip, done);
+      break;
     }
-    _exprInReg = true;
+    default:
+      break;
+  }
+  _exprInReg = true;
+}
+
+/**
+ * @brief Generates x64 assembly from a factor with a constant operand, only the other operand is
+ * evaluated and the constant becomes shifts, lea, a magic multiply or a chain of squares
+ * 
+ * @param factor Factor to generate from
+ * @param reduction Constant operand of the factor
+ */
+void Generator::generate_reduced(const AST::Factor& factor, const Evaluation::Reduction& reduction) {
+  if (reduction.constantLeft) {
+    generate_expression(*factor.right);
+  } else {
+    generate_expression(*factor.left);
+  }
+  if (!_exprInReg) pop(x64::Register::RAX);
+
+  switch (factor.op) {
+    case AST::BinaryOp::MUL:
+      x64::multiply(_code, x64::Register::RAX, reduction.constant);
+      break;
+    case AST::BinaryOp::DIV:
+    case AST::BinaryOp::MOD:
+      x64::divide(_code, reduction.constant, factor.op == AST::BinaryOp::MOD, x64::Register::RCX);
+      break;
+    case AST::BinaryOp::POW:
+      x64::power(_code, reduction.constant, x64::Register::RDX);
+      break;
+    default:
+      break;
   }
+  _exprInReg = true;
 }
 
 /**
@@ -317,7 +608,12 @@ void Generator::generate_expression(const AST::Unary& unary) {
 void Generator::generate_expression(const AST::Primary& primary) {
   belt::overloaded_visit(
       primary.value, [&](const std::unique_ptr<AST::Terminal>& terminal) { generate_expression(*terminal); },
-      [&](const std::unique_ptr<AST::Call>& call) { generate_call(*call); },
+      [&](const std::unique_ptr<AST::Call>& call) {
+        if (aggregate(get_func(call->name))) {
+          throw std::runtime_error("The values returned by " + call->name + " can only be declared");
+        }
+        generate_call(*call);
+      },
       [&](const std::unique_ptr<AST::Expression>& expression) { generate_expression(*expression); },
       [&](const std::unique_ptr<AST::String>& string) { generate_string(*string); },
       [&](const std::unique_ptr<AST::Variable>& variable) { generate_expression(*variable); });
@@ -341,13 +637,7 @@ void Generator::generate_expression(const AST::Terminal& terminal) {
  * @param variable Variable to generate from
  */
 void Generator::generate_expression(const AST::Variable& variable) {
-  auto& current = context();
-
-  auto variableIter = current.variables.find(variable.name);
-  if (variableIter == current.variables.end()) {
-    throw std::runtime_error("Unknown Variable " + variable.name);
-  }
-  emit(x64::Op::MOV, x64::Register::RAX, variableIter->second.location);
+  load(x64::Register::RAX, get_location(variable), get_access_size(variable));
   _exprInReg = true;
 }
 
@@ -358,7 +648,7 @@ void Generator::generate_expression(const AST::Variable& variable) {
  */
 void Generator::generate_expression(const Token& token) {
   if (token.type == Token::Type::NUMBER) {
-    emit(x64::Op::MOV, x64::Register::RAX, x64::Literal{std::stoi(token.value)});
+    emit(x64::Op::MOV, x64::Register::RAX, x64::Literal{std::stoll(token.value)});
     _exprInReg = true;
   } else {
     throw std::runtime_error("Invalid Terminal");
@@ -390,40 +680,26 @@ void Generator::generate_exit(const AST::Exit& exit) {
 void Generator::generate_string(const AST::String&) { throw std::runtime_error("Strings Not Implemented"); }
 
 /**
- * @brief Generates x64 assembly from an if statement
+ * @brief Generates x64 assembly from an if statement, both sides are generated even when the condition is
+ * constant, dropping the side that never runs is left to the fold pass
  * 
  * @param ifNode If to generate from
  */
 auto Generator::generate_if(const AST::If& ifNode) -> void {
-  generate_expression(*ifNode.condition);
-  emit(x64::Op::CMP, x64::Register::RAX, x64::Literal{0});
-
   auto elseLabel = new_label();
   auto endLabel = new_label();
 
-  if (!ifNode.elseBody.empty()) {
-    emit(x64::Op::JE, elseLabel);
-  } else {
-    emit(x64::Op::JE, endLabel);
-  }
+  generate_condition(*ifNode.condition, ifNode.elseBody.empty() ? endLabel : elseLabel, false);
 
-  // enter_context();
-  for (const auto& statement : ifNode.body) {
-    generate(statement);
-  }
-  // leave_context();
+  generate_block(ifNode.body);
 
   if (!ifNode.elseBody.empty()) {
     emit(x64::Op::JMP, endLabel);
-    emit(fmt::format("{}:", elseLabel));
-    // enter_context();
-    for (const auto& statement : ifNode.elseBody) {
-      generate(statement);
-    }
-    // leave_context();
+    emit(elseLabel);
+    generate_block(ifNode.elseBody);
   }
 
-  emit(fmt::format("{}:", endLabel));
+  emit(endLabel);
 }
 
 /**
@@ -432,22 +708,62 @@ auto Generator::generate_if(const AST::If& ifNode) -> void {
  * @param whileStatement While to generate from
  */
 void Generator::generate_while(const AST::While& whileStatement) {
-  auto startLabel = new_label();
-  auto endLabel = new_label();
+  auto constant = ConstantFolding::constant_value(*whileStatement.condition);
+  auto forever = constant && constant.value() != 0;
 
-  emit(fmt::format("{}:", startLabel));
-  generate_expression(*whileStatement.condition);
-  emit(x64::Op::CMP, x64::Register::RAX, x64::Literal{0});
-  emit(x64::Op::JE, endLabel);
+  auto bodyLabel = new_label();
+  auto conditionLabel = new_label();
 
-  // enter_context();
-  for (const auto& statement : whileStatement.body) {
-    generate(statement);
+  // rotated, the condition is tested at the bottom and the loop is entered through a jump to it
+  if (!forever) emit(x64::Op::JMP, conditionLabel);
+  emit(bodyLabel);
+
+  generate_block(whileStatement.body);
+
+  emit(conditionLabel);
+  generate_condition(*whileStatement.condition, bodyLabel, true);
+}
+
+/**
+ * @brief Generates a condition that jumps to a label when it is false, or when it is true
+ * 
+ * Comparisons jump straight on the flags of their cmp, anything else is tested against zero. Constant
+ * conditions either jump unconditionally or not at all
+ * 
+ * @param condition Condition to generate
+ * @param target Label to jump to
+ * @param when Value of the condition the jump is taken on
+ */
+void Generator::generate_condition(const AST::Expression& condition, x64::LabelId target, bool when) {
+  auto constant = ConstantFolding::constant_value(condition);
+  if (constant) {
+    if ((constant.value() != 0) == when) emit(x64::Op::JMP, target);
+    return;
+  }
+
+  const auto& equality = *condition.value;
+  if (equality.right) {
+    auto operands = generate_operands(*equality.left, *equality.right, true, x64::Register::RDX);
+    emit(x64::Op::CMP, x64::Register::RAX, operands.held);
+    emit(equality.equal == when ? x64::Op::JE : x64::Op::JNE, target);
+    return;
   }
-  // leave_context();
 
-  emit(x64::Op::JMP, startLabel);
-  emit(fmt::format("{}:", endLabel));
+  const auto& comparison = *equality.left;
+  if (comparison.right) {
+    auto operands = generate_operands(*comparison.left, *comparison.right, true, x64::Register::RDX);
+    if (operands.leftFirst) {
+      emit(x64::Op::CMP, operands.held, x64::Register::RAX);
+    } else {
+      emit(x64::Op::CMP, x64::Register::RAX, operands.held);
+    }
+    emit(when ? jump(comparison.op) : inverted_jump(comparison.op), target);
+    return;
+  }
+
+  generate_expression(condition);
+  emit(x64::Op::CMP, x64::Register::RAX, x64::Literal{0});
+  emit(when ? x64::Op::JNE : x64::Op::JE, target);
 }
 
 // %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
@@ -482,130 +798,153 @@ auto Generator::get_check_func_info(const std::string& funcname) -> const FirstP
 }
 
 /**
- * @brief Creates a new context
+ * @brief Gets the definition of a function generated so far
  * 
+ * @param funcname Name of the function
+ * @return const AST::Func* the function, nullptr for main and unknown functions
  */
-void Generator::enter_context(int64_t size) {
-  auto& current = context();
-  current = _contexts.emplace(Context{.size = 0,
-                                      .stack = current.stack,
-                                      .variables = current.variables,
-                                      .currVariable = current.currVariable});
+auto Generator::get_func(const std::string& funcname) const -> const AST::Func* {
+  auto found = _functions.find(funcname);
+  return found == _functions.end() ? nullptr : &found->second.body.get();
+}
 
-  for (int64_t i = 0; i < size / x64::Size::QWORD; ++i) {
-    push(x64::Literal{0});
-  }
+/**
+ * @brief Checks if a function returns two values or a type with attributes, which can only be declared
+ * 
+ * @param func Function to check, nullptr for main and unknown functions
+ */
+auto Generator::aggregate(const AST::Func* func) -> bool {
+  if (func == nullptr) return false;
+  auto returned = _firstpass.get_type(func->returnType);
+  return !func->tuple.empty() || (returned && returned.value().get().offsets);
 }
 
+/**
+ * @brief Creates the context of a function, opening its outermost scope and emitting its prologue
+ * 
+ * Every local has a constant rbp relative slot, so the whole frame is reserved at once
+ * 
+ * @param funcname Function to create the context of
+ */
 void Generator::enter_context(const std::string& funcname) {
   const auto& func = get_check_func_info(funcname);
-  auto&       current = _contexts.emplace(
-            Context{.size = 0,
-                    .stack = x64::Address{x64::Address::Mode::INDIRECT_DISPLACEMENT, x64::Register::RSP, 0},
-                    .variables = {},
-                    .currVariable = 0});
-
-  for (const auto& arg : func.params) {
-    if (arg.second.location.reg != x64::Register::RSP) {
-      if (func.dirtyRegs.at(static_cast<size_t>(arg.second.location.reg))) {
-        push(arg.second.location.reg);
-        current.variables[arg.first] = arg.second;
-        current.variables[arg.first].location = current.stack;
-      } else {
-        current.variables[arg.first].location = arg.second.location;
-      }
+
+  auto& current = _contexts.emplace(Context{.size = func.frame_size(),
+                                            .stack = func.stack,
+                                            .currVariable = 0,
+                                            .frame = func.needs_frame(),
+                                            .loop = std::nullopt});
+  _symbols.enter_scope();
+
+  if (current.frame) {
+    emit(x64::Op::PUSH, x64::Size::QWORD, x64::Register::RBP);
+    emit(x64::Op::MOV, x64::Register::RBP, x64::Register::RSP);
+    if (current.size > 0) emit(x64::Op::SUB, x64::Register::RSP, x64::Literal{current.size});
+  }
+
+  for (const auto& [reg, slot] : func.saves) {
+    emit(x64::Op::MOV, slot, reg);
+  }
+
+  // parameters are spilled again on every iteration
+  if (func.tailRecursive) {
+    current.loop = new_label();
+    emit(current.loop.value());
+  }
+
+  for (const auto& [name, param] : func.params) {
+    auto spill = func.spills.find(name);
+    if (spill != func.spills.end()) {
+      emit(x64::Op::MOV, spill->second, param.location.reg);
+      _symbols.declare(name, Variable{param.type, spill->second});
+    } else {
+      _symbols.declare(name, param);
     }
   }
+}
 
-  for (const auto& arg : func.locals) {
-    push(x64::Literal{0});
-    current.variables[arg.first] = arg.second;
-    current.variables[arg.first].location = current.stack;
+/**
+ * @brief Emits the epilogue of the current function, leaving the stack as it was on entry
+ * 
+ */
+void Generator::emit_epilogue() {
+  const auto& func = get_check_func_info(_currentFunction.top());
+  for (const auto& [reg, slot] : func.saves) {
+    emit(x64::Op::MOV, reg, slot);
   }
+  if (context().frame) emit(x64::Op::LEAVE);
 }
 
 /**
- * @brief Removes the current context
+ * @brief Removes the current context, along with every scope opened in it
  * 
  */
 void Generator::leave_context() {
-  std::for_each(context().variables.begin(), context().variables.end(), [&](const auto& var) {
-    if (var.second.location.reg == x64::Register::RSP) {
-      pop(x64::Register::RDI);
-    }
-  });
+  _symbols.leave_scope();
   _contexts.pop();
 }
 
 /**
- * @brief Generates a push instruction from an address
+ * @brief Generates a block of statements in its own scope
  * 
- * @param addr Address to push from
+ * @param body Statements to generate
  */
-void Generator::push(x64::Address addr) {
-  auto& current = context();
-  emit(x64::Op::PUSH, x64::Size::QWORD, addr);
-  current.stack.disp += x64::Size::QWORD;
-  current.size += x64::Size::QWORD;
-  for (auto& variable : current.variables) {
-    variable.second.location.disp += x64::Size::QWORD;
+void Generator::generate_block(const std::vector<AST::Statement>& body) {
+  _symbols.enter_scope();
+  for (const auto& statement : body) {
+    generate(statement);
   }
+  _symbols.leave_scope();
 }
 
+/**
+ * @brief Generates a push instruction from an address
+ * 
+ * @param addr Address to push from
+ */
+void Generator::push(x64::Address addr) { emit(x64::Op::PUSH, x64::Size::QWORD, addr); }
+
 /**
  * @brief Generates a push instruction from a literal
  * 
  * @param lit Literal to push
  */
-void Generator::push(x64::Literal lit) {
-  auto& current = context();
-  emit(x64::Op::PUSH, x64::Size::QWORD, lit);
-  for (auto& variable : current.variables) {
-    variable.second.location.disp += x64::Size::QWORD;
-  }
-}
+void Generator::push(x64::Literal lit) { emit(x64::Op::PUSH, x64::Size::QWORD, lit); }
 
 /**
  * @brief Generates a push instruction from a register
  * 
  * @param reg Register to push from
  */
-void Generator::push(x64::Register reg) {
-  auto& current = context();
-  emit(x64::Op::PUSH, x64::Size::QWORD, reg);
-  for (auto& variable : current.variables) {
-    variable.second.location.disp += x64::Size::QWORD;
-  }
-}
+void Generator::push(x64::Register reg) { emit(x64::Op::PUSH, x64::Size::QWORD, reg); }
 
 /**
  * @brief Generates a pop instruction from an address
  * 
  * @param addr Address to pop to
  */
-void Generator::pop(x64::Register reg) {
-  auto& current = context();
-  emit(x64::Op::POP, x64::Size::QWORD, reg);
-  for (auto& variable : current.variables) {
-    variable.second.location.disp -= x64::Size::QWORD;
-  }
-}
+void Generator::pop(x64::Register reg) { emit(x64::Op::POP, x64::Size::QWORD, reg); }
+
+/**
+ * @brief Appends text to the output code as is
+ * 
+ * @param value Text to append
+ */
+void Generator::emit(const std::string& value) { _code.text(value); }
 
 /**
- * @brief Appends a string to the output code
+ * @brief Defines a label at the current position
  * 
- * @param value String to append
+ * @param label Label to define
  */
-void Generator::emit(const std::string& value) { _output_code.append(fmt::format("{}\n", value)); }
+void Generator::emit(x64::LabelId label) { _code.define(label); }
 
 /**
  * @brief Generates an x64 instruction
  * 
  * @param operation Operation to generate
  */
-void Generator::emit(x64::Op operation) {
-  _output_code.append(fmt::format("{}\n", x64::to_string(operation)));
-}
+void Generator::emit(x64::Op operation) { _code.emit(operation); }
 
 /**
  * @brief Generates an x64 instruction
@@ -614,18 +953,17 @@ void Generator::emit(x64::Op operation) {
  * @param dest Destination of the operation
  */
 void Generator::emit(x64::Op operation, x64::Register src) {
-  _output_code.append(fmt::format("{} {}\n", x64::to_string(operation), x64::to_string(src)));
+  _code.emit(operation, x64::Operand::from(src));
 }
 
 /**
- * @brief Generates an x64 instruction
+ * @brief Generates a jump or call to a label
  * 
  * @param operation Operation to generate
- * @param dest Destination of the operation
- * @param src Source of the operation
+ * @param label Target of the operation
  */
-void Generator::emit(x64::Op operation, const std::string& value) {
-  _output_code.append(fmt::format("{} {}\n", x64::to_string(operation), value));
+void Generator::emit(x64::Op operation, x64::LabelId label) {
+  _code.emit(operation, x64::Operand::label(label));
 }
 
 /**
@@ -636,8 +974,7 @@ void Generator::emit(x64::Op operation, const std::string& value) {
  * @param src Source of the operation
  */
 void Generator::emit(x64::Op operation, x64::Address dest, x64::Address src) {
-  _output_code.append(
-      fmt::format("{} {}, {}\n", x64::to_string(operation), dest.to_string(), src.to_string()));
+  _code.emit(operation, x64::Operand::from(dest), x64::Operand::from(src));
 }
 
 /**
@@ -648,7 +985,7 @@ void Generator::emit(x64::Op operation, x64::Address dest, x64::Address src) {
  * @param src Source of the operation
  */
 void Generator::emit(x64::Op operation, x64::Address addr) {
-  _output_code.append(fmt::format("{} {}\n", x64::to_string(operation), addr.to_string()));
+  _code.emit(operation, x64::Operand::from(addr));
 }
 
 /**
@@ -659,20 +996,19 @@ void Generator::emit(x64::Op operation, x64::Address addr) {
  * @param src Source of the operation
  */
 void Generator::emit(x64::Op operation, x64::Register dest, x64::Address src) {
-  _output_code.append(
-      fmt::format("{} {}, {}\n", x64::to_string(operation), x64::to_string(dest), src.to_string()));
+  _code.emit(operation, x64::Operand::from(dest), x64::Operand::from(src));
 }
 
 /**
- * @brief Generates an x64 instruction
+ * @brief Emits an operation with a register destination and a sized memory source
  * 
- * @param operation Operation to generate
- * @param dest Destination of the operation
- * @param src Source of the operation
+ * @param operation Operation to emit
+ * @param dest Destination register
+ * @param size Size of the source
+ * @param src Source address
  */
-void Generator::emit(x64::Op operation, x64::Address dest, x64::Register src) {
-  _output_code.append(
-      fmt::format("{} {}, {}\n", x64::to_string(operation), dest.to_string(), x64::to_string(src)));
+void Generator::emit(x64::Op operation, x64::Register dest, x64::Size size, x64::Address src) {
+  _code.emit(operation, x64::Operand::from(dest), x64::Operand::from(src).with_size(size));
 }
 
 /**
@@ -682,9 +1018,8 @@ void Generator::emit(x64::Op operation, x64::Address dest, x64::Register src) {
  * @param dest Destination of the operation
  * @param src Source of the operation
  */
-void Generator::emit(x64::Op operation, x64::Address dest, x64::Literal value) {
-  _output_code.append(
-      fmt::format("{} {}, {}\n", x64::to_string(operation), dest.to_string(), value.to_string()));
+void Generator::emit(x64::Op operation, x64::Address dest, x64::Register src) {
+  _code.emit(operation, x64::Operand::from(dest), x64::Operand::from(src));
 }
 
 /**
@@ -694,9 +1029,8 @@ void Generator::emit(x64::Op operation, x64::Address dest, x64::Literal value) {
  * @param dest Destination of the operation
  * @param src Source of the operation
  */
-void Generator::emit(x64::Op operation, x64::Register dest, x64::Literal value) {
-  _output_code.append(
-      fmt::format("{} {}, {}\n", x64::to_string(operation), x64::to_string(dest), value.to_string()));
+void Generator::emit(x64::Op operation, x64::Address dest, x64::Literal value) {
+  _code.emit(operation, x64::Operand::from(dest), x64::Operand::from(value));
 }
 
 /**
@@ -706,9 +1040,8 @@ void Generator::emit(x64::Op operation, x64::Register dest, x64::Literal value)
  * @param dest Destination of the operation
  * @param src Source of the operation
  */
-void Generator::emit(x64::Op operation, x64::Register dest, x64::Register src) {
-  _output_code.append(
-      fmt::format("{} {}, {}\n", x64::to_string(operation), x64::to_string(dest), x64::to_string(src)));
+void Generator::emit(x64::Op operation, x64::Register dest, x64::Literal value) {
+  _code.emit(operation, x64::Operand::from(dest), x64::Operand::from(value));
 }
 
 /**
@@ -718,8 +1051,8 @@ void Generator::emit(x64::Op operation, x64::Register dest, x64::Register src) {
  * @param dest Destination of the operation
  * @param src Source of the operation
  */
-void Generator::emit(x64::Op operation, x64::Register dest, const std::string& value) {
-  _output_code.append(fmt::format("{} {}, {}\n", x64::to_string(operation), x64::to_string(dest), value));
+void Generator::emit(x64::Op operation, x64::Register dest, x64::Register src) {
+  _code.emit(operation, x64::Operand::from(dest), x64::Operand::from(src));
 }
 
 /**
@@ -729,12 +1062,11 @@ void Generator::emit(x64::Op operation, x64::Register dest, const std::string& v
  * @param value Value of the operation
  */
 void Generator::emit(x64::Op operation, x64::Literal value) {
-  _output_code.append(fmt::format("{} {}\n", x64::to_string(operation), value.to_string()));
+  _code.emit(operation, x64::Operand::from(value));
 }
 
 void Generator::emit(x64::Op operation, x64::Literal value1, x64::Literal value2) {
-  _output_code.append(
-      fmt::format("{} {}, {}\n", x64::to_string(operation), value1.to_string(), value2.to_string()));
+  _code.emit(operation, x64::Operand::from(value1), x64::Operand::from(value2));
 }
 
 /**
@@ -744,8 +1076,7 @@ void Generator::emit(x64::Op operation, x64::Literal value1, x64::Literal value2
  * @param value Value of the operation
  */
 void Generator::emit(x64::Op operation, x64::Size size, x64::Register reg) {
-  _output_code.append(
-      fmt::format("{} {} {}\n", x64::to_string(operation), x64::to_string(size), x64::to_string(reg)));
+  _code.emit(operation, x64::Operand::from(reg).with_size(size));
 }
 
 /**
@@ -755,8 +1086,7 @@ void Generator::emit(x64::Op operation, x64::Size size, x64::Register reg) {
  * @param value Value of the operation
  */
 void Generator::emit(x64::Op operation, x64::Size size, x64::Address addr) {
-  _output_code.append(
-      fmt::format("{} {} {}\n", x64::to_string(operation), x64::to_string(size), addr.to_string()));
+  _code.emit(operation, x64::Operand::from(addr).with_size(size));
 }
 
 /**
@@ -766,12 +1096,11 @@ void Generator::emit(x64::Op operation, x64::Size size, x64::Address addr) {
  * @param value Value of the operation
  */
 void Generator::emit(x64::Op operation, x64::Size size, x64::Literal lit) {
-  _output_code.append(
-      fmt::format("{} {} {}\n", x64::to_string(operation), x64::to_string(size), lit.to_string()));
+  _code.emit(operation, x64::Operand::from(lit).with_size(size));
 }
 
-auto Generator::new_label() -> std::string {
-  auto label = fmt::format("label_{}", _label_count);
+auto Generator::new_label() -> x64::LabelId {
+  auto label = _code.label(fmt::format("label_{}", _label_count));
   ++_label_count;
   return label;
 }
@@ -807,8 +1136,117 @@ void Generator::pull_comparison_result(AST::BinaryOp operation) {
   emit(x64::Op::MOVZX, x64::Register::RAX, x64::Register::AL);
 }
 
-Generator::Generator(const std::filesystem::path& outputpath)
-    : _outputFile(outputpath, std::ios_base::out | std::ios_base::trunc) {
+/**
+ * @brief Gets the jump taken when a comparison is true
+ * 
+ * @param operation Comparison operation
+ * @return x64::Op Conditional jump on the condition
+ */
+auto Generator::jump(AST::BinaryOp operation) -> x64::Op {
+  switch (operation) {
+    case AST::BinaryOp::EQ:
+      return x64::Op::JE;
+    case AST::BinaryOp::NEQ:
+      return x64::Op::JNE;
+    case AST::BinaryOp::LT:
+      return x64::Op::JL;
+    case AST::BinaryOp::LTE:
+      return x64::Op::JLE;
+    case AST::BinaryOp::GT:
+      return x64::Op::JG;
+    case AST::BinaryOp::GTE:
+      return x64::Op::JGE;
+    default:
+      break;
+  }
+  throw std::runtime_error("Invalid Comparison Operation");
+}
+
+/**
+ * @brief Gets the jump taken when a comparison is false
+ * 
+ * @param operation Comparison operation
+ * @return x64::Op Conditional jump on the inverted condition
+ */
+auto Generator::inverted_jump(AST::BinaryOp operation) -> x64::Op {
+  switch (operation) {
+    case AST::BinaryOp::EQ:
+      return x64::Op::JNE;
+    case AST::BinaryOp::NEQ:
+      return x64::Op::JE;
+    case AST::BinaryOp::LT:
+      return x64::Op::JGE;
+    case AST::BinaryOp::LTE:
+      return x64::Op::JG;
+    case AST::BinaryOp::GT:
+      return x64::Op::JLE;
+    case AST::BinaryOp::GTE:
+      return x64::Op::JL;
+    default:
+      break;
+  }
+  throw std::runtime_error("Invalid Comparison Operation");
+}
+
+/**
+ * @brief Loads a value into a register, values smaller than a QWORD are sign extended
+ * 
+ * @param dest Register to load into
+ * @param location Location of the value
+ * @param size Size of the value
+ */
+void Generator::load(x64::Register dest, x64::Address location, x64::Size size) {
+  // registers always hold sign extended values
+  if (location.mode == x64::Address::Mode::DIRECT || size == x64::Size::QWORD) {
+    emit(x64::Op::MOV, dest, location);
+  } else {
+    emit(size == x64::Size::DWORD ? x64::Op::MOVSXD : x64::Op::MOVSX, dest, size, location);
+  }
+}
+
+/**
+ * @brief Stores a register, values smaller than a QWORD only write their own bytes
+ * 
+ * @param src Register to store
+ * @param location Location to store to
+ * @param size Size of the value
+ */
+void Generator::store(x64::Register src, x64::Address location, x64::Size size) {
+  if (size == x64::Size::QWORD) {
+    emit(x64::Op::MOV, location, src);
+  } else if (location.mode == x64::Address::Mode::DIRECT) {
+    auto op = size == x64::Size::DWORD ? x64::Op::MOVSXD : x64::Op::MOVSX;
+    emit(op, location.reg, x64::sized_register(src, size));
+  } else {
+    emit(x64::Op::MOV, location, x64::sized_register(src, size));
+  }
+}
+
+/**
+ * @brief Stores a value returned in rax:rdx, writing exactly its size in bytes
+ * 
+ * Each register is stored in the largest pieces that fit, shifting the next piece down after each one
+ * 
+ * @param location Location to store to
+ * @param size Size of the value
+ */
+void Generator::store_returned(x64::Address location, int64_t size) {
+  for (auto reg : {x64::Register::RAX, x64::Register::RDX}) {
+    auto left = std::min<int64_t>(size, x64::Size::QWORD);
+    for (auto piece : {x64::Size::QWORD, x64::Size::DWORD, x64::Size::WORD, x64::Size::BYTE}) {
+      if (left < piece) continue;
+      store(reg, location, piece);
+      location = location + piece;
+      left -= piece;
+      size -= piece;
+      if (left > 0) emit(x64::Op::SHR, reg, x64::Literal{piece * 8});
+    }
+    if (size == 0) return;
+  }
+}
+
+Generator::Generator(const std::filesystem::path& outputpath, bool peephole)
+    : _outputFile(outputpath, std::ios_base::out | std::ios_base::trunc), _optimize(peephole) {
   if (!_outputFile.is_open()) {
     throw std::runtime_error("Failed to open output file");
   }
@@ -832,18 +1270,42 @@ Generator::Generator(const std::filesystem::path& outputpath)
  * @return x64::Address Location of the given variable
  */
 auto Generator::get_location(const AST::Variable& variable) -> x64::Address {
-  auto variableIter = context().variables.find(variable.name);
-  if (variableIter == context().variables.end()) {
+  auto found = _symbols.find(variable.name);
+  if (!found.has_value()) {
     throw std::runtime_error("Unknown Variable " + variable.name);
   }
+  const auto& var = found.value().get();
 
   int offset = 0;
   if (variable.attribute) {
-    const auto& type = get_check_type(variableIter->second.type);
+    const auto& type = get_check_type(var.type);
     offset = type.get_offset(variable.attribute.value());
   }
 
-  return variableIter->second.location + offset;
+  return var.location + offset;
+}
+
+/**
+ * @brief Gets the size a variable or attribute is accessed with
+ * 
+ * @param variable Variable to get the size of
+ * @return x64::Size Access size
+ */
+auto Generator::get_access_size(const AST::Variable& variable) -> x64::Size {
+  auto found = _symbols.find(variable.name);
+  if (!found.has_value()) {
+    throw std::runtime_error("Unknown Variable " + variable.name);
+  }
+
+  const auto& type = get_check_type(found.value().get().type);
+  if (variable.attribute) {
+    auto field = type.fields.find(variable.attribute.value());
+    if (field == type.fields.end()) throw std::runtime_error("Unknown Attribute " + variable.attribute.value());
+    return x64::access_size(get_check_type(field->second).size);
+  }
+
+  if (type.offsets) return x64::Size::QWORD;
+  return x64::access_size(type.size);
 }
 
 /**
@@ -887,8 +1349,9 @@ auto Generator::get_decl_type(const AST::Declaration& declaration) -> const std:
 void Generator::init_context() {
   _contexts.emplace(
       Context{.size = 0,
-              .stack = x64::Address{x64::Address::Mode::INDIRECT_DISPLACEMENT, x64::Register::RSP, 0},
-              .variables = {},
-              .currVariable = 0});
+              .stack = x64::Address{x64::Address::Mode::INDIRECT_DISPLACEMENT, x64::Register::RBP, 0},
+              .currVariable = 0,
+              .frame = false,
+              .loop = std::nullopt});
 }
 }  // namespace kuso
\ No newline at end of file
@@ -0,0 +1,88 @@
+/**
+ * @file layout.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "generator/layout.hpp"
+
+#include <algorithm>
+
+#include <fmt/format.h>
+
+namespace kuso {
+
+/**
+ * @brief Computes the layout of a type from its attributes
+ *
+ * @param fields Attributes in declaration order
+ * @param options Packing, reordering and minimum alignment of the type
+ * @return Type Type with offsets, size, alignment and padding filled in
+ */
+auto Layout::compute(std::vector<Field> fields, const Options& options) -> Type {
+  if (options.reorder && !options.packed) {
+    std::stable_sort(fields.begin(), fields.end(),
+                     [](const Field& lhs, const Field& rhs) { return lhs.align > rhs.align; });
+  }
+
+  Type type;
+  type.offsets = std::map<std::string, int>{};
+  type.align = 1;
+
+  int offset = 0;
+  for (const auto& field : fields) {
+    auto fieldAlign = options.packed ? 1 : field.align;
+    auto aligned = static_cast<int>(align_to(offset, fieldAlign));
+
+    type.padding += aligned - offset;
+    type.align = std::max(type.align, fieldAlign);
+    type.offsets.value()[field.name] = aligned;
+    type.fields[field.name] = field.type;
+    type.order.push_back(field.name);
+    offset = aligned + field.size;
+  }
+
+  type.align = std::max(type.align, options.align);
+  type.size = static_cast<int>(align_to(offset, type.align));
+  type.padding += type.size - offset;
+  return type;
+}
+
+/**
+ * @brief Formats the layout of every user defined type
+ *
+ * @param types Types to report
+ * @return std::string report
+ */
+auto Layout::report(const TypeContainer& types) -> std::string {
+  std::string report = fmt::format("{:<20}{:>8}{:>8}{:>10}\n", "type", "size", "align", "padding");
+  for (const auto& [name, tid] : types.names()) {
+    const auto& type = types.get_type(tid).value().get();
+    if (!type.offsets) continue;
+
+    report += fmt::format("{:<20}{:>8}{:>8}{:>10}\n", name, type.size, type.align, type.padding);
+    for (const auto& field : type.order) {
+      const auto& fieldType = types.get_type(type.fields.at(field)).value().get();
+      report += fmt::format("  {:<18}{:>8}{:>8}\n", field, type.offsets->at(field), fieldType.size);
+    }
+  }
+  return report;
+}
+
+/**
+ * @brief Rounds an offset up to a multiple of an alignment
+ *
+ * @param offset Offset to round
+ * @param align Alignment, a power of two
+ * @return int64_t Aligned offset
+ */
+auto Layout::align_to(int64_t offset, int64_t align) -> int64_t {
+  if (align <= 1) return offset;
+  return (offset + align - 1) / align * align;
+}
+}  // namespace kuso
@@ -0,0 +1,270 @@
+/**
+ * @file loop_invariants.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-19
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "generator/loop_invariants.hpp"
+
+#include <belt/overload.hpp>
+#include <fmt/format.h>
+#include <iterator>
+
+#include "generator/ast_util.hpp"
+#include "generator/constant_folding.hpp"
+
+namespace kuso {
+
+/**
+ * @brief Hoists the invariant expressions of every loop of the program, rewriting the AST in place
+ *
+ * @param ast AST to hoist in
+ */
+void LoopInvariants::run(AST& ast) {
+  for (auto& statement : ast) {
+    belt::overloaded_visit(
+        statement.statement, [&](const std::unique_ptr<AST::Main>& main) { run(main->body); },
+        [&](const std::unique_ptr<AST::Func>& func) { run(func->body); }, [](const auto&) {});
+  }
+}
+
+auto LoopInvariants::to_string() const -> std::string {
+  std::string report = fmt::format("{:<20}{:>8}\n", "loop invariants", "count");
+  report += fmt::format("{:<20}{:>8}\n", "hoisted", _hoisted);
+  return report;
+}
+
+/**
+ * @brief Finds the loops of a block, the locals computed for a loop are declared right before it
+ *
+ * @param body Block to search
+ */
+void LoopInvariants::run(std::vector<AST::Statement>& body) {
+  for (size_t statement = 0; statement < body.size(); ++statement) {
+    if (auto* ifStatement = std::get_if<std::unique_ptr<AST::If>>(&body[statement].statement)) {
+      run((*ifStatement)->body);
+      run((*ifStatement)->elseBody);
+      continue;
+    }
+
+    auto* loop = std::get_if<std::unique_ptr<AST::While>>(&body[statement].statement);
+    if (loop == nullptr) continue;
+
+    auto& whileStatement = **loop;
+    _preheader.clear();
+    hoist_loop(whileStatement);
+    body.insert(body.begin() + static_cast<int64_t>(statement), std::make_move_iterator(_preheader.begin()),
+                std::make_move_iterator(_preheader.end()));
+    statement += _preheader.size();
+    run(whileStatement.body);
+  }
+}
+
+/**
+ * @brief Hoists the invariant expressions of a single loop, a loop that never runs is already empty
+ *
+ * @param whileStatement Loop to hoist from
+ */
+void LoopInvariants::hoist_loop(AST::While& whileStatement) {
+  if (ConstantFolding::constant_value(*whileStatement.condition) == 0) return;
+
+  ast::Writes writes;
+  ast::collect_writes(whileStatement.body, writes);
+  if (writes.assembly) return;
+  _variant = writes.names();
+
+  root(*whileStatement.condition);
+  hoist_block(whileStatement.body);
+}
+
+/**
+ * @brief Hoists from the statements of a loop, returns and exits run at most once and are left alone
+ *
+ * @param body Statements to hoist from
+ */
+void LoopInvariants::hoist_block(std::vector<AST::Statement>& body) {
+  for (auto& statement : body) {
+    belt::overloaded_visit(
+        statement.statement,
+        [&](const std::unique_ptr<AST::Declaration>& declaration) {
+          if (declaration->value) root(*declaration->value);
+        },
+        [&](const std::unique_ptr<AST::Assignment>& assignment) { root(*assignment->value); },
+        [&](const std::unique_ptr<AST::If>& ifStatement) {
+          root(*ifStatement->condition);
+          hoist_block(ifStatement->body);
+          hoist_block(ifStatement->elseBody);
+        },
+        [&](const std::unique_ptr<AST::While>& whileStatement) {
+          root(*whileStatement->condition);
+          hoist_block(whileStatement->body);
+        },
+        [&](const std::unique_ptr<AST::Call>& call) {
+          for (auto& arg : call->args) root(*arg);
+        },
+        [&](const std::unique_ptr<AST::Destructure>& destructure) {
+          for (auto& arg : destructure->call->args) root(*arg);
+        },
+        [](const auto&) {});
+  }
+}
+
+/**
+ * @brief Hoists from a whole expression, the expression itself is hoisted if it is invariant
+ *
+ * @param expression Expression to hoist from
+ */
+void LoopInvariants::root(AST::Expression& expression) {
+  auto invariance = visit(expression);
+  if (invariance.invariant && invariance.operation) hoist(expression);
+}
+
+auto LoopInvariants::visit(AST::Expression& expression) -> Invariance { return visit(*expression.value); }
+
+/**
+ * @brief Visits both operands of a binary expression, when the whole expression is not invariant the
+ * operands that are get hoisted on their own
+ *
+ * @param left Left operand
+ * @param right Right operand
+ * @param safe Whether the operation can run when the original code wouldn't have
+ * @return Invariance of the expression
+ */
+template <typename Left, typename Right>
+auto LoopInvariants::operands(Left& left, Right& right, bool safe) -> Invariance {
+  auto leftInvariance = visit(left);
+  auto rightInvariance = visit(right);
+  if (safe && leftInvariance.invariant && rightInvariance.invariant) return Invariance{true, true};
+
+  if (leftInvariance.invariant && leftInvariance.operation) hoist(left);
+  if (rightInvariance.invariant && rightInvariance.operation) hoist(right);
+  return Invariance{false, true};
+}
+
+auto LoopInvariants::visit(AST::Equality& equality) -> Invariance {
+  if (!equality.right) return visit(*equality.left);
+  return operands(*equality.left, *equality.right, true);
+}
+
+auto LoopInvariants::visit(AST::Comparison& comparison) -> Invariance {
+  if (!comparison.right) return visit(*comparison.left);
+  return operands(*comparison.left, *comparison.right, true);
+}
+
+auto LoopInvariants::visit(AST::Term& term) -> Invariance {
+  if (!term.right) return visit(*term.left);
+  return operands(*term.left, *term.right, true);
+}
+
+/**
+ * @brief Visits a factor, a division or modulo is only hoisted when its divisor is a constant that
+ * cannot fault
+ *
+ * @param factor Factor to visit
+ * @return Invariance of the factor
+ */
+auto LoopInvariants::visit(AST::Factor& factor) -> Invariance {
+  if (!factor.right) return visit(*factor.left);
+
+  auto safe = factor.op != AST::BinaryOp::DIV && factor.op != AST::BinaryOp::MOD;
+  if (!safe) {
+    auto divisor = ConstantFolding::constant_value(*factor.right);
+    safe = divisor && divisor.value() != 0 && divisor.value() != -1;
+  }
+  return operands(*factor.left, *factor.right, safe);
+}
+
+auto LoopInvariants::visit(AST::Unary& unary) -> Invariance {
+  auto invariance = belt::overloaded_visit<Invariance>(
+      unary.value, [&](const std::unique_ptr<AST::Unary>& operand) { return visit(*operand); },
+      [&](const std::unique_ptr<AST::Primary>& primary) { return visit(*primary); });
+  if (unary.op != AST::BinaryOp::ADD) invariance.operation = true;
+  return invariance;
+}
+
+/**
+ * @brief Visits a primary expression, the arguments of a call are hoisted from but never the call
+ *
+ * @param primary Primary to visit
+ * @return Invariance of the primary
+ */
+auto LoopInvariants::visit(AST::Primary& primary) -> Invariance {
+  return belt::overloaded_visit<Invariance>(
+      primary.value, [&](const std::unique_ptr<AST::Variable>& variable) { return visit(*variable); },
+      [&](const std::unique_ptr<AST::Terminal>& terminal) {
+        return belt::overloaded_visit<Invariance>(
+            terminal->value, [&](const std::unique_ptr<AST::Variable>& variable) { return visit(*variable); },
+            [](const Token& token) { return Invariance{token.type == Token::Type::NUMBER, false}; },
+            [](const std::unique_ptr<AST::String>&) { return Invariance{false, false}; });
+      },
+      [&](const std::unique_ptr<AST::Expression>& expression) { return visit(*expression); },
+      [&](const std::unique_ptr<AST::Call>& call) {
+        for (auto& arg : call->args) root(*arg);
+        return Invariance{false, true};
+      },
+      [](const std::unique_ptr<AST::String>&) { return Invariance{false, false}; });
+}
+
+auto LoopInvariants::visit(const AST::Variable& variable) const -> Invariance {
+  return Invariance{!_variant.contains(variable.name), false};
+}
+
+void LoopInvariants::hoist(AST::Expression& expression) {
+  auto name = declare(std::make_unique<AST::Expression>(std::move(expression)));
+  expression.value = ast::wrap<AST::Equality>(ast::variable(name));
+}
+
+void LoopInvariants::hoist(AST::Equality& equality) {
+  auto name = declare(ast::wrap<AST::Expression>(std::make_unique<AST::Equality>(std::move(equality))));
+  equality.left = ast::wrap<AST::Comparison>(ast::variable(name));
+  equality.right.reset();
+}
+
+void LoopInvariants::hoist(AST::Comparison& comparison) {
+  auto name = declare(ast::wrap<AST::Expression>(std::make_unique<AST::Comparison>(std::move(comparison))));
+  comparison.left = ast::wrap<AST::Term>(ast::variable(name));
+  comparison.right.reset();
+}
+
+void LoopInvariants::hoist(AST::Term& term) {
+  auto name = declare(ast::wrap<AST::Expression>(std::make_unique<AST::Term>(std::move(term))));
+  term.left = ast::wrap<AST::Factor>(ast::variable(name));
+  term.right.reset();
+}
+
+void LoopInvariants::hoist(AST::Factor& factor) {
+  auto name = declare(ast::wrap<AST::Expression>(std::make_unique<AST::Factor>(std::move(factor))));
+  factor.left = ast::wrap<AST::Unary>(ast::variable(name));
+  factor.right.reset();
+}
+
+void LoopInvariants::hoist(AST::Unary& unary) {
+  auto name = declare(ast::wrap<AST::Expression>(std::make_unique<AST::Unary>(std::move(unary))));
+  unary.value = ast::variable(name);
+  unary.op = AST::BinaryOp::ADD;
+}
+
+/**
+ * @brief Declares the local a hoisted expression is computed into before the loop
+ *
+ * The name cannot be written in source, so it never clashes with a local of the program
+ *
+ * @param value Hoisted expression
+ * @return std::string name of the local
+ */
+auto LoopInvariants::declare(std::unique_ptr<AST::Expression> value) -> std::string {
+  auto declaration = std::make_unique<AST::Declaration>();
+  declaration->name = fmt::format("licm.{}", _hoisted++);
+  declaration->type = "int";
+  declaration->value = std::move(value);
+
+  auto name = declaration->name;
+  _preheader.emplace_back(std::move(declaration));
+  return name;
+}
+}  // namespace kuso
@@ -0,0 +1,572 @@
+/**
+ * @file loop_unrolling.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-19
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "generator/loop_unrolling.hpp"
+
+#include <algorithm>
+#include <belt/overload.hpp>
+#include <cstdlib>
+#include <fmt/format.h>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+#include "generator/ast_util.hpp"
+#include "generator/constant_folding.hpp"
+
+namespace kuso {
+namespace {
+/**
+ * @brief Condition of a loop read as `variable op bound`
+ *
+ */
+struct Condition {
+  std::string                      variable;
+  AST::BinaryOp                    op;
+  std::unique_ptr<AST::Expression> bound;
+};
+
+/**
+ * @brief Builds `left op right` for a comparison operator
+ *
+ */
+auto compare(std::unique_ptr<AST::Primary> left, AST::BinaryOp op, std::unique_ptr<AST::Primary> right)
+    -> std::unique_ptr<AST::Expression> {
+  auto rightComparison = std::make_unique<AST::Comparison>();
+  rightComparison->left = ast::wrap<AST::Term>(std::move(right));
+  auto comparison = std::make_unique<AST::Comparison>();
+  comparison->left = ast::wrap<AST::Term>(std::move(left));
+  comparison->right = std::move(rightComparison);
+  comparison->op = op;
+  return ast::wrap<AST::Expression>(std::move(comparison));
+}
+
+/**
+ * @brief Builds `name op value` for an additive operator
+ *
+ */
+auto offset(const std::string& name, AST::BinaryOp op, int64_t value) -> std::unique_ptr<AST::Expression> {
+  auto term = ast::wrap<AST::Term>(ast::variable(name));
+  term->right = ast::wrap<AST::Term>(ast::number(value));
+  term->op = op;
+  return ast::wrap<AST::Expression>(std::move(term));
+}
+
+auto variable_of(const AST::Unary& unary) -> std::optional<std::string> {
+  const auto* primary = std::get_if<std::unique_ptr<AST::Primary>>(&unary.value);
+  if (unary.op != AST::BinaryOp::ADD || primary == nullptr) return std::nullopt;
+
+  const AST::Variable* variable = nullptr;
+  if (const auto* value = std::get_if<std::unique_ptr<AST::Variable>>(&(*primary)->value)) {
+    variable = value->get();
+  } else if (const auto* terminal = std::get_if<std::unique_ptr<AST::Terminal>>(&(*primary)->value)) {
+    const auto* value = std::get_if<std::unique_ptr<AST::Variable>>(&(*terminal)->value);
+    if (value != nullptr) variable = value->get();
+  }
+  if (variable == nullptr || variable->attribute) return std::nullopt;
+  return variable->name;
+}
+
+auto variable_of(const AST::Factor& factor) -> std::optional<std::string> {
+  if (factor.right) return std::nullopt;
+  return variable_of(*factor.left);
+}
+
+auto variable_of(const AST::Term& term) -> std::optional<std::string> {
+  if (term.right) return std::nullopt;
+  return variable_of(*term.left);
+}
+
+auto variable_of(const AST::Comparison& comparison) -> std::optional<std::string> {
+  if (comparison.right) return std::nullopt;
+  return variable_of(*comparison.left);
+}
+
+auto flip(AST::BinaryOp op) -> AST::BinaryOp {
+  switch (op) {
+    case AST::BinaryOp::LT:
+      return AST::BinaryOp::GT;
+    case AST::BinaryOp::GT:
+      return AST::BinaryOp::LT;
+    case AST::BinaryOp::LTE:
+      return AST::BinaryOp::GTE;
+    case AST::BinaryOp::GTE:
+      return AST::BinaryOp::LTE;
+    default:
+      return op;
+  }
+}
+
+/**
+ * @brief Reads a loop condition as a local compared against a bound, `while (N)` runs while N != 0
+ *
+ * @param expression Condition of the loop
+ * @return std::optional<Condition> the comparison, nullopt for any other condition
+ */
+auto condition_of(const AST::Expression& expression) -> std::optional<Condition> {
+  const auto& equality = *expression.value;
+  if (equality.right) {
+    if (equality.equal || equality.right->right) return std::nullopt;
+    if (auto name = variable_of(*equality.left)) {
+      return Condition{name.value(), AST::BinaryOp::NEQ,
+                       ast::wrap<AST::Expression>(ast::clone(*equality.right))};
+    }
+    if (auto name = variable_of(*equality.right->left)) {
+      return Condition{name.value(), AST::BinaryOp::NEQ,
+                       ast::wrap<AST::Expression>(ast::clone(*equality.left))};
+    }
+    return std::nullopt;
+  }
+
+  const auto& comparison = *equality.left;
+  if (!comparison.right) {
+    auto name = variable_of(comparison);
+    if (!name) return std::nullopt;
+    return Condition{name.value(), AST::BinaryOp::NEQ, ast::wrap<AST::Expression>(ast::number(0))};
+  }
+
+  if (comparison.op != AST::BinaryOp::LT && comparison.op != AST::BinaryOp::GT &&
+      comparison.op != AST::BinaryOp::LTE && comparison.op != AST::BinaryOp::GTE) {
+    return std::nullopt;
+  }
+  if (auto name = variable_of(*comparison.left)) {
+    return Condition{name.value(), comparison.op,
+                     ast::wrap<AST::Expression>(ast::clone(*comparison.right))};
+  }
+  if (auto name = variable_of(*comparison.right)) {
+    return Condition{name.value(), flip(comparison.op),
+                     ast::wrap<AST::Expression>(ast::clone(*comparison.left))};
+  }
+  return std::nullopt;
+}
+
+/**
+ * @brief Reads `name = name + c`, `name = c + name` or `name = name - c` as the step c
+ *
+ * @param statement Statement to read
+ * @param name Local stepped
+ * @return std::optional<int64_t> the step, nullopt for any other statement
+ */
+auto step_of(const AST::Statement& statement, const std::string& name) -> std::optional<int64_t> {
+  const auto* assignment = std::get_if<std::unique_ptr<AST::Assignment>>(&statement.statement);
+  if (assignment == nullptr || (*assignment)->dest->name != name || (*assignment)->dest->attribute) {
+    return std::nullopt;
+  }
+
+  const auto& equality = *(*assignment)->value->value;
+  if (equality.right || equality.left->right) return std::nullopt;
+  const auto& term = *equality.left->left;
+  if (!term.right || term.right->right || (term.op != AST::BinaryOp::ADD && term.op != AST::BinaryOp::SUB)) {
+    return std::nullopt;
+  }
+
+  if (variable_of(*term.left) == name) {
+    auto step = ConstantFolding::constant_value(*term.right->left);
+    if (!step || term.op == AST::BinaryOp::ADD) return step;
+    if (step.value() == std::numeric_limits<int64_t>::min()) return std::nullopt;
+    return -step.value();
+  }
+  if (term.op == AST::BinaryOp::ADD && variable_of(*term.right->left) == name) {
+    return ConstantFolding::constant_value(*term.left);
+  }
+  return std::nullopt;
+}
+
+auto invariant(const AST::Expression&, const std::multiset<std::string>&) -> bool;
+
+auto invariant(const AST::Primary& primary, const std::multiset<std::string>& variant) -> bool {
+  return belt::overloaded_visit<bool>(
+      primary.value,
+      [&](const std::unique_ptr<AST::Variable>& variable) { return !variant.contains(variable->name); },
+      [&](const std::unique_ptr<AST::Terminal>& terminal) {
+        return belt::overloaded_visit<bool>(
+            terminal->value,
+            [&](const std::unique_ptr<AST::Variable>& variable) { return !variant.contains(variable->name); },
+            [](const Token& token) { return token.type == Token::Type::NUMBER; },
+            [](const std::unique_ptr<AST::String>&) { return false; });
+      },
+      [&](const std::unique_ptr<AST::Expression>& expression) { return invariant(*expression, variant); },
+      [](const std::unique_ptr<AST::String>&) { return false; },
+      [](const std::unique_ptr<AST::Call>&) { return false; });
+}
+
+auto invariant(const AST::Unary& unary, const std::multiset<std::string>& variant) -> bool {
+  return belt::overloaded_visit<bool>(
+      unary.value, [&](const std::unique_ptr<AST::Unary>& operand) { return invariant(*operand, variant); },
+      [&](const std::unique_ptr<AST::Primary>& primary) { return invariant(*primary, variant); });
+}
+
+auto invariant(const AST::Factor& factor, const std::multiset<std::string>& variant) -> bool {
+  return invariant(*factor.left, variant) && (!factor.right || invariant(*factor.right, variant));
+}
+
+auto invariant(const AST::Term& term, const std::multiset<std::string>& variant) -> bool {
+  return invariant(*term.left, variant) && (!term.right || invariant(*term.right, variant));
+}
+
+auto invariant(const AST::Comparison& comparison, const std::multiset<std::string>& variant) -> bool {
+  return invariant(*comparison.left, variant) && (!comparison.right || invariant(*comparison.right, variant));
+}
+
+auto invariant(const AST::Equality& equality, const std::multiset<std::string>& variant) -> bool {
+  return invariant(*equality.left, variant) && (!equality.right || invariant(*equality.right, variant));
+}
+
+/**
+ * @brief Whether an expression computes the same value on every iteration, calls may have side effects
+ * and are never invariant
+ *
+ */
+auto invariant(const AST::Expression& expression, const std::multiset<std::string>& variant) -> bool {
+  return invariant(*expression.value, variant);
+}
+
+/**
+ * @brief Counts the statements of a block, including those of the blocks nested in it
+ *
+ */
+auto statements(const std::vector<AST::Statement>& body) -> int64_t {
+  int64_t count = 0;
+  for (const auto& statement : body) {
+    ++count;
+    if (const auto* ifStatement = std::get_if<std::unique_ptr<AST::If>>(&statement.statement)) {
+      count += statements((*ifStatement)->body) + statements((*ifStatement)->elseBody);
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief Finds the constant a local holds when a loop starts, from the last statement before the loop
+ * writing it in the same block
+ *
+ * @param body Block of the loop
+ * @param index Position of the loop
+ * @param name Local to find
+ * @return std::optional<int64_t> the value, nullopt when it is not known
+ */
+auto initial(const std::vector<AST::Statement>& body, size_t index, const std::string& name)
+    -> std::optional<int64_t> {
+  for (auto statement = index; statement-- > 0;) {
+    const auto& previous = body[statement].statement;
+    if (const auto* declaration = std::get_if<std::unique_ptr<AST::Declaration>>(&previous)) {
+      if ((*declaration)->name == name) {
+        if (!(*declaration)->value) return std::nullopt;
+        return ConstantFolding::constant_value(*(*declaration)->value);
+      }
+    }
+    if (const auto* assignment = std::get_if<std::unique_ptr<AST::Assignment>>(&previous)) {
+      if ((*assignment)->dest->name == name) {
+        if ((*assignment)->dest->attribute) return std::nullopt;
+        return ConstantFolding::constant_value(*(*assignment)->value);
+      }
+    }
+
+    ast::Writes writes;
+    ast::collect_writes(body[statement], writes);
+    if (writes.assembly || writes.loops || writes.names().contains(name)) return std::nullopt;
+  }
+  return std::nullopt;
+}
+
+auto holds(AST::BinaryOp op, int64_t value, int64_t bound) -> bool {
+  switch (op) {
+    case AST::BinaryOp::LT:
+      return value < bound;
+    case AST::BinaryOp::GT:
+      return value > bound;
+    case AST::BinaryOp::LTE:
+      return value <= bound;
+    case AST::BinaryOp::GTE:
+      return value >= bound;
+    default:
+      return value != bound;
+  }
+}
+
+/**
+ * @brief Appends a copy of a loop body to a block, a body declaring locals is copied into a block of its
+ * own so the copies don't declare them twice
+ *
+ * @param dest Block to append to
+ * @param body Body to copy
+ */
+void append_copy(std::vector<AST::Statement>& dest, const std::vector<AST::Statement>& body) {
+  auto declares = std::ranges::any_of(body, [](const AST::Statement& statement) {
+    return std::holds_alternative<std::unique_ptr<AST::Declaration>>(statement.statement) ||
+           std::holds_alternative<std::unique_ptr<AST::Destructure>>(statement.statement);
+  });
+  if (!declares) {
+    for (const auto& statement : body) dest.push_back(ast::clone(statement));
+    return;
+  }
+
+  auto block = std::make_unique<AST::If>();
+  block->condition = ast::wrap<AST::Expression>(ast::number(1));
+  block->body = ast::clone(body);
+  dest.emplace_back(std::move(block));
+}
+
+auto no_unroll() -> std::vector<AST::Annotation> { return {AST::Annotation{"nounroll", std::nullopt}}; }
+}  // namespace
+
+/**
+ * @brief Unrolls the counted loops of every function of the program, rewriting the AST in place
+ *
+ * @param ast AST to unroll in
+ */
+void LoopUnrolling::run(AST& ast) {
+  for (auto& statement : ast) {
+    belt::overloaded_visit(
+        statement.statement,
+        [&](const std::unique_ptr<AST::Main>& main) {
+          _scopes.assign(1, {});
+          run(main->body);
+        },
+        [&](const std::unique_ptr<AST::Func>& func) {
+          _scopes.assign(1, {});
+          for (const auto& arg : func->args) _scopes.back()[arg->name] = arg->type;
+          run(func->body);
+        },
+        [](const auto&) {});
+  }
+}
+
+auto LoopUnrolling::to_string() const -> std::string {
+  std::string report = fmt::format("{:<20}{:>8}\n", "loop unrolling", "count");
+  report += fmt::format("{:<20}{:>8}\n", "fully unrolled", _full);
+  report += fmt::format("{:<20}{:>8}\n", "partially unrolled", _partial);
+  return report;
+}
+
+/**
+ * @brief Finds the loops of a block, loops that are not unrolled are searched for loops nested in them
+ *
+ * @param body Block to search
+ */
+void LoopUnrolling::run(std::vector<AST::Statement>& body) {
+  _scopes.emplace_back();
+  size_t statement = 0;
+  while (statement < body.size()) {
+    auto& current = body[statement].statement;
+    if (auto* declaration = std::get_if<std::unique_ptr<AST::Declaration>>(&current)) {
+      _scopes.back()[(*declaration)->name] = (*declaration)->type;
+    } else if (auto* destructure = std::get_if<std::unique_ptr<AST::Destructure>>(&current)) {
+      for (const auto& target : (*destructure)->targets) _scopes.back()[target->name] = target->type;
+    } else if (auto* ifStatement = std::get_if<std::unique_ptr<AST::If>>(&current)) {
+      run((*ifStatement)->body);
+      run((*ifStatement)->elseBody);
+    } else if (auto* loop = std::get_if<std::unique_ptr<AST::While>>(&current)) {
+      auto& whileStatement = **loop;
+      if (auto replaced = unroll(body, statement)) {
+        statement += replaced.value();
+        continue;
+      }
+      run(whileStatement.body);
+    }
+    ++statement;
+  }
+  _scopes.pop_back();
+}
+
+/**
+ * @brief Unrolls a single loop if it is counted
+ *
+ * The loop is fully unrolled when its trip count is known and the copies fit, either within
+ * MAX_STATEMENTS or within the factor of its @unroll annotation. Loops with any other annotation are left
+ * for the backends to report.
+ *
+ * @param body Block of the loop
+ * @param index Position of the loop
+ * @return std::optional<size_t> number of statements now in place of the loop, nullopt if it was left alone
+ */
+auto LoopUnrolling::unroll(std::vector<AST::Statement>& body, size_t index) -> std::optional<size_t> {
+  const auto& loop = *std::get<std::unique_ptr<AST::While>>(body[index].statement);
+
+  auto factor = _factor;
+  auto forced = false;
+  for (const auto& annotation : loop.annotations) {
+    if (annotation.name == "unroll" && annotation.value) {
+      factor = annotation.value.value();
+      forced = true;
+    } else {
+      factor = 1;
+    }
+  }
+  if (factor <= 1) return std::nullopt;
+
+  auto counted = induction(loop);
+  if (!counted) return std::nullopt;
+
+  auto size = statements(loop.body);
+  auto bound = ConstantFolding::constant_value(*counted->bound);
+  auto start = initial(body, index, counted->variable);
+  if (bound && start) {
+    auto limit = forced ? factor : MAX_STATEMENTS / size;
+    auto value = static_cast<uint64_t>(start.value());
+    for (int64_t trips = 0; trips <= limit; ++trips) {
+      if (!holds(counted->op, static_cast<int64_t>(value), bound.value())) {
+        return unroll_full(body, index, trips);
+      }
+      value += static_cast<uint64_t>(counted->step);
+    }
+  }
+
+  if (!forced) factor = std::min(factor, MAX_STATEMENTS / size);
+  if (factor <= 1) return std::nullopt;
+  return unroll_partial(body, index, counted.value(), factor);
+}
+
+/**
+ * @brief Replaces a loop with a copy of its body for every iteration
+ *
+ * @param body Block of the loop
+ * @param index Position of the loop
+ * @param trips Number of iterations the loop runs
+ * @return size_t number of statements now in place of the loop
+ */
+auto LoopUnrolling::unroll_full(std::vector<AST::Statement>& body, size_t index, int64_t trips) -> size_t {
+  auto loop = std::move(std::get<std::unique_ptr<AST::While>>(body[index].statement));
+
+  std::vector<AST::Statement> copies;
+  for (int64_t trip = 0; trip < trips; ++trip) append_copy(copies, loop->body);
+
+  body.erase(body.begin() + static_cast<int64_t>(index));
+  body.insert(body.begin() + static_cast<int64_t>(index), std::make_move_iterator(copies.begin()),
+              std::make_move_iterator(copies.end()));
+  ++_full;
+  return copies.size();
+}
+
+/**
+ * @brief Runs factor copies of the body per iteration before the loop, for as long as the local is at
+ * least factor steps away from the bound
+ *
+ * The unrolled loop runs while the local is below the bound minus (factor - 1) steps, or above it plus
+ * those steps when counting down. A bound that is not constant is computed once before the loop, and when
+ * subtracting the steps wraps around the limit is moved to the end of the range so the unrolled loop never
+ * runs. The original loop follows and runs the remaining iterations.
+ *
+ * @param body Block of the loop
+ * @param index Position of the loop
+ * @param counted Induction local of the loop
+ * @param factor Number of copies per iteration
+ * @return std::optional<size_t> number of statements now in place of the loop, nullopt if it was left alone
+ */
+auto LoopUnrolling::unroll_partial(std::vector<AST::Statement>& body, size_t index, const Induction& counted,
+                                   int64_t factor) -> std::optional<size_t> {
+  constexpr auto MIN = std::numeric_limits<int64_t>::min();
+  constexpr auto MAX = std::numeric_limits<int64_t>::max();
+
+  auto up = counted.step > 0;
+  if (counted.step == MIN || std::abs(counted.step) > MAX / (factor - 1)) return std::nullopt;
+  auto distance = (factor - 1) * std::abs(counted.step);
+  if (counted.op == AST::BinaryOp::LTE || counted.op == AST::BinaryOp::GTE) --distance;
+
+  std::vector<AST::Statement>   preheader;
+  std::unique_ptr<AST::Primary> limit;
+  if (auto bound = ConstantFolding::constant_value(*counted.bound)) {
+    if (up ? bound.value() < MIN + distance : bound.value() > MAX - distance) return std::nullopt;
+    limit = ast::number(up ? bound.value() - distance : bound.value() + distance);
+  } else {
+    auto boundName = declare(preheader, ast::clone(*counted.bound));
+    auto toward = up ? AST::BinaryOp::SUB : AST::BinaryOp::ADD;
+    auto limitName = declare(preheader, offset(boundName, toward, distance));
+
+    auto assignment = std::make_unique<AST::Assignment>();
+    assignment->dest = std::make_unique<AST::Variable>();
+    assignment->dest->name = limitName;
+    assignment->value = ast::wrap<AST::Expression>(ast::number(up ? MIN : MAX));
+
+    auto wrapped = std::make_unique<AST::If>();
+    auto below = up ? boundName : limitName;
+    auto above = up ? limitName : boundName;
+    wrapped->condition = compare(ast::variable(below), AST::BinaryOp::LT, ast::variable(above));
+    wrapped->body.emplace_back(std::move(assignment));
+    preheader.emplace_back(std::move(wrapped));
+    limit = ast::variable(limitName);
+  }
+
+  auto& loop = *std::get<std::unique_ptr<AST::While>>(body[index].statement);
+  auto  unrolled = std::make_unique<AST::While>();
+  auto op = up ? AST::BinaryOp::LT : AST::BinaryOp::GT;
+  unrolled->condition = compare(ast::variable(counted.variable), op, std::move(limit));
+  unrolled->annotations = no_unroll();
+  for (int64_t copy = 0; copy < factor; ++copy) append_copy(unrolled->body, loop.body);
+  loop.annotations = no_unroll();
+  preheader.emplace_back(std::move(unrolled));
+
+  auto count = preheader.size() + 1;
+  body.insert(body.begin() + static_cast<int64_t>(index), std::make_move_iterator(preheader.begin()),
+              std::make_move_iterator(preheader.end()));
+  ++_partial;
+  return count;
+}
+
+/**
+ * @brief Finds the induction local of a loop
+ *
+ * The local must be an int, written once in the loop by a constant step at the top level of its body and
+ * moving towards the bound, which the loop must not change.
+ *
+ * @param loop Loop to read
+ * @return std::optional<Induction> the induction local, nullopt if the loop is not counted
+ */
+auto LoopUnrolling::induction(const AST::While& loop) const -> std::optional<Induction> {
+  ast::Writes found;
+  ast::collect_writes(loop.body, found);
+  if (found.assembly || found.loops) return std::nullopt;
+  auto writes = found.names();
+
+  auto condition = condition_of(*loop.condition);
+  if (!condition || writes.count(condition->variable) != 1 || type_of(condition->variable) != "int") {
+    return std::nullopt;
+  }
+  if (!invariant(*condition->bound, writes)) return std::nullopt;
+
+  int64_t step = 0;
+  for (const auto& statement : loop.body) step = step_of(statement, condition->variable).value_or(step);
+
+  auto up = step > 0 && condition->op != AST::BinaryOp::GT && condition->op != AST::BinaryOp::GTE;
+  auto down = step < 0 && condition->op != AST::BinaryOp::LT && condition->op != AST::BinaryOp::LTE;
+  if (!up && !down) return std::nullopt;
+  return Induction{condition->variable, condition->op, std::move(condition->bound), step};
+}
+
+auto LoopUnrolling::type_of(const std::string& name) const -> std::optional<std::string> {
+  for (auto scope = _scopes.rbegin(); scope != _scopes.rend(); ++scope) {
+    auto type = scope->find(name);
+    if (type != scope->end()) return type->second;
+  }
+  return std::nullopt;
+}
+
+/**
+ * @brief Declares a local computed before the unrolled loop
+ *
+ * The name cannot be written in source, so it never clashes with a local of the program
+ *
+ * @param preheader Statements placed before the loop
+ * @param value Value of the local
+ * @return std::string name of the local
+ */
+auto LoopUnrolling::declare(std::vector<AST::Statement>& preheader, std::unique_ptr<AST::Expression> value)
+    -> std::string {
+  auto declaration = std::make_unique<AST::Declaration>();
+  declaration->name = fmt::format("unroll.{}", _locals++);
+  declaration->type = "int";
+  declaration->value = std::move(value);
+
+  auto name = declaration->name;
+  preheader.emplace_back(std::move(declaration));
+  return name;
+}
+}  // namespace kuso
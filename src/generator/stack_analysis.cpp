@@ -0,0 +1,378 @@
+/**
+ * @file stack_analysis.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "generator/stack_analysis.hpp"
+
+#include <algorithm>
+#include <set>
+
+#include <belt/overload.hpp>
+#include <fmt/format.h>
+
+namespace kuso {
+
+/**
+ * @brief Analyzes the stack usage of every function in the program
+ *
+ * @param ast AST to analyze
+ * @param pass First pass that already ran on the AST, provides frame sizes and saved registers
+ */
+void StackAnalysis::analyze(const AST& ast, FirstPass& pass) {
+  _functions.clear();
+  _calls.clear();
+
+  for (const auto& statement : ast) {
+    if (const auto* func = std::get_if<std::unique_ptr<AST::Func>>(&statement.statement)) {
+      analyze_func((*func)->name, (*func)->body, pass, false);
+    } else if (const auto* main = std::get_if<std::unique_ptr<AST::Main>>(&statement.statement)) {
+      analyze_func("main", (*main)->body, pass, true);
+    }
+  }
+
+  find_recursion();
+
+  std::map<std::string, bool> resolved;
+  for (const auto& entry : _functions) {
+    resolve_total(entry.first, resolved);
+  }
+}
+
+/**
+ * @brief Bound for the whole program, the stack needed from the entry point
+ *
+ * @return std::optional<int64_t> bound in bytes, empty if the program recurses
+ */
+auto StackAnalysis::program_bound() const -> std::optional<int64_t> {
+  auto main = _functions.find("main");
+  if (main == _functions.end()) return std::nullopt;
+  return main->second.total;
+}
+
+/**
+ * @brief Formats the analysis as a table
+ *
+ * @return std::string report
+ */
+auto StackAnalysis::to_string() const -> std::string {
+  std::string report = fmt::format("{:<20}{:>8}{:>8}{:>10}\n", "function", "frame", "temps", "total");
+
+  for (const auto& [name, func] : _functions) {
+    std::string total = func.total ? std::to_string(func.total.value()) : "unbounded";
+    std::string note;
+    if (func.recursive) {
+      note = "recursive";
+    } else if (!func.total) {
+      note = "calls recursive function";
+    }
+    if (func.hasAsm) note += note.empty() ? "inline asm not counted" : ", inline asm not counted";
+
+    report += fmt::format("{:<20}{:>8}{:>8}{:>10}  {}\n", name, func.frame, func.temporaries, total, note);
+  }
+
+  auto bound = program_bound();
+  report += fmt::format("{:<36}{:>10}\n", "program", bound ? std::to_string(bound.value()) : "unbounded");
+  return report;
+}
+
+/**
+ * @brief Analyzes a single function
+ *
+ * @param name Name of the function
+ * @param body Body of the function
+ * @param pass First pass information
+ * @param isMain Whether the function is the entry point, which is jumped to without a return address
+ */
+void StackAnalysis::analyze_func(const std::string& name, const std::vector<AST::Statement>& body,
+                                 FirstPass& pass, bool isMain) {
+  auto info = pass.get_function(name);
+  if (!info.has_value()) return;
+
+  _currInfo = &info.value().get();
+  _currFunc = name;
+  _depth = 0;
+
+  auto& func = _functions[name];
+  func.frame = isMain ? 0 : x64::Size::QWORD;
+  if (_currInfo->needs_frame()) func.frame += x64::Size::QWORD + _currInfo->frame_size();
+
+  analyze_body(body);
+
+  // the frame takes the same bytes in the red zone, only the instructions setting up rbp are gone
+  if (func.callees.empty() && !func.hasAsm && func.temporaries == 0) info.value().get().use_red_zone();
+}
+
+/**
+ * @brief Analyzes a list of statements, including nested blocks
+ *
+ * @param body Statements to analyze
+ */
+void StackAnalysis::analyze_body(const std::vector<AST::Statement>& body) {
+  for (const auto& statement : body) {
+    belt::overloaded_visit(
+        statement.statement, [&](const std::unique_ptr<AST::Type>&) {},
+        [&](const std::unique_ptr<AST::Declaration>& decl) {
+          if (decl->value) analyze_expression(*decl->value);
+        },
+        [&](const std::unique_ptr<AST::If>& ifStatement) {
+          analyze_expression(*ifStatement->condition);
+          analyze_body(ifStatement->body);
+          analyze_body(ifStatement->elseBody);
+        },
+        [&](const std::unique_ptr<AST::While>& whileStatement) {
+          analyze_expression(*whileStatement->condition);
+          analyze_body(whileStatement->body);
+        },
+        [&](const std::unique_ptr<AST::ASM>&) { _functions[_currFunc].hasAsm = true; },
+        [&](const std::unique_ptr<AST::Func>&) {},
+        [&](const std::unique_ptr<AST::Return>& ret) {
+          const auto* call = Evaluation::tail_call(*ret);
+          if (call && _currInfo->tailCalls.contains(call)) {
+            analyze_tail_call(*call);
+          } else if (ret->second) {
+            // the first value stays pushed while the second is computed
+            auto start = _depth;
+            analyze_expression(*ret->value);
+            push(x64::Size::QWORD);
+            analyze_expression(*ret->second);
+            _depth = start;
+          } else if (ret->value) {
+            analyze_expression(*ret->value);
+          }
+        },
+        [&](const std::unique_ptr<AST::Exit>& exit) {
+          if (exit->value) analyze_expression(*exit->value);
+        },
+        [&](const std::unique_ptr<AST::Assignment>& assignment) { analyze_expression(*assignment->value); },
+        [&](const std::unique_ptr<AST::Main>&) {},
+        [&](const std::unique_ptr<AST::Call>& call) { analyze_call(*call); },
+        [&](const std::unique_ptr<AST::Destructure>& destructure) { analyze_call(*destructure->call); },
+        [](std::nullptr_t) {});
+  }
+}
+
+/**
+ * @brief Analyzes a call, saved registers stay pushed until the call returns, evaluated arguments too when
+ * there are stack arguments
+ *
+ * @param call Call to analyze
+ */
+void StackAnalysis::analyze_call(const AST::Call& call) {
+  auto start = _depth;
+
+  auto saved = _currInfo->callSaves.find(&call);
+  if (saved != _currInfo->callSaves.end()) {
+    push(static_cast<int64_t>(saved->second.size()) * x64::Size::QWORD);
+  }
+
+  std::vector<size_t> evaluated;
+  bool                stackArgs = false;
+  for (size_t i = 0; i < call.args.size(); ++i) {
+    if (!Evaluation::direct(*call.args[i], i)) evaluated.push_back(i);
+    if (x64::parameter_reg(i) == x64::Register::NONE) stackArgs = true;
+  }
+
+  auto pushed = _depth;
+  for (auto index : evaluated) {
+    analyze_expression(*call.args[index]);
+    if (index != evaluated.back() || x64::parameter_reg(index) == x64::Register::NONE) push(x64::Size::QWORD);
+  }
+  // without stack arguments everything pushed is popped into registers before the call
+  if (!stackArgs) _depth = pushed;
+
+  _calls[_currFunc].push_back(CallSite{call.name, _depth});
+
+  auto& callees = _functions[_currFunc].callees;
+  if (std::find(callees.begin(), callees.end(), call.name) == callees.end()) callees.push_back(call.name);
+
+  _depth = start;
+}
+
+/**
+ * @brief Analyzes a tail call, every argument but the last stays pushed until all of them are evaluated
+ *
+ * @param call Call to analyze
+ */
+void StackAnalysis::analyze_tail_call(const AST::Call& call) {
+  auto start = _depth;
+  for (size_t i = 0; i < call.args.size(); ++i) {
+    analyze_expression(*call.args[i]);
+    if (i + 1 < call.args.size()) push(x64::Size::QWORD);
+  }
+  _depth = start;
+
+  if (call.name == _currFunc) return;
+  _calls[_currFunc].push_back(CallSite{call.name, _depth, true});
+
+  auto& callees = _functions[_currFunc].callees;
+  if (std::find(callees.begin(), callees.end(), call.name) == callees.end()) callees.push_back(call.name);
+}
+
+void StackAnalysis::analyze_expression(const AST::Expression& expr) { analyze_expression(*expr.value); }
+
+/**
+ * @brief Analyzes the operands of a binary expression, the first one only stays pushed while the second
+ * is evaluated if no scratch register was left for it
+ *
+ * @param left Left operand
+ * @param right Right operand
+ * @param reorderable Whether the operation can take its left operand second
+ */
+template <typename Left, typename Right>
+void StackAnalysis::analyze_operands(const Left& left, const Right& right, bool reorderable) {
+  auto leftLabel = _evaluation.label(left);
+  auto rightLabel = _evaluation.label(right);
+  auto leftFirst = Evaluation::left_first(leftLabel, rightLabel, reorderable);
+
+  if (leftFirst) {
+    analyze_expression(left);
+  } else {
+    analyze_expression(right);
+  }
+
+  auto held = _evaluation.acquire(leftFirst ? rightLabel.calls : leftLabel.calls);
+  if (held == x64::Register::NONE) push(x64::Size::QWORD);
+
+  if (leftFirst) {
+    analyze_expression(right);
+  } else {
+    analyze_expression(left);
+  }
+
+  if (held == x64::Register::NONE) {
+    _depth -= x64::Size::QWORD;
+  } else {
+    _evaluation.release(held);
+  }
+}
+
+void StackAnalysis::analyze_expression(const AST::Equality& equality) {
+  if (equality.right) {
+    analyze_operands(*equality.left, *equality.right, true);
+  } else {
+    analyze_expression(*equality.left);
+  }
+}
+
+void StackAnalysis::analyze_expression(const AST::Comparison& comparison) {
+  if (comparison.right) {
+    analyze_operands(*comparison.left, *comparison.right, true);
+  } else {
+    analyze_expression(*comparison.left);
+  }
+}
+
+void StackAnalysis::analyze_expression(const AST::Term& term) {
+  if (term.right) {
+    analyze_operands(*term.left, *term.right, true);
+  } else {
+    analyze_expression(*term.left);
+  }
+}
+
+void StackAnalysis::analyze_expression(const AST::Factor& factor) {
+  auto reduction = Evaluation::strength_reduced(factor);
+  if (reduction && reduction->constantLeft) {
+    analyze_expression(*factor.right);
+  } else if (factor.right && !reduction) {
+    analyze_operands(*factor.left, *factor.right, factor.op == AST::BinaryOp::MUL);
+  } else {
+    analyze_expression(*factor.left);
+  }
+}
+
+void StackAnalysis::analyze_expression(const AST::Unary& unary) {
+  belt::overloaded_visit(
+      unary.value, [&](const std::unique_ptr<AST::Primary>& primary) { analyze_expression(*primary); },
+      [&](const std::unique_ptr<AST::Unary>& unary) { analyze_expression(*unary); }, [](std::nullptr_t) {});
+}
+
+void StackAnalysis::analyze_expression(const AST::Primary& primary) {
+  belt::overloaded_visit(
+      primary.value, [&](const std::unique_ptr<AST::Terminal>&) {},
+      [&](const std::unique_ptr<AST::Call>& call) { analyze_call(*call); },
+      [&](const std::unique_ptr<AST::Expression>& expression) { analyze_expression(*expression); },
+      [&](const std::unique_ptr<AST::String>&) {}, [&](const std::unique_ptr<AST::Variable>&) {});
+}
+
+/**
+ * @brief Pushes bytes onto the tracked stack, keeping the deepest point of the current function
+ *
+ * @param bytes Bytes pushed
+ */
+void StackAnalysis::push(int64_t bytes) {
+  _depth += bytes;
+  auto& func = _functions[_currFunc];
+  func.temporaries = std::max(func.temporaries, _depth);
+}
+
+/**
+ * @brief Marks every function that can reach itself through the call graph
+ *
+ */
+void StackAnalysis::find_recursion() {
+  for (auto& [name, func] : _functions) {
+    std::set<std::string>    visited;
+    std::vector<std::string> work = func.callees;
+    while (!work.empty()) {
+      auto callee = work.back();
+      work.pop_back();
+      if (callee == name) {
+        func.recursive = true;
+        break;
+      }
+      if (!visited.insert(callee).second) continue;
+
+      auto calleeIter = _functions.find(callee);
+      if (calleeIter == _functions.end()) continue;
+      work.insert(work.end(), calleeIter->second.callees.begin(), calleeIter->second.callees.end());
+    }
+  }
+}
+
+/**
+ * @brief Computes the worst case stack of a function including everything it calls
+ *
+ * A function needs its frame plus either its deepest temporaries or, for every call, what is pushed
+ * at the call plus the callee's own bound. A tail callee runs in place of the frame and needs only its
+ * own bound. Recursion has no bound.
+ *
+ * @param name Name of the function
+ * @param resolved Functions already resolved
+ * @return std::optional<int64_t> bound in bytes, empty if unbounded
+ */
+auto StackAnalysis::resolve_total(const std::string& name, std::map<std::string, bool>& resolved)
+    -> std::optional<int64_t> {
+  auto funcIter = _functions.find(name);
+  if (funcIter == _functions.end()) return std::nullopt;
+
+  auto& func = funcIter->second;
+  if (resolved[name]) return func.total;
+  resolved[name] = true;
+
+  if (func.recursive) {
+    func.total = std::nullopt;
+    return func.total;
+  }
+
+  int64_t total = func.frame + func.temporaries;
+  for (const auto& call : _calls[name]) {
+    auto callee = resolve_total(call.callee, resolved);
+    if (!callee) {
+      func.total = std::nullopt;
+      return func.total;
+    }
+    total = std::max(total, call.tail ? callee.value() : func.frame + call.depth + callee.value());
+  }
+
+  func.total = total;
+  return func.total;
+}
+}  // namespace kuso
@@ -0,0 +1,181 @@
+/**
+ * @file cfg.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "ir/cfg.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <optional>
+
+namespace kuso::ir {
+namespace {
+constexpr size_t UNVISITED = std::numeric_limits<size_t>::max();
+}  // namespace
+
+/**
+ * @brief Computes the predecessors of every block, duplicated edges are listed once
+ *
+ */
+auto predecessors(const Function& func) -> std::vector<std::vector<BlockId>> {
+  std::vector<std::vector<BlockId>> preds(func.blocks.size());
+  for (size_t block = 0; block < func.blocks.size(); ++block) {
+    for (auto succ : func.blocks[block].successors()) {
+      auto& list = preds.at(succ);
+      if (std::find(list.begin(), list.end(), block) == list.end()) {
+        list.push_back(static_cast<BlockId>(block));
+      }
+    }
+  }
+  return preds;
+}
+
+/**
+ * @brief Orders the reachable blocks so every block comes before its successors, back edges aside
+ *
+ */
+auto reverse_postorder(const Function& func) -> std::vector<BlockId> {
+  std::vector<BlockId> order;
+  if (func.blocks.empty()) return order;
+
+  std::vector<bool>                       visited(func.blocks.size(), false);
+  std::vector<std::pair<BlockId, size_t>> stack{{0, 0}};
+  visited[0] = true;
+
+  while (!stack.empty()) {
+    auto& [block, next] = stack.back();
+    auto succs = func.blocks[block].successors();
+    if (next < succs.size()) {
+      auto succ = succs[next++];
+      if (!visited.at(succ)) {
+        visited[succ] = true;
+        stack.emplace_back(succ, 0);
+      }
+      continue;
+    }
+    order.push_back(block);
+    stack.pop_back();
+  }
+
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+/**
+ * @brief Drops blocks that cannot be reached from the entry and renumbers the rest
+ *
+ * @return true if any block was removed
+ */
+auto remove_unreachable_blocks(Function& func) -> bool {
+  std::vector<BlockId> remap(func.blocks.size(), std::numeric_limits<BlockId>::max());
+  for (auto block : reverse_postorder(func)) remap[block] = 0;
+
+  BlockId next = 0;
+  for (auto& target : remap) {
+    if (target == 0) target = next++;
+  }
+  if (next == func.blocks.size()) return false;
+
+  std::vector<Block> blocks;
+  blocks.reserve(next);
+  for (size_t block = 0; block < func.blocks.size(); ++block) {
+    if (remap[block] == std::numeric_limits<BlockId>::max()) continue;
+    blocks.push_back(std::move(func.blocks[block]));
+  }
+
+  for (auto& block : blocks) {
+    for (auto& inst : block.instructions) {
+      if (inst.op == Op::PHI) {
+        std::vector<VReg>    operands;
+        std::vector<BlockId> incoming;
+        for (size_t i = 0; i < inst.blocks.size(); ++i) {
+          if (remap.at(inst.blocks[i]) == std::numeric_limits<BlockId>::max()) continue;
+          operands.push_back(inst.operands[i]);
+          incoming.push_back(remap[inst.blocks[i]]);
+        }
+        inst.operands = std::move(operands);
+        inst.blocks = std::move(incoming);
+        continue;
+      }
+      for (auto& target : inst.blocks) target = remap.at(target);
+    }
+  }
+
+  func.blocks = std::move(blocks);
+  return true;
+}
+
+/**
+ * @brief Builds the tree with the iterative algorithm of Cooper, Harvey and Kennedy
+ *
+ */
+DominatorTree::DominatorTree(const Function& func)
+    : _order(reverse_postorder(func)),
+      _position(func.blocks.size(), UNVISITED),
+      _idom(func.blocks.size(), 0),
+      _children(func.blocks.size()) {
+  for (size_t i = 0; i < _order.size(); ++i) _position[_order[i]] = i;
+  if (_order.empty()) return;
+
+  auto preds = predecessors(func);
+  auto intersect = [&](BlockId lhs, BlockId rhs) {
+    while (lhs != rhs) {
+      while (_position[lhs] > _position[rhs]) lhs = _idom[lhs];
+      while (_position[rhs] > _position[lhs]) rhs = _idom[rhs];
+    }
+    return lhs;
+  };
+
+  std::vector<bool> done(func.blocks.size(), false);
+  done[_order[0]] = true;
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t i = 1; i < _order.size(); ++i) {
+      auto block = _order[i];
+
+      std::optional<BlockId> newIdom;
+      for (auto pred : preds[block]) {
+        if (!done[pred]) continue;
+        newIdom = newIdom ? intersect(pred, *newIdom) : pred;
+      }
+
+      if (newIdom && (!done[block] || _idom[block] != *newIdom)) {
+        _idom[block] = *newIdom;
+        done[block] = true;
+        changed = true;
+      }
+    }
+  }
+
+  for (size_t i = 1; i < _order.size(); ++i) _children[_idom[_order[i]]].push_back(_order[i]);
+}
+
+auto DominatorTree::reachable(BlockId block) const -> bool { return _position.at(block) != UNVISITED; }
+
+auto DominatorTree::idom(BlockId block) const -> BlockId { return _idom.at(block); }
+
+/**
+ * @brief Checks if every path from the entry to rhs goes through lhs
+ *
+ */
+auto DominatorTree::dominates(BlockId lhs, BlockId rhs) const -> bool {
+  if (!reachable(lhs) || !reachable(rhs)) return false;
+  while (_position[rhs] > _position[lhs]) rhs = _idom[rhs];
+  return lhs == rhs;
+}
+
+auto DominatorTree::children(BlockId block) const -> const std::vector<BlockId>& {
+  return _children.at(block);
+}
+
+auto DominatorTree::order() const -> const std::vector<BlockId>& { return _order; }
+}  // namespace kuso::ir
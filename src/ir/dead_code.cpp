@@ -0,0 +1,168 @@
+/**
+ * @file dead_code.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "ir/dead_code.hpp"
+
+#include <algorithm>
+#include <fmt/format.h>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include "ir/cfg.hpp"
+
+namespace kuso::ir {
+namespace {
+/**
+ * @brief Checks if a division or modulo may fault, only a constant divisor that is neither zero nor -1
+ * of a dividend that may be the smallest int is safe to remove
+ *
+ */
+auto may_fault(const Instruction& inst, const std::vector<std::optional<int64_t>>& constants) -> bool {
+  if (inst.op != Op::DIV && inst.op != Op::MOD) return false;
+  auto dividend = constants.at(inst.operands[0]);
+  auto divisor = constants.at(inst.operands[1]);
+  if (!divisor || divisor.value() == 0) return true;
+  return divisor.value() == -1 && (!dividend || dividend.value() == std::numeric_limits<int64_t>::min());
+}
+}  // namespace
+
+void DeadCode::run(Module& module) {
+  for (auto& func : module.functions) run(func);
+}
+
+void DeadCode::run(Function& func) {
+  fold_branches(func);
+  auto blocks = func.blocks.size();
+  remove_unreachable_blocks(func);
+  _blocks += static_cast<int64_t>(blocks - func.blocks.size());
+
+  if (!func.has_asm()) remove_dead_stores(func);
+  remove_dead_instructions(func);
+}
+
+auto DeadCode::to_string() const -> std::string {
+  std::string report = fmt::format("{:<20}{:>8}\n", "ir dead code", "count");
+  report += fmt::format("{:<20}{:>8}\n", "constant branches", _branches);
+  report += fmt::format("{:<20}{:>8}\n", "blocks", _blocks);
+  report += fmt::format("{:<20}{:>8}\n", "dead stores", _stores);
+  report += fmt::format("{:<20}{:>8}\n", "instructions", _instructions);
+  return report;
+}
+
+/**
+ * @brief Turns branches on constants into jumps, the phis of the target no longer taken lose the edge
+ *
+ */
+void DeadCode::fold_branches(Function& func) {
+  std::vector<const Instruction*> defs(func.vregs.size(), nullptr);
+  for (const auto& block : func.blocks) {
+    for (const auto& inst : block.instructions) {
+      if (inst.dest != NO_VREG) defs.at(inst.dest) = &inst;
+    }
+  }
+
+  for (size_t block = 0; block < func.blocks.size(); ++block) {
+    if (!func.blocks[block].terminated()) continue;
+    auto& branch = func.blocks[block].instructions.back();
+    if (branch.op != Op::BR) continue;
+    const auto* condition = defs.at(branch.operands[0]);
+    if (condition == nullptr || condition->op != Op::CONST) continue;
+
+    auto taken = branch.blocks[condition->imm != 0 ? 0 : 1];
+    auto dropped = branch.blocks[condition->imm != 0 ? 1 : 0];
+    branch.op = Op::JMP;
+    branch.operands.clear();
+    branch.blocks = {taken};
+    ++_branches;
+    if (dropped == taken) continue;
+
+    for (auto& inst : func.blocks.at(dropped).instructions) {
+      if (inst.op != Op::PHI) break;
+      for (size_t incoming = 0; incoming < inst.blocks.size(); ++incoming) {
+        if (inst.blocks[incoming] != block) continue;
+        inst.blocks.erase(inst.blocks.begin() + static_cast<int64_t>(incoming));
+        inst.operands.erase(inst.operands.begin() + static_cast<int64_t>(incoming));
+        break;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Removes the stores to slots that are never loaded, a slot whose address is used for anything
+ * but the address of a load or store is kept
+ *
+ */
+void DeadCode::remove_dead_stores(Function& func) {
+  std::vector<bool> slot(func.vregs.size(), false);
+  for (const auto& block : func.blocks) {
+    for (const auto& inst : block.instructions) {
+      if (inst.op == Op::LOCAL) slot.at(inst.dest) = true;
+    }
+  }
+
+  for (const auto& block : func.blocks) {
+    for (const auto& inst : block.instructions) {
+      for (size_t operand = 0; operand < inst.operands.size(); ++operand) {
+        auto stored = inst.op == Op::STORE && operand == 0;
+        if (!stored) slot.at(inst.operands[operand]) = false;
+      }
+    }
+  }
+
+  for (auto& block : func.blocks) {
+    auto& insts = block.instructions;
+    auto  dead = std::remove_if(insts.begin(), insts.end(), [&](const Instruction& inst) {
+      return inst.op == Op::STORE && slot.at(inst.operands[0]);
+    });
+    _stores += std::distance(dead, insts.end());
+    insts.erase(dead, insts.end());
+  }
+}
+
+/**
+ * @brief Removes instructions whose values are never used, until nothing else becomes unused, a
+ * division that may fault is kept like the AST backend keeps it
+ *
+ */
+void DeadCode::remove_dead_instructions(Function& func) {
+  std::vector<int64_t>                uses(func.vregs.size(), 0);
+  std::vector<std::optional<int64_t>> constants(func.vregs.size());
+  for (const auto& block : func.blocks) {
+    for (const auto& inst : block.instructions) {
+      for (auto operand : inst.operands) ++uses.at(operand);
+      if (inst.op == Op::CONST) constants.at(inst.dest) = inst.imm;
+    }
+  }
+
+  auto dead = [&](const Instruction& inst) {
+    if (inst.has_side_effects() || inst.op == Op::PARAM || inst.dest == NO_VREG) return false;
+    if (may_fault(inst, constants)) return false;
+    return uses.at(inst.dest) == 0;
+  };
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto& block : func.blocks) {
+      auto& insts = block.instructions;
+      for (auto inst = insts.size(); inst-- > 0;) {
+        if (!dead(insts[inst])) continue;
+        for (auto operand : insts[inst].operands) --uses.at(operand);
+        insts.erase(insts.begin() + static_cast<int64_t>(inst));
+        ++_instructions;
+        changed = true;
+      }
+    }
+  }
+}
+}  // namespace kuso::ir
@@ -0,0 +1,342 @@
+/**
+ * @file inliner.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-19
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "ir/inliner.hpp"
+
+#include <algorithm>
+#include <fmt/format.h>
+#include <iterator>
+#include <set>
+
+#include "ir/cfg.hpp"
+
+namespace kuso::ir {
+namespace {
+/**
+ * @brief Tarjan's strongly connected components of the call graph, callees come out before their callers
+ *
+ */
+class Components {
+ public:
+  explicit Components(const std::vector<std::vector<size_t>>& edges)
+      : _edges(edges), _index(edges.size(), -1), _low(edges.size(), 0), _onStack(edges.size(), false) {
+    for (size_t node = 0; node < edges.size(); ++node) {
+      if (_index[node] < 0) visit(node);
+    }
+  }
+
+  [[nodiscard]] auto components() const -> const std::vector<std::vector<size_t>>& { return _components; }
+
+ private:
+  const std::vector<std::vector<size_t>>& _edges;
+  std::vector<int64_t>                    _index;
+  std::vector<int64_t>                    _low;
+  std::vector<bool>                       _onStack;
+  std::vector<size_t>                     _stack;
+  std::vector<std::vector<size_t>>        _components;
+  int64_t                                 _next{0};
+
+  void visit(size_t node) {
+    _index[node] = _low[node] = _next++;
+    _stack.push_back(node);
+    _onStack[node] = true;
+
+    for (auto callee : _edges[node]) {
+      if (_index[callee] < 0) {
+        visit(callee);
+        _low[node] = std::min(_low[node], _low[callee]);
+      } else if (_onStack[callee]) {
+        _low[node] = std::min(_low[node], _index[callee]);
+      }
+    }
+    if (_low[node] != _index[node]) return;
+
+    auto& component = _components.emplace_back();
+    size_t member = 0;
+    do {
+      member = _stack.back();
+      _stack.pop_back();
+      _onStack[member] = false;
+      component.push_back(member);
+    } while (member != node);
+  }
+};
+}  // namespace
+
+/**
+ * @brief Inlines the calls of every function of a module, then drops the functions no call is left to
+ *
+ * @param module Module to inline in
+ */
+void Inliner::run(Module& module) {
+  auto      count = module.functions.size();
+  CallGraph graph;
+  graph.recursive.assign(count, false);
+  graph.calls.assign(count, 0);
+  graph.costs.assign(count, 0);
+  for (size_t func = 0; func < count; ++func) graph.index[module.functions[func].name] = func;
+
+  std::vector<std::vector<size_t>> callees(count);
+  for (size_t func = 0; func < count; ++func) {
+    graph.costs[func] = cost(module.functions[func]);
+    for (const auto& block : module.functions[func].blocks) {
+      for (const auto& inst : block.instructions) {
+        auto callee = graph.index.find(inst.name);
+        if (inst.op != Op::CALL || callee == graph.index.end()) continue;
+        callees[func].push_back(callee->second);
+        ++graph.calls[callee->second];
+      }
+    }
+  }
+
+  Components components(callees);
+  for (const auto& component : components.components()) {
+    for (auto func : component) {
+      graph.recursive[func] = component.size() > 1 || std::ranges::count(callees[func], func) > 0;
+    }
+  }
+  for (const auto& component : components.components()) {
+    for (auto func : component) {
+      inline_calls(module, func, graph);
+      graph.costs[func] = cost(module.functions[func]);
+    }
+  }
+
+  std::set<std::string> called;
+  for (const auto& func : module.functions) {
+    for (const auto& block : func.blocks) {
+      for (const auto& inst : block.instructions) {
+        if (inst.op == Op::CALL) called.insert(inst.name);
+      }
+    }
+  }
+  auto unused = [&](const Function& func) {
+    return !func.entry && !called.contains(func.name) && graph.calls[graph.index.at(func.name)] > 0;
+  };
+  _removed += static_cast<int64_t>(std::erase_if(module.functions, unused));
+}
+
+/**
+ * @brief Measures a function, every instruction that is left in the generated code costs one
+ *
+ * @param func Function to measure
+ * @return int64_t cost of inlining the function
+ */
+auto Inliner::cost(const Function& func) -> int64_t {
+  int64_t total = 0;
+  for (const auto& block : func.blocks) {
+    for (const auto& inst : block.instructions) {
+      if (inst.op != Op::PARAM && inst.op != Op::LOCAL && inst.op != Op::RET && inst.op != Op::PHI) ++total;
+    }
+  }
+  return total;
+}
+
+auto Inliner::inlined() const -> int64_t {
+  return std::ranges::count_if(_decisions, [](const Decision& decision) { return decision.inlined; });
+}
+
+auto Inliner::report() const -> std::string {
+  std::string report =
+      fmt::format("{:<20}{:<20}{:>6}{:>7}  {}\n", "caller", "callee", "cost", "limit", "decision");
+  for (const auto& decision : _decisions) {
+    auto verdict = decision.inlined ? std::string("inlined") : std::string("kept");
+    if (!decision.reason.empty()) verdict += ", " + decision.reason;
+    report += fmt::format("{:<20}{:<20}{:>6}{:>7}  {}\n", decision.caller, decision.callee, decision.cost,
+                          decision.threshold, verdict);
+  }
+  return report;
+}
+
+auto Inliner::to_string() const -> std::string {
+  std::string report = fmt::format("{:<20}{:>8}\n", "inliner", "count");
+  report += fmt::format("{:<20}{:>8}\n", "calls inlined", inlined());
+  report += fmt::format("{:<20}{:>8}\n", "functions removed", _removed);
+  return report;
+}
+
+/**
+ * @brief Inlines the calls of one function, the code after an inlined call is searched again but the
+ * inlined copy is not, its calls were already decided when the callee itself was visited
+ *
+ * @param module Module the function is in
+ * @param caller Index of the function
+ * @param graph Calls between the functions of the module
+ */
+void Inliner::inline_calls(Module& module, size_t caller, const CallGraph& graph) {
+  auto& func = module.functions[caller];
+  auto  callerCost = cost(func);
+
+  std::vector<bool> constant(func.vregs.size(), false);
+  for (const auto& block : func.blocks) {
+    for (const auto& inst : block.instructions) {
+      if (inst.op == Op::CONST) constant.at(inst.dest) = true;
+    }
+  }
+
+  bool              changed = false;
+  std::vector<bool> search(func.blocks.size(), true);
+  for (size_t block = 0; block < func.blocks.size(); ++block) {
+    if (!search[block]) continue;
+    for (size_t inst = 0; inst < func.blocks[block].instructions.size(); ++inst) {
+      const auto& call = func.blocks[block].instructions[inst];
+      auto        callee = graph.index.find(call.name);
+      if (call.op != Op::CALL || callee == graph.index.end()) continue;
+
+      auto constants = std::ranges::count_if(
+          call.operands, [&](VReg operand) { return operand < constant.size() && constant[operand]; });
+      const auto& body = module.functions[callee->second];
+      auto        decision = decide(func, callerCost, body, callee->second, graph, constants);
+      _decisions.push_back(decision);
+      if (!decision.inlined) continue;
+
+      inline_call(func, static_cast<BlockId>(block), inst, body);
+      callerCost += decision.cost;
+      search.resize(func.blocks.size(), false);
+      search.back() = true;
+      changed = true;
+      break;
+    }
+  }
+
+  if (changed) remove_unreachable_blocks(func);
+}
+
+/**
+ * @brief Decides whether one call is inlined
+ *
+ * @param caller Function making the call
+ * @param callerCost Cost of the caller so far
+ * @param callee Function called
+ * @param index Index of the callee in the call graph
+ * @param graph Calls between the functions of the module
+ * @param constants Number of constant arguments
+ * @return Decision whether the call is inlined and why
+ */
+auto Inliner::decide(const Function& caller, int64_t callerCost, const Function& callee, size_t index,
+                     const CallGraph& graph, int64_t constants) const -> Decision {
+  Decision decision{caller.name, callee.name, graph.costs[index], 0, false, ""};
+  decision.threshold = (graph.calls[index] == 1 ? SINGLE_CALL_THRESHOLD : _threshold) +
+                       constants * CONSTANT_ARGUMENT_BONUS;
+
+  auto loopsToEntry = !callee.blocks.empty() && !callee.blocks.front().instructions.empty() &&
+                      callee.blocks.front().instructions.front().op == Op::PHI;
+  if (callee.entry) {
+    decision.reason = "entry";
+  } else if (graph.recursive[index]) {
+    decision.reason = "recursive";
+  } else if (callee.has_asm()) {
+    decision.reason = "inline asm";
+  } else if (loopsToEntry) {
+    decision.reason = "loops to its entry";
+  } else if (callee.pair) {
+    decision.reason = "returns two values";
+  } else if (callee.inlining == Inlining::NEVER) {
+    decision.reason = "@noinline";
+  } else if (callee.inlining == Inlining::ALWAYS) {
+    decision.inlined = true;
+    decision.reason = "@inline";
+  } else if (callerCost + decision.cost > MAX_CALLER_COST) {
+    decision.reason = "caller too large";
+  } else if (decision.cost > decision.threshold) {
+    decision.reason = "too large";
+  } else {
+    decision.inlined = true;
+    if (graph.calls[index] == 1) decision.reason = "single call";
+  }
+  return decision;
+}
+
+/**
+ * @brief Replaces a call with a copy of the callee
+ *
+ * The block of the call is split, the first half jumps into the copy and every return of the copy jumps to
+ * the second half. Phis after the block now come from the second half.
+ *
+ * @param caller Function making the call
+ * @param block Block of the call
+ * @param index Position of the call in its block
+ * @param callee Function called
+ */
+void Inliner::inline_call(Function& caller, BlockId block, size_t index, const Function& callee) {
+  auto call = std::move(caller.blocks[block].instructions[index]);
+
+  std::vector<VReg> values(callee.vregs.size(), NO_VREG);
+  for (const auto& calleeBlock : callee.blocks) {
+    for (const auto& inst : calleeBlock.instructions) {
+      if (inst.op == Op::PARAM) values.at(inst.dest) = call.operands.at(static_cast<size_t>(inst.imm));
+    }
+  }
+  for (size_t value = 0; value < values.size(); ++value) {
+    if (values[value] == NO_VREG) values[value] = caller.new_vreg(callee.vregs[value]);
+  }
+
+  auto offset = static_cast<BlockId>(caller.blocks.size());
+  auto continuation = static_cast<BlockId>(offset + callee.blocks.size());
+  caller.blocks.resize(continuation + 1);
+
+  auto& before = caller.blocks[block].instructions;
+  auto& after = caller.blocks[continuation].instructions;
+  after.assign(std::make_move_iterator(before.begin() + static_cast<int64_t>(index) + 1),
+               std::make_move_iterator(before.end()));
+  before.erase(before.begin() + static_cast<int64_t>(index), before.end());
+  Instruction enter(Op::JMP);
+  enter.blocks.push_back(offset);
+  before.push_back(std::move(enter));
+
+  for (auto successor : caller.blocks[continuation].successors()) {
+    for (auto& inst : caller.blocks[successor].instructions) {
+      if (inst.op != Op::PHI) break;
+      std::ranges::replace(inst.blocks, block, continuation);
+    }
+  }
+
+  std::vector<VReg>        results;
+  std::vector<BlockId>     returns;
+  std::vector<Instruction> locals;
+  for (size_t calleeBlock = 0; calleeBlock < callee.blocks.size(); ++calleeBlock) {
+    auto& copies = caller.blocks[offset + calleeBlock].instructions;
+    for (const auto& inst : callee.blocks[calleeBlock].instructions) {
+      if (inst.op == Op::PARAM) continue;
+
+      auto copy = inst;
+      if (copy.dest != NO_VREG) copy.dest = values.at(copy.dest);
+      for (auto& operand : copy.operands) operand = values.at(operand);
+      for (auto& target : copy.blocks) target += offset;
+
+      if (copy.op == Op::LOCAL) {
+        locals.push_back(std::move(copy));
+        continue;
+      }
+      if (copy.op == Op::RET) {
+        if (!copy.operands.empty()) {
+          results.push_back(copy.operands.front());
+          returns.push_back(static_cast<BlockId>(offset + calleeBlock));
+        }
+        copy = Instruction(Op::JMP);
+        copy.blocks.push_back(continuation);
+      }
+      copies.push_back(std::move(copy));
+    }
+  }
+
+  if (call.dest != NO_VREG) {
+    Instruction result(results.size() == 1 ? Op::COPY : Op::PHI, call.type);
+    result.dest = call.dest;
+    result.operands = std::move(results);
+    if (result.op == Op::PHI) result.blocks = std::move(returns);
+    after.insert(after.begin(), std::move(result));
+  }
+
+  auto& entry = caller.blocks.front().instructions;
+  entry.insert(entry.begin(), std::make_move_iterator(locals.begin()), std::make_move_iterator(locals.end()));
+}
+}  // namespace kuso::ir
@@ -0,0 +1,225 @@
+/**
+ * @file ir.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "ir/ir.hpp"
+
+#include <algorithm>
+
+#include <fmt/format.h>
+
+namespace kuso::ir {
+
+/**
+ * @brief Checks if any block of the function contains inline assembly
+ *
+ */
+auto Function::has_asm() const -> bool {
+  return std::any_of(blocks.begin(), blocks.end(), [](const Block& block) {
+    return std::any_of(block.instructions.begin(), block.instructions.end(),
+                       [](const Instruction& inst) { return inst.op == Op::ASM; });
+  });
+}
+
+auto to_string(Type type) -> std::string {
+  switch (type) {
+    case Type::VOID:
+      return "void";
+    case Type::I1:
+      return "i1";
+    case Type::I8:
+      return "i8";
+    case Type::I16:
+      return "i16";
+    case Type::I32:
+      return "i32";
+    case Type::I64:
+      return "i64";
+    case Type::PTR:
+      return "ptr";
+  }
+  throw std::runtime_error("Invalid IR Type");
+}
+
+auto to_string(Op operation) -> std::string {
+  switch (operation) {
+    case Op::CONST:
+      return "const";
+    case Op::PARAM:
+      return "param";
+    case Op::LOCAL:
+      return "local";
+    case Op::LOAD:
+      return "load";
+    case Op::STORE:
+      return "store";
+    case Op::COPY:
+      return "copy";
+    case Op::ADD:
+      return "add";
+    case Op::SUB:
+      return "sub";
+    case Op::MUL:
+      return "mul";
+    case Op::DIV:
+      return "div";
+    case Op::MOD:
+      return "mod";
+    case Op::POW:
+      return "pow";
+    case Op::NEG:
+      return "neg";
+    case Op::CMP:
+      return "cmp";
+    case Op::ZEXT:
+      return "zext";
+    case Op::PHI:
+      return "phi";
+    case Op::CALL:
+      return "call";
+    case Op::RESULT:
+      return "result";
+    case Op::ASM:
+      return "asm";
+    case Op::RET:
+      return "ret";
+    case Op::EXIT:
+      return "exit";
+    case Op::JMP:
+      return "jmp";
+    case Op::BR:
+      return "br";
+  }
+  throw std::runtime_error("Invalid IR Op");
+}
+
+auto to_string(Cond cond) -> std::string {
+  switch (cond) {
+    case Cond::EQ:
+      return "eq";
+    case Cond::NE:
+      return "ne";
+    case Cond::LT:
+      return "lt";
+    case Cond::LE:
+      return "le";
+    case Cond::GT:
+      return "gt";
+    case Cond::GE:
+      return "ge";
+  }
+  throw std::runtime_error("Invalid IR Condition");
+}
+
+namespace {
+auto vreg_name(VReg vreg) -> std::string { return fmt::format("%{}", vreg); }
+
+auto block_name(BlockId block) -> std::string { return fmt::format("bb{}", block); }
+
+auto address(const Instruction& inst) -> std::string {
+  if (inst.imm == 0) return fmt::format("[{}]", vreg_name(inst.operands.at(0)));
+  return fmt::format("[{} + {}]", vreg_name(inst.operands.at(0)), inst.imm);
+}
+
+auto escape(const std::string& text) -> std::string {
+  std::string escaped;
+  for (auto chr : text) {
+    if (chr == '\n') {
+      escaped += "\\n";
+    } else if (chr == '"') {
+      escaped += "\\\"";
+    } else {
+      escaped += chr;
+    }
+  }
+  return escaped;
+}
+}  // namespace
+
+/**
+ * @brief Formats an instruction, values are printed as %N:type
+ *
+ */
+auto to_string(const Instruction& inst) -> std::string {
+  std::string str;
+  if (inst.dest != NO_VREG) str = fmt::format("{}:{} = ", vreg_name(inst.dest), to_string(inst.type));
+  str += to_string(inst.op);
+
+  std::vector<std::string> operands;
+  operands.reserve(inst.operands.size());
+  for (auto operand : inst.operands) operands.push_back(vreg_name(operand));
+
+  switch (inst.op) {
+    case Op::CONST:
+      return str + fmt::format(" {}", inst.imm);
+    case Op::PARAM:
+      return str + fmt::format(" {}", inst.imm);
+    case Op::LOCAL:
+      return str + fmt::format(" {}, align {}", inst.size, inst.imm);
+    case Op::LOAD:
+      return str + fmt::format(".{} {}", inst.size, address(inst));
+    case Op::STORE:
+      return str + fmt::format(".{} {}, {}", inst.size, address(inst), operands.at(1));
+    case Op::CMP:
+      return str + fmt::format(" {} {}", to_string(inst.cond), fmt::join(operands, ", "));
+    case Op::PHI: {
+      std::vector<std::string> incoming;
+      for (size_t i = 0; i < inst.operands.size(); ++i) {
+        incoming.push_back(fmt::format("[{}: {}]", block_name(inst.blocks.at(i)), operands.at(i)));
+      }
+      return str + fmt::format(" {}", fmt::join(incoming, ", "));
+    }
+    case Op::CALL:
+      return str + fmt::format(" {}({})", inst.name, fmt::join(operands, ", "));
+    case Op::ASM:
+      return str + fmt::format(" \"{}\"", escape(inst.name));
+    case Op::JMP:
+      return str + " " + block_name(inst.blocks.at(0));
+    case Op::BR:
+      return str + fmt::format(" {}, {}, {}", operands.at(0), block_name(inst.blocks.at(0)),
+                               block_name(inst.blocks.at(1)));
+    default:
+      break;
+  }
+
+  if (!operands.empty()) str += fmt::format(" {}", fmt::join(operands, ", "));
+  return str;
+}
+
+auto to_string(const Function& func) -> std::string {
+  std::vector<std::string> params;
+  params.reserve(func.params.size());
+  for (auto param : func.params) params.push_back(to_string(param));
+
+  std::string annotation;
+  if (func.inlining == Inlining::ALWAYS) annotation = " @inline";
+  if (func.inlining == Inlining::NEVER) annotation = " @noinline";
+
+  auto        returned = to_string(func.returnType);
+  std::string str = fmt::format("func {}({}) -> {}{} {{\n", func.name, fmt::join(params, ", "),
+                                func.pair ? fmt::format("({0}, {0})", returned) : returned, annotation);
+  for (size_t block = 0; block < func.blocks.size(); ++block) {
+    str += fmt::format("{}:\n", block_name(static_cast<BlockId>(block)));
+    for (const auto& inst : func.blocks[block].instructions) {
+      str += fmt::format("  {}\n", to_string(inst));
+    }
+  }
+  return str + "}\n";
+}
+
+auto to_string(const Module& module) -> std::string {
+  std::string str;
+  for (const auto& func : module.functions) {
+    if (!str.empty()) str += "\n";
+    str += to_string(func);
+  }
+  return str;
+}
+}  // namespace kuso::ir
@@ -0,0 +1,685 @@
+/**
+ * @file lowering.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "ir/lowering.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <belt/overload.hpp>
+
+#include "generator/evaluation.hpp"
+#include "generator/layout.hpp"
+#include "ir/cfg.hpp"
+#include "logging/logging.hpp"
+
+namespace kuso::ir {
+/**
+ * @brief Lowers a whole program
+ *
+ * @param ast AST to lower
+ * @return std::optional<Module> module, if the program is valid
+ */
+auto Lowering::lower(const AST& ast) -> std::optional<Module> {
+  try {
+    if (!_firstpass.types_pass(ast)) return std::nullopt;
+
+    // signatures first, calls do not depend on the order functions are defined in
+    for (const auto& statement : ast) {
+      if (!std::holds_alternative<std::unique_ptr<AST::Func>>(statement.statement)) continue;
+      const auto& func = *std::get<std::unique_ptr<AST::Func>>(statement.statement);
+      if (_signatures.contains(func.name) || func.name == "main") {
+        throw std::runtime_error("Multiple Declarations of " + func.name);
+      }
+      _signatures[func.name] = signature(func);
+    }
+
+    Module module;
+    for (const auto& statement : ast) {
+      belt::overloaded_visit(
+          statement.statement, [](const std::unique_ptr<AST::Type>&) {},
+          [&](const std::unique_ptr<AST::Func>& func) {
+            _func = &module.functions.emplace_back();
+            _func->inlining = inlining(*func);
+            const auto& returned = _signatures.at(func->name);
+            _func->pair = returned.tuple || get_check_type(get_check_type_id(returned.returnType)).size >
+                                                x64::Size::QWORD;
+            lower_func(func->name, func->args, func->body,
+                       func->returnType == "none" ? Type::VOID : Type::I64, false);
+          },
+          [&](const std::unique_ptr<AST::Main>& main) {
+            _func = &module.functions.emplace_back();
+            lower_func("main", {}, main->body, Type::VOID, true);
+          },
+          [](std::nullptr_t) {},
+          [](const auto&) {
+            throw std::runtime_error("Only types and functions are allowed at the top level");
+          });
+    }
+    _func = nullptr;
+
+    return module;
+  } catch (std::exception& e) {
+    Logging::error(e.what());
+  }
+
+  return std::nullopt;
+}
+
+/**
+ * @brief Lowers a function, parameters share the outermost scope with the body
+ *
+ */
+void Lowering::lower_func(const std::string& name, const std::vector<std::unique_ptr<AST::Declaration>>& args,
+                          const std::vector<AST::Statement>& body, Type returnType, bool entry) {
+  _func->name = name;
+  _func->returnType = returnType;
+  _func->entry = entry;
+  _prologue.clear();
+
+  _scope.enter_scope();
+  for (size_t i = 0; i < args.size(); ++i) {
+    _func->params.push_back(Type::I64);
+    if (!_scope.declare(args[i]->name,
+                        Local{NO_VREG, get_check_type_id(args[i]->type), static_cast<int64_t>(i)})) {
+      throw std::runtime_error("Multiple Declarations of " + args[i]->name);
+    }
+  }
+
+  _block = _func->new_block();
+  for (const auto& statement : body) lower(statement);
+
+  if (entry) {
+    Instruction exit(Op::EXIT);
+    exit.operands.push_back(emit_const(0));
+    emit(std::move(exit));
+  } else {
+    Instruction ret(Op::RET);
+    if (returnType != Type::VOID) ret.operands.push_back(emit_const(0));
+    if (_func->pair) ret.operands.push_back(emit_const(0));
+    emit(std::move(ret));
+  }
+  _scope.leave_scope();
+
+  auto& entryBlock = _func->blocks.front().instructions;
+  entryBlock.insert(entryBlock.begin(), _prologue.begin(), _prologue.end());
+  remove_unreachable_blocks(*_func);
+}
+
+/**
+ * @brief Reads the inlining annotations of a function, the parser rejects @inline together with @noinline
+ *
+ */
+auto Lowering::inlining(const AST::Func& func) -> Inlining {
+  auto result = Inlining::DEFAULT;
+  for (const auto& annotation : func.annotations) {
+    auto hint = annotation.name == "inline" ? Inlining::ALWAYS : Inlining::NEVER;
+    if ((annotation.name != "inline" && annotation.name != "noinline") || annotation.value) {
+      throw std::runtime_error("Unknown Annotation @" + annotation.name + " on " + func.name);
+    }
+    result = hint;
+  }
+  return result;
+}
+
+/**
+ * @brief Reads the signature of a function, a tuple holds two integers and a type with attributes returned
+ * by value fits in rax:rdx
+ *
+ */
+auto Lowering::signature(const AST::Func& func) -> Signature {
+  for (const auto& element : func.tuple) {
+    if (get_check_type(get_check_type_id(element)).offsets) {
+      throw std::runtime_error("Types with attributes cannot be returned with another value by " + func.name);
+    }
+  }
+  if (func.tuple.empty() && get_check_type(get_check_type_id(func.returnType)).size > 2 * x64::Size::QWORD) {
+    throw std::runtime_error("Types returned by value are at most 16 bytes, " + func.name + " returns " +
+                             func.returnType);
+  }
+  return Signature{func.args.size(), func.returnType != "none", func.returnType, !func.tuple.empty()};
+}
+
+/**
+ * @brief Lowers a block of statements in its own scope
+ *
+ */
+void Lowering::lower_body(const std::vector<AST::Statement>& body) {
+  _scope.enter_scope();
+  for (const auto& statement : body) lower(statement);
+  _scope.leave_scope();
+}
+
+void Lowering::lower(const AST::Statement& statement) {
+  belt::overloaded_visit(
+      statement.statement,
+      [&](const std::unique_ptr<AST::Declaration>& declaration) { lower_declaration(*declaration); },
+      [&](const std::unique_ptr<AST::Destructure>& destructure) { lower_destructure(*destructure); },
+      [&](const std::unique_ptr<AST::Assignment>& assignment) { lower_assignment(*assignment); },
+      [&](const std::unique_ptr<AST::Exit>& exit) { lower_exit(*exit); },
+      [&](const std::unique_ptr<AST::If>& ifStatement) { lower_if(*ifStatement); },
+      [&](const std::unique_ptr<AST::While>& whileStatement) { lower_while(*whileStatement); },
+      [&](const std::unique_ptr<AST::Return>& ret) { lower_return(*ret); },
+      [&](const std::unique_ptr<AST::Call>& call) { lower_call(*call, false); },
+      [&](const std::unique_ptr<AST::ASM>& asm_) {
+        Instruction inst(Op::ASM);
+        inst.name = asm_->code;
+        emit(std::move(inst));
+      },
+      [](const std::unique_ptr<AST::Type>&) {
+        throw std::runtime_error("Types must be declared at the top level");
+      },
+      [](const std::unique_ptr<AST::Func>&) {
+        throw std::runtime_error("Functions must be declared at the top level");
+      },
+      [](const std::unique_ptr<AST::Main>&) {
+        throw std::runtime_error("Main must be declared at the top level");
+      },
+      [](std::nullptr_t) {});
+}
+
+/**
+ * @brief Lowers a declaration, the value is evaluated before the name is visible
+ *
+ */
+void Lowering::lower_declaration(const AST::Declaration& declaration) {
+  auto        typeID = get_check_type_id(declaration.type);
+  const auto& type = get_check_type(typeID);
+  if (declaration.value && type.offsets) {
+    // only a call returning the whole type can initialize it, whole QWORDs of rax:rdx are stored
+    const auto* call = Evaluation::call(*declaration.value);
+    auto        callee = call == nullptr ? _signatures.end() : _signatures.find(call->name);
+    if (callee == _signatures.end() || callee->second.returnType != declaration.type) {
+      throw std::runtime_error("Cannot assign value to type with attributes");
+    }
+
+    auto address = new_local(Layout::align_to(type.size, x64::Size::QWORD), type.align);
+    std::vector<VReg> values{lower_call(*call, true)};
+    if (type.size > x64::Size::QWORD) values.push_back(emit_result(values.front()));
+    for (int64_t offset = 0; offset < type.size; offset += x64::Size::QWORD) {
+      Instruction store(Op::STORE);
+      store.operands = {address, values.at(static_cast<size_t>(offset / x64::Size::QWORD))};
+      store.imm = offset;
+      store.size = x64::Size::QWORD;
+      emit(std::move(store));
+    }
+
+    if (!_scope.declare(declaration.name, Local{address, typeID, -1})) {
+      throw std::runtime_error("Multiple Declarations of " + declaration.name);
+    }
+    return;
+  }
+
+  declare_local(declaration, declaration.value ? lower_expression(*declaration.value) : NO_VREG);
+}
+
+/**
+ * @brief Declares a local in a new slot, storing its first value if it has one
+ *
+ */
+void Lowering::declare_local(const AST::Declaration& declaration, VReg value) {
+  auto        typeID = get_check_type_id(declaration.type);
+  const auto& type = get_check_type(typeID);
+
+  // slots of types with attributes are whole QWORDs, returning one loads them that way
+  int64_t valueSize = type.offsets ? x64::Size::QWORD : x64::access_size(type.size);
+  auto    size = type.offsets ? Layout::align_to(type.size, x64::Size::QWORD) : valueSize;
+  auto    address = new_local(std::max<int64_t>(type.size, size), type.align);
+  if (value != NO_VREG) {
+    Instruction store(Op::STORE);
+    store.operands = {address, value};
+    store.size = valueSize;
+    emit(std::move(store));
+  }
+
+  if (!_scope.declare(declaration.name, Local{address, typeID, -1})) {
+    throw std::runtime_error("Multiple Declarations of " + declaration.name);
+  }
+}
+
+/**
+ * @brief Lowers a destructuring declaration, the call returns its values in rax:rdx
+ *
+ */
+void Lowering::lower_destructure(const AST::Destructure& destructure) {
+  auto callee = _signatures.find(destructure.call->name);
+  if (callee != _signatures.end() && !callee->second.tuple) {
+    throw std::runtime_error(destructure.call->name + " does not return two values");
+  }
+
+  auto first = lower_call(*destructure.call, true);
+  auto second = emit_result(first);
+  declare_local(*destructure.targets.at(0), first);
+  declare_local(*destructure.targets.at(1), second);
+}
+
+void Lowering::lower_assignment(const AST::Assignment& assignment) {
+  auto value = lower_expression(*assignment.value);
+  auto [offset, size] = access(*assignment.dest);
+
+  Instruction store(Op::STORE);
+  store.operands = {find_local(*assignment.dest).address, value};
+  store.imm = offset;
+  store.size = size;
+  emit(std::move(store));
+}
+
+void Lowering::lower_if(const AST::If& ifNode) {
+  auto condition = lower_expression(*ifNode.condition);
+
+  auto                   thenBlock = _func->new_block();
+  std::optional<BlockId> elseBlock;
+  if (!ifNode.elseBody.empty()) elseBlock = _func->new_block();
+  auto endBlock = _func->new_block();
+
+  Instruction branch(Op::BR);
+  branch.operands.push_back(condition);
+  branch.blocks = {thenBlock, elseBlock.value_or(endBlock)};
+  emit(std::move(branch));
+
+  start_block(thenBlock);
+  lower_body(ifNode.body);
+  jump(endBlock);
+
+  if (elseBlock) {
+    start_block(*elseBlock);
+    lower_body(ifNode.elseBody);
+    jump(endBlock);
+  }
+
+  start_block(endBlock);
+}
+
+/**
+ * @brief Lowers a while loop rotated, the condition is checked once before the loop and again at the
+ * bottom of the body, which branches straight back to its top
+ *
+ */
+void Lowering::lower_while(const AST::While& whileStatement) {
+  for (const auto& annotation : whileStatement.annotations) {
+    auto valid = annotation.name == "unroll" ? annotation.value && annotation.value.value() > 0
+                                             : annotation.name == "nounroll" && !annotation.value;
+    if (!valid) throw std::runtime_error("Unknown Annotation @" + annotation.name + " on while");
+  }
+
+  auto body = _func->new_block();
+  auto endBlock = _func->new_block();
+
+  auto branch = [&]() {
+    if (_func->blocks[_block].terminated()) return;
+
+    Instruction inst(Op::BR);
+    inst.operands.push_back(lower_expression(*whileStatement.condition));
+    inst.blocks = {body, endBlock};
+    emit(std::move(inst));
+  };
+
+  branch();
+  start_block(body);
+  lower_body(whileStatement.body);
+  branch();
+
+  start_block(endBlock);
+}
+
+/**
+ * @brief Lowers a return, statements after it go to a new unreachable block
+ *
+ */
+void Lowering::lower_return(const AST::Return& ret) {
+  const auto* signature = _func->entry ? nullptr : &_signatures.at(_func->name);
+  auto        tuple = signature != nullptr && signature->tuple;
+  auto        aggregated = signature != nullptr && aggregate(*signature);
+
+  // a call returning the same values leaves them in rax:rdx already
+  const auto* forwarded = ret.value && !ret.second && aggregated ? Evaluation::call(*ret.value) : nullptr;
+  auto        callee = forwarded == nullptr ? _signatures.end() : _signatures.find(forwarded->name);
+  if (callee == _signatures.end() || callee->second.returnType != signature->returnType) forwarded = nullptr;
+
+  if (ret.second ? !tuple : tuple && forwarded == nullptr) {
+    throw std::runtime_error("Invalid number of return values in " + _func->name);
+  }
+
+  std::vector<VReg> values;
+  if (forwarded) {
+    values.push_back(lower_call(*forwarded, true));
+    if (_func->pair) values.push_back(emit_result(values.front()));
+  } else if (ret.second) {
+    values.push_back(lower_expression(*ret.value));
+    values.push_back(lower_expression(*ret.second));
+  } else if (ret.value && aggregated) {
+    values = lower_returned(*ret.value, *signature);
+  } else if (ret.value) {
+    values.push_back(lower_expression(*ret.value));
+  }
+
+  if (_func->entry) {
+    Instruction exit(Op::EXIT);
+    exit.operands.push_back(values.empty() ? emit_const(0) : values.front());
+    emit(std::move(exit));
+  } else {
+    Instruction inst(Op::RET);
+    if (_func->returnType != Type::VOID) {
+      inst.operands.push_back(values.empty() ? emit_const(0) : values.front());
+    }
+    if (_func->pair) inst.operands.push_back(values.size() < 2 ? emit_const(0) : values.back());
+    emit(std::move(inst));
+  }
+
+  start_block(_func->new_block());
+}
+
+/**
+ * @brief Loads a local of a type with attributes a QWORD at a time to return it
+ *
+ */
+auto Lowering::lower_returned(const AST::Expression& value, const Signature& signature) -> std::vector<VReg> {
+  auto        typeID = get_check_type_id(signature.returnType);
+  const auto* variable = Evaluation::variable(value);
+  auto        found = _scope.find(variable == nullptr ? "" : variable->name);
+  if (!found || variable->attribute || found.value().get().type.id != typeID.id ||
+      found.value().get().param >= 0) {
+    throw std::runtime_error(_func->name + " has to return a local of type " + signature.returnType);
+  }
+
+  std::vector<VReg> values;
+  for (int64_t offset = 0; offset < get_check_type(typeID).size; offset += x64::Size::QWORD) {
+    Instruction load(Op::LOAD, Type::I64);
+    load.operands.push_back(found.value().get().address);
+    load.imm = offset;
+    load.size = x64::Size::QWORD;
+    values.push_back(emit(std::move(load)));
+  }
+  return values;
+}
+
+void Lowering::lower_exit(const AST::Exit& exit) {
+  Instruction inst(Op::EXIT);
+  inst.operands.push_back(exit.value ? lower_expression(*exit.value) : emit_const(0));
+  emit(std::move(inst));
+
+  start_block(_func->new_block());
+}
+
+/**
+ * @brief Lowers a call, arguments are evaluated left to right
+ *
+ * @param call Call to lower
+ * @param value true if the result is used
+ * @return VReg result, NO_VREG if unused
+ */
+auto Lowering::lower_call(const AST::Call& call, bool value) -> VReg {
+  auto signature = _signatures.find(call.name);
+  if (signature == _signatures.end()) throw std::runtime_error("Unknown Function " + call.name);
+  if (call.args.size() != signature->second.argCnt) {
+    throw std::runtime_error("Invalid number of arguments for " + call.name);
+  }
+
+  Instruction inst(Op::CALL, value ? Type::I64 : Type::VOID);
+  inst.name = call.name;
+  for (const auto& arg : call.args) inst.operands.push_back(lower_expression(*arg));
+  return emit(std::move(inst));
+}
+
+auto Lowering::lower_expression(const AST::Expression& expression) -> VReg {
+  return lower_expression(*expression.value);
+}
+
+auto Lowering::lower_expression(const AST::Equality& equality) -> VReg {
+  if (!equality.right) return lower_expression(*equality.left);
+
+  auto right = lower_expression(*equality.right);
+  auto left = lower_expression(*equality.left);
+  return emit_compare(equality.equal ? Cond::EQ : Cond::NE, left, right);
+}
+
+auto Lowering::lower_expression(const AST::Comparison& comparison) -> VReg {
+  if (!comparison.right) return lower_expression(*comparison.left);
+
+  auto right = lower_expression(*comparison.right);
+  auto left = lower_expression(*comparison.left);
+  switch (comparison.op) {
+    case AST::BinaryOp::LT:
+      return emit_compare(Cond::LT, left, right);
+    case AST::BinaryOp::LTE:
+      return emit_compare(Cond::LE, left, right);
+    case AST::BinaryOp::GT:
+      return emit_compare(Cond::GT, left, right);
+    case AST::BinaryOp::GTE:
+      return emit_compare(Cond::GE, left, right);
+    default:
+      throw std::runtime_error("Invalid Comparison Operation");
+  }
+}
+
+auto Lowering::lower_expression(const AST::Term& term) -> VReg {
+  if (!term.right) return lower_expression(*term.left);
+
+  auto right = lower_expression(*term.right);
+  auto left = lower_expression(*term.left);
+  return emit_binary(term.op == AST::BinaryOp::SUB ? Op::SUB : Op::ADD, left, right);
+}
+
+auto Lowering::lower_expression(const AST::Factor& factor) -> VReg {
+  if (!factor.right) return lower_expression(*factor.left);
+
+  auto right = lower_expression(*factor.right);
+  auto left = lower_expression(*factor.left);
+  switch (factor.op) {
+    case AST::BinaryOp::MUL:
+      return emit_binary(Op::MUL, left, right);
+    case AST::BinaryOp::DIV:
+      return emit_binary(Op::DIV, left, right);
+    case AST::BinaryOp::MOD:
+      return emit_binary(Op::MOD, left, right);
+    case AST::BinaryOp::POW:
+      return emit_binary(Op::POW, left, right);
+    default:
+      throw std::runtime_error("Invalid Factor Operation");
+  }
+}
+
+auto Lowering::lower_expression(const AST::Unary& unary) -> VReg {
+  auto value = belt::overloaded_visit<VReg>(
+      unary.value, [&](const std::unique_ptr<AST::Primary>& primary) { return lower_expression(*primary); },
+      [&](const std::unique_ptr<AST::Unary>& inner) { return lower_expression(*inner); });
+  if (unary.op != AST::BinaryOp::SUB && unary.op != AST::BinaryOp::NOT) return value;
+
+  Instruction neg(Op::NEG, Type::I64);
+  neg.operands.push_back(value);
+  return emit(std::move(neg));
+}
+
+auto Lowering::lower_expression(const AST::Primary& primary) -> VReg {
+  return belt::overloaded_visit<VReg>(
+      primary.value,
+      [&](const std::unique_ptr<AST::Terminal>& terminal) { return lower_expression(*terminal); },
+      [&](const std::unique_ptr<AST::Call>& call) {
+        auto callee = _signatures.find(call->name);
+        if (callee != _signatures.end() && aggregate(callee->second)) {
+          throw std::runtime_error("The values returned by " + call->name + " can only be declared");
+        }
+        return lower_call(*call, true);
+      },
+      [&](const std::unique_ptr<AST::Expression>& expression) { return lower_expression(*expression); },
+      [&](const std::unique_ptr<AST::Variable>& variable) { return lower_expression(*variable); },
+      [](const std::unique_ptr<AST::String>&) -> VReg {
+        throw std::runtime_error("Strings Not Implemented");
+      });
+}
+
+auto Lowering::lower_expression(const AST::Terminal& terminal) -> VReg {
+  return belt::overloaded_visit<VReg>(
+      terminal.value,
+      [&](const std::unique_ptr<AST::Variable>& variable) { return lower_expression(*variable); },
+      [&](const Token& token) {
+        if (token.type != Token::Type::NUMBER) throw std::runtime_error("Invalid Terminal");
+        return emit_const(std::stoll(token.value));
+      },
+      [](const std::unique_ptr<AST::String>&) -> VReg {
+        throw std::runtime_error("Strings Not Implemented");
+      });
+}
+
+auto Lowering::lower_expression(const AST::Variable& variable) -> VReg {
+  auto [offset, size] = access(variable);
+
+  Instruction load(Op::LOAD, Type::I64);
+  load.operands.push_back(find_local(variable).address);
+  load.imm = offset;
+  load.size = size;
+  return emit(std::move(load));
+}
+
+// %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+// %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%% HELPERS %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+// %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+
+/**
+ * @brief Appends an instruction to the current block, giving it a value if it has a type
+ *
+ * @return VReg defined value, NO_VREG if none
+ */
+auto Lowering::emit(Instruction inst) -> VReg {
+  if (inst.type != Type::VOID) inst.dest = _func->new_vreg(inst.type);
+  auto dest = inst.dest;
+  _func->blocks[_block].instructions.push_back(std::move(inst));
+  return dest;
+}
+
+auto Lowering::emit_binary(Op operation, VReg left, VReg right) -> VReg {
+  Instruction inst(operation, Type::I64);
+  inst.operands = {left, right};
+  return emit(std::move(inst));
+}
+
+/**
+ * @brief Compares two values, the i1 result is widened like every other value
+ *
+ */
+auto Lowering::emit_compare(Cond cond, VReg left, VReg right) -> VReg {
+  Instruction cmp(Op::CMP, Type::I1);
+  cmp.cond = cond;
+  cmp.operands = {left, right};
+
+  Instruction zext(Op::ZEXT, Type::I64);
+  zext.operands.push_back(emit(std::move(cmp)));
+  return emit(std::move(zext));
+}
+
+auto Lowering::emit_const(int64_t value) -> VReg {
+  Instruction inst(Op::CONST, Type::I64);
+  inst.imm = value;
+  return emit(std::move(inst));
+}
+
+/**
+ * @brief Reads the second value returned by the call that was just emitted
+ *
+ */
+auto Lowering::emit_result(VReg call) -> VReg {
+  Instruction inst(Op::RESULT, Type::I64);
+  inst.operands.push_back(call);
+  return emit(std::move(inst));
+}
+
+/**
+ * @brief Creates a stack slot in the entry block
+ *
+ */
+auto Lowering::new_local(int64_t size, int64_t align) -> VReg {
+  Instruction inst(Op::LOCAL, Type::PTR);
+  inst.dest = _func->new_vreg(Type::PTR);
+  inst.size = size;
+  inst.imm = align;
+  _prologue.push_back(std::move(inst));
+  return _prologue.back().dest;
+}
+
+/**
+ * @brief Ends the current block with a jump, unless it already ended
+ *
+ */
+void Lowering::jump(BlockId target) {
+  if (_func->blocks[_block].terminated()) return;
+
+  Instruction inst(Op::JMP);
+  inst.blocks.push_back(target);
+  emit(std::move(inst));
+}
+
+void Lowering::start_block(BlockId block) { _block = block; }
+
+/**
+ * @brief Finds the slot of a variable, parameters are copied to their slot on first use
+ *
+ */
+auto Lowering::find_local(const AST::Variable& variable) -> Local& {
+  auto found = _scope.find(variable.name);
+  if (!found.has_value()) throw std::runtime_error("Unknown Variable " + variable.name);
+
+  auto& local = found.value().get();
+  if (local.address == NO_VREG) {
+    const auto& type = get_check_type(local.type);
+    local.address = new_local(x64::Size::QWORD, x64::Size::QWORD);
+
+    Instruction param(Op::PARAM, Type::I64);
+    param.dest = _func->new_vreg(Type::I64);
+    param.imm = local.param;
+
+    Instruction store(Op::STORE);
+    store.operands = {local.address, param.dest};
+    store.size = type.offsets ? x64::Size::QWORD : x64::access_size(type.size);
+
+    _prologue.push_back(std::move(param));
+    _prologue.push_back(std::move(store));
+  }
+  return local;
+}
+
+/**
+ * @brief Gets the offset and size a variable or attribute is accessed with
+ *
+ */
+auto Lowering::access(const AST::Variable& variable) -> std::pair<int64_t, int64_t> {
+  const auto& local = find_local(variable);
+  const auto& type = get_check_type(local.type);
+
+  if (!variable.attribute) {
+    return {0, type.offsets ? x64::Size::QWORD : x64::access_size(type.size)};
+  }
+
+  if (local.param >= 0) throw std::runtime_error("Cannot access attributes of parameter " + variable.name);
+  auto field = type.fields.find(variable.attribute.value());
+  if (field == type.fields.end()) throw std::runtime_error("Unknown Attribute " + variable.attribute.value());
+  return {type.get_offset(field->first), x64::access_size(get_check_type(field->second).size)};
+}
+
+auto Lowering::get_check_type(TypeID typeID) -> kuso::Type& {
+  auto type = _firstpass.get_type(typeID);
+  if (!type.has_value()) throw std::runtime_error("Unknown Type");
+  return type.value().get();
+}
+
+auto Lowering::get_check_type_id(const std::string& name) -> TypeID {
+  auto typeID = _firstpass.get_type_id(name);
+  if (!typeID.has_value()) throw std::runtime_error("Unknown Type " + name);
+  return typeID.value();
+}
+
+/**
+ * @brief Checks if a function returns two values or a type with attributes, which can only be declared
+ *
+ */
+auto Lowering::aggregate(const Signature& signature) -> bool {
+  return signature.tuple || get_check_type(get_check_type_id(signature.returnType)).offsets.has_value();
+}
+}  // namespace kuso::ir
@@ -0,0 +1,624 @@
+/**
+ * @file regalloc.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "ir/regalloc.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace kuso::ir {
+namespace {
+constexpr int64_t NO_POS = std::numeric_limits<int64_t>::max();
+
+// caller saved registers come first, functions that make no calls then never have to save anything
+constexpr std::array<x64::Register, 12> ALLOCATABLE{
+    x64::Register::RCX, x64::Register::RDX, x64::Register::RSI, x64::Register::RDI,
+    x64::Register::R8,  x64::Register::R9,  x64::Register::R10, x64::Register::RBX,
+    x64::Register::R12, x64::Register::R13, x64::Register::R14, x64::Register::R15,
+};
+
+auto index(x64::Register reg) -> size_t { return static_cast<size_t>(reg); }
+
+auto use_position(size_t inst) -> int64_t { return 2 * static_cast<int64_t>(inst); }
+
+// calls write their value after the clobber of the caller saved registers
+auto def_position(const Instruction& inst, size_t index) -> int64_t {
+  return use_position(index) + (inst.op == Op::CALL ? 2 : 1);
+}
+
+// split positions are always between instructions, that's where the generator can insert moves
+auto split_position(int64_t pos) -> int64_t { return pos & ~int64_t{1}; }
+
+void merge(std::vector<LinearScan::Range>& ranges) {
+  std::sort(ranges.begin(), ranges.end());
+  std::vector<LinearScan::Range> merged;
+  for (const auto& range : ranges) {
+    if (!merged.empty() && merged.back().second >= range.first) {
+      merged.back().second = std::max(merged.back().second, range.second);
+    } else {
+      merged.push_back(range);
+    }
+  }
+  ranges = std::move(merged);
+}
+}  // namespace
+
+auto Location::in_register(x64::Register reg) -> Location {
+  Location location;
+  location.kind = Kind::REGISTER;
+  location.reg = reg;
+  return location;
+}
+
+auto Location::spilled(int64_t slot) -> Location {
+  Location location;
+  location.kind = Kind::STACK;
+  location.value = slot;
+  return location;
+}
+
+auto Location::constant(int64_t value) -> Location {
+  Location location;
+  location.kind = Kind::CONSTANT;
+  location.value = value;
+  return location;
+}
+
+auto Location::local(VReg vreg) -> Location {
+  Location location;
+  location.kind = Kind::LOCAL;
+  location.value = vreg;
+  return location;
+}
+
+auto LinearScan::Interval::covers(int64_t pos) const -> bool {
+  return std::any_of(ranges.begin(), ranges.end(),
+                     [&](const Range& range) { return range.first <= pos && pos < range.second; });
+}
+
+auto LinearScan::Interval::next_use(int64_t pos) const -> int64_t {
+  auto use = std::lower_bound(uses.begin(), uses.end(), pos);
+  return use == uses.end() ? NO_POS : *use;
+}
+
+/**
+ * @brief Finds the first position both the interval and the ranges cover
+ *
+ * @param other Sorted ranges that do not overlap
+ * @return int64_t First common position, NO_POS if there is none
+ */
+auto LinearScan::Interval::intersection(const std::vector<Range>& other) const -> int64_t {
+  size_t mine = 0;
+  size_t theirs = 0;
+  while (mine < ranges.size() && theirs < other.size()) {
+    auto from = std::max(ranges[mine].first, other[theirs].first);
+    auto to = std::min(ranges[mine].second, other[theirs].second);
+    if (from < to) return from;
+    if (ranges[mine].second < other[theirs].second) {
+      ++mine;
+    } else {
+      ++theirs;
+    }
+  }
+  return NO_POS;
+}
+
+/**
+ * @brief Splits the interval, the interval keeps everything before the position
+ *
+ * @param pos Position after the start and before the end of the interval
+ * @return Interval Rest of the interval, without a location
+ */
+auto LinearScan::Interval::split(int64_t pos) -> Interval {
+  Interval           child;
+  std::vector<Range> kept;
+  child.vreg = vreg;
+  for (const auto& range : ranges) {
+    if (range.second <= pos) {
+      kept.push_back(range);
+    } else if (range.first >= pos) {
+      child.ranges.push_back(range);
+    } else {
+      kept.emplace_back(range.first, pos);
+      child.ranges.emplace_back(pos, range.second);
+    }
+  }
+  ranges = std::move(kept);
+
+  auto first = std::lower_bound(uses.begin(), uses.end(), pos);
+  child.uses.assign(first, uses.end());
+  uses.erase(first, uses.end());
+  return child;
+}
+
+/**
+ * @brief Allocates registers for a function
+ *
+ * @param func Function to allocate, has to be valid SSA
+ * @param registers Whether to use registers at all, without them every value is spilled
+ */
+LinearScan::LinearScan(const Function& func, bool registers) : _func(func) {
+  number();
+  compute_liveness();
+  build_intervals();
+  block_registers();
+  allocate(registers);
+  resolve();
+}
+
+/**
+ * @brief Gets the location of a value at a position
+ *
+ * @param vreg Value to look up
+ * @param pos Position the value is live at
+ * @return Location Location of the value
+ */
+auto LinearScan::location(VReg vreg, int64_t pos) const -> Location {
+  if (vreg < _defs.size() && _defs[vreg] != nullptr && _defs[vreg]->op == Op::LOCAL) {
+    return Location::local(vreg);
+  }
+  if (vreg < _children.size()) {
+    for (auto child : _children[vreg]) {
+      if (_intervals[child].covers(pos)) return _intervals[child].location;
+    }
+  }
+  throw std::runtime_error("Value %" + std::to_string(vreg) + " is not live at " + std::to_string(pos));
+}
+
+/**
+ * @brief Gets the moves between split intervals that happen right before an instruction
+ *
+ * @param inst Index of the instruction in block order
+ * @return std::vector<Move> Parallel moves as destination, source
+ */
+auto LinearScan::moves_before(size_t inst) const -> std::vector<Move> {
+  auto moves = _moves.find(inst);
+  return moves == _moves.end() ? std::vector<Move>{} : moves->second;
+}
+
+/**
+ * @brief Gets the moves on an edge, values that changed location between the blocks and phi inputs,
+ * an edge without moves is empty so branches can jump straight to the target
+ *
+ * @param from Predecessor the edge leaves
+ * @param to Block the edge enters
+ * @return std::vector<Move> Parallel moves as destination, source
+ */
+auto LinearScan::edge_moves(BlockId from, BlockId to) const -> std::vector<Move> {
+  std::vector<Move> moves;
+  auto              leave = _blockTo.at(from) - 1;
+  auto              enter = _blockFrom.at(to);
+
+  // a phi that shares its input's location, or lives in a constant, needs no move
+  auto add = [&](const Location& dest, const Location& src) {
+    if (dest != src && dest.kind != Location::Kind::CONSTANT) moves.emplace_back(dest, src);
+  };
+
+  for (VReg vreg = 0; vreg < _liveIn.at(to).size(); ++vreg) {
+    if (_liveIn[to][vreg]) add(location(vreg, enter), location(vreg, leave));
+  }
+  for (const auto& [phi, input] : phi_inputs(from, to)) add(location(phi, enter), location(input, leave));
+  return moves;
+}
+
+void LinearScan::number() {
+  _defs.assign(_func.vregs.size(), nullptr);
+
+  size_t inst = 0;
+  for (const auto& block : _func.blocks) {
+    _blockFrom.push_back(use_position(inst));
+    for (const auto& instruction : block.instructions) {
+      if (instruction.dest != NO_VREG) _defs.at(instruction.dest) = &instruction;
+      if (instruction.op == Op::CALL && tracked(instruction.dest)) {
+        _calls.emplace_back(def_position(instruction, inst), instruction.dest);
+      }
+      ++inst;
+    }
+    _blockTo.push_back(use_position(inst));
+  }
+}
+
+/**
+ * @brief Computes the values live into and out of every block
+ *
+ * Phi inputs are live out of their predecessor only, phi values are defined at the start of their block
+ */
+void LinearScan::compute_liveness() {
+  auto                           count = _func.vregs.size();
+  auto                           blocks = _func.blocks.size();
+  std::vector<std::vector<bool>> gen(blocks, std::vector<bool>(count, false));
+  std::vector<std::vector<bool>> kill(blocks, std::vector<bool>(count, false));
+
+  for (size_t block = 0; block < blocks; ++block) {
+    for (const auto& inst : _func.blocks[block].instructions) {
+      if (inst.op != Op::PHI) {
+        for (auto operand : inst.operands) {
+          if (tracked(operand) && !kill[block][operand]) gen[block][operand] = true;
+        }
+      }
+      if (tracked(inst.dest)) kill[block][inst.dest] = true;
+    }
+  }
+
+  _liveIn.assign(blocks, std::vector<bool>(count, false));
+  _liveOut.assign(blocks, std::vector<bool>(count, false));
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (auto block = blocks; block-- > 0;) {
+      std::vector<bool> out(count, false);
+      for (auto succ : _func.blocks[block].successors()) {
+        for (size_t vreg = 0; vreg < count; ++vreg) out[vreg] = out[vreg] || _liveIn[succ][vreg];
+        for (const auto& input : phi_inputs(static_cast<BlockId>(block), succ)) {
+          if (tracked(input.second)) out[input.second] = true;
+        }
+      }
+
+      std::vector<bool> in(count, false);
+      for (size_t vreg = 0; vreg < count; ++vreg) {
+        in[vreg] = gen[block][vreg] || (out[vreg] && !kill[block][vreg]);
+      }
+
+      _liveOut[block] = std::move(out);
+      if (in != _liveIn[block]) {
+        _liveIn[block] = std::move(in);
+        changed = true;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Builds the live interval of every value, walking the blocks backwards
+ *
+ */
+void LinearScan::build_intervals() {
+  auto count = _func.vregs.size();
+  _intervals.resize(count);
+  _children.resize(count);
+  for (VReg vreg = 0; vreg < count; ++vreg) _intervals[vreg].vreg = vreg;
+
+  auto add_range = [&](VReg vreg, int64_t from, int64_t to) {
+    auto& ranges = _intervals[vreg].ranges;
+    if (!ranges.empty() && ranges.front().first <= to) {
+      ranges.front().first = std::min(ranges.front().first, from);
+      ranges.front().second = std::max(ranges.front().second, to);
+    } else {
+      ranges.insert(ranges.begin(), Range{from, to});
+    }
+  };
+
+  auto inst = static_cast<size_t>(_blockTo.empty() ? 0 : _blockTo.back() / 2);
+  for (auto block = _func.blocks.size(); block-- > 0;) {
+    auto from = _blockFrom[block];
+    auto live = _liveOut[block];
+    for (VReg vreg = 0; vreg < count; ++vreg) {
+      if (live[vreg]) add_range(vreg, from, _blockTo[block]);
+    }
+    for (auto succ : _func.blocks[block].successors()) {
+      for (const auto& input : phi_inputs(static_cast<BlockId>(block), succ)) {
+        if (tracked(input.second)) _intervals[input.second].uses.push_back(_blockTo[block] - 1);
+      }
+    }
+
+    const auto& insts = _func.blocks[block].instructions;
+    for (auto current = insts.rbegin(); current != insts.rend(); ++current) {
+      --inst;
+      if (tracked(current->dest)) {
+        auto def = current->op == Op::PHI ? from : def_position(*current, inst);
+        if (live[current->dest]) {
+          _intervals[current->dest].ranges.front().first = def;
+        } else {
+          add_range(current->dest, def, def + 1);
+        }
+        live[current->dest] = false;
+      }
+      if (current->op == Op::PHI) continue;
+
+      for (auto operand : current->operands) {
+        if (!tracked(operand)) continue;
+        add_range(operand, from, use_position(inst) + 1);
+        _intervals[operand].uses.push_back(use_position(inst));
+        live[operand] = true;
+      }
+    }
+  }
+
+  for (auto& interval : _intervals) std::sort(interval.uses.begin(), interval.uses.end());
+}
+
+/**
+ * @brief Blocks the registers instructions clobber or read implicitly
+ *
+ * Parameter registers are blocked from the entry until their PARAM copies them out
+ */
+void LinearScan::block_registers() {
+  _hints.assign(_func.vregs.size(), x64::Register::NONE);
+
+  size_t inst = 0;
+  for (const auto& block : _func.blocks) {
+    for (const auto& instruction : block.instructions) {
+      auto use = use_position(inst++);
+      switch (instruction.op) {
+        case Op::CALL:
+          for (auto reg : ALLOCATABLE) {
+            if (!x64::is_callee_saved(reg)) _fixed.at(index(reg)).emplace_back(use + 1, use + 2);
+          }
+          break;
+        case Op::DIV:
+        case Op::MOD:
+        case Op::POW:
+        case Op::RESULT:
+          // divisions use rdx, the second value of a call stays in it until its result copies it out
+          _fixed.at(index(x64::Register::RDX)).emplace_back(use, use + 1);
+          break;
+        case Op::PARAM: {
+          auto reg = x64::parameter_reg(static_cast<size_t>(instruction.imm));
+          if (reg == x64::Register::NONE) break;
+          _fixed.at(index(reg)).emplace_back(0, use + 1);
+          _hints.at(instruction.dest) = reg;
+          break;
+        }
+        default:
+          break;
+      }
+    }
+  }
+
+  for (auto& ranges : _fixed) merge(ranges);
+}
+
+void LinearScan::allocate(bool registers) {
+  _slots.assign(_func.vregs.size(), -1);
+  for (VReg vreg = 0; vreg < _intervals.size(); ++vreg) {
+    if (!tracked(vreg) || _intervals[vreg].ranges.empty()) continue;
+    _children[vreg].push_back(vreg);
+    _unhandled.emplace(_intervals[vreg].start(), vreg);
+  }
+
+  std::vector<size_t> active;
+  std::vector<size_t> inactive;
+  while (!_unhandled.empty()) {
+    auto [pos, current] = *_unhandled.begin();
+    _unhandled.erase(_unhandled.begin());
+
+    std::vector<size_t> stillActive;
+    std::vector<size_t> stillInactive;
+    for (auto interval : active) {
+      if (_intervals[interval].end() <= pos) continue;
+      (_intervals[interval].covers(pos) ? stillActive : stillInactive).push_back(interval);
+    }
+    for (auto interval : inactive) {
+      if (_intervals[interval].end() <= pos) continue;
+      (_intervals[interval].covers(pos) ? stillActive : stillInactive).push_back(interval);
+    }
+    active = std::move(stillActive);
+    inactive = std::move(stillInactive);
+
+    // constants never need a register of their own, every use rematerializes them
+    if (!registers || _defs.at(_intervals[current].vreg)->op == Op::CONST) {
+      spill(current);
+      continue;
+    }
+    if (!try_allocate_free(current, active, inactive)) allocate_blocked(current, active, inactive);
+    if (_intervals[current].location.kind == Location::Kind::REGISTER) active.push_back(current);
+  }
+}
+
+/**
+ * @brief Tries to find a register that is free for the interval, or at least for its beginning
+ *
+ * @return true If the interval got a register
+ */
+auto LinearScan::try_allocate_free(size_t current, const std::vector<size_t>& active,
+                                   const std::vector<size_t>& inactive) -> bool {
+  std::array<int64_t, x64::REGISTER_COUNT> freeUntil{};
+  for (auto reg : ALLOCATABLE) freeUntil.at(index(reg)) = NO_POS;
+
+  const auto& interval = _intervals[current];
+  for (auto other : active) freeUntil.at(index(_intervals[other].location.reg)) = 0;
+  for (auto other : inactive) {
+    auto& until = freeUntil.at(index(_intervals[other].location.reg));
+    until = std::min(until, interval.intersection(_intervals[other].ranges));
+  }
+  auto calls = call_blocks(current);
+  for (auto reg : ALLOCATABLE) {
+    auto& until = freeUntil.at(index(reg));
+    until = std::min({until, interval.intersection(_fixed.at(index(reg))), calls.at(index(reg))});
+  }
+
+  auto best = _hints.at(interval.vreg);
+  if (best == x64::Register::NONE || freeUntil.at(index(best)) < interval.end()) {
+    best = ALLOCATABLE.front();
+    for (auto reg : ALLOCATABLE) {
+      if (freeUntil.at(index(reg)) > freeUntil.at(index(best))) best = reg;
+    }
+  }
+
+  auto until = freeUntil.at(index(best));
+  if (until < interval.end()) {
+    auto pos = split_position(until);
+    if (pos <= interval.start()) return false;
+    auto child = split(current, pos);
+    _unhandled.emplace(_intervals[child].start(), child);
+  }
+  assign(current, best);
+  return true;
+}
+
+/**
+ * @brief Takes the register whose next use is the furthest away, or spills the interval itself
+ *
+ * Intervals that lose their register are split and spilled for the rest of their lifetime
+ */
+void LinearScan::allocate_blocked(size_t current, std::vector<size_t>& active,
+                                  std::vector<size_t>& inactive) {
+  std::array<int64_t, x64::REGISTER_COUNT> nextUse{};
+  std::array<int64_t, x64::REGISTER_COUNT> blockPos{};
+  for (auto reg : ALLOCATABLE) nextUse.at(index(reg)) = blockPos.at(index(reg)) = NO_POS;
+
+  const auto& interval = _intervals[current];
+  auto        pos = interval.start();
+  for (auto other : active) {
+    auto& use = nextUse.at(index(_intervals[other].location.reg));
+    use = std::min(use, _intervals[other].next_use(pos));
+  }
+  for (auto other : inactive) {
+    if (interval.intersection(_intervals[other].ranges) == NO_POS) continue;
+    auto& use = nextUse.at(index(_intervals[other].location.reg));
+    use = std::min(use, _intervals[other].next_use(pos));
+  }
+  auto calls = call_blocks(current);
+  for (auto reg : ALLOCATABLE) {
+    blockPos.at(index(reg)) = std::min(interval.intersection(_fixed.at(index(reg))), calls.at(index(reg)));
+    nextUse.at(index(reg)) = std::min(nextUse.at(index(reg)), blockPos.at(index(reg)));
+  }
+
+  auto best = ALLOCATABLE.front();
+  for (auto reg : ALLOCATABLE) {
+    if (nextUse.at(index(reg)) > nextUse.at(index(best))) best = reg;
+  }
+
+  auto use = nextUse.at(index(best));
+  if (use <= pos || interval.next_use(pos) > use) {
+    spill(current);
+    return;
+  }
+
+  auto blocked = blockPos.at(index(best));
+  if (blocked < interval.end()) {
+    auto at = split_position(blocked);
+    if (at <= pos) {
+      spill(current);
+      return;
+    }
+    auto child = split(current, at);
+    _unhandled.emplace(_intervals[child].start(), child);
+  }
+
+  // everything else in the register that overlaps the interval gives it up from here on
+  auto evicted = [&](size_t other) {
+    if (_intervals[other].location.reg != best) return false;
+    if (_intervals[current].intersection(_intervals[other].ranges) == NO_POS) return false;
+    evict(other, pos);
+    return true;
+  };
+  std::erase_if(active, evicted);
+  std::erase_if(inactive, evicted);
+  assign(current, best);
+}
+
+/**
+ * @brief Finds where registers are blocked around calls, a call copies its value out of rax before the moves
+ * ahead of the next instruction, which still read the intervals split where the value starts. The value
+ * can't share a register with anything live right before it, whichever of the two is allocated first.
+ *
+ * @param current Interval being allocated
+ * @return std::array<int64_t, x64::REGISTER_COUNT> Position each register is blocked from
+ */
+auto LinearScan::call_blocks(size_t current) const -> std::array<int64_t, x64::REGISTER_COUNT> {
+  std::array<int64_t, x64::REGISTER_COUNT> blocked{};
+  blocked.fill(NO_POS);
+
+  const auto& interval = _intervals[current];
+  for (const auto& [def, vreg] : _calls) {
+    if (vreg == interval.vreg && interval.covers(def)) {
+      for (const auto& other : _intervals) {
+        if (other.location.kind != Location::Kind::REGISTER || !other.covers(def - 1)) continue;
+        blocked.at(index(other.location.reg)) = std::min(blocked.at(index(other.location.reg)), def);
+      }
+    } else if (interval.covers(def - 1)) {
+      for (auto child : _children[vreg]) {
+        const auto& value = _intervals[child];
+        if (value.location.kind != Location::Kind::REGISTER || !value.covers(def)) continue;
+        blocked.at(index(value.location.reg)) = std::min(blocked.at(index(value.location.reg)), def - 1);
+      }
+    }
+  }
+  return blocked;
+}
+
+/**
+ * @brief Takes the register away from an interval, everything from the position on is spilled
+ *
+ */
+void LinearScan::evict(size_t interval, int64_t pos) {
+  auto at = split_position(pos);
+  if (at <= _intervals[interval].start()) {
+    spill(interval);
+    return;
+  }
+  spill(split(interval, at));
+}
+
+auto LinearScan::split(size_t interval, int64_t pos) -> size_t {
+  auto child = _intervals[interval].split(pos);
+  _intervals.push_back(std::move(child));
+  _children.at(_intervals.back().vreg).push_back(_intervals.size() - 1);
+  return _intervals.size() - 1;
+}
+
+/**
+ * @brief Moves an interval to the stack, constants are rematerialized instead
+ *
+ */
+void LinearScan::spill(size_t interval) {
+  auto        vreg = _intervals[interval].vreg;
+  const auto* def = _defs.at(vreg);
+  if (def->op == Op::CONST) {
+    _intervals[interval].location = Location::constant(def->imm);
+    return;
+  }
+  if (_slots.at(vreg) < 0) _slots[vreg] = _slotCount++;
+  _intervals[interval].location = Location::spilled(_slots[vreg]);
+}
+
+void LinearScan::assign(size_t interval, x64::Register reg) {
+  _intervals[interval].location = Location::in_register(reg);
+  _used.insert(reg);
+}
+
+/**
+ * @brief Inserts moves where an interval was split in the middle of a block
+ *
+ * Splits at the start of a block are resolved on the incoming edges
+ */
+void LinearScan::resolve() {
+  for (auto& children : _children) {
+    std::sort(children.begin(), children.end(),
+              [&](size_t lhs, size_t rhs) { return _intervals[lhs].start() < _intervals[rhs].start(); });
+
+    for (size_t child = 1; child < children.size(); ++child) {
+      const auto& before = _intervals[children[child - 1]];
+      const auto& after = _intervals[children[child]];
+      if (before.end() != after.start()) continue;
+      if (std::binary_search(_blockFrom.begin(), _blockFrom.end(), after.start())) continue;
+      if (before.location == after.location || after.location.kind == Location::Kind::CONSTANT) continue;
+      _moves[static_cast<size_t>(after.start() / 2)].emplace_back(after.location, before.location);
+    }
+  }
+}
+
+auto LinearScan::tracked(VReg vreg) const -> bool {
+  return vreg < _defs.size() && _defs[vreg] != nullptr && _defs[vreg]->op != Op::LOCAL;
+}
+
+auto LinearScan::phi_inputs(BlockId from, BlockId to) const -> std::vector<std::pair<VReg, VReg>> {
+  std::vector<std::pair<VReg, VReg>> inputs;
+  for (const auto& inst : _func.blocks.at(to).instructions) {
+    if (inst.op != Op::PHI) break;
+    for (size_t i = 0; i < inst.blocks.size(); ++i) {
+      if (inst.blocks[i] == from) inputs.emplace_back(inst.dest, inst.operands.at(i));
+    }
+  }
+  return inputs;
+}
+}  // namespace kuso::ir
@@ -0,0 +1,111 @@
+/**
+ * @file scalar_replacement.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-19
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "ir/scalar_replacement.hpp"
+
+#include <fmt/format.h>
+#include <iterator>
+#include <set>
+#include <vector>
+
+namespace kuso::ir {
+void ScalarReplacement::run(Module& module) {
+  for (auto& func : module.functions) run(func);
+}
+
+void ScalarReplacement::run(Function& func) {
+  if (func.blocks.empty() || func.has_asm()) return;
+
+  find_slots(func);
+  if (!_slots.empty()) replace(func);
+}
+
+auto ScalarReplacement::to_string() const -> std::string {
+  std::string report = fmt::format("{:<20}{:>8}\n", "scalar replacement", "count");
+  report += fmt::format("{:<20}{:>8}\n", "slots split", _split);
+  report += fmt::format("{:<20}{:>8}\n", "fields created", _fields);
+  return report;
+}
+
+/**
+ * @brief Finds the slots of the entry block that are only loaded and stored, in ranges that either match
+ * or don't overlap at all
+ *
+ */
+void ScalarReplacement::find_slots(const Function& func) {
+  std::map<VReg, int64_t> sizes;
+  for (const auto& inst : func.blocks.front().instructions) {
+    if (inst.op == Op::LOCAL) sizes.emplace(inst.dest, inst.size);
+  }
+
+  _slots.clear();
+  std::set<VReg> rejected;
+  for (const auto& block : func.blocks) {
+    for (const auto& inst : block.instructions) {
+      for (size_t operand = 0; operand < inst.operands.size(); ++operand) {
+        auto slot = inst.operands[operand];
+        if (!sizes.contains(slot)) continue;
+
+        auto access = (inst.op == Op::LOAD || inst.op == Op::STORE) && operand == 0;
+        if (!access) rejected.insert(slot);
+        else _slots[slot].emplace(Range{inst.imm, inst.size}, NO_VREG);
+      }
+    }
+  }
+
+  std::erase_if(_slots, [&](const auto& slot) {
+    const auto& [address, ranges] = slot;
+    if (rejected.contains(address)) return true;
+    if (ranges.size() == 1 && ranges.begin()->first == Range{0, sizes.at(address)}) return true;
+
+    // ranges are sorted by offset, one overlapping the next also covers its start
+    for (auto range = ranges.begin(), next = std::next(range); next != ranges.end(); range = next++) {
+      if (range->first.first + range->first.second > next->first.first) return true;
+    }
+    return false;
+  });
+}
+
+/**
+ * @brief Replaces every slot found with a slot per range and points the loads and stores at them
+ *
+ */
+void ScalarReplacement::replace(Function& func) {
+  std::vector<Instruction> entry;
+  for (auto& inst : func.blocks.front().instructions) {
+    auto slot = _slots.find(inst.dest);
+    if (inst.op != Op::LOCAL || slot == _slots.end()) {
+      entry.push_back(std::move(inst));
+      continue;
+    }
+
+    for (auto& [range, field] : slot->second) {
+      Instruction local(Op::LOCAL, Type::PTR);
+      local.dest = func.new_vreg(Type::PTR);
+      local.size = range.second;
+      local.imm = range.second;
+      field = local.dest;
+      entry.push_back(std::move(local));
+    }
+    ++_split;
+    _fields += static_cast<int64_t>(slot->second.size());
+  }
+  func.blocks.front().instructions = std::move(entry);
+
+  for (auto& block : func.blocks) {
+    for (auto& inst : block.instructions) {
+      if ((inst.op != Op::LOAD && inst.op != Op::STORE) || !_slots.contains(inst.operands.front())) continue;
+      inst.operands.front() = _slots.at(inst.operands.front()).at(Range{inst.imm, inst.size});
+      inst.imm = 0;
+    }
+  }
+}
+}  // namespace kuso::ir
@@ -0,0 +1,251 @@
+/**
+ * @file slot_promotion.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-19
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "ir/slot_promotion.hpp"
+
+#include <algorithm>
+#include <fmt/format.h>
+#include <numeric>
+#include <set>
+
+namespace kuso::ir {
+void SlotPromotion::run(Module& module) {
+  for (auto& func : module.functions) run(func);
+}
+
+void SlotPromotion::run(Function& func) {
+  if (func.blocks.empty() || func.has_asm()) return;
+  remove_unreachable_blocks(func);
+  _preds = predecessors(func);
+  if (!_preds.front().empty()) return;
+
+  find_slots(func);
+  if (_slots.empty()) return;
+  _promoted += static_cast<int64_t>(_slots.size());
+
+  DominatorTree tree(func);
+  place_phis(func, tree);
+
+  _undefined.clear();
+  auto& entry = func.blocks.front().instructions;
+  for (auto type : _types) {
+    Instruction zero(Op::CONST, type);
+    zero.dest = func.new_vreg(type);
+    _undefined.push_back(zero.dest);
+    entry.insert(entry.begin(), std::move(zero));
+  }
+
+  _values.assign(_types.size(), {});
+  _leaders.resize(func.vregs.size());
+  std::iota(_leaders.begin(), _leaders.end(), 0);
+  rename(func, tree, 0);
+
+  for (auto& block : func.blocks) {
+    for (auto& inst : block.instructions) {
+      for (auto& operand : inst.operands) operand = leader(operand);
+    }
+  }
+  remove_unused_phis(func);
+}
+
+auto SlotPromotion::to_string() const -> std::string {
+  std::string report = fmt::format("{:<20}{:>8}\n", "slot promotion", "count");
+  report += fmt::format("{:<20}{:>8}\n", "slots promoted", _promoted);
+  report += fmt::format("{:<20}{:>8}\n", "loads removed", _loads);
+  report += fmt::format("{:<20}{:>8}\n", "stores removed", _stores);
+  return report;
+}
+
+/**
+ * @brief Finds the slots of the entry block that are only loaded and stored whole, as 8 bytes of one type
+ *
+ */
+void SlotPromotion::find_slots(const Function& func) {
+  std::map<VReg, Type> candidates;
+  for (const auto& inst : func.blocks.front().instructions) {
+    if (inst.op == Op::LOCAL && inst.size == 8) candidates.emplace(inst.dest, Type::VOID);
+  }
+
+  std::set<VReg> rejected;
+  for (const auto& block : func.blocks) {
+    for (const auto& inst : block.instructions) {
+      for (size_t operand = 0; operand < inst.operands.size(); ++operand) {
+        auto slot = candidates.find(inst.operands[operand]);
+        if (slot == candidates.end()) continue;
+
+        auto access = inst.op == Op::LOAD || inst.op == Op::STORE;
+        auto whole  = access && operand == 0 && inst.imm == 0 && inst.size == 8;
+        auto type = inst.op == Op::LOAD ? inst.type : func.vregs.at(inst.operands.back());
+        if (!whole || (slot->second != Type::VOID && slot->second != type)) rejected.insert(slot->first);
+        slot->second = type;
+      }
+    }
+  }
+
+  _slots.clear();
+  _phis.clear();
+  _types.clear();
+  for (auto [slot, type] : candidates) {
+    if (type == Type::VOID || rejected.contains(slot)) continue;
+    _slots.emplace(slot, _types.size());
+    _types.push_back(type);
+  }
+}
+
+/**
+ * @brief Places a phi for every slot on the iterated dominance frontier of the blocks storing to it
+ *
+ */
+void SlotPromotion::place_phis(Function& func, const DominatorTree& tree) {
+  std::vector<std::set<BlockId>> frontier(func.blocks.size());
+  for (auto block : tree.order()) {
+    if (_preds[block].size() < 2) continue;
+    for (auto pred : _preds[block]) {
+      for (auto runner = pred; runner != tree.idom(block); runner = tree.idom(runner)) {
+        frontier[runner].insert(block);
+      }
+    }
+  }
+
+  std::vector<std::vector<BlockId>> stores(_types.size());
+  for (size_t block = 0; block < func.blocks.size(); ++block) {
+    for (const auto& inst : func.blocks[block].instructions) {
+      auto slot = inst.op == Op::STORE ? _slots.find(inst.operands[0]) : _slots.end();
+      if (slot != _slots.end()) stores[slot->second].push_back(static_cast<BlockId>(block));
+    }
+  }
+
+  for (size_t slot = 0; slot < _types.size(); ++slot) {
+    std::vector<bool> placed(func.blocks.size(), false);
+    std::vector<bool> queued(func.blocks.size(), false);
+    auto&             work = stores[slot];
+    for (auto block : work) queued[block] = true;
+
+    while (!work.empty()) {
+      auto block = work.back();
+      work.pop_back();
+      for (auto join : frontier[block]) {
+        if (placed[join]) continue;
+        placed[join] = true;
+
+        Instruction phi(Op::PHI, _types[slot]);
+        phi.dest = func.new_vreg(_types[slot]);
+        _phis.emplace(phi.dest, slot);
+        auto& insts = func.blocks[join].instructions;
+        insts.insert(insts.begin(), std::move(phi));
+
+        if (!queued[join]) {
+          queued[join] = true;
+          work.push_back(join);
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Replaces the loads of a block with the value each slot holds there, fills in the phis of its
+ * successors, then does the same for the blocks it dominates
+ *
+ * @param func Function of the block
+ * @param tree Dominator tree of the function
+ * @param block Block to rename
+ */
+void SlotPromotion::rename(Function& func, const DominatorTree& tree, BlockId block) {
+  std::vector<size_t> depths;
+  depths.reserve(_values.size());
+  for (const auto& values : _values) depths.push_back(values.size());
+  auto current = [&](size_t slot) { return _values[slot].empty() ? _undefined[slot] : _values[slot].back(); };
+
+  auto& insts = func.blocks[block].instructions;
+  for (size_t index = 0; index < insts.size();) {
+    auto& inst = insts[index];
+    if (inst.op == Op::PHI) {
+      auto phi = _phis.find(inst.dest);
+      if (phi != _phis.end()) _values[phi->second].push_back(inst.dest);
+      ++index;
+      continue;
+    }
+
+    for (auto& operand : inst.operands) operand = leader(operand);
+    auto slot = inst.op == Op::LOAD || inst.op == Op::STORE ? _slots.find(inst.operands[0]) : _slots.end();
+    if (slot == _slots.end()) {
+      ++index;
+      continue;
+    }
+
+    if (inst.op == Op::LOAD) {
+      _leaders.at(inst.dest) = current(slot->second);
+      ++_loads;
+    } else {
+      _values[slot->second].push_back(inst.operands[1]);
+      ++_stores;
+    }
+    insts.erase(insts.begin() + static_cast<int64_t>(index));
+  }
+
+  auto successors = func.blocks[block].successors();
+  std::sort(successors.begin(), successors.end());
+  successors.erase(std::unique(successors.begin(), successors.end()), successors.end());
+  for (auto successor : successors) {
+    for (auto& inst : func.blocks[successor].instructions) {
+      if (inst.op != Op::PHI) break;
+      auto phi = _phis.find(inst.dest);
+      if (phi == _phis.end()) continue;
+      inst.operands.push_back(current(phi->second));
+      inst.blocks.push_back(block);
+    }
+  }
+
+  for (auto child : tree.children(block)) rename(func, tree, child);
+
+  for (size_t slot = 0; slot < _values.size(); ++slot) _values[slot].resize(depths[slot]);
+}
+
+/**
+ * @brief Removes the placed phis whose value only reaches other placed phis
+ *
+ */
+void SlotPromotion::remove_unused_phis(Function& func) {
+  std::map<VReg, const Instruction*> defs;
+  for (const auto& block : func.blocks) {
+    for (const auto& inst : block.instructions) {
+      if (_phis.contains(inst.dest)) defs.emplace(inst.dest, &inst);
+    }
+  }
+
+  std::set<VReg>    used;
+  std::vector<VReg> work;
+  for (const auto& block : func.blocks) {
+    for (const auto& inst : block.instructions) {
+      if (_phis.contains(inst.dest)) continue;
+      for (auto operand : inst.operands) {
+        if (_phis.contains(operand) && used.insert(operand).second) work.push_back(operand);
+      }
+    }
+  }
+  while (!work.empty()) {
+    auto phi = work.back();
+    work.pop_back();
+    for (auto operand : defs.at(phi)->operands) {
+      if (_phis.contains(operand) && used.insert(operand).second) work.push_back(operand);
+    }
+  }
+
+  auto unused = [&](const auto& inst) { return _phis.contains(inst.dest) && !used.contains(inst.dest); };
+  for (auto& block : func.blocks) std::erase_if(block.instructions, unused);
+}
+
+auto SlotPromotion::leader(VReg value) const -> VReg {
+  while (value < _leaders.size() && _leaders[value] != value) value = _leaders[value];
+  return value;
+}
+}  // namespace kuso::ir
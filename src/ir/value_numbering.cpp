@@ -0,0 +1,216 @@
+/**
+ * @file value_numbering.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-19
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "ir/value_numbering.hpp"
+
+#include <algorithm>
+#include <fmt/format.h>
+#include <numeric>
+
+namespace kuso::ir {
+namespace {
+/**
+ * @brief Checks if an instruction computes its value from its operands alone
+ *
+ * A division that is dominated by the same division runs after it has already not faulted.
+ */
+auto pure(const Instruction& inst) -> bool {
+  switch (inst.op) {
+    case Op::CONST:
+    case Op::ADD:
+    case Op::SUB:
+    case Op::MUL:
+    case Op::DIV:
+    case Op::MOD:
+    case Op::POW:
+    case Op::NEG:
+    case Op::CMP:
+    case Op::ZEXT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+auto swap(Cond cond) -> Cond {
+  switch (cond) {
+    case Cond::LT:
+      return Cond::GT;
+    case Cond::GT:
+      return Cond::LT;
+    case Cond::LE:
+      return Cond::GE;
+    case Cond::GE:
+      return Cond::LE;
+    default:
+      return cond;
+  }
+}
+}  // namespace
+
+void ValueNumbering::run(Module& module) {
+  for (auto& func : module.functions) run(func);
+}
+
+void ValueNumbering::run(Function& func) {
+  if (func.blocks.empty()) return;
+
+  _table.clear();
+  _keys.clear();
+  _leaders.resize(func.vregs.size());
+  std::iota(_leaders.begin(), _leaders.end(), 0);
+  _slots.assign(func.vregs.size(), false);
+  _exits.assign(func.blocks.size(), Memory{});
+  _preds = predecessors(func);
+  for (const auto& block : func.blocks) {
+    for (const auto& inst : block.instructions) {
+      if (inst.op == Op::LOCAL) _slots.at(inst.dest) = true;
+    }
+  }
+
+  DominatorTree tree(func);
+  number(func, tree, 0);
+
+  for (auto& block : func.blocks) {
+    for (auto& inst : block.instructions) {
+      for (auto& operand : inst.operands) operand = leader(operand);
+    }
+  }
+}
+
+auto ValueNumbering::to_string() const -> std::string {
+  std::string report = fmt::format("{:<20}{:>8}\n", "value numbering", "count");
+  report += fmt::format("{:<20}{:>8}\n", "redundant values", _values);
+  report += fmt::format("{:<20}{:>8}\n", "redundant loads", _loads);
+  return report;
+}
+
+/**
+ * @brief Numbers the values of a block, then of the blocks it dominates, the values it added to the table
+ * are taken out again once all of them are done
+ *
+ * @param func Function of the block
+ * @param tree Dominator tree of the function
+ * @param block Block to number
+ */
+void ValueNumbering::number(Function& func, const DominatorTree& tree, BlockId block) {
+  auto mark = _keys.size();
+
+  Memory memory;
+  if (block != 0 && _preds[block].size() == 1) {
+    memory = _exits[_preds[block].front()];
+  } else {
+    memory.all = memory.any = ++_version;
+  }
+
+  auto& insts = func.blocks[block].instructions;
+  for (size_t inst = 0; inst < insts.size();) {
+    auto& current = insts[inst];
+    if (current.op != Op::PHI) {
+      for (auto& operand : current.operands) operand = leader(operand);
+    }
+    clobber(memory, current);
+    if (current.op == Op::STORE) forward(func, current, memory);
+    if (!pure(current) && current.op != Op::LOAD) {
+      ++inst;
+      continue;
+    }
+
+    auto value = key(current, memory);
+    auto found = _table.find(value);
+    if (found == _table.end()) {
+      _table.emplace(value, current.dest);
+      _keys.push_back(std::move(value));
+      ++inst;
+      continue;
+    }
+
+    ++(current.op == Op::LOAD ? _loads : _values);
+    _leaders.at(current.dest) = found->second;
+    insts.erase(insts.begin() + static_cast<int64_t>(inst));
+  }
+  _exits[block] = memory;
+
+  for (auto child : tree.children(block)) number(func, tree, child);
+
+  for (auto key = _keys.begin() + static_cast<int64_t>(mark); key != _keys.end(); ++key) _table.erase(*key);
+  _keys.resize(mark);
+}
+
+/**
+ * @brief Starts a new version of the memory an instruction may write
+ *
+ * @param memory Versions of memory before the instruction
+ * @param inst Instruction
+ */
+void ValueNumbering::clobber(Memory& memory, const Instruction& inst) {
+  if (inst.op == Op::STORE && _slots.at(inst.operands[0])) {
+    memory.slots[inst.operands[0]] = memory.any = ++_version;
+  } else if (inst.op == Op::STORE || inst.op == Op::CALL || inst.op == Op::ASM) {
+    memory.all = memory.any = ++_version;
+    memory.slots.clear();
+  }
+}
+
+/**
+ * @brief Records the value of a whole 8 byte store as the value of a load reading it back, narrower loads
+ * sign extend and are left alone
+ *
+ * @param func Function of the store
+ * @param store Store
+ * @param memory Versions of memory after the store
+ */
+void ValueNumbering::forward(const Function& func, const Instruction& store, const Memory& memory) {
+  if (store.size != 8) return;
+
+  Instruction load(Op::LOAD, func.vregs.at(store.operands[1]));
+  load.operands = {store.operands[0]};
+  load.imm      = store.imm;
+  load.size     = store.size;
+
+  auto value = key(load, memory);
+  if (_table.emplace(value, store.operands[1]).second) _keys.push_back(std::move(value));
+}
+
+/**
+ * @brief Builds the key of an instruction, loads from a stack slot see its version and any other load
+ * sees every store
+ *
+ * @param inst Instruction
+ * @param memory Versions of memory at the instruction
+ * @return Key the key
+ */
+auto ValueNumbering::key(const Instruction& inst, const Memory& memory) const -> Key {
+  Key value{inst.op, inst.type, inst.cond, inst.imm, inst.size, 0, inst.operands};
+  if (inst.op == Op::LOAD) {
+    auto base = inst.operands[0];
+    auto slot = memory.slots.find(base);
+    value.memory = !_slots.at(base)             ? memory.any
+                   : slot != memory.slots.end() ? std::max(memory.all, slot->second)
+                                                : memory.all;
+  }
+
+  auto& operands = value.operands;
+  if (operands.size() != 2 || operands[0] <= operands[1]) return value;
+  if (inst.op == Op::ADD || inst.op == Op::MUL) {
+    std::swap(operands[0], operands[1]);
+  } else if (inst.op == Op::CMP) {
+    std::swap(operands[0], operands[1]);
+    value.cond = swap(inst.cond);
+  }
+  return value;
+}
+
+auto ValueNumbering::leader(VReg value) const -> VReg {
+  while (value < _leaders.size() && _leaders[value] != value) value = _leaders[value];
+  return value;
+}
+}  // namespace kuso::ir
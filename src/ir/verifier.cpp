@@ -0,0 +1,201 @@
+/**
+ * @file verifier.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "ir/verifier.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include <fmt/format.h>
+
+#include "ir/cfg.hpp"
+
+namespace kuso::ir {
+namespace {
+auto expected_operands(Op operation) -> std::optional<size_t> {
+  switch (operation) {
+    case Op::CONST:
+    case Op::PARAM:
+    case Op::LOCAL:
+    case Op::ASM:
+    case Op::JMP:
+      return 0;
+    case Op::LOAD:
+    case Op::COPY:
+    case Op::NEG:
+    case Op::ZEXT:
+    case Op::RESULT:
+    case Op::EXIT:
+    case Op::BR:
+      return 1;
+    case Op::STORE:
+    case Op::ADD:
+    case Op::SUB:
+    case Op::MUL:
+    case Op::DIV:
+    case Op::MOD:
+    case Op::POW:
+    case Op::CMP:
+      return 2;
+    default:
+      return std::nullopt;
+  }
+}
+
+auto expected_blocks(Op operation) -> size_t {
+  if (operation == Op::JMP) return 1;
+  if (operation == Op::BR) return 2;
+  return 0;
+}
+
+auto defines_value(Op operation) -> bool {
+  return operation != Op::STORE && operation != Op::ASM && operation != Op::CALL && operation != Op::RET &&
+         operation != Op::EXIT && operation != Op::JMP && operation != Op::BR;
+}
+}  // namespace
+
+auto verify(const Function& func) -> std::vector<std::string> {
+  std::vector<std::string> errors;
+  auto error = [&](BlockId block, const std::string& message) {
+    errors.push_back(fmt::format("{}: bb{}: {}", func.name, block, message));
+  };
+
+  if (func.blocks.empty()) {
+    errors.push_back(fmt::format("{}: function has no blocks", func.name));
+    return errors;
+  }
+
+  // Where every value is defined, as (block, index)
+  std::vector<std::optional<std::pair<BlockId, size_t>>> defs(func.vregs.size());
+
+  for (BlockId block = 0; block < func.blocks.size(); ++block) {
+    const auto& insts = func.blocks[block].instructions;
+    if (!func.blocks[block].terminated()) error(block, "block does not end in a terminator");
+
+    bool phis = true;
+    for (size_t index = 0; index < insts.size(); ++index) {
+      const auto& inst = insts[index];
+      if (inst.is_terminator() && index + 1 != insts.size()) {
+        error(block, "terminator in the middle of the block");
+      }
+
+      if (inst.op == Op::PHI) {
+        if (!phis) error(block, "phi after a non phi instruction");
+      } else {
+        phis = false;
+      }
+
+      auto operands = expected_operands(inst.op);
+      if (operands && inst.operands.size() != *operands) {
+        error(block, fmt::format("'{}' has {} operands", to_string(inst), inst.operands.size()));
+      }
+      if (inst.op != Op::PHI && inst.blocks.size() != expected_blocks(inst.op)) {
+        error(block, fmt::format("'{}' has {} targets", to_string(inst), inst.blocks.size()));
+      }
+      for (auto target : inst.blocks) {
+        if (target >= func.blocks.size()) {
+          error(block, fmt::format("'{}' targets a missing block", to_string(inst)));
+        }
+      }
+      for (auto operand : inst.operands) {
+        if (operand >= func.vregs.size()) {
+          error(block, fmt::format("'{}' uses an unknown value", to_string(inst)));
+        }
+      }
+
+      if (inst.op == Op::RET && func.pair && inst.operands.size() != 2) {
+        error(block, fmt::format("'{}' has to return two values", to_string(inst)));
+      }
+
+      if (!defines_value(inst.op) && inst.op != Op::CALL) {
+        if (inst.dest != NO_VREG) error(block, fmt::format("'{}' cannot define a value", to_string(inst)));
+        continue;
+      }
+      if (inst.dest == NO_VREG) {
+        if (inst.op != Op::CALL) error(block, fmt::format("'{}' does not define a value", to_string(inst)));
+        continue;
+      }
+      if (inst.dest >= func.vregs.size()) {
+        error(block, fmt::format("'{}' defines an unknown value", to_string(inst)));
+        continue;
+      }
+      if (defs[inst.dest]) error(block, fmt::format("%{} is defined more than once", inst.dest));
+      if (func.vregs[inst.dest] != inst.type) {
+        error(block, fmt::format("'{}' has the wrong type", to_string(inst)));
+      }
+      if (inst.op == Op::CMP && inst.type != Type::I1) error(block, "cmp must define an i1");
+      if (inst.op == Op::LOCAL && inst.type != Type::PTR) error(block, "local must define a ptr");
+      auto follows = [&] {
+        return index > 0 && insts[index - 1].op == Op::CALL && !inst.operands.empty() &&
+               insts[index - 1].dest == inst.operands.front();
+      };
+      if (inst.op == Op::RESULT && !follows()) {
+        error(block, fmt::format("'{}' does not follow its call", to_string(inst)));
+      }
+      defs[inst.dest] = std::make_pair(block, index);
+    }
+  }
+  if (!errors.empty()) return errors;
+
+  DominatorTree dom(func);
+  auto          preds = predecessors(func);
+
+  auto available = [&](VReg value, BlockId block, size_t index) {
+    if (!defs.at(value)) return false;
+    auto [defBlock, defIndex] = *defs[value];
+    if (defBlock == block) return defIndex < index;
+    return dom.dominates(defBlock, block);
+  };
+
+  for (auto block : dom.order()) {
+    const auto& insts = func.blocks[block].instructions;
+    for (size_t index = 0; index < insts.size(); ++index) {
+      const auto& inst = insts[index];
+
+      if (inst.op == Op::PHI) {
+        auto incoming = inst.blocks;
+        auto expected = preds[block];
+        std::sort(incoming.begin(), incoming.end());
+        std::sort(expected.begin(), expected.end());
+        if (inst.operands.size() != inst.blocks.size() || incoming != expected) {
+          error(block, fmt::format("'{}' does not match the predecessors", to_string(inst)));
+          continue;
+        }
+        for (size_t i = 0; i < inst.operands.size(); ++i) {
+          auto from = inst.blocks[i];
+          if (!available(inst.operands[i], from, func.blocks[from].instructions.size())) {
+            error(block,
+                  fmt::format("'{}' uses %{} where it is not defined", to_string(inst), inst.operands[i]));
+          }
+        }
+        continue;
+      }
+
+      for (auto operand : inst.operands) {
+        if (!available(operand, block, index)) {
+          error(block, fmt::format("'{}' uses %{} before its definition", to_string(inst), operand));
+        }
+      }
+    }
+  }
+
+  return errors;
+}
+
+auto verify(const Module& module) -> std::vector<std::string> {
+  std::vector<std::string> errors;
+  for (const auto& func : module.functions) {
+    auto funcErrors = verify(func);
+    errors.insert(errors.end(), funcErrors.begin(), funcErrors.end());
+  }
+  return errors;
+}
+}  // namespace kuso::ir
@@ -0,0 +1,731 @@
+/**
+ * @file x64_lowering.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "ir/x64_lowering.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+#include "generator/layout.hpp"
+#include "linux/linux.hpp"
+#include "x64/arithmetic.hpp"
+
+namespace kuso::ir {
+namespace {
+// slots are aligned relative to rbp, which is only 16 byte aligned
+constexpr int64_t MAX_SLOT_ALIGN = 16;
+
+auto set_op(Cond cond) -> x64::Op {
+  switch (cond) {
+    case Cond::EQ:
+      return x64::Op::SETE;
+    case Cond::NE:
+      return x64::Op::SETNE;
+    case Cond::LT:
+      return x64::Op::SETL;
+    case Cond::LE:
+      return x64::Op::SETLE;
+    case Cond::GT:
+      return x64::Op::SETG;
+    case Cond::GE:
+      return x64::Op::SETGE;
+  }
+  throw std::runtime_error("Invalid IR Condition");
+}
+
+auto jump_op(Cond cond) -> x64::Op {
+  switch (cond) {
+    case Cond::EQ:
+      return x64::Op::JE;
+    case Cond::NE:
+      return x64::Op::JNE;
+    case Cond::LT:
+      return x64::Op::JL;
+    case Cond::LE:
+      return x64::Op::JLE;
+    case Cond::GT:
+      return x64::Op::JG;
+    case Cond::GE:
+      return x64::Op::JGE;
+  }
+  throw std::runtime_error("Invalid IR Condition");
+}
+
+auto negate(Cond cond) -> Cond {
+  switch (cond) {
+    case Cond::EQ:
+      return Cond::NE;
+    case Cond::NE:
+      return Cond::EQ;
+    case Cond::LT:
+      return Cond::GE;
+    case Cond::LE:
+      return Cond::GT;
+    case Cond::GT:
+      return Cond::LE;
+    case Cond::GE:
+      return Cond::LT;
+  }
+  throw std::runtime_error("Invalid IR Condition");
+}
+
+auto binary_op(Op operation) -> x64::Op {
+  switch (operation) {
+    case Op::ADD:
+      return x64::Op::ADD;
+    case Op::SUB:
+      return x64::Op::SUB;
+    case Op::MUL:
+      return x64::Op::IMUL;
+    default:
+      break;
+  }
+  throw std::runtime_error("Invalid IR Binary Operation");
+}
+}  // namespace
+
+/**
+ * @brief Generates the assembly of a whole module
+ *
+ * @param module Module to generate from
+ * @return std::string assembly
+ */
+auto X64Lowering::generate(const Module& module) -> std::string {
+  _code = x64::InstructionBuffer();
+  _labels.clear();
+  _labelCount = 0;
+
+  size_t funcCount = 0;
+  for (const auto& func : module.functions) {
+    _labels[func.name] = _code.label(func.entry ? "_start" : fmt::format(".func_{}", funcCount++));
+  }
+
+  emit("global _start\nsection .text\n");
+  for (const auto& func : module.functions) generate(func);
+  if (_optimize) _peephole.run(_code);
+  return _code.render();
+}
+
+void X64Lowering::generate(const Function& func) {
+  _func = &func;
+  _allocation.emplace(func, !func.has_asm());
+  _frame = layout_frame(func);
+
+  _blockLabels.clear();
+  for (size_t block = 0; block < func.blocks.size(); ++block) _blockLabels.push_back(new_label());
+
+  _uses.assign(func.vregs.size(), 0);
+  for (const auto& block : func.blocks) {
+    for (const auto& inst : block.instructions) {
+      for (auto operand : inst.operands) ++_uses.at(operand);
+    }
+  }
+
+  emit(_labels.at(func.name));
+  if (_frame.frame) {
+    emit(x64::Op::PUSH, x64::Size::QWORD, x64::Register::RBP);
+    emit(x64::Op::MOV, x64::Register::RBP, x64::Register::RSP);
+    if (_frame.size > 0) emit(x64::Op::SUB, x64::Register::RSP, x64::Literal{_frame.size});
+  }
+  for (const auto& [reg, save] : _frame.saves) emit(x64::Op::MOV, save, reg);
+
+  _index = 0;
+  for (BlockId block = 0; block < func.blocks.size(); ++block) {
+    emit(_blockLabels[block]);
+    const auto& instructions = func.blocks[block].instructions;
+    for (size_t inst = 0; inst < instructions.size(); ++inst) {
+      parallel_move(_allocation->moves_before(_index));
+      if (tail_call(func, instructions, inst)) {
+        generate_tail_call(instructions[inst]);
+        _index += instructions.size() - inst;
+        break;
+      }
+      if (fused_branch(instructions, inst)) _flags = instructions[inst].cond;
+      generate(instructions[inst], block, block + 1);
+      ++_index;
+    }
+  }
+
+  _allocation.reset();
+  _func = nullptr;
+}
+
+/**
+ * @brief Generates a single instruction, operands are read at 2i and the value is written at 2i + 1
+ *
+ * @param inst Instruction to generate
+ * @param block Block the instruction is in
+ * @param next Block laid out after it, jumps to it fall through
+ */
+void X64Lowering::generate(const Instruction& inst, BlockId block, BlockId next) {
+  auto use = 2 * static_cast<int64_t>(_index);
+  auto operand = [&](size_t operand) { return location(inst.operands.at(operand), use); };
+  auto dest = [&]() { return location(inst.dest, use + 1); };
+
+  switch (inst.op) {
+    case Op::CONST:
+      move(dest(), Location::constant(inst.imm));
+      break;
+    case Op::PARAM: {
+      auto reg = x64::parameter_reg(static_cast<size_t>(inst.imm));
+      if (reg == x64::Register::NONE) {
+        // the caller pushes stack arguments in order, above the return address and saved rbp
+        auto remaining = static_cast<int64_t>(_frame.stackParams) - 1 - (inst.imm - 6);
+        load(dest(),
+             x64::Address{x64::Address::Mode::INDIRECT_DISPLACEMENT, x64::Register::RBP,
+                          (2 + remaining) * x64::Size::QWORD},
+             x64::Size::QWORD);
+        break;
+      }
+      move(dest(), Location::in_register(reg));
+      break;
+    }
+    case Op::LOCAL:
+      break;
+    case Op::LOAD:
+      load(dest(), address(inst, use), x64::access_size(inst.size));
+      break;
+    case Op::STORE: {
+      auto addr = address(inst, use);
+      auto value = operand(1);
+      auto reg = value.kind == Location::Kind::REGISTER ? value.reg : x64::Register::RAX;
+      move(reg, value);
+      emit(x64::Op::MOV, addr, x64::sized_register(reg, x64::access_size(inst.size)));
+      break;
+    }
+    case Op::ZEXT:
+      // the branch reads the flags of the compare
+      if (_flags) break;
+      [[fallthrough]];
+    case Op::COPY:
+      move(dest(), operand(0));
+      break;
+    case Op::ADD:
+    case Op::SUB:
+    case Op::MUL:
+      generate_binary(inst);
+      break;
+    case Op::DIV:
+    case Op::MOD: {
+      // the allocator keeps the divisor out of rdx
+      auto divisor = operand(1);
+      move(x64::Register::RAX, operand(0));
+      if (divisor.kind == Location::Kind::CONSTANT && x64::reduces_divide(divisor.value)) {
+        x64::divide(_code, divisor.value, inst.op == Op::MOD, x64::Register::R11);
+        move(dest(), Location::in_register(x64::Register::RAX));
+        break;
+      }
+      emit(x64::Op::CQO);
+      if (divisor.kind == Location::Kind::REGISTER) {
+        emit(x64::Op::IDIV, divisor.reg);
+      } else if (divisor.kind == Location::Kind::STACK) {
+        emit(x64::Op::IDIV, x64::Size::QWORD, spill_slot(divisor.value));
+      } else {
+        move(x64::Register::R11, divisor);
+        emit(x64::Op::IDIV, x64::Register::R11);
+      }
+      move(dest(), Location::in_register(inst.op == Op::DIV ? x64::Register::RAX : x64::Register::RDX));
+      break;
+    }
+    case Op::POW: {
+      auto exponent = operand(1);
+      if (exponent.kind == Location::Kind::CONSTANT) {
+        move(x64::Register::RAX, operand(0));
+        x64::power(_code, exponent.value, x64::Register::RDX);
+      } else {
+        move(x64::Register::R11, exponent);
+        move(x64::Register::RAX, operand(0));
+        auto loop = new_label();
+        auto skip = new_label();
+        auto done = new_label();
+        x64::power(_code, x64::Register::R11, x64::Register::RDX, loop, skip, done);
+      }
+      move(dest(), Location::in_register(x64::Register::RAX));
+      break;
+    }
+    case Op::NEG: {
+      auto result = dest();
+      auto reg = result.kind == Location::Kind::REGISTER ? result.reg : x64::Register::RAX;
+      move(reg, operand(0));
+      emit(x64::Op::NEG, reg);
+      move(result, Location::in_register(reg));
+      break;
+    }
+    case Op::CMP: {
+      auto lhs = operand(0);
+      auto reg = lhs.kind == Location::Kind::REGISTER ? lhs.reg : x64::Register::R11;
+      move(reg, lhs);
+      emit(x64::Op::CMP, reg, operand(1), x64::Register::RAX);
+      if (_flags) break;
+
+      auto result = dest();
+      auto target = result.kind == Location::Kind::REGISTER ? result.reg : x64::Register::RAX;
+      emit(set_op(inst.cond), x64::Register::AL);
+      emit(x64::Op::MOVZX, target, x64::Register::AL);
+      move(result, Location::in_register(target));
+      break;
+    }
+    case Op::PHI:
+      break;
+    case Op::CALL:
+      generate_call(inst);
+      break;
+    case Op::RESULT:
+      move(dest(), Location::in_register(x64::Register::RDX));
+      break;
+    case Op::ASM:
+      emit(inst.name);
+      break;
+    case Op::RET:
+      if (inst.operands.size() == 2) {
+        parallel_move({{Location::in_register(x64::Register::RAX), operand(0)},
+                       {Location::in_register(x64::Register::RDX), operand(1)}});
+      } else if (!inst.operands.empty()) {
+        move(x64::Register::RAX, operand(0));
+      }
+      generate_epilogue();
+      emit(x64::Op::RET);
+      break;
+    case Op::EXIT:
+      move(x64::Register::RDI, operand(0));
+      emit(x64::Op::MOV, x64::Register::RAX, x64::Literal{lnx::Syscall::EXIT});
+      emit(x64::Op::SYSCALL);
+      break;
+    case Op::JMP:
+      parallel_move(_allocation->edge_moves(block, inst.blocks.at(0)));
+      if (inst.blocks.at(0) != next) emit(x64::Op::JMP, _blockLabels.at(inst.blocks[0]));
+      break;
+    case Op::BR: {
+      auto onTrue = inst.blocks.at(0);
+      auto onFalse = inst.blocks.at(1);
+      auto trueMoves = _allocation->edge_moves(block, onTrue);
+      auto trueLabel = trueMoves.empty() ? _blockLabels.at(onTrue) : new_label();
+
+      auto falseMoves = _allocation->edge_moves(block, onFalse);
+
+      auto cond = _flags.value_or(Cond::NE);
+      if (!_flags) {
+        auto value = operand(0);
+        auto reg = value.kind == Location::Kind::REGISTER ? value.reg : x64::Register::RAX;
+        move(reg, value);
+        emit(x64::Op::TEST, reg, reg);
+      }
+      _flags.reset();
+
+      // the guard of a rotated loop falls through into its body
+      if (onTrue == next && trueMoves.empty() && falseMoves.empty()) {
+        emit(jump_op(negate(cond)), _blockLabels.at(onFalse));
+        break;
+      }
+
+      emit(jump_op(cond), trueLabel);
+      parallel_move(std::move(falseMoves));
+      if (onFalse != next || !trueMoves.empty()) emit(x64::Op::JMP, _blockLabels.at(onFalse));
+
+      // edges that need moves get their own trampoline
+      if (!trueMoves.empty()) {
+        emit(trueLabel);
+        parallel_move(std::move(trueMoves));
+        emit(x64::Op::JMP, _blockLabels[onTrue]);
+      }
+      break;
+    }
+  }
+}
+
+/**
+ * @brief Checks if a compare only feeds the branch right after it, possibly through a ZEXT
+ *
+ * The compare then sets the flags for the branch to jump on directly, nothing may be moved between
+ * them since moves can clobber the flags once the peephole pass turns them into xor.
+ *
+ * @param instructions Instructions of the block
+ * @param index Position of the compare in the block
+ * @return true If the compare and the branch are generated as cmp and jcc
+ */
+auto X64Lowering::fused_branch(const std::vector<Instruction>& instructions, size_t index) const -> bool {
+  if (instructions[index].op != Op::CMP) return false;
+
+  auto value = instructions[index].dest;
+  for (auto inst = index + 1; inst < instructions.size(); ++inst) {
+    const auto& user = instructions[inst];
+    if (_uses.at(value) != 1 || user.operands.empty() || user.operands.front() != value) return false;
+    if (!_allocation->moves_before(_index + inst - index).empty()) return false;
+    if (user.op == Op::BR) return true;
+    if (user.op != Op::ZEXT) return false;
+    value = user.dest;
+  }
+  return false;
+}
+
+/**
+ * @brief Generates ADD, SUB and MUL straight into the destination register when there is one
+ *
+ */
+void X64Lowering::generate_binary(const Instruction& inst) {
+  auto use = 2 * static_cast<int64_t>(_index);
+  auto lhs = location(inst.operands.at(0), use);
+  auto rhs = location(inst.operands.at(1), use);
+  auto dest = location(inst.dest, use + 1);
+  auto reg = dest.kind == Location::Kind::REGISTER ? dest.reg : x64::Register::RAX;
+
+  // a constant factor is multiplied in with shifts or lea where they beat imul
+  auto reduced = [](const Location& operand) {
+    return operand.kind == Location::Kind::CONSTANT && x64::reduces_multiply(operand.value);
+  };
+  if (inst.op == Op::MUL && (reduced(rhs) || reduced(lhs))) {
+    auto constantRight = reduced(rhs);
+    move(reg, constantRight ? lhs : rhs);
+    x64::multiply(_code, reg, constantRight ? rhs.value : lhs.value);
+    move(dest, Location::in_register(reg));
+    return;
+  }
+
+  // the right operand already sits in the destination, only the commutative operations can use it
+  if (rhs.kind == Location::Kind::REGISTER && rhs.reg == reg) {
+    if (inst.op != Op::SUB) {
+      emit(binary_op(inst.op), reg, lhs, x64::Register::R11);
+      return;
+    }
+    reg = x64::Register::RAX;
+  }
+
+  move(reg, lhs);
+  emit(binary_op(inst.op), reg, rhs, x64::Register::R11);
+  move(dest, Location::in_register(reg));
+}
+
+/**
+ * @brief Generates a call, the first six arguments go in registers and the rest are pushed in order
+ *
+ * @param inst Call to generate
+ */
+void X64Lowering::generate_call(const Instruction& inst) {
+  auto label = _labels.find(inst.name);
+  if (label == _labels.end()) throw std::runtime_error("Unknown Function " + inst.name);
+
+  auto                          use = 2 * static_cast<int64_t>(_index);
+  int64_t                       stackArgs = 0;
+  std::vector<LinearScan::Move> args;
+  for (size_t i = 0; i < inst.operands.size(); ++i) {
+    auto arg = location(inst.operands[i], use);
+    auto reg = x64::parameter_reg(i);
+    if (reg != x64::Register::NONE) {
+      args.emplace_back(Location::in_register(reg), arg);
+      continue;
+    }
+
+    if (arg.kind == Location::Kind::STACK) {
+      emit(x64::Op::PUSH, x64::Size::QWORD, spill_slot(arg.value));
+    } else {
+      auto value = arg.kind == Location::Kind::REGISTER ? arg.reg : x64::Register::RAX;
+      move(value, arg);
+      emit(x64::Op::PUSH, x64::Size::QWORD, value);
+    }
+    ++stackArgs;
+  }
+  parallel_move(std::move(args));
+
+  emit(x64::Op::CALL, label->second);
+  if (stackArgs > 0) emit(x64::Op::ADD, x64::Register::RSP, x64::Literal{stackArgs * x64::Size::QWORD});
+  if (inst.dest != NO_VREG) move(location(inst.dest, use + 2), Location::in_register(x64::Register::RAX));
+}
+
+/**
+ * @brief Generates a call whose result is returned right away, the callee takes over the frame and returns
+ * for it. A call of the function to itself jumps back to its entry block instead, the parameters are read
+ * from their registers again.
+ *
+ * @param inst Call to generate, the return after it is not generated
+ */
+void X64Lowering::generate_tail_call(const Instruction& inst) {
+  auto label = _labels.find(inst.name);
+  if (label == _labels.end()) throw std::runtime_error("Unknown Function " + inst.name);
+
+  auto                          use = 2 * static_cast<int64_t>(_index);
+  std::vector<LinearScan::Move> args;
+  for (size_t i = 0; i < inst.operands.size(); ++i) {
+    args.emplace_back(Location::in_register(x64::parameter_reg(i)), location(inst.operands[i], use));
+  }
+  parallel_move(std::move(args));
+
+  if (inst.name == _func->name) {
+    emit(x64::Op::JMP, _blockLabels.front());
+    return;
+  }
+  generate_epilogue();
+  emit(x64::Op::JMP, label->second);
+}
+
+/**
+ * @brief Checks if a call is in tail position, directly followed by a return of its result
+ *
+ * Every argument has to go in a register, stack arguments would overwrite the caller's own. The entry
+ * block is only jumped back to if it has no phis.
+ *
+ * @param func Function the call is in
+ * @param instructions Instructions of the block
+ * @param index Position of the call in the block
+ * @return true If the call and the return after it are generated as a jump
+ */
+auto X64Lowering::tail_call(const Function& func, const std::vector<Instruction>& instructions,
+                            size_t index) const -> bool {
+  const auto& call = instructions[index];
+  if (call.op != Op::CALL || index + 1 >= instructions.size() || _labels.count(call.name) == 0) return false;
+  if (!call.operands.empty() && x64::parameter_reg(call.operands.size() - 1) == x64::Register::NONE) {
+    return false;
+  }
+
+  const auto& ret = instructions[index + 1];
+  if (ret.op != Op::RET || ret.operands.size() > 1) return false;
+  if (!ret.operands.empty() && ret.operands.front() != call.dest) return false;
+  if (call.name != func.name) return true;
+
+  const auto& entry = func.blocks.front().instructions;
+  return entry.empty() || entry.front().op != Op::PHI;
+}
+
+/**
+ * @brief Restores the callee saved registers and the caller's frame
+ *
+ */
+void X64Lowering::generate_epilogue() {
+  for (const auto& [reg, save] : _frame.saves) emit(x64::Op::MOV, reg, save);
+  if (_frame.frame) emit(x64::Op::LEAVE);
+}
+
+/**
+ * @brief Gives every LOCAL its own aligned storage and every spilled value an 8 byte slot
+ *
+ * Callee saved registers the allocator used or inline assembly names get a slot too, except in the entry
+ * function
+ */
+auto X64Lowering::layout_frame(const Function& func) -> Frame {
+  Frame frame;
+  frame.locals.assign(func.vregs.size(), 0);
+
+  int64_t offset = 0;
+  auto    allocate = [&](int64_t size, int64_t align) {
+    align = std::min(std::max<int64_t>(align, 1), MAX_SLOT_ALIGN);
+    offset = Layout::align_to(offset + size, align);
+    return -offset;
+  };
+  auto save = [&](x64::Register reg) {
+    if (func.entry || !x64::is_callee_saved(reg) || reg == x64::Register::RBP) return;
+    if (frame.saves.contains(reg)) return;
+    frame.saves[reg] = x64::Address{x64::Address::Mode::INDIRECT_DISPLACEMENT, x64::Register::RBP,
+                                    allocate(x64::Size::QWORD, x64::Size::QWORD)};
+  };
+
+  for (auto reg : _allocation->used_registers()) save(reg);
+  for (const auto& block : func.blocks) {
+    for (const auto& inst : block.instructions) {
+      if (inst.op == Op::PARAM && x64::parameter_reg(static_cast<size_t>(inst.imm)) == x64::Register::NONE) {
+        frame.frame = true;
+      }
+      if (inst.op == Op::ASM) {
+        auto usage = x64::scan_asm(inst.name);
+        for (size_t reg = 0; reg < x64::REGISTER_COUNT; ++reg) {
+          if (usage.regs.at(reg)) save(static_cast<x64::Register>(reg));
+        }
+      }
+      if (inst.op == Op::LOCAL) frame.locals.at(inst.dest) = allocate(inst.size, inst.imm);
+    }
+  }
+  for (int64_t slot = 0; slot < _allocation->spill_slots(); ++slot) {
+    frame.spills.push_back(allocate(x64::Size::QWORD, x64::Size::QWORD));
+  }
+
+  frame.stackParams = func.params.size() > 6 ? func.params.size() - 6 : 0;
+  frame.size = Layout::align_to(offset, MAX_SLOT_ALIGN);
+  frame.frame = frame.frame || frame.size > 0;
+  return frame;
+}
+
+auto X64Lowering::location(VReg vreg, int64_t pos) const -> Location {
+  return _allocation->location(vreg, pos);
+}
+
+auto X64Lowering::local_slot(VReg vreg) const -> x64::Address {
+  return x64::Address{x64::Address::Mode::INDIRECT_DISPLACEMENT, x64::Register::RBP, _frame.locals.at(vreg)};
+}
+
+auto X64Lowering::spill_slot(int64_t slot) const -> x64::Address {
+  return x64::Address{x64::Address::Mode::INDIRECT_DISPLACEMENT, x64::Register::RBP,
+                      _frame.spills.at(static_cast<size_t>(slot))};
+}
+
+/**
+ * @brief Gets the memory operand of a LOAD or STORE, LOCAL addresses are folded into the displacement
+ *
+ */
+auto X64Lowering::address(const Instruction& inst, int64_t pos) -> x64::Address {
+  auto base = location(inst.operands.at(0), pos);
+  if (base.kind == Location::Kind::LOCAL) return local_slot(inst.operands[0]) + static_cast<int>(inst.imm);
+
+  auto reg = base.kind == Location::Kind::REGISTER ? base.reg : x64::Register::R11;
+  move(reg, base);
+  return x64::Address{x64::Address::Mode::INDIRECT_DISPLACEMENT, reg, inst.imm};
+}
+
+auto X64Lowering::new_label() -> x64::LabelId { return _code.label(fmt::format("label_{}", _labelCount++)); }
+
+/**
+ * @brief Moves a value between locations, memory to memory moves go through r11
+ *
+ * Nothing is ever moved into a constant, it is rematerialized where it is used
+ */
+void X64Lowering::move(const Location& dest, const Location& src) {
+  if (dest == src || dest.kind == Location::Kind::CONSTANT || dest.kind == Location::Kind::NONE) return;
+
+  if (dest.kind == Location::Kind::STACK) {
+    auto reg = src.kind == Location::Kind::REGISTER ? src.reg : x64::Register::R11;
+    move(reg, src);
+    emit(x64::Op::MOV, spill_slot(dest.value), reg);
+    return;
+  }
+
+  switch (src.kind) {
+    case Location::Kind::REGISTER:
+      emit(x64::Op::MOV, dest.reg, src.reg);
+      break;
+    case Location::Kind::STACK:
+      emit(x64::Op::MOV, dest.reg, spill_slot(src.value));
+      break;
+    case Location::Kind::CONSTANT:
+      emit(x64::Op::MOV, dest.reg, x64::Literal{src.value});
+      break;
+    case Location::Kind::LOCAL:
+      emit(x64::Op::LEA, dest.reg, local_slot(static_cast<VReg>(src.value)));
+      break;
+    case Location::Kind::NONE:
+      throw std::runtime_error("Value without a location");
+  }
+}
+
+void X64Lowering::move(x64::Register reg, const Location& src) { move(Location::in_register(reg), src); }
+
+/**
+ * @brief Performs moves that happen at the same time, cycles are broken through rax
+ *
+ * @param moves Moves as destination, source
+ */
+void X64Lowering::parallel_move(std::vector<LinearScan::Move> moves) {
+  std::erase_if(moves, [](const LinearScan::Move& move) {
+    return move.first == move.second || move.first.kind == Location::Kind::CONSTANT;
+  });
+
+  while (!moves.empty()) {
+    auto ready = std::find_if(moves.begin(), moves.end(), [&](const LinearScan::Move& move) {
+      return std::none_of(moves.begin(), moves.end(),
+                          [&](const LinearScan::Move& other) { return other.second == move.first; });
+    });
+    if (ready != moves.end()) {
+      move(ready->first, ready->second);
+      moves.erase(ready);
+      continue;
+    }
+
+    // every destination is still read by another move, park one of them
+    auto parked = moves.front().first;
+    move(x64::Register::RAX, parked);
+    for (auto& other : moves) {
+      if (other.second == parked) other.second = Location::in_register(x64::Register::RAX);
+    }
+  }
+}
+
+/**
+ * @brief Loads memory into a location, sign extending accesses smaller than a QWORD
+ *
+ */
+void X64Lowering::load(const Location& dest, x64::Address src, x64::Size size) {
+  auto reg = dest.kind == Location::Kind::REGISTER ? dest.reg : x64::Register::RAX;
+  if (size == x64::Size::QWORD) {
+    emit(x64::Op::MOV, reg, src);
+  } else {
+    emit(size == x64::Size::DWORD ? x64::Op::MOVSXD : x64::Op::MOVSX, reg, size, src);
+  }
+  move(dest, Location::in_register(reg));
+}
+
+void X64Lowering::emit(const std::string& value) { _code.text(value); }
+
+void X64Lowering::emit(x64::LabelId label) { _code.define(label); }
+
+void X64Lowering::emit(x64::Op operation) { _code.emit(operation); }
+
+void X64Lowering::emit(x64::Op operation, x64::LabelId label) {
+  _code.emit(operation, x64::Operand::label(label));
+}
+
+void X64Lowering::emit(x64::Op operation, x64::Register reg) {
+  _code.emit(operation, x64::Operand::from(reg));
+}
+
+void X64Lowering::emit(x64::Op operation, x64::Size size, x64::Register reg) {
+  _code.emit(operation, x64::Operand::from(reg).with_size(size));
+}
+
+void X64Lowering::emit(x64::Op operation, x64::Size size, x64::Address addr) {
+  _code.emit(operation, x64::Operand::from(addr).with_size(size));
+}
+
+void X64Lowering::emit(x64::Op operation, x64::Register dest, x64::Register src) {
+  _code.emit(operation, x64::Operand::from(dest), x64::Operand::from(src));
+}
+
+void X64Lowering::emit(x64::Op operation, x64::Register dest, x64::Address src) {
+  _code.emit(operation, x64::Operand::from(dest), x64::Operand::from(src));
+}
+
+void X64Lowering::emit(x64::Op operation, x64::Register dest, x64::Size size, x64::Address src) {
+  _code.emit(operation, x64::Operand::from(dest), x64::Operand::from(src).with_size(size));
+}
+
+void X64Lowering::emit(x64::Op operation, x64::Address dest, x64::Register src) {
+  _code.emit(operation, x64::Operand::from(dest), x64::Operand::from(src));
+}
+
+void X64Lowering::emit(x64::Op operation, x64::Register dest, x64::Literal value) {
+  _code.emit(operation, x64::Operand::from(dest), x64::Operand::from(value));
+}
+
+/**
+ * @brief Emits an operation with an allocated source, constants that don't fit an immediate and LOCAL
+ * addresses go through the scratch register
+ *
+ */
+void X64Lowering::emit(x64::Op operation, x64::Register dest, const Location& src, x64::Register scratch) {
+  switch (src.kind) {
+    case Location::Kind::REGISTER:
+      emit(operation, dest, src.reg);
+      return;
+    case Location::Kind::STACK:
+      emit(operation, dest, spill_slot(src.value));
+      return;
+    case Location::Kind::CONSTANT:
+      if (x64::fits_immediate(src.value)) {
+        emit(operation, dest, x64::Literal{src.value});
+        return;
+      }
+      break;
+    case Location::Kind::LOCAL:
+      break;
+    case Location::Kind::NONE:
+      throw std::runtime_error("Value without a location");
+  }
+  move(scratch, src);
+  emit(operation, dest, scratch);
+}
+}  // namespace kuso::ir
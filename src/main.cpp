@@ -9,12 +9,110 @@
  * See file LICENSE for the full License
  */
 
+#include <algorithm>
+#include <charconv>
+
+#include "generator/argument_splitting.hpp"
+#include "generator/constant_folding.hpp"
+#include "generator/dead_code.hpp"
 #include "generator/generator.hpp"
+#include "generator/layout.hpp"
+#include "generator/loop_invariants.hpp"
+#include "generator/loop_unrolling.hpp"
+#include "ir/dead_code.hpp"
+#include "ir/inliner.hpp"
+#include "ir/lowering.hpp"
+#include "ir/scalar_replacement.hpp"
+#include "ir/slot_promotion.hpp"
+#include "ir/value_numbering.hpp"
+#include "ir/verifier.hpp"
+#include "ir/x64_lowering.hpp"
 #include "logging/logging.hpp"
 #include "parser/parser.hpp"
+#include "setup/pipeline.hpp"
 #include "setup/setup.hpp"
 #include "types/arg_types.hpp"
 
+namespace {
+using Pass = kuso::Pipeline::Pass;
+
+/**
+ * @brief Picks the pipeline from -passes or the optimization level, -O2 when neither is given
+ * 
+ * @return Pipeline the passes to run
+ */
+auto select_pipeline() -> kuso::Pipeline {
+  std::string level;
+  for (const auto* flag : {"O0", "O1", "O2", "Os"}) {
+    if (!pirate::Args::has(flag)) continue;
+    if (!level.empty()) throw std::runtime_error("Only one of -O0, -O1, -O2 and -Os can be given");
+    level = std::string(flag).substr(1);
+  }
+
+  if (!pirate::Args::has("passes")) return kuso::Pipeline::level(level.empty() ? "2" : level);
+  if (!level.empty()) throw std::runtime_error("-passes replaces the optimization level, give only one");
+  return kuso::Pipeline::parse(pirate::Args::get("passes"));
+}
+
+/**
+ * @brief Compiles through the SSA IR, writing either the IR itself or the assembly generated from it
+ * 
+ * @param ast AST to compile
+ * @param outpath Path of the output file
+ * @param emitIR true to write the IR instead of assembly
+ * @param pipeline Passes to run on the IR
+ * @return int exit code
+ */
+auto compile_ssa(const kuso::AST& ast, const std::filesystem::path& outpath, bool emitIR,
+                 const kuso::Pipeline& pipeline) -> int {
+  kuso::ir::Lowering lowering;
+  auto               module = lowering.lower(ast);
+  if (!module) return -1;
+
+  kuso::ir::Inliner inliner(pipeline.optimize_size() ? kuso::ir::Inliner::SIZE_THRESHOLD
+                                                     : kuso::ir::Inliner::THRESHOLD);
+  kuso::ir::ScalarReplacement scalarReplacement;
+  kuso::ir::SlotPromotion      slotPromotion;
+  kuso::ir::ValueNumbering     valueNumbering;
+  kuso::ir::DeadCode           deadCode;
+  for (auto pass : pipeline.passes()) {
+    if (pass == Pass::INLINE) inliner.run(module.value());
+    if (pass == Pass::SROA) scalarReplacement.run(module.value());
+    if (pass == Pass::MEM2REG) slotPromotion.run(module.value());
+    if (pass == Pass::GVN) valueNumbering.run(module.value());
+    if (pass == Pass::IR_DEAD_CODE) deadCode.run(module.value());
+  }
+
+  auto errors = kuso::ir::verify(module.value());
+  for (const auto& error : errors) kuso::Logging::error(error);
+  if (!errors.empty()) return -1;
+
+  kuso::ir::X64Lowering x64Lowering(pipeline.has(Pass::PEEPHOLE));
+  try {
+    auto output = emitIR ? kuso::ir::to_string(module.value()) : x64Lowering.generate(module.value());
+
+    belt::File outputFile(outpath, std::ios_base::out | std::ios_base::trunc);
+    if (!outputFile.is_open()) throw std::runtime_error("Failed to open output file");
+    outputFile.write(output);
+  } catch (std::exception& e) {
+    kuso::Logging::error(e.what());
+    return -1;
+  }
+
+  if (pirate::Args::has("layout-report")) fmt::print("{}", kuso::Layout::report(lowering.types()));
+  if (pirate::Args::has("inline-report")) fmt::print("{}", inliner.report());
+  if (pirate::Args::has("stats")) {
+    fmt::print("{}{}{}{}{}", inliner.to_string(), scalarReplacement.to_string(), slotPromotion.to_string(),
+               valueNumbering.to_string(), deadCode.to_string());
+  }
+  if (pirate::Args::has("stats") && !emitIR) fmt::print("{}", x64Lowering.peephole().to_string());
+  if (pirate::Args::has("stack-report")) {
+    kuso::Logging::warn("-stack-report is only available with -backend=ast");
+  }
+  return 0;
+}
+}  // namespace
+
 auto main(int argc, const char** argv) -> int {
   if (!kuso::initialize(argc, argv)) return 0;
 
@@ -26,10 +124,82 @@ auto main(int argc, const char** argv) -> int {
   kuso::Parser parser;
   auto         ast = parser.parse(inpath);
 
+  auto emit = pirate::Args::get("emit");
+  auto backend = pirate::Args::has("backend") ? pirate::Args::get("backend") : std::string();
+  if (emit != "asm" && emit != "ir") {
+    kuso::Logging::error("Unknown output " + emit + ", expected asm or ir");
+    return -1;
+  }
+  if (!backend.empty() && backend != "ast" && backend != "ssa") {
+    kuso::Logging::error("Unknown backend " + backend + ", expected ast or ssa");
+    return -1;
+  }
+
+  auto    unroll = pirate::Args::get("unroll");
+  int64_t factor = 0;
+  auto [end, error] = std::from_chars(unroll.data(), unroll.data() + unroll.size(), factor);
+  if (error != std::errc() || end != unroll.data() + unroll.size() || factor < 1) {
+    kuso::Logging::error("Unknown unroll factor " + unroll + ", expected a positive number");
+    return -1;
+  }
+
+  kuso::Pipeline pipeline;
+  try {
+    pipeline = select_pipeline();
+  } catch (std::exception& e) {
+    kuso::Logging::error(e.what());
+    return -1;
+  }
+
+  // without -backend the passes on the SSA IR, which every level from -O1 has, pick the backend they run on
+  auto onIR = [](Pass pass) { return !kuso::Pipeline::on_ast(pass) && pass != Pass::PEEPHOLE; };
+  if (backend.empty()) backend = std::ranges::any_of(pipeline.passes(), onIR) ? "ssa" : "ast";
+
+  if (ast) {
+    try {
+      kuso::ArgumentSplitting splitting;
+      splitting.run(ast.value());
+    } catch (std::exception& e) {
+      kuso::Logging::error(e.what());
+      return -1;
+    }
+  }
+
+  kuso::ConstantFolding folding;
+  kuso::DeadCode        deadCode;
+  kuso::LoopInvariants  loopInvariants;
+  kuso::LoopUnrolling   loopUnrolling(factor);
+  if (ast) {
+    for (auto pass : pipeline.passes()) {
+      if (pass == Pass::FOLD) folding.run(ast.value());
+      if (pass == Pass::DEAD_CODE) deadCode.run(ast.value());
+      if (pass == Pass::LICM) loopInvariants.run(ast.value());
+      if (pass == Pass::UNROLL) loopUnrolling.run(ast.value());
+    }
+    if (pirate::Args::has("stats")) {
+      fmt::print("{}{}{}{}", folding.to_string(), deadCode.to_string(), loopInvariants.to_string(),
+                 loopUnrolling.to_string());
+    }
+  }
+
+  if (ast && (backend == "ssa" || emit == "ir")) {
+    kuso::Logging::debug(ast->to_string());
+    return compile_ssa(ast.value(), outpath, emit == "ir", pipeline);
+  }
+
   if (ast) {
-    kuso::Generator generator(outpath);
+    kuso::Generator generator(outpath, pipeline.has(Pass::PEEPHOLE));
     kuso::Logging::debug(ast->to_string());
     generator.generate(ast.value());
+    if (pirate::Args::has("stack-report")) fmt::print("{}", generator.stack_analysis().to_string());
+    if (pirate::Args::has("layout-report")) fmt::print("{}", kuso::Layout::report(generator.types()));
+    if (pirate::Args::has("inline-report")) {
+      kuso::Logging::warn("-inline-report is only available with -backend=ssa");
+    }
+    if (std::ranges::any_of(pipeline.passes(), onIR)) {
+      kuso::Logging::warn("inline, sroa, mem2reg, gvn and ir-dce only run with -backend=ssa");
+    }
+    if (pirate::Args::has("stats")) fmt::print("{}", generator.peephole().to_string());
     return 0;
   }
 
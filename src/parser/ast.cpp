@@ -37,6 +37,7 @@ auto AST::to_string() const -> std::string {
         [&result](const std::unique_ptr<AST::ASM>& ASM) { result += ASM->to_string(0); },
         [&result](const std::unique_ptr<Declaration>& declaration) { result += declaration->to_string(0); },
         [&result](const std::unique_ptr<While>& while_) { result += while_->to_string(0); },
+        [&result](const std::unique_ptr<Destructure>& destructure) { result += destructure->to_string(0); },
         [&result](std::nullptr_t) { result += "null\n"; });
   }
   return result;
@@ -136,7 +137,19 @@ auto AST::Declaration::to_string(int indent) const -> std::string {
  * @return std::string string representation
  */
 auto AST::Return::to_string(int indent) const -> std::string {
-  return fmt::format("\n{: >{}}Return:", "", indent) + (value ? value->to_string(indent + 1) : "");
+  return fmt::format("\n{: >{}}Return:", "", indent) + (value ? value->to_string(indent + 1) : "") +
+         (second ? second->to_string(indent + 1) : "");
+}
+
+/**
+ * @brief returns the string representation of the destructuring declaration
+ * 
+ * @param indent spaces to indent
+ * @return std::string string representation
+ */
+auto AST::Destructure::to_string(int indent) const -> std::string {
+  return fmt::format("\n{: >{}}Destructure:", "", indent) + targets[0]->to_string(indent + 1) +
+         targets[1]->to_string(indent + 1) + call->to_string(indent + 1);
 }
 
 /**
@@ -182,6 +195,7 @@ auto AST::Statement::to_string(int indent) const -> std::string {
       [&](const std::unique_ptr<If>& if_) { return if_->to_string(indent); },
       [&](const std::unique_ptr<Exit>& exit) { return exit->to_string(indent); },
       [&](const std::unique_ptr<Declaration>& declaration) { return declaration->to_string(indent); },
+      [&](const std::unique_ptr<Destructure>& destructure) { return destructure->to_string(indent); },
       [&](const std::unique_ptr<Func>& func) { return func->to_string(indent); },
       [&](const std::unique_ptr<Call>& call) { return call->to_string(indent); },
       [&](const std::unique_ptr<Return>& return_) { return return_->to_string(indent); },
@@ -198,7 +212,12 @@ auto AST::Statement::to_string(int indent) const -> std::string {
  * @return std::string string representation
  */
 auto AST::While::to_string(int indent) const -> std::string {
-  std::string ret = fmt::format("\n{: >{}}While:", "", indent) + condition->to_string(indent + 1) + ":\n";
+  std::string ret = fmt::format("\n{: >{}}While:", "", indent) + condition->to_string(indent + 1);
+  for (const auto& annotation : annotations) {
+    ret += " @" + annotation.name;
+    if (annotation.value) ret += fmt::format("({})", annotation.value.value());
+  }
+  ret += ":\n";
   for (const auto& statement : body) {
     ret += statement.to_string(indent + 1);
   }
@@ -301,7 +320,12 @@ auto AST::Func::to_string(int indent) const -> std::string {
   for (const auto& arg : args) {
     ret += arg->to_string(indent + 1) + ", ";
   }
-  ret += "):\n";
+  ret += ")";
+  for (const auto& annotation : annotations) {
+    ret += " @" + annotation.name;
+    if (annotation.value) ret += fmt::format("({})", annotation.value.value());
+  }
+  ret += ":\n";
   for (const auto& statement : body) {
     ret += statement.to_string(indent + 1);
   }
@@ -340,7 +364,12 @@ auto AST::Terminal::to_string(int indent) const -> std::string {
  * @return std::string string representation
  */
 auto AST::Type::to_string(int indent) const -> std::string {
-  return fmt::format("\n{: >{}}Type:", "", indent) + name;
+  std::string str = fmt::format("\n{: >{}}Type:", "", indent) + name;
+  for (const auto& annotation : annotations) {
+    str += " @" + annotation.name;
+    if (annotation.value) str += fmt::format("({})", annotation.value.value());
+  }
+  return str;
 }
 
 /**
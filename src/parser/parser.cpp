@@ -16,6 +16,7 @@
 #include <iostream>
 #include <memory>
 #include <stdexcept>
+#include <string_view>
 
 #include <fmt/format.h>
 
@@ -130,6 +131,9 @@ auto Parser::parse_statement(Token& token, Tokens& tokens) -> AST::Statement {
       }
       syntax_error(token, Token(Token::Type::COLON));
       break;
+    case Token::Type::OPEN_PAREN:
+      statement.statement = parse_destructure(token, tokens);
+      break;
     case Token::Type::ASM:
       statement.statement = parse_asm(token, tokens);
       break;
@@ -211,6 +215,7 @@ auto Parser::parse_type(Token& token, Tokens& tokens) -> std::unique_ptr<AST::Ty
 
   match({Token::Type::IDENTIFIER}, token, tokens);
   type->name = token.value;
+  type->annotations = parse_annotations(token, tokens);
 
   match({Token::Type::OPEN_BRACE}, token, tokens);
 
@@ -243,6 +248,34 @@ auto Parser::parse_attribute(Token& token, Tokens& tokens) -> AST::Attribute {
   return attribute;
 }
 
+/**
+ * @brief Parses a list of annotations, each one is `@name` optionally followed by `(number)`
+ * 
+ * @param token token found
+ * @param tokens list of tokens
+ * @return std::vector<AST::Annotation> 
+ */
+auto Parser::parse_annotations(Token& token, Tokens& tokens) -> std::vector<AST::Annotation> {
+  std::vector<AST::Annotation> annotations;
+
+  while (try_match({Token::Type::AT}, token, tokens)) {
+    auto annotation = AST::Annotation{};
+
+    match({Token::Type::IDENTIFIER}, token, tokens);
+    annotation.name = token.value;
+
+    if (try_match({Token::Type::OPEN_PAREN}, token, tokens)) {
+      match({Token::Type::NUMBER}, token, tokens);
+      annotation.value = std::stoll(token.value);
+      match({Token::Type::CLOSE_PAREN}, token, tokens);
+    }
+
+    annotations.push_back(annotation);
+  }
+
+  return annotations;
+}
+
 /**
  * @brief Parses an expression
  * 
@@ -353,7 +386,8 @@ auto Parser::parse_factor(Token& token, Tokens& tokens) -> std::unique_ptr<AST::
   auto factor = std::make_unique<AST::Factor>();
   factor->left = parse_unary(token, tokens);
 
-  while (try_match({Token::Type::ASTERISK, Token::Type::SLASH, Token::Type::PERCENT}, token, tokens)) {
+  while (try_match({Token::Type::ASTERISK, Token::Type::SLASH, Token::Type::PERCENT, Token::Type::CARET},
+                   token, tokens)) {
     switch (token.type) {
       case Token::Type::ASTERISK:
         factor->op = AST::BinaryOp::MUL;
@@ -364,6 +398,9 @@ auto Parser::parse_factor(Token& token, Tokens& tokens) -> std::unique_ptr<AST::
       case Token::Type::PERCENT:
         factor->op = AST::BinaryOp::MOD;
         break;
+      case Token::Type::CARET:
+        factor->op = AST::BinaryOp::POW;
+        break;
       default:
         break;
     }
@@ -384,18 +421,10 @@ auto Parser::parse_unary(Token& token, Tokens& tokens) -> std::unique_ptr<AST::U
   // std::cout << "parse_unary\n";
   auto unary = std::make_unique<AST::Unary>();
 
-  while (try_match({Token::Type::MINUS, Token::Type::EXCLAMATION}, token, tokens)) {
-    switch (token.type) {
-      case Token::Type::MINUS:
-        unary->op = AST::BinaryOp::SUB;
-        break;
-      case Token::Type::EXCLAMATION:
-        unary->op = AST::BinaryOp::NOT;
-        break;
-      default:
-        break;
-    }
+  if (try_match({Token::Type::MINUS, Token::Type::EXCLAMATION}, token, tokens)) {
+    unary->op = token.type == Token::Type::MINUS ? AST::BinaryOp::SUB : AST::BinaryOp::NOT;
     unary->value = parse_unary(token, tokens);
+    return unary;
   }
   unary->value = parse_primary(token, tokens);
 
@@ -498,6 +527,7 @@ auto Parser::parse_while(Token& token, Tokens& tokens) -> std::unique_ptr<AST::W
   whileStatement->condition = parse_expression(token, tokens);
 
   match({Token::Type::CLOSE_PAREN}, token, tokens);
+  whileStatement->annotations = parse_annotations(token, tokens);
   match({Token::Type::OPEN_BRACE}, token, tokens);
   token = consume(tokens);
 
@@ -557,8 +587,28 @@ auto Parser::parse_func(Token& token, Tokens& tokens) -> std::unique_ptr<AST::Fu
   }
 
   match({Token::Type::ARROW}, token, tokens);
-  match({Token::Type::IDENTIFIER}, token, tokens);
-  func->returnType = token.value;
+  if (try_match({Token::Type::OPEN_PAREN}, token, tokens)) {
+    for (size_t i = 0; i < 2; ++i) {
+      if (i > 0) match({Token::Type::COMMA}, token, tokens);
+      match({Token::Type::IDENTIFIER}, token, tokens);
+      func->tuple.push_back(token.value);
+    }
+    match({Token::Type::CLOSE_PAREN}, token, tokens);
+    func->returnType = fmt::format("({}, {})", func->tuple[0], func->tuple[1]);
+  } else {
+    match({Token::Type::IDENTIFIER}, token, tokens);
+    func->returnType = token.value;
+  }
+  func->annotations = parse_annotations(token, tokens);
+  auto annotated = [&func](std::string_view name) {
+    return std::any_of(func->annotations.begin(), func->annotations.end(),
+                       [name](const AST::Annotation& annotation) { return annotation.name == name; });
+  };
+  if (annotated("inline") && annotated("noinline")) {
+    throw ParseError(fmt::format("Syntax Error: Line {} Column {}\n"
+                                 "Conflicting Annotations @inline and @noinline on {}",
+                                 token.line, token.column, func->name));
+  }
 
   match({Token::Type::OPEN_BRACE}, token, tokens);
   token = consume(tokens);
@@ -651,10 +701,37 @@ auto Parser::parse_return(Token& token, Tokens& tokens) -> std::unique_ptr<AST::
   }
 
   returnStatement->value = parse_expression(token, tokens);
+  if (try_match({Token::Type::COMMA}, token, tokens)) {
+    returnStatement->second = parse_expression(token, tokens);
+  }
 
   return returnStatement;
 }
 
+/**
+ * @brief Parses a declaration of the two values a call returns
+ * 
+ * @param token token found
+ * @param tokens list of tokens
+ * @return std::unique_ptr<AST::Destructure> 
+ */
+auto Parser::parse_destructure(Token& token, Tokens& tokens) -> std::unique_ptr<AST::Destructure> {
+  auto destructure = std::make_unique<AST::Destructure>();
+
+  for (size_t i = 0; i < destructure->targets.size(); ++i) {
+    if (i > 0) match({Token::Type::COMMA}, token, tokens);
+    match({Token::Type::IDENTIFIER}, token, tokens);
+    destructure->targets.at(i) = parse_declaration(token, tokens);
+    if (destructure->targets.at(i)->value) syntax_error(token, Token(Token::Type::CLOSE_PAREN));
+  }
+  match({Token::Type::CLOSE_PAREN}, token, tokens);
+  match({Token::Type::EQUAL}, token, tokens);
+  match({Token::Type::IDENTIFIER}, token, tokens);
+  destructure->call = parse_call(token, tokens);
+
+  return destructure;
+}
+
 /**
  * @brief Matches a token, if it doesn't match it prints a syntax error and exits the program
  * 
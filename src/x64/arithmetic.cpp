@@ -0,0 +1,252 @@
+/**
+ * @file arithmetic.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "x64/arithmetic.hpp"
+
+#include <array>
+#include <bit>
+#include <limits>
+
+#include "x64/addressing.hpp"
+
+namespace kuso::x64 {
+namespace {
+constexpr int64_t WORD_BITS = 64;
+
+void emit(InstructionBuffer& code, Op operation, Register reg) { code.emit(operation, Operand::from(reg)); }
+
+void emit(InstructionBuffer& code, Op operation, Register dest, Register src) {
+  code.emit(operation, Operand::from(dest), Operand::from(src));
+}
+
+void emit(InstructionBuffer& code, Op operation, Register dest, int64_t value) {
+  code.emit(operation, Operand::from(dest), Operand::from(Literal{value}));
+}
+}  // namespace
+
+/**
+ * @brief Computes the magic number of a signed division, Hacker's Delight 10-1
+ *
+ * @param divisor Divisor, its absolute value is at least 2
+ * @return Magic multiplier and shift of the division
+ */
+auto magic(int64_t divisor) -> Magic {
+  constexpr uint64_t TWO63 = 1ULL << 63U;
+
+  auto absolute = divisor < 0 ? 0 - static_cast<uint64_t>(divisor) : static_cast<uint64_t>(divisor);
+  auto bound = TWO63 + (static_cast<uint64_t>(divisor) >> 63U);
+  auto absoluteBound = bound - 1 - bound % absolute;
+
+  int64_t  shift = WORD_BITS - 1;
+  uint64_t q1 = TWO63 / absoluteBound;
+  uint64_t r1 = TWO63 - q1 * absoluteBound;
+  uint64_t q2 = TWO63 / absolute;
+  uint64_t r2 = TWO63 - q2 * absolute;
+  uint64_t delta = 0;
+  do {
+    ++shift;
+    q1 *= 2;
+    r1 *= 2;
+    if (r1 >= absoluteBound) {
+      ++q1;
+      r1 -= absoluteBound;
+    }
+    q2 *= 2;
+    r2 *= 2;
+    if (r2 >= absolute) {
+      ++q2;
+      r2 -= absolute;
+    }
+    delta = absolute - r2;
+  } while (q1 < delta || (q1 == delta && r1 == 0));
+
+  auto multiplier = static_cast<int64_t>(q2 + 1);
+  if (divisor < 0) multiplier = static_cast<int64_t>(0 - static_cast<uint64_t>(multiplier));
+  return Magic{multiplier, shift - WORD_BITS};
+}
+
+/**
+ * @brief Gets the exponent of a power of two
+ *
+ * @param value Value to check
+ * @return std::optional<int64_t> k if value is 2^k, nullopt otherwise
+ */
+auto power_of_two(int64_t value) -> std::optional<int64_t> {
+  if (value <= 0 || !std::has_single_bit(static_cast<uint64_t>(value))) return std::nullopt;
+  return std::countr_zero(static_cast<uint64_t>(value));
+}
+
+auto fits_immediate(int64_t value) -> bool {
+  return value >= std::numeric_limits<int32_t>::min() && value <= std::numeric_limits<int32_t>::max();
+}
+
+auto reduces_multiply(int64_t factor) -> bool { return fits_immediate(factor); }
+
+auto reduces_divide(int64_t divisor) -> bool { return divisor != 0 && fits_immediate(divisor); }
+
+/**
+ * @brief Raises a number to a power the way the generated code does, wrapping on overflow
+ *
+ * Negative exponents give 0
+ *
+ * @param base Base of the power
+ * @param exponent Exponent of the power
+ * @return int64_t base to the power of exponent
+ */
+auto power(int64_t base, int64_t exponent) -> int64_t {
+  if (exponent < 0) return 0;
+
+  uint64_t result = 1;
+  auto     square = static_cast<uint64_t>(base);
+  for (auto bits = static_cast<uint64_t>(exponent); bits != 0; bits >>= 1U) {
+    if ((bits & 1U) != 0) result *= square;
+    square *= square;
+  }
+  return static_cast<int64_t>(result);
+}
+
+/**
+ * @brief Multiplies a register by a constant that fits an immediate, with shifts and lea where they
+ * replace the imul
+ *
+ * @param code Buffer to emit to
+ * @param reg Register to multiply in place
+ * @param factor Constant to multiply by
+ */
+void multiply(InstructionBuffer& code, Register reg, int64_t factor) {
+  if (factor == 0) {
+    emit(code, Op::MOV, reg, 0);
+    return;
+  }
+  if (factor == 1) return;
+
+  auto absolute = factor < 0 ? -factor : factor;
+  auto shift = std::countr_zero(static_cast<uint64_t>(absolute));
+  auto odd = absolute >> shift;
+  if (odd != 1 && odd != 3 && odd != 5 && odd != 9) {
+    emit(code, Op::IMUL, reg, factor);
+    return;
+  }
+
+  if (odd != 1) {
+    auto scaled = Address{.mode = Address::Mode::SCALED, .reg = reg, .index = reg, .scale = odd - 1};
+    code.emit(Op::LEA, Operand::from(reg), Operand::from(scaled));
+  }
+  if (shift > 0) emit(code, Op::SHL, reg, shift);
+  if (factor < 0) emit(code, Op::NEG, reg);
+}
+
+/**
+ * @brief Divides rax by a nonzero constant that fits an immediate, leaving the quotient or the remainder
+ * in rax. Both round towards zero like idiv, powers of two use shifts and the rest a magic number
+ *
+ * @param code Buffer to emit to
+ * @param divisor Constant to divide by
+ * @param remainder true for the remainder, false for the quotient
+ * @param scratch Register besides rdx that may be clobbered
+ */
+void divide(InstructionBuffer& code, int64_t divisor, bool remainder, Register scratch) {
+  if (divisor == 1 || divisor == -1) {
+    if (remainder) {
+      emit(code, Op::MOV, Register::RAX, 0);
+    } else if (divisor == -1) {
+      emit(code, Op::NEG, Register::RAX);
+    }
+    return;
+  }
+
+  auto absolute = divisor < 0 ? -divisor : divisor;
+  if (auto shift = power_of_two(absolute)) {
+    // negative dividends are biased by divisor - 1 so the shift rounds towards zero
+    emit(code, Op::MOV, scratch, Register::RAX);
+    if (shift.value() > 1) emit(code, Op::SAR, scratch, WORD_BITS - 1);
+    emit(code, Op::SHR, scratch, WORD_BITS - shift.value());
+    if (remainder) {
+      emit(code, Op::ADD, scratch, Register::RAX);
+      emit(code, Op::AND, scratch, -absolute);
+      emit(code, Op::SUB, Register::RAX, scratch);
+      return;
+    }
+    emit(code, Op::ADD, Register::RAX, scratch);
+    emit(code, Op::SAR, Register::RAX, shift.value());
+    if (divisor < 0) emit(code, Op::NEG, Register::RAX);
+    return;
+  }
+
+  auto [multiplier, shift] = magic(divisor);
+  emit(code, Op::MOV, scratch, Register::RAX);
+  emit(code, Op::MOV, Register::RDX, multiplier);
+  emit(code, Op::IMUL, Register::RDX);
+  if (divisor > 0 && multiplier < 0) emit(code, Op::ADD, Register::RDX, scratch);
+  if (divisor < 0 && multiplier > 0) emit(code, Op::SUB, Register::RDX, scratch);
+  if (shift > 0) emit(code, Op::SAR, Register::RDX, shift);
+  emit(code, Op::MOV, Register::RAX, Register::RDX);
+  emit(code, Op::SHR, Register::RAX, WORD_BITS - 1);
+  emit(code, Op::ADD, Register::RAX, Register::RDX);
+  if (!remainder) return;
+
+  emit(code, Op::IMUL, Register::RAX, divisor);
+  emit(code, Op::SUB, scratch, Register::RAX);
+  emit(code, Op::MOV, Register::RAX, scratch);
+}
+
+/**
+ * @brief Raises rax to a constant power by repeated squaring, from the highest bit of the exponent down
+ *
+ * @param code Buffer to emit to
+ * @param exponent Constant exponent
+ * @param scratch Register that may be clobbered
+ */
+void power(InstructionBuffer& code, int64_t exponent, Register scratch) {
+  if (exponent <= 0) {
+    emit(code, Op::MOV, Register::RAX, exponent == 0 ? 1 : 0);
+    return;
+  }
+
+  auto bits = static_cast<uint64_t>(exponent);
+  if (!std::has_single_bit(bits)) emit(code, Op::MOV, scratch, Register::RAX);
+  for (auto bit = std::bit_width(bits) - 1; bit-- > 0;) {
+    emit(code, Op::IMUL, Register::RAX, Register::RAX);
+    if (((bits >> bit) & 1U) != 0) emit(code, Op::IMUL, Register::RAX, scratch);
+  }
+}
+
+/**
+ * @brief Raises rax to the power in a register, a square and multiply loop over the bits of the exponent
+ *
+ * @param code Buffer to emit to
+ * @param exponent Register holding the exponent, clobbered
+ * @param scratch Register that may be clobbered
+ * @param loop Label of the loop
+ * @param skip Label after the multiply of a set bit
+ * @param done Label after the loop
+ */
+void power(InstructionBuffer& code, Register exponent, Register scratch, LabelId loop, LabelId skip,
+           LabelId done) {
+  emit(code, Op::MOV, scratch, Register::RAX);
+  emit(code, Op::MOV, Register::RAX, 1);
+  emit(code, Op::TEST, exponent, exponent);
+  code.emit(Op::JG, Operand::label(loop));
+  code.emit(Op::JE, Operand::label(done));
+  emit(code, Op::MOV, Register::RAX, 0);
+  code.emit(Op::JMP, Operand::label(done));
+
+  code.define(loop);
+  emit(code, Op::TEST, exponent, 1);
+  code.emit(Op::JE, Operand::label(skip));
+  emit(code, Op::IMUL, Register::RAX, scratch);
+  code.define(skip);
+  emit(code, Op::IMUL, scratch, scratch);
+  emit(code, Op::SHR, exponent, 1);
+  code.emit(Op::JNE, Operand::label(loop));
+  code.define(done);
+}
+}  // namespace kuso::x64
@@ -0,0 +1,148 @@
+/**
+ * @file instruction.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "x64/instruction.hpp"
+
+#include <fmt/format.h>
+
+namespace kuso::x64 {
+auto Operand::from(Register reg) -> Operand { return Operand{.reg = reg, .kind = Kind::REGISTER}; }
+
+/**
+ * @brief Creates an operand from an address, direct register addresses become register operands
+ *
+ * @param addr Address of the operand
+ * @return Operand register or memory operand
+ */
+auto Operand::from(Address addr) -> Operand {
+  if (addr.mode == Address::Mode::DIRECT && addr.reg != Register::NONE) return from(addr.reg);
+  return Operand{.value = addr.disp,
+                 .reg = addr.reg,
+                 .index = addr.index,
+                 .mode = addr.mode,
+                 .kind = Kind::ADDRESS,
+                 .scale = static_cast<uint8_t>(addr.scale)};
+}
+
+auto Operand::from(Literal lit) -> Operand { return Operand{.value = lit.value, .kind = Kind::IMMEDIATE}; }
+
+auto Operand::label(LabelId label) -> Operand { return Operand{.value = label, .kind = Kind::LABEL}; }
+
+auto Operand::with_size(Size operandSize) const -> Operand {
+  auto operand = *this;
+  operand.size = operandSize;
+  operand.sized = true;
+  return operand;
+}
+
+auto Operand::address() const -> Address {
+  if (kind == Kind::REGISTER) return Address{Address::Mode::DIRECT, reg, 0};
+  return Address{mode, reg, value, index, scale};
+}
+
+void InstructionBuffer::emit(Op operation) { _instructions.push_back(Instruction{.op = operation}); }
+
+void InstructionBuffer::emit(Op operation, const Operand& operand) {
+  _instructions.push_back(Instruction{.operands = {operand, Operand{}}, .op = operation, .count = 1});
+}
+
+void InstructionBuffer::emit(Op operation, const Operand& dest, const Operand& src) {
+  _instructions.push_back(Instruction{.operands = {dest, src}, .op = operation, .count = 2});
+}
+
+void InstructionBuffer::define(LabelId label) {
+  _instructions.push_back(
+      Instruction{.operands = {Operand::label(label), Operand{}}, .kind = Instruction::Kind::LABEL});
+}
+
+/**
+ * @brief Appends text that is written out as is, one line of output
+ *
+ * @param value Text to append
+ */
+void InstructionBuffer::text(std::string value) {
+  auto index = static_cast<int64_t>(_texts.size());
+  _texts.push_back(std::move(value));
+  _instructions.push_back(Instruction{.operands = {Operand{.value = index}, Operand{}},
+                                      .kind = Instruction::Kind::TEXT});
+}
+
+/**
+ * @brief Gets the id of a label, new names get the next id
+ *
+ * @param name Name of the label
+ * @return LabelId id of the label
+ */
+auto InstructionBuffer::label(const std::string& name) -> LabelId {
+  auto [label, inserted] = _labelIds.try_emplace(name, static_cast<LabelId>(_labels.size()));
+  if (inserted) _labels.push_back(name);
+  return label->second;
+}
+
+auto InstructionBuffer::label_name(LabelId label) const -> const std::string& {
+  return _labels.at(static_cast<size_t>(label));
+}
+
+/**
+ * @brief Turns the buffer into NASM assembly, one instruction per line
+ *
+ * @return std::string assembly
+ */
+auto InstructionBuffer::render() const -> std::string {
+  std::string output;
+  output.reserve(_instructions.size() * 16);
+
+  for (const auto& inst : _instructions) {
+    switch (inst.kind) {
+      case Instruction::Kind::TEXT:
+        output.append(_texts.at(static_cast<size_t>(inst.operands[0].value)));
+        break;
+      case Instruction::Kind::LABEL:
+        output.append(label_name(inst.operands[0].value));
+        output.push_back(':');
+        break;
+      case Instruction::Kind::OP:
+        output.append(to_string(inst.op));
+        for (uint8_t operand = 0; operand < inst.count; ++operand) {
+          output.append(operand == 0 ? " " : ", ");
+          render(output, inst.operands.at(operand));
+        }
+        break;
+    }
+    output.push_back('\n');
+  }
+  return output;
+}
+
+void InstructionBuffer::render(std::string& output, const Operand& operand) const {
+  if (operand.sized) {
+    output.append(to_string(operand.size));
+    output.push_back(' ');
+  }
+
+  switch (operand.kind) {
+    case Operand::Kind::REGISTER:
+      output.append(to_string(operand.reg));
+      break;
+    case Operand::Kind::ADDRESS:
+      output.append(operand.address().to_string());
+      break;
+    case Operand::Kind::IMMEDIATE:
+      output.append(std::to_string(operand.value));
+      break;
+    case Operand::Kind::LABEL:
+      output.append(label_name(operand.value));
+      break;
+    case Operand::Kind::NONE:
+      throw std::runtime_error("Invalid Operand");
+  }
+}
+}  // namespace kuso::x64
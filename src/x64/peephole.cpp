@@ -0,0 +1,480 @@
+/**
+ * @file peephole.cpp
+ * @author Rolland Goodenough (goodenoughr@gmail.com)
+ * @date 2026-10-18
+ *
+ * @copyright Copyright 2023 Rolland Goodenough
+ *
+ * This file is part of kuso which is released under the MIT License
+ * See file LICENSE for the full License
+ */
+
+#include "x64/peephole.hpp"
+
+#include <array>
+#include <initializer_list>
+
+#include <fmt/format.h>
+
+#include "x64/arithmetic.hpp"
+
+namespace kuso::x64 {
+namespace {
+using Registers = uint32_t;
+
+/**
+ * @brief What an instruction does to the registers and the flags
+ *
+ * Only registers that are overwritten as a whole count as written, partial writes merge with the old
+ * value and count as reads. A barrier is anything control can enter or leave through other than falling
+ * through, or code the pass knows nothing about.
+ */
+struct Effects {
+  Registers reads{0};
+  Registers writes{0};
+  bool      flagsRead{false};
+  bool      flagsWritten{false};
+  bool      barrier{false};
+  bool      exits{false};
+};
+
+auto bit(Register reg) -> Registers {
+  auto full = full_register(reg);
+  if (full == Register::NONE) return 0;
+  return 1U << static_cast<uint32_t>(full);
+}
+
+auto bits(std::initializer_list<Register> regs) -> Registers {
+  Registers mask = 0;
+  for (auto reg : regs) mask |= bit(reg);
+  return mask;
+}
+
+void read(Effects& effects, const Operand& operand) {
+  if (operand.kind == Operand::Kind::REGISTER || operand.kind == Operand::Kind::ADDRESS) {
+    effects.reads |= bit(operand.reg) | bit(operand.index);
+  }
+}
+
+void write(Effects& effects, const Operand& operand) {
+  if (operand.kind != Operand::Kind::REGISTER) {
+    read(effects, operand);
+    return;
+  }
+
+  // 32 bit writes zero the upper half, smaller ones keep it
+  auto size = register_size(operand.reg);
+  if (size == Size::QWORD || size == Size::DWORD) {
+    effects.writes |= bit(operand.reg);
+  } else {
+    effects.reads |= bit(operand.reg);
+  }
+}
+
+auto effects(const Instruction& inst) -> Effects {
+  Effects effects;
+  if (inst.kind != Instruction::Kind::OP) {
+    effects.barrier = true;
+    return effects;
+  }
+
+  const auto& dest = inst.operands[0];
+  const auto& src = inst.operands[1];
+  switch (inst.op) {
+    case Op::MOV:
+    case Op::MOVL:
+    case Op::MOVZX:
+    case Op::MOVSX:
+    case Op::MOVSXD:
+    case Op::LEA:
+      read(effects, src);
+      write(effects, dest);
+      break;
+    case Op::XOR:
+      // xor r, r only writes r
+      if (dest.kind == Operand::Kind::REGISTER && dest == src) {
+        write(effects, dest);
+        effects.flagsWritten = true;
+        break;
+      }
+      [[fallthrough]];
+    case Op::ADD:
+    case Op::SUB:
+    case Op::AND:
+    case Op::OR:
+    case Op::SHL:
+    case Op::SHR:
+    case Op::SAR:
+    case Op::CMP:
+    case Op::TEST:
+      read(effects, dest);
+      read(effects, src);
+      effects.flagsWritten = true;
+      break;
+    case Op::IMUL:
+    case Op::MUL:
+    case Op::IDIV:
+    case Op::DIV:
+      read(effects, dest);
+      read(effects, src);
+      if (inst.count == 1) effects.reads |= bits({Register::RAX, Register::RDX});
+      effects.flagsWritten = true;
+      break;
+    case Op::NEG:
+      read(effects, dest);
+      effects.flagsWritten = true;
+      break;
+    case Op::NOT:
+      read(effects, dest);
+      break;
+    case Op::SETE:
+    case Op::SETNE:
+    case Op::SETG:
+    case Op::SETGE:
+    case Op::SETL:
+    case Op::SETLE:
+      read(effects, dest);
+      effects.flagsRead = true;
+      break;
+    case Op::JE:
+    case Op::JNE:
+    case Op::JG:
+    case Op::JGE:
+    case Op::JL:
+    case Op::JLE:
+      effects.flagsRead = true;
+      effects.barrier = true;
+      break;
+    case Op::JMP:
+      effects.barrier = true;
+      break;
+    case Op::PUSH:
+      read(effects, dest);
+      effects.reads |= bit(Register::RSP);
+      break;
+    case Op::POP:
+      write(effects, dest);
+      effects.reads |= bit(Register::RSP);
+      break;
+    case Op::CALL:
+      effects.reads |= bits({Register::RDI, Register::RSI, Register::RDX, Register::RCX, Register::R8,
+                             Register::R9, Register::RSP});
+      effects.writes |= bits({Register::RAX, Register::RDX, Register::R10, Register::R11});
+      effects.flagsWritten = true;
+      break;
+    case Op::RET:
+      effects.reads |= bits({Register::RAX, Register::RDX, Register::RSP, Register::RBP, Register::RBX,
+                             Register::R12, Register::R13, Register::R14, Register::R15});
+      effects.exits = true;
+      break;
+    case Op::SYSCALL:
+      effects.reads |= bits({Register::RAX, Register::RDI, Register::RSI, Register::RDX, Register::R10,
+                             Register::R8, Register::R9});
+      effects.writes |= bits({Register::RCX, Register::R11});
+      break;
+    case Op::CQO:
+      effects.reads |= bit(Register::RAX);
+      effects.writes |= bit(Register::RDX);
+      break;
+    case Op::LEAVE:
+      effects.reads |= bit(Register::RBP);
+      break;
+    case Op::NOP:
+      break;
+    default:
+      effects.barrier = true;
+      break;
+  }
+  return effects;
+}
+
+auto instruction(Op operation, const Operand& dest, const Operand& src) -> Instruction {
+  return Instruction{.operands = {dest, src}, .op = operation, .count = 2};
+}
+
+auto instruction(Op operation, const Operand& operand) -> Instruction {
+  return Instruction{.operands = {operand, Operand{}}, .op = operation, .count = 1};
+}
+
+auto is(const Instruction& inst, Op operation) -> bool {
+  return inst.kind == Instruction::Kind::OP && inst.op == operation;
+}
+
+auto is_register(const Operand& operand) -> bool {
+  return operand.kind == Operand::Kind::REGISTER && register_size(operand.reg) == Size::QWORD;
+}
+
+auto is_move(const Instruction& inst) -> bool {
+  return inst.kind == Instruction::Kind::OP && inst.count == 2 &&
+         (inst.op == Op::MOV || inst.op == Op::LEA || inst.op == Op::MOVZX || inst.op == Op::MOVSX ||
+          inst.op == Op::MOVSXD);
+}
+
+auto is_jump(const Instruction& inst) -> bool {
+  if (inst.kind != Instruction::Kind::OP || inst.operands[0].kind != Operand::Kind::LABEL) return false;
+  switch (inst.op) {
+    case Op::JMP:
+    case Op::JE:
+    case Op::JNE:
+    case Op::JG:
+    case Op::JGE:
+    case Op::JL:
+    case Op::JLE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+auto is_zero(const Operand& operand) -> bool {
+  return operand.kind == Operand::Kind::IMMEDIATE && operand.value == 0;
+}
+
+auto unsized(Operand operand) -> Operand {
+  operand.sized = false;
+  return operand;
+}
+
+// push x / pop y -> mov y, x
+auto push_pop(const Peephole&, std::span<const Instruction> window) -> Peephole::Replacement {
+  if (!is(window[0], Op::PUSH) || !is(window[1], Op::POP)) return std::nullopt;
+
+  auto src = unsized(window[0].operands[0]);
+  auto dest = unsized(window[1].operands[0]);
+  if (dest.kind != Operand::Kind::REGISTER) return std::nullopt;
+  if (src == dest) return std::vector<Instruction>{};
+  return std::vector<Instruction>{instruction(Op::MOV, dest, src)};
+}
+
+// mov r, r ->
+auto self_move(const Peephole&, std::span<const Instruction> window) -> Peephole::Replacement {
+  const auto& inst = window[0];
+  if (!is(inst, Op::MOV) || !is_register(inst.operands[0]) || inst.operands[0] != inst.operands[1]) {
+    return std::nullopt;
+  }
+  return std::vector<Instruction>{};
+}
+
+// mov a, x / mov b, a -> mov b, x when a is not read afterwards
+auto move_chain(const Peephole& peephole, std::span<const Instruction> window) -> Peephole::Replacement {
+  const auto& first = window[0];
+  const auto& second = window[1];
+  if (!is(first, Op::MOV) || !is(second, Op::MOV)) return std::nullopt;
+  if (!is_register(first.operands[0]) || !is_register(second.operands[0])) return std::nullopt;
+  if (second.operands[1] != first.operands[0] || peephole.live_after(first.operands[0].reg)) {
+    return std::nullopt;
+  }
+  return std::vector<Instruction>{instruction(Op::MOV, second.operands[0], first.operands[1])};
+}
+
+// mov a, x / push a -> push x when a is not read afterwards
+auto move_push(const Peephole& peephole, std::span<const Instruction> window) -> Peephole::Replacement {
+  const auto& move = window[0];
+  const auto& push = window[1];
+  if (!is(move, Op::MOV) || !is(push, Op::PUSH) || !is_register(move.operands[0])) return std::nullopt;
+  if (unsized(push.operands[0]) != move.operands[0] || peephole.live_after(move.operands[0].reg)) {
+    return std::nullopt;
+  }
+
+  const auto& src = move.operands[1];
+  if (src.kind == Operand::Kind::IMMEDIATE && !fits_immediate(src.value)) return std::nullopt;
+  if (src.kind == Operand::Kind::REGISTER && !is_register(src)) return std::nullopt;
+  return std::vector<Instruction>{instruction(Op::PUSH, src.with_size(Size::QWORD))};
+}
+
+// mov [m], a / mov b, [m] -> mov [m], a / mov b, a
+auto store_load(const Peephole&, std::span<const Instruction> window) -> Peephole::Replacement {
+  const auto& store = window[0];
+  const auto& load = window[1];
+  if (!is(store, Op::MOV) || !is(load, Op::MOV)) return std::nullopt;
+  if (store.operands[0].kind != Operand::Kind::ADDRESS || !is_register(store.operands[1]) ||
+      !is_register(load.operands[0]) || unsized(load.operands[1]) != unsized(store.operands[0])) {
+    return std::nullopt;
+  }
+
+  if (load.operands[0] == store.operands[1]) return std::vector<Instruction>{store};
+  return std::vector<Instruction>{store, instruction(Op::MOV, load.operands[0], store.operands[1])};
+}
+
+// jmp l / l: -> l:
+auto jump_next(const Peephole&, std::span<const Instruction> window) -> Peephole::Replacement {
+  const auto& label = window[1];
+  if (!is_jump(window[0]) || label.kind != Instruction::Kind::LABEL) return std::nullopt;
+  if (window[0].operands[0] != label.operands[0]) return std::nullopt;
+  return std::vector<Instruction>{label};
+}
+
+// jmp label / mov rax, 1 -> jmp label, nothing falls into an instruction after a jump or ret
+auto unreachable(const Peephole&, std::span<const Instruction> window) -> Peephole::Replacement {
+  if (!is(window[0], Op::RET) && !(is(window[0], Op::JMP) && is_jump(window[0]))) return std::nullopt;
+  if (window[1].kind != Instruction::Kind::OP) return std::nullopt;
+  return std::vector<Instruction>{window[0]};
+}
+
+// movzx rax, al / cmp rax, 0 -> test al, al when rax is not read afterwards
+auto bool_test(const Peephole& peephole, std::span<const Instruction> window) -> Peephole::Replacement {
+  const auto& extend = window[0];
+  const auto& compare = window[1];
+  if (!is(extend, Op::MOVZX) || !is(compare, Op::CMP) || !is_register(extend.operands[0])) {
+    return std::nullopt;
+  }
+
+  const auto& byte = extend.operands[1];
+  if (byte.kind != Operand::Kind::REGISTER || register_size(byte.reg) != Size::BYTE ||
+      full_register(byte.reg) != extend.operands[0].reg) {
+    return std::nullopt;
+  }
+  if (compare.operands[0] != extend.operands[0] || !is_zero(compare.operands[1]) ||
+      peephole.live_after(extend.operands[0].reg)) {
+    return std::nullopt;
+  }
+  return std::vector<Instruction>{instruction(Op::TEST, byte, byte)};
+}
+
+// cmp r, 0 -> test r, r, both leave the same flags
+auto compare_zero(const Peephole&, std::span<const Instruction> window) -> Peephole::Replacement {
+  const auto& compare = window[0];
+  if (!is(compare, Op::CMP) || compare.operands[0].kind != Operand::Kind::REGISTER ||
+      !is_zero(compare.operands[1])) {
+    return std::nullopt;
+  }
+  return std::vector<Instruction>{instruction(Op::TEST, compare.operands[0], compare.operands[0])};
+}
+
+// mov r, x -> when r is not read afterwards
+auto dead_move(const Peephole& peephole, std::span<const Instruction> window) -> Peephole::Replacement {
+  const auto& move = window[0];
+  if (!is_move(move) || move.operands[0].kind != Operand::Kind::REGISTER) return std::nullopt;
+
+  auto reg = full_register(move.operands[0].reg);
+  if (reg == Register::RSP || reg == Register::RBP || peephole.live_after(reg)) return std::nullopt;
+  return std::vector<Instruction>{};
+}
+
+// mov r, 0 -> xor r32, r32 when the flags are not read afterwards
+auto zero_idiom(const Peephole& peephole, std::span<const Instruction> window) -> Peephole::Replacement {
+  const auto& move = window[0];
+  if (!is(move, Op::MOV) || !is_register(move.operands[0])) return std::nullopt;
+  if (!is_zero(move.operands[1]) || peephole.flags_live_after()) return std::nullopt;
+
+  auto reg = Operand::from(sized_register(move.operands[0].reg, Size::DWORD));
+  return std::vector<Instruction>{instruction(Op::XOR, reg, reg)};
+}
+
+// rules that only change the encoding run in the last sweep, so they don't hide patterns from the others
+constexpr std::array<Peephole::Rule, 11> RULES{{
+    {"push-pop", 2, 0, push_pop},
+    {"self-move", 1, 0, self_move},
+    {"move-chain", 2, 0, move_chain},
+    {"move-push", 2, 0, move_push},
+    {"store-load", 2, 0, store_load},
+    {"jump-next", 2, 0, jump_next},
+    {"unreachable", 2, 0, unreachable},
+    {"bool-test", 2, 0, bool_test},
+    {"dead-move", 1, 0, dead_move},
+    {"compare-zero", 1, 1, compare_zero},
+    {"zero-idiom", 1, 1, zero_idiom},
+}};
+
+constexpr size_t SWEEPS = 2;
+}  // namespace
+
+/**
+ * @brief Rewrites the instructions of a buffer in place
+ *
+ * @param code Buffer to rewrite
+ */
+void Peephole::run(InstructionBuffer& code) {
+  if (_stats.empty()) {
+    for (const auto& rule : RULES) _stats.push_back(RuleStats{.name = rule.name});
+  }
+
+  for (size_t sweep = 0; sweep < SWEEPS; ++sweep) {
+    _input = std::move(code.instructions());
+    _output.clear();
+    _output.reserve(_input.size());
+
+    for (_next = 0; _next < _input.size();) {
+      _output.push_back(_input[_next++]);
+      reduce(sweep);
+    }
+
+    code.instructions() = std::move(_output);
+  }
+  _input.clear();
+  _output.clear();
+}
+
+/**
+ * @brief Applies the rules of a sweep to the end of the rewritten code until none matches
+ *
+ * @param sweep Sweep the rules belong to
+ */
+void Peephole::reduce(size_t sweep) {
+  auto matched = true;
+  while (matched) {
+    matched = false;
+    for (size_t rule = 0; rule < RULES.size() && !matched; ++rule) {
+      auto length = RULES.at(rule).length;
+      if (RULES.at(rule).sweep != sweep || _output.size() < length) continue;
+
+      auto window = std::span<const Instruction>(_output).last(length);
+      auto replacement = RULES.at(rule).rewrite(*this, window);
+      if (!replacement) continue;
+
+      _output.resize(_output.size() - length);
+      _output.insert(_output.end(), replacement->begin(), replacement->end());
+      _stats.at(rule).applied++;
+      _stats.at(rule).removed += static_cast<int64_t>(length - replacement->size());
+      matched = true;
+    }
+  }
+}
+
+/**
+ * @brief Checks if a register may be read before it is overwritten, after the current window
+ *
+ * @param reg Register to check
+ * @return true If the value in the register may still be used
+ */
+auto Peephole::live_after(Register reg) const -> bool {
+  auto target = bit(reg);
+  for (auto inst = _next; inst < _input.size(); ++inst) {
+    auto effect = effects(_input[inst]);
+    if (effect.barrier || (effect.reads & target) != 0) return true;
+    if ((effect.writes & target) != 0 || effect.exits) return false;
+  }
+  return false;
+}
+
+/**
+ * @brief Checks if the flags may be read before they are overwritten, after the current window
+ *
+ * @return true If the flags may still be used
+ */
+auto Peephole::flags_live_after() const -> bool {
+  for (auto inst = _next; inst < _input.size(); ++inst) {
+    auto effect = effects(_input[inst]);
+    if (effect.barrier || effect.flagsRead) return true;
+    if (effect.flagsWritten || effect.exits) return false;
+  }
+  return false;
+}
+
+/**
+ * @brief Creates a report of how often every rule matched and how many instructions it removed
+ *
+ * @return std::string report
+ */
+auto Peephole::to_string() const -> std::string {
+  std::string report = fmt::format("{:<20}{:>8}{:>10}\n", "peephole rule", "applied", "removed");
+
+  int64_t removed = 0;
+  for (const auto& rule : _stats) {
+    report += fmt::format("{:<20}{:>8}{:>10}\n", rule.name, rule.applied, rule.removed);
+    removed += rule.removed;
+  }
+  report += fmt::format("{:<28}{:>10}\n", "total", removed);
+  return report;
+}
+}  // namespace kuso::x64